@@ -38,6 +38,13 @@ extern "C"
     esp_err_t api_schema_get_handler(httpd_req_t *req);
     esp_err_t api_schema_post_handler(httpd_req_t *req);
 
+    // Animation API
+    esp_err_t api_animation_post_handler(httpd_req_t *req);
+    esp_err_t api_animation_upload_handler(httpd_req_t *req);
+
+    // Effect script API
+    esp_err_t api_script_upload_handler(httpd_req_t *req);
+
     // Thread Devices API
     esp_err_t api_thread_devices_get_handler(httpd_req_t *req);
     esp_err_t api_thread_devices_add_handler(httpd_req_t *req);
@@ -58,6 +65,12 @@ extern "C"
     esp_err_t api_scenes_delete_handler(httpd_req_t *req);
     esp_err_t api_scenes_activate_handler(httpd_req_t *req);
 
+    // Diagnostics API
+    esp_err_t api_diagnostics_handler(httpd_req_t *req);
+    esp_err_t api_diagnostics_messages_handler(httpd_req_t *req);
+    esp_err_t api_diagnostics_message_log_handler(httpd_req_t *req);
+    esp_err_t api_diagnostics_message_log_post_handler(httpd_req_t *req);
+
     // Static file serving
     esp_err_t api_static_file_handler(httpd_req_t *req);
 
@@ -2,8 +2,21 @@
 #define COMMON_H
 
 #include <cJSON.h>
+#include "settings_registry.h"
+
+// Settings the light status JSON depends on (for message_manager_subscribe)
+#define LIGHT_STATUS_SETTINGS (SETTING_MASK(LIGHT_ACTIVE) | SETTING_MASK(LIGHT_MODE) | SETTING_MASK(LIGHT_VARIANT))
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
 
 void common_init(void);
 cJSON *create_light_status_json(void);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // COMMON_H
@@ -124,6 +124,25 @@ esp_err_t api_handlers_register(httpd_handle_t server)
     if (err != ESP_OK)
         return err;
 
+    // Animation endpoints, the exact URI has to be registered before the wildcard
+    httpd_uri_t animation_post = {
+        .uri = "/api/animation", .method = HTTP_POST, .handler = api_animation_post_handler};
+    err = httpd_register_uri_handler(server, &animation_post);
+    if (err != ESP_OK)
+        return err;
+
+    httpd_uri_t animation_upload = {
+        .uri = "/api/animation/*", .method = HTTP_POST, .handler = api_animation_upload_handler};
+    err = httpd_register_uri_handler(server, &animation_upload);
+    if (err != ESP_OK)
+        return err;
+
+    httpd_uri_t script_upload = {
+        .uri = "/api/script/*", .method = HTTP_POST, .handler = api_script_upload_handler};
+    err = httpd_register_uri_handler(server, &script_upload);
+    if (err != ESP_OK)
+        return err;
+
     // Thread device endpoints
     httpd_uri_t thread_devices_get = {
         .uri = "/api/thread/devices", .method = HTTP_GET, .handler = api_thread_devices_get_handler};
@@ -214,6 +233,31 @@ esp_err_t api_handlers_register(httpd_handle_t server)
     if (err != ESP_OK)
         return err;
 
+    // Diagnostics endpoints
+    httpd_uri_t diagnostics = {.uri = "/api/diagnostics", .method = HTTP_GET, .handler = api_diagnostics_handler};
+    err = httpd_register_uri_handler(server, &diagnostics);
+    if (err != ESP_OK)
+        return err;
+
+    httpd_uri_t diagnostics_messages = {
+        .uri = "/api/diagnostics/messages", .method = HTTP_GET, .handler = api_diagnostics_messages_handler};
+    err = httpd_register_uri_handler(server, &diagnostics_messages);
+    if (err != ESP_OK)
+        return err;
+
+    httpd_uri_t diagnostics_message_log = {
+        .uri = "/api/diagnostics/messages/log", .method = HTTP_GET, .handler = api_diagnostics_message_log_handler};
+    err = httpd_register_uri_handler(server, &diagnostics_message_log);
+    if (err != ESP_OK)
+        return err;
+
+    httpd_uri_t diagnostics_message_log_post = {.uri = "/api/diagnostics/messages/log",
+                                                .method = HTTP_POST,
+                                                .handler = api_diagnostics_message_log_post_handler};
+    err = httpd_register_uri_handler(server, &diagnostics_message_log_post);
+    if (err != ESP_OK)
+        return err;
+
     // Captive portal detection endpoints
     httpd_uri_t captive_generate_204 = {
         .uri = "/generate_204", .method = HTTP_GET, .handler = api_captive_portal_handler};
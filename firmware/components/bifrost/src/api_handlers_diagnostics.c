@@ -0,0 +1,299 @@
+#include "bifrost/api_handlers.h"
+#include "bifrost/api_handlers_util.h"
+#include "led_anim.h"
+#include "led_effect.h"
+#include "led_power.h"
+#include "led_realtime.h"
+#include "led_script.h"
+#include "led_strip_ws2812.h"
+#include "led_transition.h"
+#include "message_manager.h"
+#include "persistence_manager.h"
+
+#include <cJSON.h>
+#include <esp_log.h>
+#include <sdkconfig.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "api_diagnostics";
+
+// ============================================================================
+// Diagnostics API
+// ============================================================================
+
+esp_err_t api_diagnostics_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "GET /api/diagnostics");
+
+    cJSON *json = cJSON_CreateObject();
+
+    led_effect_stats_t effect_stats;
+    led_effect_get_stats(&effect_stats);
+    cJSON *effects = cJSON_CreateObject();
+    cJSON_AddNumberToObject(effects, "segments", effect_stats.active_segments);
+    cJSON_AddNumberToObject(effects, "pixels", effect_stats.active_pixels);
+    cJSON_AddNumberToObject(effects, "avg_us", effect_stats.avg_us);
+    cJSON_AddNumberToObject(effects, "max_us", effect_stats.max_us);
+    cJSON_AddItemToObject(json, "effects", effects);
+
+    led_script_stats_t script_stats;
+    led_script_get_stats(&script_stats);
+    cJSON *scripts = cJSON_CreateObject();
+    cJSON_AddNumberToObject(scripts, "segments", script_stats.active_segments);
+    cJSON_AddNumberToObject(scripts, "instructions", script_stats.instructions);
+    cJSON_AddNumberToObject(scripts, "budget", CONFIG_LED_SCRIPT_BUDGET);
+    cJSON_AddNumberToObject(scripts, "budget_frames", script_stats.budget_frames);
+    cJSON_AddNumberToObject(scripts, "avg_us", script_stats.avg_us);
+    cJSON_AddNumberToObject(scripts, "max_us", script_stats.max_us);
+    cJSON_AddItemToObject(json, "scripts", scripts);
+
+    led_strip_stats_t strip_stats;
+    led_strip_get_stats(&strip_stats);
+    cJSON *strip = cJSON_CreateObject();
+    cJSON_AddNumberToObject(strip, "commands", strip_stats.commands);
+    cJSON_AddNumberToObject(strip, "dropped", strip_stats.dropped_commands);
+    cJSON_AddItemToObject(json, "strip", strip);
+
+    led_transition_stats_t transition_stats;
+    led_transition_get_stats(&transition_stats);
+    cJSON *transition = cJSON_CreateObject();
+    cJSON_AddBoolToObject(transition, "active", transition_stats.active);
+    cJSON_AddNumberToObject(transition, "count", transition_stats.transitions);
+    cJSON_AddNumberToObject(transition, "last_us", transition_stats.last_us);
+    cJSON_AddNumberToObject(transition, "max_us", transition_stats.max_us);
+    cJSON_AddItemToObject(json, "transition", transition);
+
+    led_power_stats_t power_stats;
+    led_power_get_stats(&power_stats);
+    cJSON *power = cJSON_CreateObject();
+    cJSON_AddNumberToObject(power, "budget_ma", power_stats.budget_ma);
+    cJSON_AddNumberToObject(power, "estimate_ma", power_stats.estimate_ma);
+    cJSON_AddNumberToObject(power, "output_ma", power_stats.output_ma);
+    cJSON_AddNumberToObject(power, "scale", power_stats.scale);
+    cJSON_AddNumberToObject(power, "limited_frames", power_stats.limited_frames);
+    cJSON_AddItemToObject(json, "power", power);
+
+    led_anim_stats_t anim_stats;
+    led_anim_get_stats(&anim_stats);
+    cJSON *animation = cJSON_CreateObject();
+    cJSON_AddBoolToObject(animation, "playing", anim_stats.playing);
+    cJSON_AddStringToObject(animation, "file", anim_stats.file);
+    cJSON_AddNumberToObject(animation, "frames", anim_stats.frames);
+    cJSON_AddNumberToObject(animation, "skipped", anim_stats.skipped);
+    cJSON_AddNumberToObject(animation, "underruns", anim_stats.underruns);
+    cJSON_AddNumberToObject(animation, "errors", anim_stats.errors);
+    cJSON_AddNumberToObject(animation, "decode_max_us", anim_stats.decode_max_us);
+    cJSON_AddItemToObject(json, "animation", animation);
+
+    led_realtime_stats_t realtime_stats;
+    led_realtime_get_stats(&realtime_stats);
+    cJSON *realtime = cJSON_CreateObject();
+    cJSON_AddBoolToObject(realtime, "active", realtime_stats.active);
+    cJSON_AddNumberToObject(realtime, "packets", realtime_stats.packets);
+    cJSON_AddNumberToObject(realtime, "invalid_packets", realtime_stats.invalid_packets);
+    cJSON_AddNumberToObject(realtime, "lost_packets", realtime_stats.lost_packets);
+    cJSON_AddNumberToObject(realtime, "frames", realtime_stats.frames);
+    cJSON_AddNumberToObject(realtime, "incomplete_frames", realtime_stats.incomplete_frames);
+    cJSON_AddNumberToObject(realtime, "superseded_frames", realtime_stats.superseded_frames);
+    cJSON_AddNumberToObject(realtime, "timeouts", realtime_stats.timeouts);
+    cJSON_AddNumberToObject(realtime, "fps", realtime_stats.fps);
+    cJSON_AddNumberToObject(realtime, "latency_avg_us", realtime_stats.latency_avg_us);
+    cJSON_AddNumberToObject(realtime, "latency_max_us", realtime_stats.latency_max_us);
+    cJSON_AddItemToObject(json, "realtime", realtime);
+
+    message_manager_stats_t message_stats;
+    message_manager_get_stats(&message_stats);
+    cJSON *messages = cJSON_CreateObject();
+    cJSON_AddNumberToObject(messages, "delivered", message_stats.delivered);
+    cJSON_AddNumberToObject(messages, "avoided", message_stats.avoided);
+    cJSON_AddNumberToObject(messages, "dropped", message_stats.dropped);
+    cJSON_AddNumberToObject(messages, "inbox_dropped", message_stats.inbox_dropped);
+    cJSON_AddNumberToObject(messages, "coalesced", message_stats.coalesced);
+    cJSON_AddNumberToObject(messages, "superseded", message_stats.superseded);
+    cJSON_AddNumberToObject(messages, "ring_dropped", message_stats.ring_dropped);
+    cJSON *lane_peak = cJSON_CreateObject();
+    cJSON_AddNumberToObject(lane_peak, "interactive", message_stats.lane_peak[MESSAGE_LANE_INTERACTIVE]);
+    cJSON_AddNumberToObject(lane_peak, "state", message_stats.lane_peak[MESSAGE_LANE_STATE]);
+    cJSON_AddNumberToObject(lane_peak, "telemetry", message_stats.lane_peak[MESSAGE_LANE_TELEMETRY]);
+    cJSON_AddItemToObject(messages, "lane_peak", lane_peak);
+    cJSON_AddItemToObject(json, "messages", messages);
+
+    persistence_manager_write_stats_t write_stats;
+    persistence_manager_cache_stats_t cache_stats;
+    persistence_manager_get_write_stats(&write_stats);
+    persistence_manager_get_cache_stats(&cache_stats);
+    cJSON *settings = cJSON_CreateObject();
+    cJSON_AddNumberToObject(settings, "writes", write_stats.writes);
+    cJSON_AddNumberToObject(settings, "flash_writes", write_stats.flash_writes);
+    cJSON_AddNumberToObject(settings, "saved", write_stats.saved);
+    cJSON_AddNumberToObject(settings, "commits", write_stats.commits);
+    cJSON_AddNumberToObject(settings, "pending", write_stats.pending);
+    cJSON_AddNumberToObject(settings, "cache_hits", cache_stats.hits);
+    cJSON_AddNumberToObject(settings, "cache_misses", cache_stats.misses);
+    cJSON_AddItemToObject(json, "settings", settings);
+
+    char *response = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    esp_err_t res = send_json_response(req, response);
+    free(response);
+    return res;
+}
+
+static cJSON *create_histogram_json(const message_histogram_t *histogram)
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "count", histogram->count);
+    cJSON_AddNumberToObject(json, "avg_us", histogram->count ? (double)(histogram->total_us / histogram->count) : 0);
+    cJSON_AddNumberToObject(json, "max_us", histogram->max_us);
+    cJSON *buckets = cJSON_CreateArray();
+    for (size_t i = 0; i < MESSAGE_TRACE_BUCKETS; i++)
+    {
+        cJSON_AddItemToArray(buckets, cJSON_CreateNumber(histogram->buckets[i]));
+    }
+    cJSON_AddItemToObject(json, "buckets", buckets);
+    return json;
+}
+
+esp_err_t api_diagnostics_messages_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "GET /api/diagnostics/messages");
+
+    // About 1.5 KB, too much for the stack of the HTTP server task
+    message_manager_trace_t *trace = malloc(sizeof(message_manager_trace_t));
+    if (!trace)
+        return send_error_response(req, 500, "Out of memory");
+    message_manager_get_trace(trace);
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON *limits = cJSON_CreateArray();
+    for (size_t i = 0; i + 1 < MESSAGE_TRACE_BUCKETS; i++)
+    {
+        cJSON_AddItemToArray(limits, cJSON_CreateNumber(message_manager_bucket_limit(i)));
+    }
+    cJSON_AddItemToObject(json, "bucket_us", limits);
+
+    static const char *const type_names[MESSAGE_TYPE_COUNT] = {
+        [MESSAGE_TYPE_SETTINGS] = "settings",
+        [MESSAGE_TYPE_BUTTON] = "button",
+        [MESSAGE_TYPE_SIMULATION] = "simulation",
+    };
+    cJSON *wait = cJSON_CreateObject();
+    for (int type = 0; type < MESSAGE_TYPE_COUNT; type++)
+    {
+        cJSON_AddItemToObject(wait, type_names[type], create_histogram_json(&trace->wait[type]));
+    }
+    cJSON_AddItemToObject(json, "wait", wait);
+
+    cJSON *listeners = cJSON_CreateArray();
+    for (size_t i = 0; i < trace->listener_count; i++)
+    {
+        const message_listener_trace_t *listener = &trace->listeners[i];
+        cJSON *item = cJSON_CreateObject();
+        if (listener->name[0])
+        {
+            cJSON_AddStringToObject(item, "name", listener->name);
+        }
+        else
+        {
+            // Called by the dispatcher, identified by the address of the callback
+            char address[20];
+            snprintf(address, sizeof(address), "%p", (void *)listener->listener);
+            cJSON_AddStringToObject(item, "name", address);
+        }
+        cJSON_AddBoolToObject(item, "executor", listener->name[0] != '\0');
+        cJSON_AddItemToObject(item, "latency", create_histogram_json(&listener->latency));
+        cJSON_AddItemToObject(item, "run", create_histogram_json(&listener->run));
+        cJSON_AddItemToArray(listeners, item);
+    }
+    cJSON_AddItemToObject(json, "listeners", listeners);
+    free(trace);
+
+    char *response = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    esp_err_t res = send_json_response(req, response);
+    free(response);
+    return res;
+}
+
+static esp_err_t send_record_status(httpd_req_t *req)
+{
+    message_record_status_t status;
+    message_manager_record_status(&status);
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "recording", status.recording);
+    cJSON_AddBoolToObject(json, "full", status.full);
+    cJSON_AddNumberToObject(json, "records", status.records);
+    cJSON_AddNumberToObject(json, "bytes", status.length);
+    cJSON_AddNumberToObject(json, "capacity", status.capacity);
+
+    char *response = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    esp_err_t res = send_json_response(req, response);
+    free(response);
+    return res;
+}
+
+esp_err_t api_diagnostics_message_log_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "GET /api/diagnostics/messages/log");
+
+    // Only the POST handler replaces the log, and it runs in the same HTTP server task
+    message_record_status_t status;
+    message_manager_record_status(&status);
+    if (!status.log)
+        return send_error_response(req, 404, "No message log recorded");
+
+    set_cors_headers(req);
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"messages.mlog\"");
+    return httpd_resp_send(req, (const char *)status.log, (ssize_t)status.length);
+}
+
+esp_err_t api_diagnostics_message_log_post_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "POST /api/diagnostics/messages/log");
+
+    char body[128];
+    int n = httpd_req_recv(req, body, sizeof(body) - 1);
+    if (n <= 0)
+        return send_error_response(req, 400, "Empty body");
+    body[n] = '\0';
+
+    cJSON *json = cJSON_Parse(body);
+    if (!json)
+        return send_error_response(req, 400, "Invalid JSON");
+
+    const cJSON *action = cJSON_GetObjectItem(json, "action");
+    const cJSON *bytes = cJSON_GetObjectItem(json, "bytes");
+    if (!is_valid(action))
+    {
+        cJSON_Delete(json);
+        return send_error_response(req, 400, "Missing action");
+    }
+
+    esp_err_t err = ESP_OK;
+    if (strcmp(action->valuestring, "start") == 0)
+    {
+        size_t capacity = cJSON_IsNumber(bytes) && bytes->valuedouble > 0 ? (size_t)bytes->valuedouble : 32 * 1024;
+        if (!message_manager_record_start(capacity))
+            err = ESP_ERR_NO_MEM;
+    }
+    else if (strcmp(action->valuestring, "stop") == 0)
+    {
+        message_manager_record_stop();
+    }
+    else
+    {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    cJSON_Delete(json);
+
+    if (err == ESP_ERR_NO_MEM)
+        return send_error_response(req, 507, "Not enough memory for the message log");
+    if (err != ESP_OK)
+        return send_error_response(req, 400, "Unknown action");
+    return send_record_status(req);
+}
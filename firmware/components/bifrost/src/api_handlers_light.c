@@ -1,7 +1,13 @@
 #include "bifrost/api_handlers.h"
 #include "bifrost/api_handlers_util.h"
 #include "bifrost/common.h"
+#include "led_anim.h"
+#include "led_calibration.h"
+#include "led_effect.h"
+#include "led_remap.h"
+#include "led_script.h"
 #include "led_segment.h"
+#include "led_transition.h"
 #include "message_manager.h"
 #include "persistence_manager.h"
 #include "storage.h"
@@ -9,6 +15,7 @@
 #include <cJSON.h>
 #include <esp_heap_caps.h>
 #include <esp_log.h>
+#include <sdkconfig.h>
 #include <string.h>
 
 static const char *TAG = "api_light";
@@ -38,12 +45,7 @@ esp_err_t api_light_power_handler(httpd_req_t *req)
         cJSON *active = cJSON_GetObjectItem(json, "on");
         if (cJSON_IsBool(active))
         {
-            message_t msg = {};
-            msg.type = MESSAGE_TYPE_SETTINGS;
-            msg.data.settings.type = SETTINGS_TYPE_BOOL;
-            strncpy(msg.data.settings.key, "light_active", sizeof(msg.data.settings.key) - 1);
-            msg.data.settings.value.bool_value = cJSON_IsTrue(active);
-            message_manager_post(&msg, pdMS_TO_TICKS(100));
+            SETTINGS_POST_BOOL(LIGHT_ACTIVE, cJSON_IsTrue(active), pdMS_TO_TICKS(100));
         }
         cJSON_Delete(json);
     }
@@ -92,27 +94,24 @@ esp_err_t api_light_mode_handler(httpd_req_t *req)
         cJSON *mode = cJSON_GetObjectItem(json, "mode");
         if (cJSON_IsString(mode))
         {
-            message_t msg = {};
-            msg.type = MESSAGE_TYPE_SETTINGS;
-            msg.data.settings.type = SETTINGS_TYPE_INT;
-            strncpy(msg.data.settings.key, "light_mode", sizeof(msg.data.settings.key) - 1);
+            int32_t light_mode;
             if (strcmp(mode->valuestring, "simulation") == 0)
             {
-                msg.data.settings.value.int_value = 0;
+                light_mode = 0;
             }
             else if (strcmp(mode->valuestring, "day") == 0)
             {
-                msg.data.settings.value.int_value = 1;
+                light_mode = 1;
             }
             else if (strcmp(mode->valuestring, "night") == 0)
             {
-                msg.data.settings.value.int_value = 2;
+                light_mode = 2;
             }
             else
             {
-                msg.data.settings.value.int_value = -1; // Unknown mode
+                light_mode = -1; // Unknown mode
             }
-            message_manager_post(&msg, pdMS_TO_TICKS(100));
+            SETTINGS_POST_INT(LIGHT_MODE, light_mode, pdMS_TO_TICKS(100));
         }
         cJSON_Delete(json);
     }
@@ -145,12 +144,7 @@ esp_err_t api_light_schema_handler(httpd_req_t *req)
             int schema_id = 0;
             sscanf(schema_file->valuestring, "schema_%d.csv", &schema_id);
 
-            message_t msg = {};
-            msg.type = MESSAGE_TYPE_SETTINGS;
-            msg.data.settings.type = SETTINGS_TYPE_INT;
-            strncpy(msg.data.settings.key, "light_variant", sizeof(msg.data.settings.key) - 1);
-            msg.data.settings.value.int_value = schema_id;
-            message_manager_post(&msg, pdMS_TO_TICKS(100));
+            SETTINGS_POST_INT(LIGHT_VARIANT, schema_id, pdMS_TO_TICKS(100));
         }
         cJSON_Delete(json);
     }
@@ -174,47 +168,193 @@ esp_err_t api_light_status_handler(httpd_req_t *req)
 // LED Configuration API
 // ============================================================================
 
-static int compare_segments_by_start(const void *a, const void *b)
+static cJSON *create_effect_json(const led_effect_config_t *effect)
 {
-    const led_segment_t *seg_a = (const led_segment_t *)a;
-    const led_segment_t *seg_b = (const led_segment_t *)b;
-    return (int)seg_a->start - (int)seg_b->start;
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "type", led_effect_type_to_string((led_effect_type_t)effect->type));
+    cJSON_AddNumberToObject(json, "speed", effect->speed);
+    cJSON_AddNumberToObject(json, "intensity", effect->intensity);
+    cJSON *c = cJSON_CreateObject();
+    cJSON_AddNumberToObject(c, "r", effect->color.red);
+    cJSON_AddNumberToObject(c, "g", effect->color.green);
+    cJSON_AddNumberToObject(c, "b", effect->color.blue);
+    cJSON_AddItemToObject(json, "color", c);
+    return json;
 }
 
-esp_err_t api_wled_config_get_handler(httpd_req_t *req)
+static uint8_t get_byte(const cJSON *object, const char *key, uint8_t default_value)
 {
-    ESP_LOGI(TAG, "GET /api/wled/config");
+    const cJSON *item = cJSON_GetObjectItem(object, key);
+    if (!cJSON_IsNumber(item))
+        return default_value;
+    if (item->valuedouble < 0)
+        return 0;
+    return item->valuedouble > 255 ? 255 : (uint8_t)item->valuedouble;
+}
+
+// Parses {"type":"fire","speed":128,"intensity":255,"color":{"r":..,"g":..,"b":..}}
+static bool parse_effect_json(const cJSON *json, led_effect_config_t *effect)
+{
+    const cJSON *type = cJSON_GetObjectItem(json, "type");
+    if (!cJSON_IsString(type))
+        return false;
 
-    extern led_segment_t segments[LED_SEGMENT_MAX_LEN];
-    extern size_t segment_count;
+    led_effect_type_t effect_type = led_effect_type_from_string(type->valuestring);
+    if (effect_type == LED_EFFECT_COUNT)
+    {
+        ESP_LOGW(TAG, "Unknown effect type: %s", type->valuestring);
+        return false;
+    }
+
+    const cJSON *c = cJSON_GetObjectItem(json, "color");
+    effect->type = (uint8_t)effect_type;
+    effect->speed = get_byte(json, "speed", 128);
+    effect->intensity = get_byte(json, "intensity", 255);
+    effect->color.red = get_byte(c, "r", 255);
+    effect->color.green = get_byte(c, "g", 180);
+    effect->color.blue = get_byte(c, "b", 80);
+    return true;
+}
 
+static cJSON *create_remap_json(const led_remap_config_t *remap)
+{
     cJSON *json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "offset", remap->offset);
+    cJSON_AddBoolToObject(json, "reverse", (remap->flags & LED_REMAP_REVERSE) != 0);
+    cJSON_AddNumberToObject(json, "skip", remap->skip);
+    return json;
+}
 
-    persistence_manager_t pm;
-    if (persistence_manager_init(&pm, "led_config") == ESP_OK)
+// Parses {"offset":120,"reverse":true,"skip":0}, the offset defaults to the logical start
+static bool parse_remap_json(const cJSON *json, uint16_t start, led_remap_config_t *remap)
+{
+    const cJSON *offset = cJSON_GetObjectItem(json, "offset");
+    if (offset != NULL && (!cJSON_IsNumber(offset) || offset->valuedouble < 0 ||
+                           offset->valuedouble >= CONFIG_LED_STRIP_MAX_LEDS))
+        return false;
+
+    remap->offset = offset != NULL ? (uint16_t)offset->valuedouble : start;
+    remap->skip = get_byte(json, "skip", 0);
+    remap->flags = cJSON_IsTrue(cJSON_GetObjectItem(json, "reverse")) ? LED_REMAP_REVERSE : 0;
+    return true;
+}
+
+static cJSON *create_calibration_json(const led_calibration_config_t *calibration)
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON *matrix = cJSON_CreateArray();
+    for (int i = 0; i < 9; i++)
     {
-        segment_count = persistence_manager_get_int(&pm, "segment_count", 0);
-        size_t required_size = sizeof(led_segment_t) * segment_count;
-        persistence_manager_get_blob(&pm, "segments", segments, required_size, NULL);
-        persistence_manager_deinit(&pm);
+        cJSON_AddItemToArray(matrix, cJSON_CreateNumber((double)calibration->matrix[i] / LED_CALIBRATION_ONE));
+    }
+    cJSON_AddItemToObject(json, "matrix", matrix);
+    cJSON *gain = cJSON_CreateObject();
+    cJSON_AddNumberToObject(gain, "r", calibration->gain[0]);
+    cJSON_AddNumberToObject(gain, "g", calibration->gain[1]);
+    cJSON_AddNumberToObject(gain, "b", calibration->gain[2]);
+    cJSON_AddItemToObject(json, "gain", gain);
+    return json;
+}
 
-        qsort(segments, segment_count, sizeof(led_segment_t), compare_segments_by_start);
+// Parses {"matrix":[1,0,0, 0,1,0, 0,0,1],"gain":{"r":255,"g":240,"b":220}}, missing parts are the identity
+static bool parse_calibration_json(const cJSON *json, led_calibration_config_t *calibration)
+{
+    led_calibration_identity(calibration);
 
-        cJSON *segments_arr = cJSON_CreateArray();
-        for (uint8_t i = 0; i < segment_count; ++i)
+    const cJSON *matrix = cJSON_GetObjectItem(json, "matrix");
+    if (matrix != NULL)
+    {
+        if (!cJSON_IsArray(matrix) || cJSON_GetArraySize(matrix) != 9)
+            return false;
+        for (int i = 0; i < 9; i++)
         {
-            cJSON *seg = cJSON_CreateObject();
-            cJSON_AddStringToObject(seg, "name", segments[i].name);
-            cJSON_AddNumberToObject(seg, "start", segments[i].start);
-            cJSON_AddNumberToObject(seg, "leds", segments[i].leds);
-            cJSON_AddItemToArray(segments_arr, seg);
+            const cJSON *item = cJSON_GetArrayItem(matrix, i);
+            double value = cJSON_IsNumber(item) ? item->valuedouble * LED_CALIBRATION_ONE : INT16_MAX + 1.0;
+            if (value < INT16_MIN || value > INT16_MAX)
+                return false;
+            calibration->matrix[i] = (int16_t)(value < 0 ? value - 0.5 : value + 0.5);
         }
-        cJSON_AddItemToObject(json, "segments", segments_arr);
     }
-    else
+
+    const cJSON *gain = cJSON_GetObjectItem(json, "gain");
+    calibration->gain[0] = get_byte(gain, "r", 255);
+    calibration->gain[1] = get_byte(gain, "g", 255);
+    calibration->gain[2] = get_byte(gain, "b", 255);
+    return true;
+}
+
+// Parses {"duration_ms":800,"easing":"ease-in-out"}, missing fields keep their current value
+static bool parse_transition_json(const cJSON *json, led_transition_config_t *transition)
+{
+    const cJSON *duration = cJSON_GetObjectItem(json, "duration_ms");
+    if (cJSON_IsNumber(duration))
+    {
+        if (duration->valuedouble < 0 || duration->valuedouble > 10000)
+            return false;
+        transition->duration_ms = (uint16_t)duration->valuedouble;
+    }
+
+    const cJSON *easing = cJSON_GetObjectItem(json, "easing");
+    if (cJSON_IsString(easing))
+    {
+        led_easing_t curve = led_easing_from_string(easing->valuestring);
+        if (curve == LED_EASING_COUNT)
+        {
+            ESP_LOGW(TAG, "Unknown easing: %s", easing->valuestring);
+            return false;
+        }
+        transition->easing = (uint8_t)curve;
+    }
+    return true;
+}
+
+esp_err_t api_wled_config_get_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "GET /api/wled/config");
+
+    // Segments are loaded at boot and kept current by the POST handler
+    led_segment_list_t list;
+    led_segment_get_all(&list);
+    const led_segment_t *segments = list.segments;
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON *segments_arr = cJSON_CreateArray();
+    for (uint8_t i = 0; i < list.count; ++i)
     {
-        cJSON_AddItemToObject(json, "segments", cJSON_CreateArray());
+        cJSON *seg = cJSON_CreateObject();
+        cJSON_AddStringToObject(seg, "name", segments[i].name);
+        cJSON_AddNumberToObject(seg, "start", segments[i].start);
+        cJSON_AddNumberToObject(seg, "leds", segments[i].leds);
+        led_effect_config_t effect;
+        if (led_effect_get(segments[i].name, &effect))
+        {
+            cJSON_AddItemToObject(seg, "effect", create_effect_json(&effect));
+        }
+        led_remap_config_t remap;
+        if (led_remap_get(segments[i].name, &remap))
+        {
+            cJSON_AddItemToObject(seg, "remap", create_remap_json(&remap));
+        }
+        led_calibration_config_t calibration;
+        if (led_calibration_get(segments[i].name, &calibration))
+        {
+            cJSON_AddItemToObject(seg, "calibration", create_calibration_json(&calibration));
+        }
+        char script[LED_SCRIPT_NAME_MAX];
+        if (led_script_get(segments[i].name, script, sizeof(script)))
+        {
+            cJSON_AddStringToObject(seg, "script", script);
+        }
+        cJSON_AddItemToArray(segments_arr, seg);
     }
+    cJSON_AddItemToObject(json, "segments", segments_arr);
+
+    led_transition_config_t transition;
+    led_transition_get_config(&transition);
+    cJSON *transition_json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(transition_json, "duration_ms", transition.duration_ms);
+    cJSON_AddStringToObject(transition_json, "easing", led_easing_to_string((led_easing_t)transition.easing));
+    cJSON_AddItemToObject(json, "transition", transition_json);
 
     char *response = cJSON_PrintUnformatted(json);
     cJSON_Delete(json);
@@ -258,12 +398,29 @@ esp_err_t api_wled_config_post_handler(httpd_req_t *req)
         return send_error_response(req, 400, "Missing segments array");
     }
 
-    extern led_segment_t segments[LED_SEGMENT_MAX_LEN];
-    extern size_t segment_count;
+    cJSON *transition_json = cJSON_GetObjectItem(json, "transition");
+    if (cJSON_IsObject(transition_json))
+    {
+        led_transition_config_t transition;
+        led_transition_get_config(&transition);
+        if (!parse_transition_json(transition_json, &transition))
+        {
+            cJSON_Delete(json);
+            return send_error_response(req, 400, "Invalid transition");
+        }
+        led_transition_set_config(&transition);
+        led_transition_save();
+    }
+
+    // A script that does not compile is reported after the rest of the configuration is applied
+    char script_error[96] = "";
+
+    // Built here and published as a whole, the LED task keeps rendering the old list until then
+    led_segment_t segments[LED_SEGMENT_MAX_LEN];
+    memset(segments, 0, sizeof(segments));
     size_t count = cJSON_GetArraySize(segments_arr);
     if (count > LED_SEGMENT_MAX_LEN)
         count = LED_SEGMENT_MAX_LEN;
-    segment_count = count;
     for (size_t i = 0; i < LED_SEGMENT_MAX_LEN; ++i)
     {
         cJSON *seg = cJSON_GetArrayItem(segments_arr, i);
@@ -276,6 +433,55 @@ esp_err_t api_wled_config_post_handler(httpd_req_t *req)
             segments[i].name[sizeof(segments[i].name) - 1] = '\0';
             segments[i].start = (uint16_t)start->valuedouble;
             segments[i].leds = (uint16_t)leds->valuedouble;
+
+            // Effects are bound by segment name; segments without "effect" keep their current one
+            cJSON *effect_json = cJSON_GetObjectItem(seg, "effect");
+            led_effect_config_t effect;
+            if (cJSON_IsObject(effect_json) && parse_effect_json(effect_json, &effect))
+            {
+                led_effect_set(segments[i].name, &effect);
+            }
+
+            // Same for the wiring, "remap": null restores the identity
+            cJSON *remap_json = cJSON_GetObjectItem(seg, "remap");
+            led_remap_config_t remap;
+            if (cJSON_IsNull(remap_json))
+            {
+                led_remap_set(segments[i].name, NULL);
+            }
+            else if (cJSON_IsObject(remap_json) && parse_remap_json(remap_json, segments[i].start, &remap))
+            {
+                led_remap_set(segments[i].name, &remap);
+            }
+
+            // Color correction of the strip batch, "calibration": null removes it
+            cJSON *calibration_json = cJSON_GetObjectItem(seg, "calibration");
+            led_calibration_config_t calibration;
+            if (cJSON_IsNull(calibration_json))
+            {
+                led_calibration_set(segments[i].name, NULL);
+            }
+            else if (cJSON_IsObject(calibration_json) && parse_calibration_json(calibration_json, &calibration))
+            {
+                led_calibration_set(segments[i].name, &calibration);
+            }
+
+            // "script": "file" binds an uploaded script, null unbinds it
+            cJSON *script_json = cJSON_GetObjectItem(seg, "script");
+            led_script_error_t error;
+            if (cJSON_IsNull(script_json))
+            {
+                led_script_bind(segments[i].name, NULL, &error);
+            }
+            else if (cJSON_IsString(script_json) &&
+                     led_script_bind(segments[i].name, script_json->valuestring, &error) != ESP_OK &&
+                     script_error[0] == '\0')
+            {
+                if (error.line == 0)
+                    snprintf(script_error, sizeof(script_error), "Script: %s", error.message);
+                else
+                    snprintf(script_error, sizeof(script_error), "Script line %u: %s", error.line, error.message);
+            }
         }
         else
         {
@@ -287,14 +493,21 @@ esp_err_t api_wled_config_post_handler(httpd_req_t *req)
     }
     cJSON_Delete(json);
 
-    qsort(segments, segment_count, sizeof(led_segment_t), compare_segments_by_start);
+    led_segment_set(segments, count);
+    led_segment_save();
 
-    persistence_manager_t pm;
-    if (persistence_manager_init(&pm, "led_config") == ESP_OK)
+    led_effect_segments_changed();
+    led_effect_save();
+    led_remap_segments_changed();
+    led_remap_save();
+    led_calibration_segments_changed();
+    led_calibration_save();
+    led_script_segments_changed();
+    led_script_save();
+
+    if (script_error[0] != '\0')
     {
-        persistence_manager_set_blob(&pm, "segments", segments, sizeof(led_segment_t) * segment_count);
-        persistence_manager_set_int(&pm, "segment_count", (int32_t)segment_count);
-        persistence_manager_deinit(&pm);
+        return send_error_response(req, 400, script_error);
     }
 
     set_cors_headers(req);
@@ -432,3 +645,210 @@ esp_err_t api_schema_post_handler(httpd_req_t *req)
         return send_error_response(req, 500, "Failed to save schema");
     return httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
 }
+
+// ============================================================================
+// Animation API
+// ============================================================================
+
+// Copies the last path segment of the URI without its query string; false if it is empty or does not fit
+static bool upload_file_name(const httpd_req_t *req, char *name, size_t size)
+{
+    size_t end = strcspn(req->uri, "?");
+    size_t start = end;
+    while (start > 0 && req->uri[start - 1] != '/')
+        start--;
+    if (start == 0 || start == end || end - start >= size)
+        return false;
+    memcpy(name, req->uri + start, end - start);
+    name[end - start] = '\0';
+    return true;
+}
+
+esp_err_t api_animation_post_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "POST /api/animation");
+
+    char buf[256];
+    int total = 0, ret;
+    while (total < (int)sizeof(buf) - 1)
+    {
+        ret = httpd_req_recv(req, buf + total, sizeof(buf) - 1 - total);
+        if (ret <= 0)
+            break;
+        total += ret;
+    }
+    buf[total] = '\0';
+
+    cJSON *json = cJSON_Parse(buf);
+    if (!json)
+    {
+        return send_error_response(req, 400, "Invalid JSON");
+    }
+
+    // {"file":"harbor.lanim","segment":"harbor","loop":true} plays, a missing or null file stops
+    const cJSON *file = cJSON_GetObjectItem(json, "file");
+    const cJSON *segment = cJSON_GetObjectItem(json, "segment");
+    const cJSON *loop = cJSON_GetObjectItem(json, "loop");
+    esp_err_t err = ESP_OK;
+    if (cJSON_IsString(file))
+    {
+        err = led_anim_play(file->valuestring, cJSON_IsString(segment) ? segment->valuestring : NULL,
+                            cJSON_IsBool(loop) ? cJSON_IsTrue(loop) : false);
+    }
+    else
+    {
+        led_anim_stop();
+    }
+    cJSON_Delete(json);
+
+    if (err == ESP_ERR_NOT_FOUND)
+        return send_error_response(req, 404, "Unknown segment");
+    if (err != ESP_OK)
+        return send_error_response(req, 400, "Invalid file name");
+
+    set_cors_headers(req);
+    return httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
+}
+
+esp_err_t api_animation_upload_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "POST /api/animation/*");
+
+    char filename[LED_ANIM_NAME_MAX];
+    if (!upload_file_name(req, filename, sizeof(filename)))
+    {
+        return send_error_response(req, 400, "Invalid animation path");
+    }
+
+    // The header is checked before anything is written, so a wrong upload cannot replace a file
+    led_anim_header_t header;
+    int total = 0, ret;
+    while (total < (int)sizeof(header))
+    {
+        ret = httpd_req_recv(req, (char *)&header + total, sizeof(header) - total);
+        if (ret <= 0)
+            return send_error_response(req, 400, "Incomplete animation header");
+        total += ret;
+    }
+    if (led_anim_header_check(&header) != ESP_OK)
+    {
+        return send_error_response(req, 400, "Invalid animation header");
+    }
+
+    // A running decoder may hold the old file open, it must be closed before the file is rewritten
+    if (!led_anim_release(filename, pdMS_TO_TICKS(1000)))
+    {
+        return send_error_response(req, 409, "Animation is in use");
+    }
+
+    FILE *file = storage_open(filename, "wb");
+    if (file == NULL)
+    {
+        return send_error_response(req, 500, "Failed to create animation");
+    }
+
+    // Streamed in chunks, the animation never has to fit into RAM
+    char *chunk = heap_caps_malloc(1024, MALLOC_CAP_DEFAULT);
+    bool ok = chunk != NULL && fwrite(&header, sizeof(header), 1, file) == 1;
+    while (ok && total < req->content_len)
+    {
+        ret = httpd_req_recv(req, chunk, 1024);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+            continue;
+        ok = ret > 0 && fwrite(chunk, 1, ret, file) == (size_t)ret;
+        total += ret > 0 ? ret : 0;
+    }
+    free(chunk);
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok)
+    {
+        storage_remove(filename);
+        return send_error_response(req, 500, "Failed to save animation");
+    }
+
+    ESP_LOGI(TAG, "Saved animation %s, %d bytes", filename, total);
+    set_cors_headers(req);
+    return httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
+}
+
+// ============================================================================
+// Effect Script API
+// ============================================================================
+
+esp_err_t api_script_upload_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "POST /api/script/*");
+
+    char filename[LED_SCRIPT_NAME_MAX];
+    if (!upload_file_name(req, filename, sizeof(filename)))
+    {
+        return send_error_response(req, 400, "Invalid script path");
+    }
+
+    if (req->content_len > LED_SCRIPT_SOURCE_MAX)
+    {
+        return send_error_response(req, 400, "Script too long");
+    }
+
+    char *source = heap_caps_malloc(LED_SCRIPT_SOURCE_MAX, MALLOC_CAP_DEFAULT);
+    if (!source)
+        return send_error_response(req, 500, "Memory allocation failed");
+    int total = 0, ret;
+    while (total < (int)req->content_len)
+    {
+        ret = httpd_req_recv(req, source + total, req->content_len - total);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+            continue;
+        if (ret <= 0)
+            break;
+        total += ret;
+    }
+
+    // Compiled before anything is written, so a broken script cannot replace a working one
+    led_script_program_t program;
+    led_script_error_t error;
+    esp_err_t err = led_script_compile(source, total, &program, &error);
+    if (err != ESP_OK)
+    {
+        free(source);
+        char message[80];
+        snprintf(message, sizeof(message), "line %u: %s", error.line, error.message);
+        return send_error_response(req, 400, message);
+    }
+
+    FILE *file = storage_open(filename, "wb");
+    bool ok = file != NULL && fwrite(source, 1, total, file) == (size_t)total;
+    ok = file != NULL && fclose(file) == 0 && ok;
+    free(source);
+    if (!ok)
+    {
+        storage_remove(filename);
+        return send_error_response(req, 500, "Failed to save script");
+    }
+
+    // Segments running the old version pick up the new one
+    led_segment_list_t list;
+    led_segment_get_all(&list);
+    for (size_t i = 0; i < list.count; i++)
+    {
+        char bound[LED_SCRIPT_NAME_MAX];
+        if (led_script_get(list.segments[i].name, bound, sizeof(bound)) && strcmp(bound, filename) == 0)
+        {
+            led_script_bind(list.segments[i].name, filename, &error);
+        }
+    }
+
+    ESP_LOGI(TAG, "Saved script %s, %u frame + %u pixel instructions", filename, program.frame_len,
+             program.pixel_len);
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "status", "ok");
+    cJSON_AddNumberToObject(json, "frame_instructions", program.frame_len);
+    cJSON_AddNumberToObject(json, "pixel_instructions", program.pixel_len);
+    char *response = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    esp_err_t res = send_json_response(req, response);
+    free(response);
+    return res;
+}
@@ -7,17 +7,21 @@
 
 #include <cJSON.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 const char *system_time = NULL;
+static char system_time_buffer[sizeof(((simulation_message_t *)0)->time)];
 rgb_t color = {0, 0, 0};
 
 static void on_message_received(const message_t *msg)
 {
     if (msg->type == MESSAGE_TYPE_SIMULATION)
     {
-        system_time = msg->data.simulation.time;
+        // The message is only valid during the call
+        strncpy(system_time_buffer, msg->data.simulation.time, sizeof(system_time_buffer) - 1);
+        system_time = system_time_buffer;
         color.red = msg->data.simulation.red;
         color.green = msg->data.simulation.green;
         color.blue = msg->data.simulation.blue;
@@ -31,39 +35,44 @@ static void on_message_received(const message_t *msg)
     }
     else if (msg->type == MESSAGE_TYPE_SETTINGS)
     {
-        const char *key = msg->data.settings.key;
-        if (strcmp(key, "light_active") == 0 ||
-            strcmp(key, "light_mode") == 0 ||
-            strcmp(key, "light_variant") == 0)
-        {
-            cJSON *json = create_light_status_json();
-            cJSON_AddStringToObject(json, "type", "status");
-            char *response = cJSON_PrintUnformatted(json);
-            cJSON_Delete(json);
-            api_server_ws_broadcast(response);
-            free(response);
-        }
+        // Only the LIGHT_STATUS_SETTINGS are delivered
+        cJSON *json = create_light_status_json();
+        cJSON_AddStringToObject(json, "type", "status");
+        char *response = cJSON_PrintUnformatted(json);
+        cJSON_Delete(json);
+        api_server_ws_broadcast(response);
+        free(response);
     }
 }
 
 void common_init(void)
 {
-    message_manager_register_listener(on_message_received);
+    message_manager_subscribe(on_message_received,
+                              MESSAGE_MASK(MESSAGE_TYPE_SIMULATION) | MESSAGE_MASK(MESSAGE_TYPE_SETTINGS),
+                              LIGHT_STATUS_SETTINGS);
+
+    // Building and sending the status takes longer than a simulation step, only the latest one matters
+    message_executor_config_t executor = {
+        .name = "status_broadcast",
+        .stack_size = 3072,
+        .priority = 4,
+        .inbox_length = 4,
+        .policy = MESSAGE_INBOX_COALESCE,
+    };
+    message_manager_set_executor(on_message_received, &executor);
 }
 
 // Returns a cJSON object with the current light status
 cJSON *create_light_status_json(void)
 {
-    persistence_manager_t pm;
-    persistence_manager_init(&pm, "config");
     cJSON *json = cJSON_CreateObject();
 
-    bool light_active = persistence_manager_get_bool(&pm, "light_active", false);
+    bool light_active = SETTINGS_GET_BOOL(LIGHT_ACTIVE);
     cJSON_AddBoolToObject(json, "on", light_active);
 
     cJSON_AddBoolToObject(json, "thunder", false);
 
-    int mode = persistence_manager_get_int(&pm, "light_mode", 1);
+    int mode = SETTINGS_GET_INT(LIGHT_MODE);
     const char *mode_str = "simulation";
     if (mode == 1)
     {
@@ -75,13 +84,11 @@ cJSON *create_light_status_json(void)
     }
     cJSON_AddStringToObject(json, "mode", mode_str);
 
-    int variant = persistence_manager_get_int(&pm, "light_variant", 1);
+    int variant = SETTINGS_GET_INT(LIGHT_VARIANT);
     char schema_filename[20];
     snprintf(schema_filename, sizeof(schema_filename), "schema_%02d.csv", variant);
     cJSON_AddStringToObject(json, "schema", schema_filename);
 
-    persistence_manager_deinit(&pm);
-
     cJSON *c = cJSON_CreateObject();
     cJSON_AddNumberToObject(c, "r", color.red);
     cJSON_AddNumberToObject(c, "g", color.green);
@@ -1,7 +1,6 @@
 #include "bifrost/websocket_handler.h"
 #include "bifrost/api_server.h"
 #include "bifrost/common.h"
-#include "message_manager.h"
 
 #include <esp_http_server.h>
 #include <esp_log.h>
@@ -13,16 +12,6 @@ static const char *TAG = "websocket_handler";
 static int ws_clients[WS_MAX_CLIENTS];
 static int ws_client_count = 0;
 
-static void on_message_received(const message_t *msg)
-{
-    cJSON *json = create_light_status_json();
-    cJSON_AddStringToObject(json, "type", "status");
-    char *response = cJSON_PrintUnformatted(json);
-    cJSON_Delete(json);
-    api_server_ws_broadcast(response);
-    free(response);
-}
-
 static void ws_clients_init(void)
 {
     for (int i = 0; i < WS_MAX_CLIENTS; i++)
@@ -191,8 +180,7 @@ static void ws_async_send(void *arg)
 
 esp_err_t websocket_handler_init(httpd_handle_t server)
 {
-    message_manager_register_listener(on_message_received);
-
+    // The status is broadcast by the status_broadcast listener of common.c
     ws_clients_init();
     // Register WebSocket URI handler
     httpd_uri_t ws_uri = {.uri = "/ws",
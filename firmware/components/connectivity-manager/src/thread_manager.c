@@ -1,6 +1,7 @@
 #include "thread_manager.h"
 #include "esp_ot_config.h"
 #include "led_status.h"
+#include "persistence_manager.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -18,7 +19,6 @@
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
-#include "nvs.h"
 #include "openthread/coap.h"
 #include "openthread/commissioner.h"
 #include "openthread/dataset.h"
@@ -76,58 +76,61 @@ static thread_group_t *find_group_by_addr(const char *addr)
 }
 
 // ─── NVS Persistence ─────────────────────────────────────────────────────────
+// The device and group tables go to the flash right away instead of waiting in the write-behind journal of the
+// persistence manager: persistence_manager_save() flushes the journal and commits the namespace, which also
+// covers a removed key.
 
 static void persist_devices(void)
 {
-    nvs_handle_t h;
-    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK)
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, NVS_NAMESPACE) != ESP_OK)
         return;
     if (s_device_count > 0)
-        nvs_set_blob(h, "devices", s_devices, s_device_count * sizeof(thread_device_t));
+        persistence_manager_set_blob(&pm, "devices", s_devices, s_device_count * sizeof(thread_device_t));
     else
-        nvs_erase_key(h, "devices");
-    nvs_commit(h);
-    nvs_close(h);
+        persistence_manager_remove_key(&pm, "devices");
+    persistence_manager_save(&pm);
+    persistence_manager_deinit(&pm);
 }
 
 static void load_devices(void)
 {
-    nvs_handle_t h;
-    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK)
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, NVS_NAMESPACE) != ESP_OK)
         return;
-    size_t size = sizeof(s_devices);
-    if (nvs_get_blob(h, "devices", s_devices, &size) == ESP_OK)
+    size_t size = 0;
+    if (persistence_manager_get_blob(&pm, "devices", s_devices, sizeof(s_devices), &size))
     {
         s_device_count = size / sizeof(thread_device_t);
         for (size_t i = 0; i < s_device_count; ++i)
             s_devices[i].reachable = false;
     }
-    nvs_close(h);
+    persistence_manager_deinit(&pm);
     ESP_LOGI(TAG, "Loaded %zu device(s) from NVS", s_device_count);
 }
 
 static void persist_groups(void)
 {
-    nvs_handle_t h;
-    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK)
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, NVS_NAMESPACE) != ESP_OK)
         return;
     if (s_group_count > 0)
-        nvs_set_blob(h, "groups", s_groups, s_group_count * sizeof(thread_group_t));
+        persistence_manager_set_blob(&pm, "groups", s_groups, s_group_count * sizeof(thread_group_t));
     else
-        nvs_erase_key(h, "groups");
-    nvs_commit(h);
-    nvs_close(h);
+        persistence_manager_remove_key(&pm, "groups");
+    persistence_manager_save(&pm);
+    persistence_manager_deinit(&pm);
 }
 
 static void load_groups(void)
 {
-    nvs_handle_t h;
-    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK)
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, NVS_NAMESPACE) != ESP_OK)
         return;
-    size_t size = sizeof(s_groups);
-    if (nvs_get_blob(h, "groups", s_groups, &size) == ESP_OK)
+    size_t size = 0;
+    if (persistence_manager_get_blob(&pm, "groups", s_groups, sizeof(s_groups), &size))
         s_group_count = size / sizeof(thread_group_t);
-    nvs_close(h);
+    persistence_manager_deinit(&pm);
     ESP_LOGI(TAG, "Loaded %zu group(s) from NVS", s_group_count);
 }
 
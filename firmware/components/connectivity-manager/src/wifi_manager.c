@@ -2,6 +2,7 @@
 #include "skuld/skuld.h"
 #include "bifrost/api_server.h"
 #include "dns_hijack.h"
+#include "led_realtime.h"
 #include "led_status.h"
 #include "persistence_manager.h"
 
@@ -181,4 +182,8 @@ void wifi_manager_init()
     // API server start
     api_server_config_t s_config = API_SERVER_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(api_server_start(&s_config));
+
+#if CONFIG_LED_REALTIME_ENABLE
+    led_realtime_start();
+#endif
 }
@@ -2,7 +2,9 @@
 
 #include <SDL3/SDL_render.h>
 
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
 class Matrix
 {
@@ -11,10 +13,17 @@ class Matrix
 
     [[nodiscard]] SDL_Renderer *renderer() const;
 
+    /**
+     * @brief Takes over a strip frame as packed RGB triplets, LED i is drawn at row i / cols.
+     */
+    void SetPixels(const uint8_t *rgb, size_t count);
+
     void Render() const;
 
     [[nodiscard]] SDL_WindowID windowId() const;
 
+    [[nodiscard]] static float PixelSize(uint8_t cells);
+
   private:
     void DrawColoredGrid() const;
 
@@ -24,6 +33,8 @@ class Matrix
     uint8_t m_cols;
     uint8_t m_rows;
 
-    static constexpr float cellSize = 50.0f;
+    std::vector<uint8_t> m_pixels;
+
+    static constexpr float cellSize = 16.0f;
     static constexpr float spacing = 1.0f;
 };
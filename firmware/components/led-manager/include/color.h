@@ -3,6 +3,15 @@
 #include <stdint.h>
 #include <sys/cdefs.h>
 
+// Hue is stored in 2 degree steps (0..179), saturation and value in 0..255
+#define HSV_HUE_MAX 180
+
+// Interpolation factors are Q1.15 fixed point: 0 = start, COLOR_FRACT_ONE = end
+#define COLOR_FRACT_SHIFT 15
+#define COLOR_FRACT_ONE (1u << COLOR_FRACT_SHIFT)
+
+typedef uint16_t color_fract_t;
+
 typedef struct
 {
     uint8_t red;
@@ -10,16 +19,89 @@ typedef struct
     uint8_t blue;
 } rgb_t;
 
+// Per channel sum over a range of pixels, e.g. to estimate the current draw
+typedef struct
+{
+    uint32_t red;
+    uint32_t green;
+    uint32_t blue;
+} rgb_sum_t;
+
+typedef struct
+{
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t white;
+} rgbw_t;
+
+// Range of the color temperature table
+#define COLOR_KELVIN_MIN 1000
+#define COLOR_KELVIN_MAX 12000
+
+// RGB appearance of the white LEDs of an RGBW strip, prepared for color_extract_white()
 typedef struct
 {
-    float h;
-    float s;
-    float v;
+    rgb_t white;
+    uint16_t inverse[3]; // 255 * 256 / channel (rounded up), 0 if the white LED has no share in that channel
+} color_white_point_t;
+
+typedef struct
+{
+    uint8_t h;
+    uint8_t s;
+    uint8_t v;
 } hsv_t;
 
 __BEGIN_DECLS
-rgb_t interpolate_color_rgb(rgb_t start, rgb_t end, float factor);
-rgb_t interpolate_color_hsv(rgb_t start, rgb_t end, float factor);
+/**
+ * @brief Converts the ratio num / den into an interpolation factor, clamped to [0, COLOR_FRACT_ONE].
+ */
+color_fract_t color_fract_from_ratio(uint32_t num, uint32_t den);
+
+rgb_t interpolate_color_rgb(rgb_t start, rgb_t end, color_fract_t factor);
+rgb_t interpolate_color_hsv(rgb_t start, rgb_t end, color_fract_t factor);
 hsv_t rgb_to_hsv(rgb_t rgb);
 rgb_t hsv_to_rgb(hsv_t hsv);
+
+/**
+ * @brief Scales every channel by scale / 255 (255 keeps the color unchanged).
+ */
+rgb_t color_scale(rgb_t color, uint8_t scale);
+
+/**
+ * @brief Mixes two colors with an 8 bit alpha (0 = background, 255 = foreground).
+ */
+rgb_t color_blend(rgb_t background, rgb_t foreground, uint8_t alpha);
+
+/**
+ * @brief Adds two colors, saturating every channel at 255.
+ */
+rgb_t color_add(rgb_t a, rgb_t b);
+
+/**
+ * @brief Returns the color of a black body at the given temperature, normalized to full brightness.
+ *
+ * Looks up a table in 100 K steps and interpolates in between; the temperature is clamped to
+ * [COLOR_KELVIN_MIN, COLOR_KELVIN_MAX].
+ */
+rgb_t color_from_kelvin(uint16_t kelvin);
+
+void color_white_point_init(color_white_point_t *white_point, rgb_t white);
+
+/**
+ * @brief Moves as much of the color as possible to the white LED.
+ *
+ * The white channel takes the largest share that the white LED can reproduce (as seen through
+ * the white point), the remainder stays on the RGB LEDs. Integer only.
+ */
+rgbw_t color_extract_white(const color_white_point_t *white_point, rgb_t color);
 __END_DECLS
+
+/**
+ * @brief Exact x / 255 for 0 <= x <= 65534 without a division.
+ */
+static inline uint32_t color_div255(uint32_t x)
+{
+    return (x + 1 + (x >> 8)) >> 8;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+// Floating point color math as color.c had it before the switch to fixed point. Only a reference:
+// led_color_tool checks the fixed point functions against it, it and the color bench of the firmware
+// (CONFIG_COLOR_BENCH) measure both.
+
+#include "color.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+
+// Not inlined, so that a bench compares calls with the calls into color.c
+#define COLOR_REFERENCE __attribute__((noinline)) inline
+
+struct HsvFloat
+{
+    float h; // 0..179, 2 degree steps like hsv_t
+    float s;
+    float v;
+};
+
+COLOR_REFERENCE HsvFloat RefRgbToHsv(rgb_t rgb)
+{
+    HsvFloat hsv;
+    uint8_t max = std::max({rgb.red, rgb.green, rgb.blue});
+    uint8_t min = std::min({rgb.red, rgb.green, rgb.blue});
+    uint8_t delta = max - min;
+
+    hsv.v = max;
+    if (max == 0)
+    {
+        hsv.s = 0;
+        hsv.h = 0;
+        return hsv;
+    }
+    hsv.s = (delta * 255) / max;
+
+    if (delta == 0)
+    {
+        hsv.h = 0;
+        return hsv;
+    }
+    int16_t hue;
+    if (rgb.red == max)
+    {
+        hue = ((int16_t)(rgb.green - rgb.blue) * 30) / delta;
+        if (hue < 0)
+            hue += 180;
+    }
+    else if (rgb.green == max)
+        hue = 60 + ((int16_t)(rgb.blue - rgb.red) * 30) / delta;
+    else
+        hue = 120 + ((int16_t)(rgb.red - rgb.green) * 30) / delta;
+    hsv.h = (uint8_t)hue;
+    return hsv;
+}
+
+COLOR_REFERENCE rgb_t RefHsvToRgb(HsvFloat hsv)
+{
+    if (hsv.s == 0)
+    {
+        uint8_t v = (uint8_t)hsv.v;
+        return rgb_t{v, v, v};
+    }
+
+    uint16_t region = (uint16_t)(hsv.h / 30);
+    uint16_t remainder = (uint16_t)((hsv.h - (region * 30)) * 6);
+
+    uint8_t v = (uint8_t)hsv.v;
+    uint8_t p = (uint8_t)((hsv.v * (255 - hsv.s)) / 255);
+    uint8_t q = (uint8_t)((hsv.v * (255 - ((hsv.s * remainder) / 180))) / 255);
+    uint8_t t = (uint8_t)((hsv.v * (255 - ((hsv.s * (180 - remainder)) / 180))) / 255);
+
+    switch (region)
+    {
+    case 0:
+        return rgb_t{v, t, p};
+    case 1:
+        return rgb_t{q, v, p};
+    case 2:
+        return rgb_t{p, v, t};
+    case 3:
+        return rgb_t{p, q, v};
+    case 4:
+        return rgb_t{t, p, v};
+    default:
+        return rgb_t{v, p, q};
+    }
+}
+
+COLOR_REFERENCE rgb_t RefInterpolateRgb(rgb_t start, rgb_t end, float factor)
+{
+    factor = std::clamp(factor, 0.0f, 1.0f);
+    return rgb_t{(uint8_t)(start.red + (end.red - start.red) * factor),
+                 (uint8_t)(start.green + (end.green - start.green) * factor),
+                 (uint8_t)(start.blue + (end.blue - start.blue) * factor)};
+}
+
+// Same as the old version, but on the 0..179 hue circle of hsv_t (the old one wrapped at 360)
+COLOR_REFERENCE rgb_t RefInterpolateHsv(rgb_t start, rgb_t end, float factor)
+{
+    factor = std::clamp(factor, 0.0f, 1.0f);
+    HsvFloat a = RefRgbToHsv(start);
+    HsvFloat b = RefRgbToHsv(end);
+
+    float h1 = a.h;
+    float h2 = b.h;
+    if (h2 - h1 > HSV_HUE_MAX / 2)
+        h1 += HSV_HUE_MAX;
+    else if (h2 - h1 < -HSV_HUE_MAX / 2)
+        h2 += HSV_HUE_MAX;
+
+    HsvFloat result;
+    result.h = std::fmod(h1 + (h2 - h1) * factor, (float)HSV_HUE_MAX);
+    result.s = a.s + (b.s - a.s) * factor;
+    result.v = a.v + (b.v - a.v) * factor;
+    return RefHsvToRgb(result);
+}
+
+COLOR_REFERENCE rgb_t RefScale(rgb_t color, uint8_t scale)
+{
+    return rgb_t{(uint8_t)(color.red * scale / 255.0f), (uint8_t)(color.green * scale / 255.0f),
+                 (uint8_t)(color.blue * scale / 255.0f)};
+}
+
+COLOR_REFERENCE rgb_t RefBlend(rgb_t background, rgb_t foreground, uint8_t alpha)
+{
+    float a = alpha / 255.0f;
+    return rgb_t{(uint8_t)(background.red + (foreground.red - background.red) * a),
+                 (uint8_t)(background.green + (foreground.green - background.green) * a),
+                 (uint8_t)(background.blue + (foreground.blue - background.blue) * a)};
+}
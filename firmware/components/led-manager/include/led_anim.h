@@ -0,0 +1,134 @@
+#pragma once
+
+#include "color.h"
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+// Pre-rendered animation file (little endian):
+//
+//   led_anim_header_t
+//   frame_count x { uint16_t size; uint8_t ops[size]; }
+//
+// Every frame is coded as the difference to the previous one (frame 0 to black). An op byte holds the
+// kind in bits 7..6 and count - 1 (1..64 pixels) in bits 5..0:
+//
+//   LED_ANIM_OP_SKIP     pixels are unchanged
+//   LED_ANIM_OP_RUN      pixels take the RGB triplet that follows
+//   LED_ANIM_OP_LITERAL  count RGB triplets follow
+//
+// Pixels behind the last op are unchanged, so a still frame is an empty record.
+
+#define LED_ANIM_MAGIC "LANM"
+#define LED_ANIM_VERSION 1
+
+#define LED_ANIM_OP_SKIP 0x00
+#define LED_ANIM_OP_RUN 0x40
+#define LED_ANIM_OP_LITERAL 0x80
+#define LED_ANIM_OP_MASK 0xC0
+#define LED_ANIM_OP_MAX_COUNT 64
+
+// Upper bound of an encoded frame of leds pixels
+#define LED_ANIM_FRAME_BYTES_MAX(leds)                                                                    \
+    ((size_t)(leds) * 3 + ((size_t)(leds) + LED_ANIM_OP_MAX_COUNT - 1) / LED_ANIM_OP_MAX_COUNT)
+
+#define LED_ANIM_NAME_MAX 32
+
+typedef struct
+{
+    char magic[4];        // LED_ANIM_MAGIC
+    uint16_t version;     // LED_ANIM_VERSION
+    uint16_t leds;        // pixels per frame
+    uint16_t start;       // first strip pixel, used when played without a segment
+    uint16_t frame_rate;  // frames per second
+    uint16_t reserved[2]; // 0
+    uint32_t frame_count;
+} led_anim_header_t;
+
+// Playback counters, frames are counted in the LED task
+typedef struct
+{
+    bool playing;
+    char file[LED_ANIM_NAME_MAX];
+    uint32_t frames;        // frames shown
+    uint32_t skipped;       // frames dropped to keep the frame rate
+    uint32_t underruns;     // LED frames where the next animation frame was not decoded in time
+    uint32_t errors;        // files that could not be opened or were corrupt
+    uint32_t decode_max_us; // slowest read + decode of one frame
+} led_anim_stats_t;
+
+__BEGIN_DECLS
+/**
+ * @brief Checks magic, version and the size limits of a header.
+ *
+ * @return ESP_ERR_INVALID_VERSION on a foreign file or version, ESP_ERR_INVALID_SIZE on a frame larger
+ *         than CONFIG_LED_STRIP_MAX_LEDS or a frame rate outside 1..100.
+ */
+esp_err_t led_anim_header_check(const led_anim_header_t *header);
+
+/**
+ * @brief Encodes frame as difference to previous.
+ *
+ * @param out Receives the ops, must hold LED_ANIM_FRAME_BYTES_MAX(leds) bytes.
+ * @return Number of bytes written, 0 if the frame equals previous.
+ */
+size_t led_anim_encode_frame(const rgb_t *previous, const rgb_t *frame, size_t leds, uint8_t *out);
+
+/**
+ * @brief Applies an encoded frame to frame, which holds the previous frame on entry.
+ *
+ * @return ESP_ERR_INVALID_SIZE if the ops run past leds pixels or past size bytes, ESP_ERR_INVALID_ARG
+ *         on an unknown op.
+ */
+esp_err_t led_anim_decode_frame(rgb_t *frame, size_t leds, const uint8_t *data, size_t size);
+
+/**
+ * @brief Creates the decoder task. Called by led_strip_init().
+ */
+esp_err_t led_anim_init(void);
+
+/**
+ * @brief Starts streaming an animation from the storage partition.
+ *
+ * The file is read and decoded by a separate task into a ring of CONFIG_LED_ANIM_RING_FRAMES frame
+ * buffers, so RAM use does not depend on the length of the animation. Replaces a running animation.
+ *
+ * @param file File name in the storage partition.
+ * @param segment Segment the animation is played to (clipped to its length), NULL for the start
+ *                pixel stored in the file.
+ * @param loop Restart at the end instead of stopping.
+ * @return ESP_ERR_NOT_FOUND on an unknown segment, ESP_ERR_INVALID_ARG on an invalid file name. Errors
+ *         in the file itself are only detected by the decoder task and counted in the stats.
+ */
+esp_err_t led_anim_play(const char *file, const char *segment, bool loop);
+
+void led_anim_stop(void);
+
+/**
+ * @brief Stops the animation if it plays file and waits until the decoder task has closed it, so the
+ *        file can be rewritten or removed. Must not be called from the decoder or the LED task.
+ *
+ * @param timeout Longest wait for the decoder.
+ * @return false if the decoder still has the file open after timeout, or it was started again meanwhile.
+ */
+bool led_anim_release(const char *file, TickType_t timeout);
+
+/**
+ * @brief Returns true while an animation is playing.
+ */
+bool led_anim_active(void);
+
+/**
+ * @brief Advances the animation clock and writes the current frame over its range of the framebuffer.
+ *
+ * Called by the LED task after the effects. Frames are taken from the ring according to the frame
+ * rate of the file, late frames are skipped. The channel sums in sum are updated for the replaced
+ * pixels, cost is bounded by the length of the animation.
+ */
+void led_anim_render(rgb_t *framebuffer, size_t length, rgb_sum_t *sum);
+
+void led_anim_get_stats(led_anim_stats_t *stats);
+__END_DECLS
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "color.h"
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+// Matrix coefficients are Q3.12 fixed point: LED_CALIBRATION_ONE = 1.0, range -8.0 .. 7.9998
+#define LED_CALIBRATION_SHIFT 12
+#define LED_CALIBRATION_ONE (1 << LED_CALIBRATION_SHIFT)
+
+// Color correction of one segment (stored as blob, keep the layout stable). The output of a pixel is
+//   out = gain / 255 * (matrix * in)
+// with matrix in row-major order (row 0 yields red), so e.g. a bluish batch is corrected with a
+// smaller blue gain and crosstalk between the channels with the off-diagonal coefficients.
+typedef struct
+{
+    int16_t matrix[9];
+    uint8_t gain[3]; // red, green, blue; 255 = 1.0
+    uint8_t reserved;
+} led_calibration_config_t;
+
+// Matrix, gain and global brightness of a frame folded into one set of Q3.12 coefficients
+typedef struct
+{
+    int32_t k[9];
+} led_calibration_kernel_t;
+
+__BEGIN_DECLS
+/**
+ * @brief Loads the calibration bindings from the "led_config" namespace.
+ */
+void led_calibration_load(void);
+
+/**
+ * @brief Persists the calibration bindings to the "led_config" namespace.
+ */
+void led_calibration_save(void);
+
+/**
+ * @brief Returns the calibration of the segment with the given name.
+ *
+ * @return true if the segment is calibrated, false otherwise (config is set to the identity).
+ */
+bool led_calibration_get(const char *segment_name, led_calibration_config_t *config);
+
+/**
+ * @brief Sets the calibration of the segment with the given name, NULL removes it.
+ *
+ * @return ESP_ERR_NO_MEM if all slots are used.
+ */
+esp_err_t led_calibration_set(const char *segment_name, const led_calibration_config_t *config);
+
+/**
+ * @brief Drops bindings whose segment no longer exists. Must be called after the segment list changed.
+ */
+void led_calibration_segments_changed(void);
+
+/**
+ * @brief Fills config with the identity (unit matrix, full gain).
+ */
+void led_calibration_identity(led_calibration_config_t *config);
+
+/**
+ * @brief Returns by how much the calibration of a segment can raise the current of a pixel, Q3.12.
+ *
+ * The bound is the largest column sum of the positive coefficients times their gains: one input
+ * channel feeds every output channel of its column.
+ */
+uint32_t led_calibration_current_gain(const led_calibration_config_t *config);
+
+/**
+ * @brief Returns the largest led_calibration_current_gain() of the calibrated segments, at least
+ *        LED_CALIBRATION_ONE. Called by the LED task for the current estimate of a frame.
+ */
+uint32_t led_calibration_peak_gain(void);
+
+/**
+ * @brief Prepares the output stage for one frame.
+ *
+ * Called by the LED task before serializing. After every change the bindings are compiled into a
+ * table of CONFIG_LED_STRIP_MAX_LEDS entries: entry i is 0 for an uncalibrated logical pixel or
+ * k + 1 for a pixel of a segment using kernels[k]. The kernels already contain the global brightness
+ * scale (255 = unchanged), so a calibrated pixel needs no separate scaling pass.
+ *
+ * @return The table, NULL while no segment is calibrated.
+ */
+const uint8_t *led_calibration_prepare(uint8_t scale, const led_calibration_kernel_t **kernels);
+
+/**
+ * @brief Folds a calibration and a brightness scale into a kernel.
+ */
+void led_calibration_fuse(const led_calibration_config_t *config, uint8_t scale, led_calibration_kernel_t *kernel);
+__END_DECLS
+
+/**
+ * @brief Applies a kernel to a pixel; the output kernel of the LED task runs this per pixel.
+ */
+static inline rgb_t led_calibration_apply(const led_calibration_kernel_t *kernel, rgb_t pixel)
+{
+    const int32_t *k = kernel->k;
+    const int32_t half = LED_CALIBRATION_ONE / 2;
+    int32_t r = (k[0] * pixel.red + k[1] * pixel.green + k[2] * pixel.blue + half) >> LED_CALIBRATION_SHIFT;
+    int32_t g = (k[3] * pixel.red + k[4] * pixel.green + k[5] * pixel.blue + half) >> LED_CALIBRATION_SHIFT;
+    int32_t b = (k[6] * pixel.red + k[7] * pixel.green + k[8] * pixel.blue + half) >> LED_CALIBRATION_SHIFT;
+    rgb_t out = {
+        (uint8_t)(r < 0 ? 0 : r > 255 ? 255 : r),
+        (uint8_t)(g < 0 ? 0 : g > 255 ? 255 : g),
+        (uint8_t)(b < 0 ? 0 : b > 255 ? 255 : b),
+    };
+    return out;
+}
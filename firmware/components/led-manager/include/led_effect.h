@@ -0,0 +1,97 @@
+#pragma once
+
+#include "color.h"
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+// Scenery effects that can be attached to a segment
+typedef enum
+{
+    LED_EFFECT_NONE,
+    LED_EFFECT_LANTERN, // flickering gas lantern
+    LED_EFFECT_WELDING, // bursts of bright bluish flashes
+    LED_EFFECT_FIRE,    // glowing, per pixel varying embers
+    LED_EFFECT_CHASE,   // running lights
+    LED_EFFECT_TV,      // changing TV light in a window
+    LED_EFFECT_COUNT
+} led_effect_type_t;
+
+// Effect settings of one segment (stored as blob, keep the layout stable)
+typedef struct
+{
+    uint8_t type;      // led_effect_type_t
+    uint8_t speed;     // 0 = slowest, 255 = fastest
+    uint8_t intensity; // scales the light the effect adds on top of the base color
+    rgb_t color;
+} led_effect_config_t;
+
+// Render cost of the effect engine, measured in the LED task
+typedef struct
+{
+    uint32_t frames;
+    uint32_t last_us;
+    uint32_t avg_us;
+    uint32_t max_us;
+    uint16_t active_segments;
+    uint16_t active_pixels;
+} led_effect_stats_t;
+
+__BEGIN_DECLS
+/**
+ * @brief Loads the effect bindings from the "led_config" namespace.
+ */
+void led_effect_load(void);
+
+/**
+ * @brief Persists the effect bindings to the "led_config" namespace.
+ */
+void led_effect_save(void);
+
+/**
+ * @brief Returns the effect attached to the segment with the given name.
+ *
+ * @return true if an effect is attached, false otherwise (config is set to LED_EFFECT_NONE).
+ */
+bool led_effect_get(const char *segment_name, led_effect_config_t *config);
+
+/**
+ * @brief Attaches an effect to the segment with the given name (LED_EFFECT_NONE detaches it).
+ *
+ * @return ESP_ERR_INVALID_ARG on an unknown effect type, ESP_ERR_NO_MEM if all slots are used.
+ */
+esp_err_t led_effect_set(const char *segment_name, const led_effect_config_t *config);
+
+/**
+ * @brief Drops bindings whose segment no longer exists and re-resolves segment ranges.
+ *
+ * Must be called after the global segment list has been changed.
+ */
+void led_effect_segments_changed(void);
+
+/**
+ * @brief Returns true if at least one effect is attached to an existing segment.
+ */
+bool led_effect_any_active(void);
+
+/**
+ * @brief Advances all effects by one frame and adds their light to the framebuffer.
+ *
+ * The light actually added (after saturation) is accumulated into sum, tracked per segment while
+ * rendering. Cost is bounded by the number of pixels covered by effect segments (at most length).
+ */
+void led_effect_render(rgb_t *framebuffer, size_t length, rgb_sum_t *sum);
+
+void led_effect_get_stats(led_effect_stats_t *stats);
+
+const char *led_effect_type_to_string(led_effect_type_t type);
+
+/**
+ * @brief Parses an effect name as used by the API ("lantern", "fire", ...).
+ *
+ * @return The effect type or LED_EFFECT_COUNT if the name is unknown.
+ */
+led_effect_type_t led_effect_type_from_string(const char *name);
+__END_DECLS
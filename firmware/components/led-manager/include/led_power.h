@@ -0,0 +1,37 @@
+#pragma once
+
+#include "color.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+// Current estimate and limiter state of the last frame
+typedef struct
+{
+    uint32_t budget_ma;    // 0 = limiter disabled
+    uint32_t estimate_ma;  // draw of the frame at full brightness
+    uint32_t output_ma;    // draw after limiting
+    uint8_t scale;         // global brightness applied at the output, 255 = unlimited
+    uint32_t limited_frames;
+} led_power_stats_t;
+
+__BEGIN_DECLS
+/**
+ * @brief Estimates the current of a frame from its channel sums and updates the global brightness.
+ *
+ * The estimate is O(1) in the number of pixels: the caller passes channel sums that are maintained
+ * while the frame is composed. If the frame exceeds CONFIG_LED_POWER_BUDGET_MA the brightness is
+ * pulled down within a few frames, it recovers slowly once there is headroom again.
+ *
+ * @return Brightness to apply to every pixel at the output (255 = unchanged).
+ */
+uint8_t led_power_update(const rgb_sum_t *sum, size_t pixels);
+
+/**
+ * @brief Returns true while the brightness has not reached its target yet, i.e. further frames are needed.
+ */
+bool led_power_settling(void);
+
+void led_power_get_stats(led_power_stats_t *stats);
+__END_DECLS
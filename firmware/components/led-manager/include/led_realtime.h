@@ -0,0 +1,96 @@
+#pragma once
+
+#include "color.h"
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+// DDP (Distributed Display Protocol), 10 byte header (+4 with timecode) followed by pixel data
+#define LED_REALTIME_DDP_HEADER_LEN 10
+#define LED_REALTIME_DDP_TIMECODE_LEN 4
+#define LED_REALTIME_DDP_VERSION_MASK 0xC0
+#define LED_REALTIME_DDP_VERSION_1 0x40
+#define LED_REALTIME_DDP_FLAG_TIMECODE 0x10
+#define LED_REALTIME_DDP_FLAG_STORAGE 0x08
+#define LED_REALTIME_DDP_FLAG_REPLY 0x04
+#define LED_REALTIME_DDP_FLAG_QUERY 0x02
+#define LED_REALTIME_DDP_FLAG_PUSH 0x01
+#define LED_REALTIME_DDP_TYPE_RGB8 0x0B
+#define LED_REALTIME_DDP_ID_DISPLAY 1
+
+// E1.31 (sACN) data packet, DMX slots follow the 126 byte header
+#define LED_REALTIME_E131_PORT 5568
+#define LED_REALTIME_E131_HEADER_LEN 126
+#define LED_REALTIME_E131_PIXELS_PER_UNIVERSE 170
+#define LED_REALTIME_E131_OPTION_PREVIEW 0x80
+#define LED_REALTIME_E131_OPTION_TERMINATED 0x40
+
+typedef enum
+{
+    LED_REALTIME_DDP,
+    LED_REALTIME_E131,
+} led_realtime_protocol_t;
+
+// Receiver counters; latency is measured from the first packet of a frame to its output
+typedef struct
+{
+    bool active;                // realtime frames are overriding the simulator
+    uint32_t packets;           // valid data packets
+    uint32_t invalid_packets;   // malformed or unsupported packets
+    uint32_t lost_packets;      // gaps in the sequence numbers
+    uint32_t frames;            // frames completed by the receiver
+    uint32_t incomplete_frames; // E1.31 frames that restarted before all universes arrived
+    uint32_t superseded_frames; // frames completed while the previous one was not shown yet
+    uint32_t timeouts;          // fallbacks to the simulator
+    uint16_t fps;               // completed frames in the last second
+    uint32_t latency_avg_us;
+    uint32_t latency_max_us;
+} led_realtime_stats_t;
+
+__BEGIN_DECLS
+/**
+ * @brief Opens the DDP and E1.31 sockets and starts the receiver task.
+ *
+ * Needs a running network stack. DDP listens on CONFIG_LED_REALTIME_DDP_PORT, E1.31 on
+ * LED_REALTIME_E131_PORT (unicast and the multicast groups of the configured universes).
+ */
+esp_err_t led_realtime_start(void);
+
+/**
+ * @brief Opens a non-blocking UDP socket for the protocol on the given port.
+ *
+ * @return The socket or -1.
+ */
+int led_realtime_open(led_realtime_protocol_t protocol, uint16_t port);
+
+/**
+ * @brief Reads one datagram from the socket.
+ *
+ * The header is peeked, the pixel data is received straight into the frame under construction, which
+ * starts out dark. A completed frame (DDP push flag or data up to the end of the configured strip, last
+ * E1.31 universe) is handed to the LED task.
+ *
+ * @return ESP_ERR_NOT_FOUND if no datagram was pending, ESP_ERR_INVALID_ARG on a packet that was
+ *         dropped, ESP_OK otherwise.
+ */
+esp_err_t led_realtime_receive(int socket, led_realtime_protocol_t protocol);
+
+/**
+ * @brief Returns true while frames arrive within CONFIG_LED_REALTIME_TIMEOUT_MS.
+ */
+bool led_realtime_active(void);
+
+/**
+ * @brief Writes the newest realtime frame into the framebuffer.
+ *
+ * Called by the LED task instead of composing base color, effects and animations. Computes the
+ * channel sums of the frame in the same pass.
+ *
+ * @return false if realtime is not active, the framebuffer is untouched then.
+ */
+bool led_realtime_render(rgb_t *framebuffer, size_t length, rgb_sum_t *sum);
+
+void led_realtime_get_stats(led_realtime_stats_t *stats);
+__END_DECLS
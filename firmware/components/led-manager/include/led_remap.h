@@ -0,0 +1,69 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+#define LED_REMAP_REVERSE 0x01 // the run is wired from its last pixel to its first
+
+// Sentinel of the compiled table: the physical pixel is not driven by any logical pixel
+#define LED_REMAP_DARK 0xFFFF
+
+// Wiring of one segment (stored as blob, keep the layout stable). Rendering works on logical pixels
+// start..start+leds-1 of the segment; on the strip they occupy the physical pixels offset,
+// offset + 1 + skip, offset + 2 * (1 + skip), ...
+typedef struct
+{
+    uint16_t offset; // first physical pixel of the run
+    uint8_t skip;    // dark physical pixels after every pixel (e.g. LEDs hidden behind a wall)
+    uint8_t flags;   // LED_REMAP_*
+} led_remap_config_t;
+
+__BEGIN_DECLS
+/**
+ * @brief Loads the remap bindings from the "led_config" namespace.
+ */
+void led_remap_load(void);
+
+/**
+ * @brief Persists the remap bindings to the "led_config" namespace.
+ */
+void led_remap_save(void);
+
+/**
+ * @brief Returns the wiring of the segment with the given name.
+ *
+ * @return true if the segment is remapped, false otherwise (config is zeroed).
+ */
+bool led_remap_get(const char *segment_name, led_remap_config_t *config);
+
+/**
+ * @brief Sets the wiring of the segment with the given name, NULL restores the identity.
+ *
+ * @return ESP_ERR_NO_MEM if all slots are used.
+ */
+esp_err_t led_remap_set(const char *segment_name, const led_remap_config_t *config);
+
+/**
+ * @brief Drops bindings whose segment no longer exists and recompiles the table.
+ *
+ * Must be called after the global segment list has been changed.
+ */
+void led_remap_segments_changed(void);
+
+/**
+ * @brief Returns the physical to logical index table of the output stage.
+ *
+ * Called by the LED task once per frame. The bindings are compiled into a flat table of
+ * CONFIG_LED_STRIP_MAX_LEDS entries after every change: entry i is the logical pixel shown by
+ * physical pixel i, or LED_REMAP_DARK. Pixels outside remapped segments keep their index, the
+ * physical pixels a remapped segment left or skips stay dark unless another segment moved there.
+ * Skipped pixels of segments without a remap stay lit; a remapped pixel landing on one replaces it
+ * and is logged as a conflict.
+ *
+ * @return The table, NULL while no segment is remapped (physical = logical).
+ */
+const uint16_t *led_remap_table(void);
+__END_DECLS
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "color.h"
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+// Effect scripts: one assignment per line (or separated by ';'), '#' starts a comment.
+//
+//   wave = sin(i * 8 - t * 3)
+//   r = scale(wave, 255)
+//   g = scale(wave, 120) + noise(i, t / 4) / 8
+//   b = 0
+//
+// Values are 32 bit integers, colors and waves use 0..255 as fixed point 0.0..1.0. Inputs: i (pixel
+// in the segment), n (pixels in the segment), t (frames since the script was bound, at
+// CONFIG_LED_EFFECT_FRAME_RATE), pr, pg, pb (pixel color before the script). The outputs r, g, b are
+// clamped to 0..255 and added to the pixel like the light of the built-in effects. Every name is
+// assigned once, before it is used.
+//
+// Operators: + - * / % and unary -, division by zero gives 0. Functions: sin(x) and tri(x) (waves with
+// a period of 256, 0..255), scale(a, b) (a * b / 255), min(a, b), max(a, b), abs(x), noise(x, y)
+// (hash, 0..255) and rand() (0..255, new for every pixel).
+//
+// The compiler folds constants and moves everything that does not depend on the pixel into a
+// prologue that runs once per frame.
+
+#define LED_SCRIPT_SOURCE_MAX 2048
+#define LED_SCRIPT_CODE_MAX 64
+#define LED_SCRIPT_REGISTERS 32
+#define LED_SCRIPT_NAME_MAX 32
+
+// Fixed registers, variables and constants follow
+typedef enum
+{
+    LED_SCRIPT_REG_I,
+    LED_SCRIPT_REG_N,
+    LED_SCRIPT_REG_T,
+    LED_SCRIPT_REG_PR,
+    LED_SCRIPT_REG_PG,
+    LED_SCRIPT_REG_PB,
+    LED_SCRIPT_REG_R,
+    LED_SCRIPT_REG_G,
+    LED_SCRIPT_REG_B,
+    LED_SCRIPT_REG_FIRST_FREE,
+} led_script_register_t;
+
+// Instruction word: op | dst << 8 | a << 16 | b << 24
+typedef enum
+{
+    LED_SCRIPT_OP_MOV,
+    LED_SCRIPT_OP_ADD,
+    LED_SCRIPT_OP_SUB,
+    LED_SCRIPT_OP_MUL,
+    LED_SCRIPT_OP_DIV,
+    LED_SCRIPT_OP_MOD,
+    LED_SCRIPT_OP_NEG,
+    LED_SCRIPT_OP_ABS,
+    LED_SCRIPT_OP_MIN,
+    LED_SCRIPT_OP_MAX,
+    LED_SCRIPT_OP_SCALE,
+    LED_SCRIPT_OP_SIN,
+    LED_SCRIPT_OP_TRI,
+    LED_SCRIPT_OP_NOISE,
+    LED_SCRIPT_OP_RAND,
+    LED_SCRIPT_OP_COUNT
+} led_script_op_t;
+
+typedef struct
+{
+    uint8_t frame_len;      // instructions of the per frame prologue
+    uint8_t pixel_len;      // instructions per pixel, following the prologue
+    uint32_t constant_mask; // registers holding constants
+    uint32_t code[LED_SCRIPT_CODE_MAX];
+    int32_t init[LED_SCRIPT_REGISTERS]; // register values at the start of a frame
+} led_script_program_t;
+
+typedef struct
+{
+    uint16_t line;
+    char message[48];
+} led_script_error_t;
+
+// Evaluation cost, measured in the LED task
+typedef struct
+{
+    uint16_t active_segments;
+    uint32_t frames;
+    uint32_t instructions;  // executed in the last frame
+    uint32_t budget_frames; // frames where CONFIG_LED_SCRIPT_BUDGET cut a script short
+    uint32_t avg_us;
+    uint32_t max_us;
+} led_script_stats_t;
+
+__BEGIN_DECLS
+/**
+ * @brief Compiles a script.
+ *
+ * @return ESP_ERR_INVALID_ARG on a syntax error, ESP_ERR_INVALID_SIZE if the script needs more than
+ *         LED_SCRIPT_CODE_MAX instructions or LED_SCRIPT_REGISTERS registers; error describes the
+ *         problem then.
+ */
+esp_err_t led_script_compile(const char *source, size_t length, led_script_program_t *program,
+                             led_script_error_t *error);
+
+/**
+ * @brief Evaluates a program for one frame of a segment and adds the resulting light to pixels.
+ *
+ * No allocations, the registers live on the stack. A frame costs frame_len + leds * pixel_len
+ * instructions; pixels that do not fit into budget are left unchanged. The light actually added
+ * (after saturation) is accumulated into added.
+ *
+ * @param rng State of rand(), must not be 0.
+ * @return Instructions executed.
+ */
+uint32_t led_script_run(const led_script_program_t *program, rgb_t *pixels, uint16_t leds, uint32_t frame,
+                        uint32_t budget, uint32_t *rng, rgb_sum_t *added);
+
+/**
+ * @brief Writes a listing of the program, one instruction per line.
+ */
+void led_script_disassemble(const led_script_program_t *program, void (*print)(const char *line, void *context),
+                            void *context);
+
+/**
+ * @brief Loads the script bindings from the "led_config" namespace and compiles their files.
+ */
+void led_script_load(void);
+
+/**
+ * @brief Binds the script file from the storage partition to the segment with the given name.
+ *
+ * The file is compiled here, the LED task only picks up the program. file NULL unbinds the segment.
+ *
+ * @return ESP_ERR_NOT_FOUND if the file does not exist, ESP_ERR_NO_MEM if all CONFIG_LED_SCRIPT_MAX
+ *         slots are used, or the error of led_script_compile().
+ */
+esp_err_t led_script_bind(const char *segment_name, const char *file, led_script_error_t *error);
+
+/**
+ * @brief Copies the name of the file bound to the segment into file.
+ *
+ * @return false if no script is bound to the segment.
+ */
+bool led_script_get(const char *segment_name, char *file, size_t size);
+
+/**
+ * @brief Persists the script bindings to the "led_config" namespace.
+ */
+void led_script_save(void);
+
+/**
+ * @brief Drops bindings whose segment no longer exists. Must be called after the segment list changed.
+ */
+void led_script_segments_changed(void);
+
+bool led_script_any_active(void);
+
+/**
+ * @brief Runs the scripts of all bound segments for one frame.
+ *
+ * Called by the LED task after the built-in effects. At most CONFIG_LED_SCRIPT_BUDGET instructions
+ * are executed per frame, pixels beyond the budget keep their color for this frame.
+ */
+void led_script_render(rgb_t *framebuffer, size_t length, rgb_sum_t *sum);
+
+void led_script_get_stats(led_script_stats_t *stats);
+__END_DECLS
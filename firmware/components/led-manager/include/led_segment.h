@@ -1,7 +1,9 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/cdefs.h>
 
 #define LED_SEGMENT_MAX_LEN 15
 
@@ -12,5 +14,50 @@ typedef struct
     uint16_t leds;
 } led_segment_t;
 
-led_segment_t segments[LED_SEGMENT_MAX_LEN];
-size_t segment_count;
+// Copy of the segment list, sorted by start index
+typedef struct
+{
+    led_segment_t segments[LED_SEGMENT_MAX_LEN];
+    size_t count;
+} led_segment_list_t;
+
+__BEGIN_DECLS
+/**
+ * @brief Loads the segment list from the "led_config" namespace, sorted by start index.
+ */
+void led_segment_load(void);
+
+/**
+ * @brief Writes the segment list to the "led_config" namespace.
+ */
+void led_segment_save(void);
+
+/**
+ * @brief Replaces the segment list.
+ *
+ * The list is sorted and published as a whole, so the LED task never sees a half written one. Call
+ * the *_segments_changed() functions of the modules bound to segments afterwards.
+ *
+ * @param count Number of entries, at most LED_SEGMENT_MAX_LEN are taken.
+ */
+void led_segment_set(const led_segment_t *segments, size_t count);
+
+/**
+ * @brief Copies the current segment list.
+ */
+void led_segment_get_all(led_segment_list_t *list);
+
+/**
+ * @brief Looks up a segment by name.
+ *
+ * @param segment Receives the segment if found, may be NULL to only test for it.
+ * @return true if a segment has this name.
+ */
+bool led_segment_find(const char *name, led_segment_t *segment);
+
+/**
+ * @brief Returns the configured length of the strip: the pixels up to the end of the last segment,
+ *        0 if no segment is configured.
+ */
+uint16_t led_segment_strip_length(void);
+__END_DECLS
@@ -39,7 +39,9 @@ esp_err_t led_status_init(int gpio_num);
 /**
  * @brief Sets the lighting behavior for a single LED.
  *
- * This function is thread-safe.
+ * This function never blocks and may be called from tasks, timer callbacks and ISRs.
+ * The behavior is published to a per-LED mailbox and picked up by the status task at its
+ * next evaluation; repeating the current behavior is a no-op.
  *
  * @param index Index of the LED (0 to STATUS_LED_COUNT - 1).
  * @param behavior The structure with the desired behavior.
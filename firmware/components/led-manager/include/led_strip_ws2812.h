@@ -12,7 +12,28 @@ typedef enum
     LED_STATE_SIMULATION,
 } led_state_t;
 
+// Counters of the main strip output
+typedef struct
+{
+    uint32_t commands;         // commands posted via led_strip_update
+    uint32_t dropped_commands; // commands superseded before the LED task rendered them
+} led_strip_stats_t;
+
 __BEGIN_DECLS
 esp_err_t led_strip_init(void);
+
+/**
+ * @brief Posts a new state/color for the main strip.
+ *
+ * Never blocks: the command replaces any command the LED task has not picked up yet
+ * (latest wins), superseded commands are counted in led_strip_stats_t.
+ */
 esp_err_t led_strip_update(led_state_t state, rgb_t color);
+
+/**
+ * @brief Makes the LED task render a frame now, e.g. after an animation was started.
+ */
+void led_strip_wake(void);
+
+void led_strip_get_stats(led_strip_stats_t *stats);
 __END_DECLS
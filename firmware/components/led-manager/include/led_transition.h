@@ -0,0 +1,88 @@
+#pragma once
+
+#include "color.h"
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+// Easing curves of the crossfade between two strip states
+typedef enum
+{
+    LED_EASING_LINEAR,
+    LED_EASING_EASE_IN,     // slow start (quadratic)
+    LED_EASING_EASE_OUT,    // slow end (quadratic)
+    LED_EASING_EASE_IN_OUT, // slow start and end (smoothstep)
+    LED_EASING_COUNT
+} led_easing_t;
+
+typedef struct
+{
+    uint16_t duration_ms; // 0 disables transitions
+    uint8_t easing;       // led_easing_t
+} led_transition_config_t;
+
+// Cost of the crossfade pass, measured in the LED task
+typedef struct
+{
+    uint32_t transitions;
+    uint32_t frames;
+    uint32_t last_us;
+    uint32_t max_us;
+    bool active;
+} led_transition_stats_t;
+
+__BEGIN_DECLS
+/**
+ * @brief Loads the transition settings from the "led_config" namespace (Kconfig defaults otherwise).
+ */
+void led_transition_load(void);
+
+/**
+ * @brief Persists the transition settings to the "led_config" namespace.
+ */
+void led_transition_save(void);
+
+void led_transition_get_config(led_transition_config_t *config);
+
+/**
+ * @brief Changes duration and easing of the following transitions.
+ *
+ * @return ESP_ERR_INVALID_ARG on an unknown easing curve.
+ */
+esp_err_t led_transition_set_config(const led_transition_config_t *config);
+
+/**
+ * @brief Starts a crossfade from the frame currently shown on the strip.
+ *
+ * The frame is copied into a static buffer, at most CONFIG_LED_STRIP_MAX_LEDS pixels are kept.
+ * Starting a new transition while one is running fades from the mixed frame on the strip.
+ * sum holds the channel sums of that frame.
+ */
+void led_transition_start(const rgb_t *frame, size_t length, const rgb_sum_t *sum);
+
+/**
+ * @brief Returns true while a crossfade is running.
+ */
+bool led_transition_active(void);
+
+/**
+ * @brief Blends the snapshot into the freshly rendered target frame according to the elapsed time.
+ *
+ * Cost is one fixed-point pass over the framebuffer, so it is bounded by length. The channel sums
+ * of the target frame in sum are mixed the same way, without touching the pixels again.
+ */
+void led_transition_apply(rgb_t *framebuffer, size_t length, rgb_sum_t *sum);
+
+void led_transition_get_stats(led_transition_stats_t *stats);
+
+const char *led_easing_to_string(led_easing_t easing);
+
+/**
+ * @brief Parses an easing name as used by the API ("linear", "ease-in-out", ...).
+ *
+ * @return The easing curve or LED_EASING_COUNT if the name is unknown.
+ */
+led_easing_t led_easing_from_string(const char *name);
+__END_DECLS
@@ -1,60 +1,160 @@
 #include "color.h"
-#include <math.h>
 
-rgb_t interpolate_color_rgb(rgb_t start, rgb_t end, float factor)
+// Width of one hue sector (60 degrees) and the full circle with 8 fractional hue bits
+#define HUE_SECTOR_Q8 (30 * 256)
+#define HUE_CIRCLE_Q8 (HSV_HUE_MAX * 256)
+// Denominator of the q/t terms: 255 * 180 * 256
+#define HSV_QT_DIV (45900u * 256u)
+
+#define KELVIN_STEP 100
+
+// Black body colors from COLOR_KELVIN_MIN to COLOR_KELVIN_MAX in KELVIN_STEP steps
+// (approximation by Tanner Helland), precomputed so that no float math is needed at runtime
+static const rgb_t kelvin_table[] = {
+    {255, 68, 0}, {255, 77, 0}, {255, 86, 0}, {255, 94, 0}, {255, 101, 0}, {255, 108, 0}, {255, 115, 0},
+    {255, 121, 0}, {255, 126, 0}, {255, 132, 0}, {255, 137, 14}, {255, 142, 27}, {255, 146, 39}, {255, 151, 50},
+    {255, 155, 61}, {255, 159, 70}, {255, 163, 79}, {255, 167, 87}, {255, 170, 95}, {255, 174, 103},
+    {255, 177, 110}, {255, 180, 117}, {255, 184, 123}, {255, 187, 129}, {255, 190, 135}, {255, 193, 141},
+    {255, 195, 146}, {255, 198, 151}, {255, 201, 157}, {255, 203, 161}, {255, 206, 166}, {255, 208, 171},
+    {255, 211, 175}, {255, 213, 179}, {255, 215, 183}, {255, 218, 187}, {255, 220, 191}, {255, 222, 195},
+    {255, 224, 199}, {255, 226, 202}, {255, 228, 206}, {255, 230, 209}, {255, 232, 213}, {255, 234, 216},
+    {255, 236, 219}, {255, 237, 222}, {255, 239, 225}, {255, 241, 228}, {255, 243, 231}, {255, 244, 234},
+    {255, 246, 237}, {255, 248, 240}, {255, 249, 242}, {255, 251, 245}, {255, 253, 248}, {255, 254, 250},
+    {255, 255, 255}, {254, 249, 255}, {250, 246, 255}, {246, 244, 255}, {243, 242, 255}, {240, 240, 255},
+    {237, 239, 255}, {234, 237, 255}, {232, 236, 255}, {230, 235, 255}, {228, 234, 255}, {226, 233, 255},
+    {224, 232, 255}, {223, 231, 255}, {221, 230, 255}, {220, 229, 255}, {218, 228, 255}, {217, 227, 255},
+    {216, 227, 255}, {215, 226, 255}, {214, 225, 255}, {213, 225, 255}, {212, 224, 255}, {211, 223, 255},
+    {210, 223, 255}, {209, 222, 255}, {208, 222, 255}, {207, 221, 255}, {206, 221, 255}, {205, 220, 255},
+    {205, 220, 255}, {204, 219, 255}, {203, 219, 255}, {202, 218, 255}, {202, 218, 255}, {201, 218, 255},
+    {200, 217, 255}, {200, 217, 255}, {199, 217, 255}, {199, 216, 255}, {198, 216, 255}, {197, 215, 255},
+    {197, 215, 255}, {196, 215, 255}, {196, 214, 255}, {195, 214, 255}, {195, 214, 255}, {194, 213, 255},
+    {194, 213, 255}, {193, 213, 255}, {193, 213, 255}, {192, 212, 255}, {192, 212, 255}, {192, 212, 255},
+    {191, 211, 255},
+};
+
+static inline uint8_t lerp8(uint8_t start, uint8_t end, color_fract_t factor)
+{
+    // Arithmetic shift rounds towards -inf, matching a truncating float lerp of non-negative results
+    int32_t delta = (int32_t)end - (int32_t)start;
+    return (uint8_t)(start + ((delta * (int32_t)factor) >> COLOR_FRACT_SHIFT));
+}
+
+static inline color_fract_t clamp_fract(color_fract_t factor)
+{
+    return factor > COLOR_FRACT_ONE ? COLOR_FRACT_ONE : factor;
+}
+
+// hue_q8 carries 8 fractional bits so interpolated hues keep their precision
+static rgb_t hsv_q8_to_rgb(uint32_t hue_q8, uint8_t s, uint8_t v)
+{
+    rgb_t rgb;
+
+    if (s == 0)
+    {
+        // Graustufe
+        rgb.red = v;
+        rgb.green = v;
+        rgb.blue = v;
+        return rgb;
+    }
+
+    uint32_t region = hue_q8 / HUE_SECTOR_Q8;
+    uint32_t remainder = (hue_q8 - (region * HUE_SECTOR_Q8)) * 6;
+
+    uint8_t p = (uint8_t)color_div255((uint32_t)v * (255 - s));
+    uint8_t q = (uint8_t)(((uint32_t)v * (HSV_QT_DIV - (uint32_t)s * remainder)) / HSV_QT_DIV);
+    uint8_t t = (uint8_t)(((uint32_t)v * (HSV_QT_DIV - (uint32_t)s * ((180 * 256) - remainder))) / HSV_QT_DIV);
+
+    switch (region)
+    {
+    case 0:
+        rgb.red = v;
+        rgb.green = t;
+        rgb.blue = p;
+        break;
+    case 1:
+        rgb.red = q;
+        rgb.green = v;
+        rgb.blue = p;
+        break;
+    case 2:
+        rgb.red = p;
+        rgb.green = v;
+        rgb.blue = t;
+        break;
+    case 3:
+        rgb.red = p;
+        rgb.green = q;
+        rgb.blue = v;
+        break;
+    case 4:
+        rgb.red = t;
+        rgb.green = p;
+        rgb.blue = v;
+        break;
+    default: // case 5:
+        rgb.red = v;
+        rgb.green = p;
+        rgb.blue = q;
+        break;
+    }
+
+    return rgb;
+}
+
+color_fract_t color_fract_from_ratio(uint32_t num, uint32_t den)
+{
+    if (den == 0 || num >= den)
+        return COLOR_FRACT_ONE;
+
+    return (color_fract_t)(((uint64_t)num << COLOR_FRACT_SHIFT) / den);
+}
+
+rgb_t interpolate_color_rgb(rgb_t start, rgb_t end, color_fract_t factor)
 {
-    // Clamp factor to [0, 1]
-    if (factor > 1.0f)
-        factor = 1.0f;
-    if (factor < 0.0f)
-        factor = 0.0f;
+    factor = clamp_fract(factor);
 
     rgb_t result;
-    result.red = (uint8_t)(start.red + (end.red - start.red) * factor);
-    result.green = (uint8_t)(start.green + (end.green - start.green) * factor);
-    result.blue = (uint8_t)(start.blue + (end.blue - start.blue) * factor);
+    result.red = lerp8(start.red, end.red, factor);
+    result.green = lerp8(start.green, end.green, factor);
+    result.blue = lerp8(start.blue, end.blue, factor);
 
     return result;
 }
 
-rgb_t interpolate_color_hsv(rgb_t start, rgb_t end, float factor)
+rgb_t interpolate_color_hsv(rgb_t start, rgb_t end, color_fract_t factor)
 {
-    // Clamp factor to [0, 1]
-    if (factor > 1.0f)
-        factor = 1.0f;
-    if (factor < 0.0f)
-        factor = 0.0f;
+    factor = clamp_fract(factor);
 
     // Convert RGB to HSV
     hsv_t start_hsv = rgb_to_hsv(start);
     hsv_t end_hsv = rgb_to_hsv(end);
 
-    // Handle hue interpolation carefully (circular)
-    double h1 = start_hsv.h;
-    double h2 = end_hsv.h;
-    double diff = h2 - h1;
+    // Handle hue interpolation carefully (circular, take the shorter way round)
+    int32_t h1 = start_hsv.h;
+    int32_t h2 = end_hsv.h;
+    int32_t diff = h2 - h1;
 
-    if (diff > 180.0)
+    if (diff > HSV_HUE_MAX / 2)
     {
-        h1 += 360.0;
+        h1 += HSV_HUE_MAX;
     }
-    else if (diff < -180.0)
+    else if (diff < -HSV_HUE_MAX / 2)
     {
-        h2 += 360.0;
+        h2 += HSV_HUE_MAX;
     }
 
-    // Interpolate HSV values
-    hsv_t interpolated_hsv;
-    interpolated_hsv.h = fmodf(h1 + (h2 - h1) * factor, 360.0f);
-    if (interpolated_hsv.h < 0.0f)
+    int32_t hue_q8 = (h1 << 8) + ((((h2 - h1) * 256) * (int32_t)factor) >> COLOR_FRACT_SHIFT);
+    if (hue_q8 >= HUE_CIRCLE_Q8)
     {
-        interpolated_hsv.h += 360.0f;
+        hue_q8 -= HUE_CIRCLE_Q8;
     }
-    interpolated_hsv.s = start_hsv.s + (end_hsv.s - start_hsv.s) * factor;
-    interpolated_hsv.v = start_hsv.v + (end_hsv.v - start_hsv.v) * factor;
+
+    uint8_t s = lerp8(start_hsv.s, end_hsv.s, factor);
+    uint8_t v = lerp8(start_hsv.v, end_hsv.v, factor);
 
     // Convert back to RGB
-    return hsv_to_rgb(interpolated_hsv);
+    return hsv_q8_to_rgb((uint32_t)hue_q8, s, v);
 }
 
 hsv_t rgb_to_hsv(rgb_t rgb)
@@ -80,7 +180,7 @@ hsv_t rgb_to_hsv(rgb_t rgb)
     // Saturation berechnen
     if (max != 0)
     {
-        hsv.s = (delta * 255) / max;
+        hsv.s = (uint8_t)((delta * 255) / max);
     }
     else
     {
@@ -126,58 +226,97 @@ hsv_t rgb_to_hsv(rgb_t rgb)
 
 rgb_t hsv_to_rgb(hsv_t hsv)
 {
-    rgb_t rgb;
+    return hsv_q8_to_rgb((uint32_t)hsv.h << 8, hsv.s, hsv.v);
+}
 
-    if (hsv.s == 0)
-    {
-        // Graustufe
-        rgb.red = hsv.v;
-        rgb.green = hsv.v;
-        rgb.blue = hsv.v;
-    }
-    else
-    {
-        uint16_t region = hsv.h / 30;
-        uint16_t remainder = (hsv.h - (region * 30)) * 6;
+rgb_t color_scale(rgb_t color, uint8_t scale)
+{
+    rgb_t result;
+    result.red = (uint8_t)color_div255((uint32_t)color.red * scale);
+    result.green = (uint8_t)color_div255((uint32_t)color.green * scale);
+    result.blue = (uint8_t)color_div255((uint32_t)color.blue * scale);
+    return result;
+}
 
-        uint8_t p = (hsv.v * (255 - hsv.s)) / 255;
-        uint8_t q = (hsv.v * (255 - ((hsv.s * remainder) / 180))) / 255;
-        uint8_t t = (hsv.v * (255 - ((hsv.s * (180 - remainder)) / 180))) / 255;
+rgb_t color_blend(rgb_t background, rgb_t foreground, uint8_t alpha)
+{
+    uint32_t inv = 255 - alpha;
 
-        switch (region)
-        {
-        case 0:
-            rgb.red = hsv.v;
-            rgb.green = t;
-            rgb.blue = p;
-            break;
-        case 1:
-            rgb.red = q;
-            rgb.green = hsv.v;
-            rgb.blue = p;
-            break;
-        case 2:
-            rgb.red = p;
-            rgb.green = hsv.v;
-            rgb.blue = t;
-            break;
-        case 3:
-            rgb.red = p;
-            rgb.green = q;
-            rgb.blue = hsv.v;
-            break;
-        case 4:
-            rgb.red = t;
-            rgb.green = p;
-            rgb.blue = hsv.v;
-            break;
-        default: // case 5:
-            rgb.red = hsv.v;
-            rgb.green = p;
-            rgb.blue = q;
-            break;
-        }
-    }
+    rgb_t result;
+    result.red = (uint8_t)color_div255(background.red * inv + foreground.red * (uint32_t)alpha);
+    result.green = (uint8_t)color_div255(background.green * inv + foreground.green * (uint32_t)alpha);
+    result.blue = (uint8_t)color_div255(background.blue * inv + foreground.blue * (uint32_t)alpha);
+    return result;
+}
 
-    return rgb;
+rgb_t color_add(rgb_t a, rgb_t b)
+{
+    uint16_t red = (uint16_t)a.red + b.red;
+    uint16_t green = (uint16_t)a.green + b.green;
+    uint16_t blue = (uint16_t)a.blue + b.blue;
+
+    rgb_t result;
+    result.red = red > 255 ? 255 : (uint8_t)red;
+    result.green = green > 255 ? 255 : (uint8_t)green;
+    result.blue = blue > 255 ? 255 : (uint8_t)blue;
+    return result;
+}
+
+rgb_t color_from_kelvin(uint16_t kelvin)
+{
+    if (kelvin <= COLOR_KELVIN_MIN)
+        return kelvin_table[0];
+    if (kelvin >= COLOR_KELVIN_MAX)
+        return kelvin_table[(COLOR_KELVIN_MAX - COLOR_KELVIN_MIN) / KELVIN_STEP];
+
+    uint32_t offset = kelvin - COLOR_KELVIN_MIN;
+    uint32_t index = offset / KELVIN_STEP;
+    color_fract_t factor = color_fract_from_ratio(offset - index * KELVIN_STEP, KELVIN_STEP);
+    return interpolate_color_rgb(kelvin_table[index], kelvin_table[index + 1], factor);
+}
+
+static uint16_t white_inverse(uint8_t channel)
+{
+    // Rounded up, so that a color equal to the white point moves completely to the white LED
+    return channel == 0 ? 0 : (uint16_t)(((255u << 8) + channel - 1) / channel);
+}
+
+void color_white_point_init(color_white_point_t *white_point, rgb_t white)
+{
+    white_point->white = white;
+    white_point->inverse[0] = white_inverse(white.red);
+    white_point->inverse[1] = white_inverse(white.green);
+    white_point->inverse[2] = white_inverse(white.blue);
+}
+
+// Level of the white LED that this channel allows, 255 if the white LED does not emit in it
+static inline uint32_t white_limit(uint8_t channel, uint16_t inverse)
+{
+    if (inverse == 0)
+        return 255;
+    uint32_t limit = ((uint32_t)channel * inverse) >> 8;
+    return limit > 255 ? 255 : limit;
+}
+
+rgbw_t color_extract_white(const color_white_point_t *white_point, rgb_t color)
+{
+    uint32_t white = white_limit(color.red, white_point->inverse[0]);
+    uint32_t limit = white_limit(color.green, white_point->inverse[1]);
+    if (limit < white)
+        white = limit;
+    limit = white_limit(color.blue, white_point->inverse[2]);
+    if (limit < white)
+        white = limit;
+
+    // The white LED takes over white * white_point of every channel, at most what the channel had
+    uint32_t red = color_div255(white * white_point->white.red);
+    uint32_t green = color_div255(white * white_point->white.green);
+    uint32_t blue = color_div255(white * white_point->white.blue);
+
+    rgbw_t result;
+    result.red = (uint8_t)(color.red > red ? color.red - red : 0);
+    result.green = (uint8_t)(color.green > green ? color.green - green : 0);
+    result.blue = (uint8_t)(color.blue > blue ? color.blue - blue : 0);
+    result.white = (uint8_t)white;
+    return result;
 }
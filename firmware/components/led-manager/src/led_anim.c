@@ -0,0 +1,414 @@
+#include "led_anim.h"
+#include "led_segment.h"
+#include "led_strip_ws2812.h"
+#include "storage.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <inttypes.h>
+#include <sdkconfig.h>
+#include <string.h>
+
+static const char *TAG = "led_anim";
+
+#define RING_FRAMES CONFIG_LED_ANIM_RING_FRAMES
+
+typedef struct
+{
+    uint32_t generation; // bumped by every play/stop, the tasks drop work of older generations
+    bool active;
+    bool loop;
+    char file[LED_ANIM_NAME_MAX];
+    int32_t segment_start; // -1 = start pixel of the file
+    uint16_t segment_leds;
+} led_anim_request_t;
+
+typedef struct
+{
+    uint16_t start;
+    uint16_t leds; // pixels written to the strip, at most the pixels of a frame
+    uint32_t frame_us;
+} led_anim_playback_t;
+
+static TaskHandle_t decoder_task_handle;
+
+// Protects the request, the ring indices and the stats. The ring holds decoded frames: the LED task
+// shows slot head and releases it when the next frame is due, the decoder fills (head + count) %
+// RING_FRAMES. Neither task touches the other's slots, so the pixels are accessed without the lock.
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static led_anim_request_t request;
+static uint32_t ring_generation;
+static size_t head;
+static size_t count;
+static bool finished; // the decoder reached the end of a non-looping file
+static led_anim_playback_t playback;
+static led_anim_stats_t stats;
+static uint32_t decoder_generation; // request the decoder works on, the files of older ones are closed
+
+static rgb_t ring[RING_FRAMES][CONFIG_LED_STRIP_MAX_LEDS];
+
+// Owned by the decoder task
+static uint8_t payload[LED_ANIM_FRAME_BYTES_MAX(CONFIG_LED_STRIP_MAX_LEDS)];
+
+// Owned by the LED task
+static bool started;
+static int64_t start_us;
+static uint32_t shown;
+
+static void fail(uint32_t generation, const char *file, const char *reason)
+{
+    ESP_LOGE(TAG, "%s: %s", file, reason);
+    taskENTER_CRITICAL(&lock);
+    if (request.generation == generation)
+    {
+        request.active = false;
+    }
+    stats.errors++;
+    taskEXIT_CRITICAL(&lock);
+}
+
+static FILE *open_animation(const led_anim_request_t *current, led_anim_header_t *header)
+{
+    FILE *file = storage_open(current->file, "rb");
+    if (file == NULL)
+    {
+        fail(current->generation, current->file, "not found");
+        return NULL;
+    }
+
+    if (fread(header, sizeof(*header), 1, file) != 1 || led_anim_header_check(header) != ESP_OK ||
+        header->frame_count == 0)
+    {
+        fclose(file);
+        fail(current->generation, current->file, "invalid header");
+        return NULL;
+    }
+
+    uint32_t start = current->segment_start >= 0 ? (uint32_t)current->segment_start : header->start;
+    uint32_t leds = header->leds;
+    if (current->segment_start >= 0 && leds > current->segment_leds)
+        leds = current->segment_leds;
+    if (start >= CONFIG_LED_STRIP_MAX_LEDS)
+        leds = 0;
+    else if (start + leds > CONFIG_LED_STRIP_MAX_LEDS)
+        leds = CONFIG_LED_STRIP_MAX_LEDS - start;
+
+    taskENTER_CRITICAL(&lock);
+    if (request.generation == current->generation)
+    {
+        playback = (led_anim_playback_t){
+            .start = (uint16_t)start,
+            .leds = (uint16_t)leds,
+            .frame_us = 1000000u / header->frame_rate,
+        };
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    ESP_LOGI(TAG, "Playing %s: %u leds at %u, %" PRIu32 " frames at %u fps", current->file, (unsigned)leds,
+             (unsigned)start, header->frame_count, header->frame_rate);
+    return file;
+}
+
+static bool read_frame(FILE *file, rgb_t *frame, size_t leds)
+{
+    uint8_t size_le[2];
+    if (fread(size_le, sizeof(size_le), 1, file) != 1)
+        return false;
+    size_t size = (size_t)size_le[0] | ((size_t)size_le[1] << 8);
+    if (size > LED_ANIM_FRAME_BYTES_MAX(leds) || (size > 0 && fread(payload, size, 1, file) != 1))
+        return false;
+    return led_anim_decode_frame(frame, leds, payload, size) == ESP_OK;
+}
+
+// Reads ahead from flash into the free ring slots; blocking file I/O stays out of the LED task
+static void led_anim_decoder_task(void *pvParameters)
+{
+    led_anim_request_t current = {0};
+    led_anim_header_t header;
+    FILE *file = NULL;
+    uint32_t decoded = 0; // frames decoded since the start of the file or the last loop
+    size_t previous_slot = 0;
+
+    for (;;)
+    {
+        taskENTER_CRITICAL(&lock);
+        bool changed = request.generation != current.generation;
+        if (changed)
+        {
+            current = request;
+        }
+        bool writable = ring_generation == current.generation && count < RING_FRAMES && !finished;
+        size_t slot = (head + count) % RING_FRAMES;
+        taskEXIT_CRITICAL(&lock);
+
+        if (changed)
+        {
+            if (file != NULL)
+            {
+                fclose(file);
+                file = NULL;
+            }
+            taskENTER_CRITICAL(&lock);
+            decoder_generation = current.generation;
+            taskEXIT_CRITICAL(&lock);
+            decoded = 0;
+            if (current.active)
+            {
+                file = open_animation(&current, &header);
+            }
+            continue;
+        }
+
+        if (file == NULL || !writable)
+        {
+            // Woken by play/stop and by the LED task when it resets or releases a slot
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        if (decoded == header.frame_count)
+        {
+            if (!current.loop)
+            {
+                taskENTER_CRITICAL(&lock);
+                if (ring_generation == current.generation)
+                {
+                    finished = true;
+                }
+                taskEXIT_CRITICAL(&lock);
+                fclose(file);
+                file = NULL;
+                continue;
+            }
+            fseek(file, sizeof(header), SEEK_SET);
+            decoded = 0;
+        }
+
+        int64_t begin = esp_timer_get_time();
+        rgb_t *frame = ring[slot];
+        if (decoded == 0)
+        {
+            memset(frame, 0, sizeof(rgb_t) * header.leds);
+        }
+        else
+        {
+            memcpy(frame, ring[previous_slot], sizeof(rgb_t) * header.leds);
+        }
+        if (!read_frame(file, frame, header.leds))
+        {
+            fclose(file);
+            file = NULL;
+            fail(current.generation, current.file, "corrupt frame");
+            continue;
+        }
+        previous_slot = slot;
+        decoded++;
+        uint32_t elapsed = (uint32_t)(esp_timer_get_time() - begin);
+
+        taskENTER_CRITICAL(&lock);
+        if (ring_generation == current.generation && request.generation == current.generation)
+        {
+            count++;
+        }
+        if (elapsed > stats.decode_max_us)
+        {
+            stats.decode_max_us = elapsed;
+        }
+        taskEXIT_CRITICAL(&lock);
+    }
+}
+
+esp_err_t led_anim_init(void)
+{
+    if (xTaskCreate(led_anim_decoder_task, "led_anim_task", 4096, NULL, tskIDLE_PRIORITY + 1,
+                    &decoder_task_handle) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create animation decoder task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static bool valid_file_name(const char *file)
+{
+    size_t length = strnlen(file, LED_ANIM_NAME_MAX);
+    return length > 0 && length < LED_ANIM_NAME_MAX && strchr(file, '/') == NULL;
+}
+
+static void post_request(const led_anim_request_t *next)
+{
+    taskENTER_CRITICAL(&lock);
+    uint32_t generation = request.generation + 1;
+    request = *next;
+    request.generation = generation;
+    taskEXIT_CRITICAL(&lock);
+
+    if (decoder_task_handle != NULL)
+    {
+        xTaskNotifyGive(decoder_task_handle);
+    }
+    led_strip_wake();
+}
+
+esp_err_t led_anim_play(const char *file, const char *segment, bool loop)
+{
+    if (file == NULL || !valid_file_name(file))
+        return ESP_ERR_INVALID_ARG;
+
+    led_anim_request_t next = {
+        .active = true,
+        .loop = loop,
+        .segment_start = -1,
+    };
+    strncpy(next.file, file, sizeof(next.file) - 1);
+
+    if (segment != NULL)
+    {
+        led_segment_t found;
+        if (!led_segment_find(segment, &found))
+            return ESP_ERR_NOT_FOUND;
+        next.segment_start = found.start;
+        next.segment_leds = found.leds;
+    }
+
+    post_request(&next);
+    return ESP_OK;
+}
+
+void led_anim_stop(void)
+{
+    led_anim_request_t next = {.active = false, .segment_start = -1};
+    post_request(&next);
+}
+
+bool led_anim_release(const char *file, TickType_t timeout)
+{
+    TickType_t begin = xTaskGetTickCount();
+    bool stopped = false;
+    for (;;)
+    {
+        taskENTER_CRITICAL(&lock);
+        bool playing = request.active && strncmp(request.file, file, sizeof(request.file)) == 0;
+        bool behind = decoder_task_handle != NULL && decoder_generation != request.generation;
+        taskEXIT_CRITICAL(&lock);
+
+        if (playing && !stopped)
+        {
+            led_anim_stop();
+            stopped = true;
+            continue;
+        }
+        if (!playing && !behind)
+            return true;
+        if (playing || xTaskGetTickCount() - begin >= timeout)
+            return false;
+        vTaskDelay(1);
+    }
+}
+
+bool led_anim_active(void)
+{
+    taskENTER_CRITICAL(&lock);
+    bool active = request.active;
+    taskEXIT_CRITICAL(&lock);
+    return active;
+}
+
+void led_anim_render(rgb_t *framebuffer, size_t length, rgb_sum_t *sum)
+{
+    int64_t now = esp_timer_get_time();
+    bool notify = false;
+    const rgb_t *frame = NULL;
+    led_anim_playback_t target = {0};
+
+    taskENTER_CRITICAL(&lock);
+    if (ring_generation != request.generation)
+    {
+        // A new file (or none): drop the decoded frames, the decoder refills from slot 0
+        ring_generation = request.generation;
+        head = 0;
+        count = 0;
+        finished = false;
+        started = false;
+        notify = true;
+    }
+
+    if (request.active && count > 0)
+    {
+        if (!started)
+        {
+            started = true;
+            start_us = now;
+            shown = 0;
+            stats.frames++;
+        }
+
+        uint32_t due = (uint32_t)((now - start_us) / playback.frame_us);
+        if (due > shown)
+        {
+            // Slot head stays on the strip until its successor is decoded
+            uint32_t advance = due - shown;
+            if (advance > count - 1)
+            {
+                if (finished && count == 1)
+                {
+                    request.active = false;
+                }
+                else
+                {
+                    stats.underruns++;
+                }
+                advance = (uint32_t)(count - 1);
+            }
+            if (advance > 0)
+            {
+                head = (head + advance) % RING_FRAMES;
+                count -= advance;
+                shown += advance;
+                stats.frames += advance;
+                stats.skipped += advance - 1;
+                notify = true;
+            }
+        }
+
+        if (request.active)
+        {
+            frame = ring[head];
+            target = playback;
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    if (notify && decoder_task_handle != NULL)
+    {
+        xTaskNotifyGive(decoder_task_handle);
+    }
+    if (frame == NULL)
+        return;
+
+    size_t end = (size_t)target.start + target.leds;
+    if (end > length)
+        end = length;
+    for (size_t i = target.start; i < end; i++)
+    {
+        rgb_t pixel = frame[i - target.start];
+        sum->red += (uint32_t)pixel.red - framebuffer[i].red;
+        sum->green += (uint32_t)pixel.green - framebuffer[i].green;
+        sum->blue += (uint32_t)pixel.blue - framebuffer[i].blue;
+        framebuffer[i] = pixel;
+    }
+}
+
+void led_anim_get_stats(led_anim_stats_t *out)
+{
+    taskENTER_CRITICAL(&lock);
+    *out = stats;
+    out->playing = request.active;
+    if (out->playing)
+    {
+        memcpy(out->file, request.file, sizeof(out->file));
+    }
+    taskEXIT_CRITICAL(&lock);
+}
@@ -0,0 +1,107 @@
+#include "led_anim.h"
+
+#include <sdkconfig.h>
+#include <string.h>
+
+_Static_assert(sizeof(led_anim_header_t) == 20, "led_anim_header_t is stored in files");
+_Static_assert(sizeof(rgb_t) == 3, "literal ops are copied as packed RGB triplets");
+
+static inline bool same_color(rgb_t a, rgb_t b)
+{
+    return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
+
+esp_err_t led_anim_header_check(const led_anim_header_t *header)
+{
+    if (memcmp(header->magic, LED_ANIM_MAGIC, sizeof(header->magic)) != 0 || header->version != LED_ANIM_VERSION)
+        return ESP_ERR_INVALID_VERSION;
+    if (header->leds == 0 || header->leds > CONFIG_LED_STRIP_MAX_LEDS || header->frame_rate == 0 ||
+        header->frame_rate > 100)
+        return ESP_ERR_INVALID_SIZE;
+    return ESP_OK;
+}
+
+size_t led_anim_encode_frame(const rgb_t *previous, const rgb_t *frame, size_t leds, uint8_t *out)
+{
+    size_t size = 0;
+    size_t used = 0; // end of the last op that changes pixels, trailing skips are dropped
+    size_t i = 0;
+
+    while (i < leds)
+    {
+        size_t count = 1;
+        if (same_color(frame[i], previous[i]))
+        {
+            while (i + count < leds && count < LED_ANIM_OP_MAX_COUNT && same_color(frame[i + count], previous[i + count]))
+                count++;
+            out[size++] = LED_ANIM_OP_SKIP | (uint8_t)(count - 1);
+            i += count;
+            continue;
+        }
+
+        while (i + count < leds && count < LED_ANIM_OP_MAX_COUNT && same_color(frame[i + count], frame[i]))
+            count++;
+        if (count >= 2)
+        {
+            out[size++] = LED_ANIM_OP_RUN | (uint8_t)(count - 1);
+            out[size++] = frame[i].red;
+            out[size++] = frame[i].green;
+            out[size++] = frame[i].blue;
+            i += count;
+            used = size;
+            continue;
+        }
+
+        // Literal until an unchanged pixel (a skip costs one byte) or a run of two (four bytes instead of six)
+        while (i + count < leds && count < LED_ANIM_OP_MAX_COUNT && !same_color(frame[i + count], previous[i + count]) &&
+               !(i + count + 1 < leds && same_color(frame[i + count], frame[i + count + 1])))
+            count++;
+        out[size++] = LED_ANIM_OP_LITERAL | (uint8_t)(count - 1);
+        memcpy(&out[size], &frame[i], count * sizeof(rgb_t));
+        size += count * sizeof(rgb_t);
+        i += count;
+        used = size;
+    }
+
+    return used;
+}
+
+esp_err_t led_anim_decode_frame(rgb_t *frame, size_t leds, const uint8_t *data, size_t size)
+{
+    size_t i = 0;
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        uint8_t op = data[pos++];
+        size_t count = (size_t)(op & ~LED_ANIM_OP_MASK) + 1;
+        if (i + count > leds)
+            return ESP_ERR_INVALID_SIZE;
+
+        switch (op & LED_ANIM_OP_MASK)
+        {
+        case LED_ANIM_OP_SKIP:
+            break;
+        case LED_ANIM_OP_RUN: {
+            if (pos + 3 > size)
+                return ESP_ERR_INVALID_SIZE;
+            rgb_t color = {.red = data[pos], .green = data[pos + 1], .blue = data[pos + 2]};
+            pos += 3;
+            for (size_t n = 0; n < count; n++)
+                frame[i + n] = color;
+            break;
+        }
+        case LED_ANIM_OP_LITERAL:
+            if (pos + count * sizeof(rgb_t) > size)
+                return ESP_ERR_INVALID_SIZE;
+            memcpy(&frame[i], &data[pos], count * sizeof(rgb_t));
+            pos += count * sizeof(rgb_t);
+            break;
+        default:
+            return ESP_ERR_INVALID_ARG;
+        }
+        i += count;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,275 @@
+#include "led_calibration.h"
+#include "led_segment.h"
+#include "persistence_manager.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <sdkconfig.h>
+#include <string.h>
+
+static const char *TAG = "led_calibration";
+
+#define MAX_LEDS CONFIG_LED_STRIP_MAX_LEDS
+
+_Static_assert(LED_SEGMENT_MAX_LEN < 255, "table entries hold the kernel index + 1 in a byte");
+
+// Calibration of a segment; bound by name so it survives re-ordering of the segment list
+typedef struct
+{
+    char segment[32];
+    led_calibration_config_t config;
+} led_calibration_binding_t;
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; // protects the bindings
+static led_calibration_binding_t bindings[LED_SEGMENT_MAX_LEN];
+static size_t binding_count;
+static volatile bool bindings_dirty = true;
+
+// Owned by the LED task
+static uint8_t table[MAX_LEDS];
+static led_calibration_config_t configs[LED_SEGMENT_MAX_LEN];
+static led_calibration_kernel_t kernels[LED_SEGMENT_MAX_LEN];
+static size_t kernel_count;
+static int16_t fused_scale = -1; // scale the kernels were fused with, -1 after a rebuild
+static uint32_t peak_gain = LED_CALIBRATION_ONE; // largest current gain of the kernels
+
+// Rebuilds the table from the bindings; runs in the LED task
+static void compile_table(void)
+{
+    static led_calibration_binding_t snapshot[LED_SEGMENT_MAX_LEN];
+    static led_segment_list_t list;
+    size_t count;
+
+    taskENTER_CRITICAL(&lock);
+    count = binding_count;
+    memcpy(snapshot, bindings, sizeof(led_calibration_binding_t) * count);
+    bindings_dirty = false;
+    taskEXIT_CRITICAL(&lock);
+    led_segment_get_all(&list);
+
+    memset(table, 0, sizeof(table));
+    kernel_count = 0;
+    peak_gain = LED_CALIBRATION_ONE;
+    for (size_t b = 0; b < count; b++)
+    {
+        for (size_t s = 0; s < list.count; s++)
+        {
+            if (strcmp(list.segments[s].name, snapshot[b].segment) != 0 || list.segments[s].leds == 0)
+                continue;
+
+            configs[kernel_count] = snapshot[b].config;
+            uint32_t gain = led_calibration_current_gain(&configs[kernel_count]);
+            if (gain > peak_gain)
+                peak_gain = gain;
+            kernel_count++;
+            uint32_t end = (uint32_t)list.segments[s].start + list.segments[s].leds;
+            for (uint32_t i = list.segments[s].start; i < end && i < MAX_LEDS; i++)
+            {
+                table[i] = (uint8_t)kernel_count;
+            }
+            break;
+        }
+    }
+    fused_scale = -1;
+
+    ESP_LOGI(TAG, "Compiled calibration table for %u segments", (unsigned)kernel_count);
+}
+
+// --- Public API ---
+
+void led_calibration_identity(led_calibration_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->matrix[0] = config->matrix[4] = config->matrix[8] = LED_CALIBRATION_ONE;
+    config->gain[0] = config->gain[1] = config->gain[2] = 255;
+}
+
+void led_calibration_fuse(const led_calibration_config_t *config, uint8_t scale, led_calibration_kernel_t *kernel)
+{
+    for (int row = 0; row < 3; row++)
+    {
+        int64_t factor = (int64_t)config->gain[row] * scale;
+        for (int col = 0; col < 3; col++)
+        {
+            int64_t value = config->matrix[row * 3 + col] * factor;
+            // Round half away from zero, the coefficients may be negative
+            kernel->k[row * 3 + col] = (int32_t)((value + (value < 0 ? -32512 : 32512)) / 65025);
+        }
+    }
+}
+
+uint32_t led_calibration_current_gain(const led_calibration_config_t *config)
+{
+    // Every output channel draws current, so what an input channel can cost is the sum of its
+    // column; negative coefficients only lower the output for some inputs and are left out
+    uint32_t peak = 0;
+    for (int col = 0; col < 3; col++)
+    {
+        uint32_t gain = 0;
+        for (int row = 0; row < 3; row++)
+        {
+            int32_t coefficient = config->matrix[row * 3 + col];
+            if (coefficient > 0)
+                gain += ((uint32_t)coefficient * config->gain[row] + 254) / 255;
+        }
+        if (gain > peak)
+            peak = gain;
+    }
+    return peak;
+}
+
+uint32_t led_calibration_peak_gain(void)
+{
+    if (bindings_dirty)
+    {
+        compile_table();
+    }
+    return peak_gain;
+}
+
+const uint8_t *led_calibration_prepare(uint8_t scale, const led_calibration_kernel_t **out)
+{
+    if (bindings_dirty)
+    {
+        compile_table();
+    }
+    if (kernel_count == 0)
+        return NULL;
+
+    // Brightness changes at most once per frame, the matrix only with the configuration
+    if (fused_scale != scale)
+    {
+        for (size_t k = 0; k < kernel_count; k++)
+        {
+            led_calibration_fuse(&configs[k], scale, &kernels[k]);
+        }
+        fused_scale = scale;
+    }
+    *out = kernels;
+    return table;
+}
+
+bool led_calibration_get(const char *segment_name, led_calibration_config_t *config)
+{
+    bool found = false;
+    led_calibration_identity(config);
+
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < binding_count; i++)
+    {
+        if (strcmp(bindings[i].segment, segment_name) == 0)
+        {
+            *config = bindings[i].config;
+            found = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    return found;
+}
+
+esp_err_t led_calibration_set(const char *segment_name, const led_calibration_config_t *config)
+{
+    if (!segment_name)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t ret = ESP_OK;
+
+    taskENTER_CRITICAL(&lock);
+    size_t i = 0;
+    while (i < binding_count && strcmp(bindings[i].segment, segment_name) != 0)
+        i++;
+
+    if (config == NULL)
+    {
+        if (i < binding_count)
+        {
+            bindings[i] = bindings[--binding_count];
+        }
+    }
+    else if (i < binding_count || binding_count < LED_SEGMENT_MAX_LEN)
+    {
+        if (i == binding_count)
+        {
+            strncpy(bindings[i].segment, segment_name, sizeof(bindings[i].segment) - 1);
+            bindings[i].segment[sizeof(bindings[i].segment) - 1] = '\0';
+            binding_count++;
+        }
+        bindings[i].config = *config;
+        bindings[i].config.reserved = 0;
+    }
+    else
+    {
+        ret = ESP_ERR_NO_MEM;
+    }
+    bindings_dirty = true;
+    taskEXIT_CRITICAL(&lock);
+
+    return ret;
+}
+
+void led_calibration_segments_changed(void)
+{
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < binding_count;)
+    {
+        if (!led_segment_find(bindings[i].segment, NULL))
+            bindings[i] = bindings[--binding_count];
+        else
+            i++;
+    }
+    bindings_dirty = true;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void led_calibration_load(void)
+{
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") != ESP_OK)
+        return;
+
+    int32_t count = persistence_manager_get_int(&pm, "calib_count", 0);
+    if (count < 0 || count > LED_SEGMENT_MAX_LEN)
+        count = 0;
+
+    static led_calibration_binding_t loaded[LED_SEGMENT_MAX_LEN];
+    if (count > 0 &&
+        !persistence_manager_get_blob(&pm, "calibs", loaded, sizeof(led_calibration_binding_t) * count, NULL))
+        count = 0;
+    persistence_manager_deinit(&pm);
+
+    taskENTER_CRITICAL(&lock);
+    binding_count = 0;
+    for (int32_t i = 0; i < count; i++)
+    {
+        loaded[i].segment[sizeof(loaded[i].segment) - 1] = '\0';
+        bindings[binding_count++] = loaded[i];
+    }
+    bindings_dirty = true;
+    taskEXIT_CRITICAL(&lock);
+
+    ESP_LOGI(TAG, "Loaded %u calibrated segments", (unsigned)binding_count);
+}
+
+void led_calibration_save(void)
+{
+    static led_calibration_binding_t copy[LED_SEGMENT_MAX_LEN];
+    size_t count;
+
+    taskENTER_CRITICAL(&lock);
+    count = binding_count;
+    memcpy(copy, bindings, sizeof(led_calibration_binding_t) * count);
+    taskEXIT_CRITICAL(&lock);
+
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") == ESP_OK)
+    {
+        if (count > 0)
+            persistence_manager_set_blob(&pm, "calibs", copy, sizeof(led_calibration_binding_t) * count);
+        else
+            persistence_manager_remove_key(&pm, "calibs");
+        persistence_manager_set_int(&pm, "calib_count", (int32_t)count);
+        persistence_manager_deinit(&pm);
+    }
+}
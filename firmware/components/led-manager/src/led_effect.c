@@ -0,0 +1,526 @@
+#include "led_effect.h"
+#include "led_segment.h"
+#include "persistence_manager.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+
+static const char *TAG = "led_effect";
+
+// Pixel distance between two lights of a chase effect
+#define CHASE_SPACING 4
+
+// Effect attached to a segment; bound by name so it survives re-ordering of the segment list
+typedef struct
+{
+    char segment[32];
+    led_effect_config_t config;
+} led_effect_binding_t;
+
+// Per segment runtime state, advanced once per frame
+typedef struct
+{
+    uint32_t rng;
+    uint16_t phase;
+    uint16_t timer;
+    uint8_t level;
+    uint8_t target;
+    rgb_t tint;
+} led_effect_state_t;
+
+// Resolved effect, only touched by the LED task
+typedef struct
+{
+    uint16_t start;
+    uint16_t leds;
+    led_effect_config_t config;
+    led_effect_state_t state;
+    rgb_sum_t added; // light added to the segment in the last frame
+} led_effect_slot_t;
+
+static const char *const effect_names[LED_EFFECT_COUNT] = {
+    [LED_EFFECT_NONE] = "none",   [LED_EFFECT_LANTERN] = "lantern", [LED_EFFECT_WELDING] = "welding",
+    [LED_EFFECT_FIRE] = "fire",   [LED_EFFECT_CHASE] = "chase",     [LED_EFFECT_TV] = "tv",
+};
+
+// --- Module variables ---
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; // protects bindings and stats
+static led_effect_binding_t bindings[LED_SEGMENT_MAX_LEN];
+static size_t binding_count;
+static volatile bool bindings_dirty = true;
+static volatile bool any_active;
+
+static led_effect_slot_t slots[LED_SEGMENT_MAX_LEN];
+static size_t slot_count;
+static led_effect_stats_t stats;
+
+// --- Helpers ---
+
+static inline uint32_t next_random(led_effect_state_t *state)
+{
+    // xorshift32
+    uint32_t x = state->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state->rng = x;
+    return x;
+}
+
+static inline uint8_t hash8(uint32_t a, uint32_t b)
+{
+    uint32_t h = a * 0x9E3779B1u ^ b * 0x85EBCA77u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return (uint8_t)(h >> 24);
+}
+
+static inline uint8_t add_sat8(uint8_t a, uint8_t b)
+{
+    uint16_t sum = (uint16_t)a + b;
+    return sum > 255 ? 255 : (uint8_t)sum;
+}
+
+// Effects are light sources, so they are added on top of the base color. The light that actually
+// made it past saturation is summed per segment, so the frame's channel sums stay O(segments).
+static inline void add_light(led_effect_slot_t *slot, rgb_t *pixel, rgb_t color, uint8_t level)
+{
+    rgb_t before = *pixel;
+    pixel->red = add_sat8(pixel->red, (uint8_t)color_div255((uint32_t)color.red * level));
+    pixel->green = add_sat8(pixel->green, (uint8_t)color_div255((uint32_t)color.green * level));
+    pixel->blue = add_sat8(pixel->blue, (uint8_t)color_div255((uint32_t)color.blue * level));
+    slot->added.red += pixel->red - before.red;
+    slot->added.green += pixel->green - before.green;
+    slot->added.blue += pixel->blue - before.blue;
+}
+
+// 1 (fast) .. 16 (slow) frames between two effect steps
+static inline uint16_t frames_per_step(uint8_t speed)
+{
+    return 1 + ((255 - speed) >> 4);
+}
+
+static inline uint8_t with_intensity(const led_effect_slot_t *slot, uint8_t level)
+{
+    return (uint8_t)color_div255((uint32_t)level * slot->config.intensity);
+}
+
+// Must be called with the lock held
+static void update_any_active(void)
+{
+    bool active = false;
+    for (size_t i = 0; i < binding_count && !active; i++)
+    {
+        active = bindings[i].config.type != LED_EFFECT_NONE && led_segment_find(bindings[i].segment, NULL);
+    }
+    any_active = active;
+    bindings_dirty = true;
+}
+
+// --- Effects ---
+
+static void render_lantern(led_effect_slot_t *slot, rgb_t *pixels)
+{
+    led_effect_state_t *state = &slot->state;
+
+    if (state->timer == 0)
+    {
+        uint32_t r = next_random(state);
+        // Mostly calm flame with an occasional dip as if hit by a draught
+        state->target = ((r & 0x1F) == 0) ? 70 : 170 + ((r >> 8) % 86);
+        state->timer = frames_per_step(slot->config.speed);
+    }
+    else
+    {
+        state->timer--;
+    }
+
+    int16_t diff = (int16_t)state->target - state->level;
+    state->level = (uint8_t)(state->level + diff / 4 + (diff > 0) - (diff < 0));
+
+    uint8_t level = with_intensity(slot, state->level);
+    for (uint16_t i = 0; i < slot->leds; i++)
+    {
+        add_light(slot, &pixels[i], slot->config.color, level);
+    }
+}
+
+static void render_welding(led_effect_slot_t *slot, rgb_t *pixels)
+{
+    led_effect_state_t *state = &slot->state;
+    uint32_t r = next_random(state);
+
+    if (state->timer == 0)
+    {
+        // phase 1 = welding burst, phase 0 = pause between two seams
+        state->phase = !state->phase;
+        uint16_t step = frames_per_step(slot->config.speed);
+        state->timer = state->phase ? (uint16_t)(15 + (r % 60)) : (uint16_t)(step * (10 + ((r >> 8) % 40)));
+    }
+    state->timer--;
+
+    if (!state->phase)
+        return;
+
+    // Arc light: mostly bright, randomly collapsing for a frame
+    state->level = (r & 0x300) ? 255 - ((r >> 16) & 0x3F) : (r >> 24) & 0x3F;
+
+    uint8_t level = with_intensity(slot, state->level);
+    for (uint16_t i = 0; i < slot->leds; i++)
+    {
+        add_light(slot, &pixels[i], slot->config.color, level);
+    }
+}
+
+static void render_fire(led_effect_slot_t *slot, rgb_t *pixels)
+{
+    led_effect_state_t *state = &slot->state;
+
+    // Value noise over time: each pixel blends between two hashed heat keys
+    state->phase += 1 + (slot->config.speed >> 3);
+    uint32_t key = state->phase >> 6;
+    uint32_t frac = (state->phase & 0x3F) << 2;
+
+    for (uint16_t i = 0; i < slot->leds; i++)
+    {
+        int32_t a = hash8(i, key);
+        int32_t b = hash8(i, key + 1);
+        uint8_t heat = (uint8_t)(a + (((b - a) * (int32_t)frac) >> 8));
+        // Keep embers glowing, never fully dark
+        heat = 80 + (uint8_t)color_div255((uint32_t)heat * 175);
+
+        // Green and blue fall off faster than red, so dim embers turn red
+        rgb_t ember = color_scale(slot->config.color, heat);
+        ember.green = (uint8_t)color_div255((uint32_t)ember.green * heat);
+        ember.blue = (uint8_t)color_div255((uint32_t)ember.blue * color_div255((uint32_t)heat * heat));
+
+        add_light(slot, &pixels[i], ember, slot->config.intensity);
+    }
+}
+
+static void render_chase(led_effect_slot_t *slot, rgb_t *pixels)
+{
+    led_effect_state_t *state = &slot->state;
+
+    if (state->timer == 0)
+    {
+        state->phase = (uint16_t)((state->phase + 1) % CHASE_SPACING);
+        state->timer = frames_per_step(slot->config.speed);
+    }
+    else
+    {
+        state->timer--;
+    }
+
+    uint8_t head = with_intensity(slot, 255);
+    uint8_t tail = with_intensity(slot, 48);
+    for (uint16_t i = state->phase; i < slot->leds; i += CHASE_SPACING)
+    {
+        add_light(slot, &pixels[i], slot->config.color, head);
+        if (i > 0)
+            add_light(slot, &pixels[i - 1], slot->config.color, tail);
+    }
+}
+
+static void render_tv(led_effect_slot_t *slot, rgb_t *pixels)
+{
+    led_effect_state_t *state = &slot->state;
+    uint32_t r = next_random(state);
+
+    if (state->timer == 0)
+    {
+        // Scene cut: new dominant color, TV light tends to be bluish
+        state->tint.red = 60 + (r & 0x7F);
+        state->tint.green = 60 + ((r >> 7) & 0x7F);
+        state->tint.blue = 120 + ((r >> 14) % 136);
+        state->target = 110 + ((r >> 22) & 0x7F);
+        state->timer = frames_per_step(slot->config.speed) * (2 + ((r >> 3) & 0x0F));
+    }
+    else
+    {
+        state->timer--;
+    }
+
+    // Small brightness jitter around the scene brightness
+    int16_t level = (int16_t)state->target + (int16_t)((r >> 24) & 0x1F) - 16;
+    state->level = level < 0 ? 0 : (level > 255 ? 255 : (uint8_t)level);
+
+    rgb_t tint = {
+        .red = (uint8_t)color_div255((uint32_t)state->tint.red * slot->config.color.red),
+        .green = (uint8_t)color_div255((uint32_t)state->tint.green * slot->config.color.green),
+        .blue = (uint8_t)color_div255((uint32_t)state->tint.blue * slot->config.color.blue),
+    };
+    uint8_t out = with_intensity(slot, state->level);
+    for (uint16_t i = 0; i < slot->leds; i++)
+    {
+        add_light(slot, &pixels[i], tint, out);
+    }
+}
+
+// Rebuilds the slot list from the bindings; runs in the LED task
+static void resolve_slots(void)
+{
+    static led_effect_binding_t snapshot[LED_SEGMENT_MAX_LEN];
+    static led_segment_list_t list;
+    size_t count;
+
+    taskENTER_CRITICAL(&lock);
+    count = binding_count;
+    memcpy(snapshot, bindings, sizeof(led_effect_binding_t) * count);
+    bindings_dirty = false;
+    taskEXIT_CRITICAL(&lock);
+    led_segment_get_all(&list);
+
+    slot_count = 0;
+    for (size_t b = 0; b < count; b++)
+    {
+        if (snapshot[b].config.type == LED_EFFECT_NONE)
+            continue;
+
+        for (size_t s = 0; s < list.count; s++)
+        {
+            if (strcmp(list.segments[s].name, snapshot[b].segment) != 0 || list.segments[s].leds == 0)
+                continue;
+
+            led_effect_slot_t *slot = &slots[slot_count++];
+            memset(slot, 0, sizeof(*slot));
+            slot->start = list.segments[s].start;
+            slot->leds = list.segments[s].leds;
+            slot->config = snapshot[b].config;
+            slot->state.rng = 0x6D2B79F5u ^ ((uint32_t)s * 0x9E3779B1u) ^ (uint32_t)esp_timer_get_time();
+            if (slot->state.rng == 0)
+                slot->state.rng = 1;
+            break;
+        }
+    }
+}
+
+// --- Public API ---
+
+void led_effect_render(rgb_t *framebuffer, size_t length, rgb_sum_t *sum)
+{
+    int64_t begin = esp_timer_get_time();
+
+    if (bindings_dirty)
+    {
+        resolve_slots();
+    }
+
+    uint16_t active_pixels = 0;
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        led_effect_slot_t *slot = &slots[i];
+        if (slot->start >= length)
+            continue;
+
+        // Clip to the framebuffer so a bad segment configuration cannot overrun it
+        led_effect_slot_t clipped = *slot;
+        if (clipped.start + clipped.leds > length)
+            clipped.leds = (uint16_t)(length - clipped.start);
+        clipped.added = (rgb_sum_t){0};
+        rgb_t *pixels = &framebuffer[slot->start];
+
+        switch (slot->config.type)
+        {
+        case LED_EFFECT_LANTERN:
+            render_lantern(&clipped, pixels);
+            break;
+        case LED_EFFECT_WELDING:
+            render_welding(&clipped, pixels);
+            break;
+        case LED_EFFECT_FIRE:
+            render_fire(&clipped, pixels);
+            break;
+        case LED_EFFECT_CHASE:
+            render_chase(&clipped, pixels);
+            break;
+        case LED_EFFECT_TV:
+            render_tv(&clipped, pixels);
+            break;
+        default:
+            break;
+        }
+
+        slot->state = clipped.state;
+        slot->added = clipped.added;
+        sum->red += clipped.added.red;
+        sum->green += clipped.added.green;
+        sum->blue += clipped.added.blue;
+        active_pixels += clipped.leds;
+    }
+
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - begin);
+
+    taskENTER_CRITICAL(&lock);
+    stats.frames++;
+    stats.last_us = elapsed;
+    // Exponential moving average over ~16 frames
+    stats.avg_us = stats.frames == 1 ? elapsed : stats.avg_us - stats.avg_us / 16 + elapsed / 16;
+    if (elapsed > stats.max_us)
+        stats.max_us = elapsed;
+    stats.active_segments = (uint16_t)slot_count;
+    stats.active_pixels = active_pixels;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void led_effect_get_stats(led_effect_stats_t *out)
+{
+    taskENTER_CRITICAL(&lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&lock);
+}
+
+bool led_effect_any_active(void)
+{
+    return any_active;
+}
+
+bool led_effect_get(const char *segment_name, led_effect_config_t *config)
+{
+    bool found = false;
+    memset(config, 0, sizeof(*config));
+
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < binding_count; i++)
+    {
+        if (strcmp(bindings[i].segment, segment_name) == 0)
+        {
+            *config = bindings[i].config;
+            found = config->type != LED_EFFECT_NONE;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    return found;
+}
+
+esp_err_t led_effect_set(const char *segment_name, const led_effect_config_t *config)
+{
+    if (!segment_name || !config || config->type >= LED_EFFECT_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t ret = ESP_OK;
+
+    taskENTER_CRITICAL(&lock);
+    size_t i = 0;
+    while (i < binding_count && strcmp(bindings[i].segment, segment_name) != 0)
+        i++;
+
+    if (config->type == LED_EFFECT_NONE)
+    {
+        if (i < binding_count)
+        {
+            bindings[i] = bindings[--binding_count];
+        }
+    }
+    else if (i < binding_count || binding_count < LED_SEGMENT_MAX_LEN)
+    {
+        if (i == binding_count)
+        {
+            strncpy(bindings[i].segment, segment_name, sizeof(bindings[i].segment) - 1);
+            bindings[i].segment[sizeof(bindings[i].segment) - 1] = '\0';
+            binding_count++;
+        }
+        bindings[i].config = *config;
+    }
+    else
+    {
+        ret = ESP_ERR_NO_MEM;
+    }
+    update_any_active();
+    taskEXIT_CRITICAL(&lock);
+
+    return ret;
+}
+
+void led_effect_segments_changed(void)
+{
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < binding_count;)
+    {
+        if (!led_segment_find(bindings[i].segment, NULL))
+            bindings[i] = bindings[--binding_count];
+        else
+            i++;
+    }
+    update_any_active();
+    taskEXIT_CRITICAL(&lock);
+}
+
+void led_effect_load(void)
+{
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") != ESP_OK)
+        return;
+
+    int32_t count = persistence_manager_get_int(&pm, "effect_count", 0);
+    if (count < 0 || count > LED_SEGMENT_MAX_LEN)
+        count = 0;
+
+    taskENTER_CRITICAL(&lock);
+    binding_count = 0;
+    taskEXIT_CRITICAL(&lock);
+
+    static led_effect_binding_t loaded[LED_SEGMENT_MAX_LEN];
+    if (count > 0 && persistence_manager_get_blob(&pm, "effects", loaded, sizeof(led_effect_binding_t) * count, NULL))
+    {
+        taskENTER_CRITICAL(&lock);
+        for (int32_t i = 0; i < count; i++)
+        {
+            if (loaded[i].config.type < LED_EFFECT_COUNT)
+            {
+                loaded[i].segment[sizeof(loaded[i].segment) - 1] = '\0';
+                bindings[binding_count++] = loaded[i];
+            }
+        }
+        taskEXIT_CRITICAL(&lock);
+    }
+    persistence_manager_deinit(&pm);
+
+    taskENTER_CRITICAL(&lock);
+    update_any_active();
+    taskEXIT_CRITICAL(&lock);
+
+    ESP_LOGI(TAG, "Loaded %u effect bindings", (unsigned)binding_count);
+}
+
+void led_effect_save(void)
+{
+    static led_effect_binding_t copy[LED_SEGMENT_MAX_LEN];
+    size_t count;
+
+    taskENTER_CRITICAL(&lock);
+    count = binding_count;
+    memcpy(copy, bindings, sizeof(led_effect_binding_t) * count);
+    taskEXIT_CRITICAL(&lock);
+
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") == ESP_OK)
+    {
+        if (count > 0)
+            persistence_manager_set_blob(&pm, "effects", copy, sizeof(led_effect_binding_t) * count);
+        else
+            persistence_manager_remove_key(&pm, "effects");
+        persistence_manager_set_int(&pm, "effect_count", (int32_t)count);
+        persistence_manager_deinit(&pm);
+    }
+}
+
+const char *led_effect_type_to_string(led_effect_type_t type)
+{
+    return type < LED_EFFECT_COUNT ? effect_names[type] : "none";
+}
+
+led_effect_type_t led_effect_type_from_string(const char *name)
+{
+    for (int i = 0; name && i < LED_EFFECT_COUNT; i++)
+    {
+        if (strcmp(effect_names[i], name) == 0)
+            return (led_effect_type_t)i;
+    }
+    return LED_EFFECT_COUNT;
+}
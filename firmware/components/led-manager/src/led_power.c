@@ -0,0 +1,64 @@
+#include "led_power.h"
+
+#include <freertos/FreeRTOS.h>
+#include <sdkconfig.h>
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; // protects stats
+static led_power_stats_t stats = {.budget_ma = CONFIG_LED_POWER_BUDGET_MA, .scale = 255};
+
+// Owned by the LED task
+static uint8_t scale = 255;
+static uint8_t target = 255;
+
+static uint32_t channel_ma(const rgb_sum_t *sum)
+{
+    // The sums may include the gain of the calibration (up to 24x), so the product needs 64 bits
+    return (uint32_t)(((uint64_t)sum->red + sum->green + sum->blue) * CONFIG_LED_POWER_CHANNEL_MA / 255);
+}
+
+uint8_t led_power_update(const rgb_sum_t *sum, size_t pixels)
+{
+    uint32_t idle_ma = (uint32_t)pixels * CONFIG_LED_POWER_IDLE_UA / 1000;
+    uint32_t estimate_ma = channel_ma(sum);
+
+    target = 255;
+    if (CONFIG_LED_POWER_BUDGET_MA > 0 && estimate_ma > 0 && estimate_ma + idle_ma > CONFIG_LED_POWER_BUDGET_MA)
+    {
+        // Only the channel current scales with the brightness, the idle draw of the drivers stays
+        uint32_t available = CONFIG_LED_POWER_BUDGET_MA > idle_ma ? CONFIG_LED_POWER_BUDGET_MA - idle_ma : 0;
+        target = (uint8_t)(available * 255 / estimate_ma);
+    }
+
+    if (scale > target)
+    {
+        // Fast attack: halve the distance each frame, so an overload lasts only a few frames
+        scale = target + (scale - target) / 2;
+    }
+    else if (scale < target)
+    {
+        // Slow release (about 5 s from 0 to full at 50 Hz) so the brightness does not pump
+        scale++;
+    }
+
+    taskENTER_CRITICAL(&lock);
+    stats.estimate_ma = estimate_ma + idle_ma;
+    stats.output_ma = (uint32_t)((uint64_t)estimate_ma * scale / 255) + idle_ma;
+    stats.scale = scale;
+    if (scale < 255)
+        stats.limited_frames++;
+    taskEXIT_CRITICAL(&lock);
+
+    return scale;
+}
+
+bool led_power_settling(void)
+{
+    return scale != target;
+}
+
+void led_power_get_stats(led_power_stats_t *out)
+{
+    taskENTER_CRITICAL(&lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&lock);
+}
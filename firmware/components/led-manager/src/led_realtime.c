@@ -0,0 +1,496 @@
+#include "led_realtime.h"
+#include "led_segment.h"
+#include "led_strip_ws2812.h"
+
+#include <arpa/inet.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <sdkconfig.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static const char *TAG = "led_realtime";
+
+#define FRAME_BYTES (CONFIG_LED_STRIP_MAX_LEDS * sizeof(rgb_t))
+#define E131_UNIVERSES                                                                                     \
+    ((CONFIG_LED_STRIP_MAX_LEDS + LED_REALTIME_E131_PIXELS_PER_UNIVERSE - 1) / LED_REALTIME_E131_PIXELS_PER_UNIVERSE)
+#define TIMEOUT_US ((int64_t)CONFIG_LED_REALTIME_TIMEOUT_MS * 1000)
+
+_Static_assert(E131_UNIVERSES <= 32, "universes with a sequence number are tracked in a 32 bit mask");
+
+static const uint8_t e131_acn_id[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+
+// Triple buffer: the receiver fills frames[writing], the LED task shows frames[showing], a completed
+// frame waits in frames[ready]. The indices are swapped under the lock, the pixels are only touched
+// by the owner of the index.
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static rgb_t frames[3][CONFIG_LED_STRIP_MAX_LEDS];
+static uint8_t writing = 0;
+static uint8_t ready = 1;
+static uint8_t showing = 2;
+static bool ready_fresh;
+static int64_t ready_first_us; // arrival of the first packet of frames[ready]
+static int64_t last_frame_us;
+static bool receiving; // a frame arrived since the last timeout or stream termination
+static led_realtime_stats_t stats;
+
+// Owned by the receiver
+static bool frame_started;
+static int64_t frame_first_us; // arrival of the first packet of frames[writing]
+static uint8_t ddp_sequence;
+static uint8_t e131_sequence[E131_UNIVERSES];
+static uint32_t e131_seen;     // universes with a valid sequence number
+static int16_t e131_highest = -1; // highest universe in frames[writing], -1 = none
+static bool e131_last_known;
+static uint8_t e131_last; // highest universe of the stream, its packet completes a frame
+static int64_t e131_packet_us; // arrival of the last E1.31 packet
+static int64_t fps_window_us;
+static uint16_t fps_frames;
+
+// Owned by the LED task
+static bool was_active;
+
+static inline uint16_t be16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void publish(int64_t now)
+{
+    taskENTER_CRITICAL(&lock);
+    uint8_t completed = writing;
+    writing = ready;
+    ready = completed;
+    if (ready_fresh)
+    {
+        stats.superseded_frames++;
+    }
+    ready_fresh = true;
+    ready_first_us = frame_first_us;
+    last_frame_us = now;
+    receiving = true;
+    stats.frames++;
+    taskEXIT_CRITICAL(&lock);
+
+    frame_started = false;
+    e131_highest = -1;
+
+    fps_frames++;
+    if (now - fps_window_us >= 1000000)
+    {
+        taskENTER_CRITICAL(&lock);
+        stats.fps = fps_frames;
+        taskEXIT_CRITICAL(&lock);
+        fps_frames = 0;
+        fps_window_us = now;
+    }
+
+    led_strip_wake();
+}
+
+// Forgets the E1.31 stream after a termination or a timeout. The next sender has its own sequence
+// numbers and may cover fewer universes, the partial frame of the old one is dropped.
+static void e131_reset(void)
+{
+    e131_seen = 0;
+    e131_highest = -1;
+    e131_last_known = false;
+    e131_last = 0;
+    frame_started = false;
+}
+
+// Starts filling frames[writing] with the first packet of a frame. The buffer last held the frame
+// before the previous one, so it is cleared: pixels the sender does not reach stay dark.
+static void start_frame(int64_t now)
+{
+    if (frame_started)
+        return;
+    frame_started = true;
+    frame_first_us = now;
+    memset(frames[writing], 0, FRAME_BYTES);
+}
+
+// Bytes of a frame on the configured strip (up to the end of the last segment), the whole buffer
+// without segments
+static size_t strip_bytes(void)
+{
+    size_t leds = led_segment_strip_length();
+    if (leds == 0 || leds > CONFIG_LED_STRIP_MAX_LEDS)
+        leds = CONFIG_LED_STRIP_MAX_LEDS;
+    return leds * sizeof(rgb_t);
+}
+
+// Drops the pending datagram
+static void discard(int socket)
+{
+    uint8_t byte;
+    recv(socket, &byte, sizeof(byte), MSG_DONTWAIT);
+}
+
+static esp_err_t reject(int socket, bool count)
+{
+    discard(socket);
+    if (count)
+    {
+        taskENTER_CRITICAL(&lock);
+        stats.invalid_packets++;
+        taskEXIT_CRITICAL(&lock);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+// Receives the datagram with the header into header and the data straight into the current frame
+static ssize_t receive_into_frame(int socket, uint8_t *header, size_t header_len, size_t offset, size_t len)
+{
+    struct iovec iov[2] = {
+        {.iov_base = header, .iov_len = header_len},
+        {.iov_base = (uint8_t *)frames[writing] + offset, .iov_len = len},
+    };
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = len > 0 ? 2 : 1,
+    };
+    return recvmsg(socket, &msg, MSG_DONTWAIT);
+}
+
+static uint32_t count_lost(uint8_t expected, uint8_t received, uint8_t modulo)
+{
+    return (uint32_t)((received + modulo - expected) % modulo);
+}
+
+static esp_err_t receive_ddp(int socket, uint8_t *header, ssize_t peeked, int64_t now)
+{
+    uint8_t flags = header[0];
+    if (peeked < LED_REALTIME_DDP_HEADER_LEN || (flags & LED_REALTIME_DDP_VERSION_MASK) != LED_REALTIME_DDP_VERSION_1)
+        return reject(socket, true);
+    // Queries, replies and config/storage packets of other DDP devices are not for the display
+    if ((flags & (LED_REALTIME_DDP_FLAG_QUERY | LED_REALTIME_DDP_FLAG_REPLY | LED_REALTIME_DDP_FLAG_STORAGE)) ||
+        header[3] != LED_REALTIME_DDP_ID_DISPLAY)
+        return reject(socket, false);
+    // 0 = undefined (RGB by convention), 1 = RGB as sent by older WLED versions
+    if (header[2] != 0 && header[2] != 1 && header[2] != LED_REALTIME_DDP_TYPE_RGB8)
+        return reject(socket, true);
+
+    size_t header_len = LED_REALTIME_DDP_HEADER_LEN;
+    if (flags & LED_REALTIME_DDP_FLAG_TIMECODE)
+    {
+        header_len += LED_REALTIME_DDP_TIMECODE_LEN;
+        if (peeked < (ssize_t)header_len)
+            return reject(socket, true);
+    }
+
+    // Data beyond the configured strip is dropped
+    uint32_t offset = be32(&header[4]);
+    size_t len = be16(&header[8]);
+    size_t frame_bytes = strip_bytes();
+    if (offset >= frame_bytes)
+        len = 0;
+    else if (offset + len > frame_bytes)
+        len = frame_bytes - offset;
+
+    start_frame(now);
+    if (receive_into_frame(socket, header, header_len, offset, len) < (ssize_t)header_len)
+        return ESP_ERR_INVALID_ARG;
+
+    // Sequence numbers run 1..15, 0 means the sender does not use them
+    uint8_t sequence = header[1] & 0x0F;
+    uint32_t lost = 0;
+    if (sequence != 0 && ddp_sequence != 0)
+        lost = count_lost(ddp_sequence % 15 + 1, sequence, 15);
+    ddp_sequence = sequence;
+
+    taskENTER_CRITICAL(&lock);
+    stats.packets++;
+    stats.lost_packets += lost;
+    taskEXIT_CRITICAL(&lock);
+
+    // The push flag marks the last packet of a frame, senders without it fill the strip to the end
+    if ((flags & LED_REALTIME_DDP_FLAG_PUSH) || (offset < frame_bytes && offset + len >= frame_bytes))
+        publish(now);
+    return ESP_OK;
+}
+
+static esp_err_t receive_e131(int socket, uint8_t *header, ssize_t peeked, int64_t now)
+{
+    if (peeked < LED_REALTIME_E131_HEADER_LEN || memcmp(&header[4], e131_acn_id, sizeof(e131_acn_id)) != 0 ||
+        be32(&header[18]) != 0x00000004 || be32(&header[40]) != 0x00000002 || header[117] != 0x02)
+        return reject(socket, true);
+    // Alternate start codes (e.g. per-slot priorities) and preview data are not shown
+    uint8_t options = header[112];
+    if (header[125] != 0 || (options & LED_REALTIME_E131_OPTION_PREVIEW))
+        return reject(socket, false);
+
+    uint16_t universe = be16(&header[113]);
+    if (universe < CONFIG_LED_REALTIME_E131_UNIVERSE || universe >= CONFIG_LED_REALTIME_E131_UNIVERSE + E131_UNIVERSES)
+        return reject(socket, false);
+    uint8_t index = (uint8_t)(universe - CONFIG_LED_REALTIME_E131_UNIVERSE);
+    uint32_t bit = 1u << index;
+
+    // The LED task fell back after the timeout, the next packet belongs to a new stream
+    if (e131_seen != 0 && now - e131_packet_us >= TIMEOUT_US)
+        e131_reset();
+    e131_packet_us = now;
+
+    if (options & LED_REALTIME_E131_OPTION_TERMINATED)
+    {
+        // The sender stopped, fall back without waiting for the timeout
+        discard(socket);
+        e131_reset();
+        taskENTER_CRITICAL(&lock);
+        receiving = false;
+        taskEXIT_CRITICAL(&lock);
+        led_strip_wake();
+        return ESP_OK;
+    }
+
+    // Per universe sequence; packets up to 20 behind are late duplicates and dropped (E1.31 6.7.2)
+    uint8_t sequence = header[111];
+    uint32_t lost = 0;
+    if (e131_seen & bit)
+    {
+        int8_t diff = (int8_t)(sequence - (uint8_t)(e131_sequence[index] + 1));
+        if (diff < 0 && diff >= -20)
+            return reject(socket, false);
+        lost = diff > 0 ? (uint32_t)diff : 0;
+    }
+    e131_sequence[index] = sequence;
+    e131_seen |= bit;
+
+    // Senders go through the universes in order, a lower one starts the next frame. The first wrap
+    // tells the number of universes of the stream, later ones mean the rest of the frame got lost.
+    if (index <= e131_highest)
+    {
+        if (e131_last_known)
+        {
+            taskENTER_CRITICAL(&lock);
+            stats.incomplete_frames++;
+            taskEXIT_CRITICAL(&lock);
+        }
+        else
+        {
+            e131_last = (uint8_t)e131_highest;
+            e131_last_known = true;
+        }
+        publish(now);
+    }
+
+    size_t offset = (size_t)index * LED_REALTIME_E131_PIXELS_PER_UNIVERSE * sizeof(rgb_t);
+    size_t slots = be16(&header[123]) > 0 ? be16(&header[123]) - 1u : 0; // property count includes the start code
+    size_t len = slots - slots % sizeof(rgb_t);
+    if (len > LED_REALTIME_E131_PIXELS_PER_UNIVERSE * sizeof(rgb_t))
+        len = LED_REALTIME_E131_PIXELS_PER_UNIVERSE * sizeof(rgb_t);
+    if (offset + len > FRAME_BYTES)
+        len = FRAME_BYTES - offset;
+
+    start_frame(now);
+    if (receive_into_frame(socket, header, LED_REALTIME_E131_HEADER_LEN, offset, len) < LED_REALTIME_E131_HEADER_LEN)
+        return ESP_ERR_INVALID_ARG;
+    e131_highest = index;
+    if (e131_last_known && index > e131_last)
+        e131_last = index;
+
+    taskENTER_CRITICAL(&lock);
+    stats.packets++;
+    stats.lost_packets += lost;
+    taskEXIT_CRITICAL(&lock);
+
+    if (e131_last_known && index == e131_last)
+        publish(now);
+    return ESP_OK;
+}
+
+esp_err_t led_realtime_receive(int socket, led_realtime_protocol_t protocol)
+{
+    uint8_t header[LED_REALTIME_E131_HEADER_LEN];
+    size_t peek_len = protocol == LED_REALTIME_DDP ? LED_REALTIME_DDP_HEADER_LEN + LED_REALTIME_DDP_TIMECODE_LEN
+                                                   : LED_REALTIME_E131_HEADER_LEN;
+    ssize_t peeked = recv(socket, header, peek_len, MSG_PEEK | MSG_DONTWAIT);
+    if (peeked < 0)
+        return ESP_ERR_NOT_FOUND;
+
+    int64_t now = esp_timer_get_time();
+    return protocol == LED_REALTIME_DDP ? receive_ddp(socket, header, peeked, now)
+                                        : receive_e131(socket, header, peeked, now);
+}
+
+int led_realtime_open(led_realtime_protocol_t protocol, uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0)
+    {
+        ESP_LOGE(TAG, "Failed to create socket");
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to bind port %u", port);
+        close(sock);
+        return -1;
+    }
+
+    if (protocol == LED_REALTIME_E131)
+    {
+        // sACN multicast group of a universe: 239.255.<high byte>.<low byte>
+        for (uint32_t i = 0; i < E131_UNIVERSES; i++)
+        {
+            uint32_t universe = CONFIG_LED_REALTIME_E131_UNIVERSE + i;
+            struct ip_mreq group = {0};
+            group.imr_multiaddr.s_addr = htonl(0xEFFF0000u | (universe & 0xFFFF));
+            group.imr_interface.s_addr = htonl(INADDR_ANY);
+            if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) != 0)
+            {
+                ESP_LOGW(TAG, "Failed to join multicast group of universe %" PRIu32 ", unicast only", universe);
+                break;
+            }
+        }
+    }
+    return sock;
+}
+
+static void led_realtime_task(void *pvParameters)
+{
+    int sockets[2] = {
+        led_realtime_open(LED_REALTIME_DDP, CONFIG_LED_REALTIME_DDP_PORT),
+        led_realtime_open(LED_REALTIME_E131, LED_REALTIME_E131_PORT),
+    };
+    int max_socket = sockets[0] > sockets[1] ? sockets[0] : sockets[1];
+    if (max_socket < 0)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    for (;;)
+    {
+        fd_set readable;
+        FD_ZERO(&readable);
+        for (int i = 0; i < 2; i++)
+        {
+            if (sockets[i] >= 0)
+                FD_SET(sockets[i], &readable);
+        }
+
+        if (select(max_socket + 1, &readable, NULL, NULL, NULL) < 0)
+        {
+            ESP_LOGW(TAG, "select failed");
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        for (int i = 0; i < 2; i++)
+        {
+            if (sockets[i] >= 0 && FD_ISSET(sockets[i], &readable))
+            {
+                // Drain the socket, a frame spans several datagrams
+                while (led_realtime_receive(sockets[i], i == 0 ? LED_REALTIME_DDP : LED_REALTIME_E131) !=
+                       ESP_ERR_NOT_FOUND)
+                    ;
+            }
+        }
+    }
+}
+
+esp_err_t led_realtime_start(void)
+{
+    if (xTaskCreate(led_realtime_task, "led_realtime", 4096, NULL, tskIDLE_PRIORITY + 2, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create realtime receiver task");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Listening for DDP on %d and E1.31 universes %d..%d", CONFIG_LED_REALTIME_DDP_PORT,
+             CONFIG_LED_REALTIME_E131_UNIVERSE, CONFIG_LED_REALTIME_E131_UNIVERSE + E131_UNIVERSES - 1);
+    return ESP_OK;
+}
+
+bool led_realtime_active(void)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&lock);
+    bool active = receiving && now - last_frame_us < TIMEOUT_US;
+    taskEXIT_CRITICAL(&lock);
+    return active;
+}
+
+bool led_realtime_render(rgb_t *framebuffer, size_t length, rgb_sum_t *sum)
+{
+    int64_t now = esp_timer_get_time();
+    bool fresh;
+    int64_t first_us = 0;
+
+    taskENTER_CRITICAL(&lock);
+    bool active = receiving && now - last_frame_us < TIMEOUT_US;
+    fresh = ready_fresh;
+    if (fresh)
+    {
+        uint8_t next = ready;
+        ready = showing;
+        showing = next;
+        ready_fresh = false;
+        first_us = ready_first_us;
+    }
+    if (was_active && !active)
+    {
+        receiving = false;
+        stats.timeouts++;
+    }
+    const rgb_t *frame = frames[showing];
+    taskEXIT_CRITICAL(&lock);
+
+    was_active = active;
+    if (!active)
+        return false;
+
+    if (length > CONFIG_LED_STRIP_MAX_LEDS)
+        length = CONFIG_LED_STRIP_MAX_LEDS;
+    rgb_sum_t frame_sum = {0};
+    for (size_t i = 0; i < length; i++)
+    {
+        rgb_t pixel = frame[i];
+        frame_sum.red += pixel.red;
+        frame_sum.green += pixel.green;
+        frame_sum.blue += pixel.blue;
+        framebuffer[i] = pixel;
+    }
+    *sum = frame_sum;
+
+    if (fresh)
+    {
+        uint32_t latency = (uint32_t)(now - first_us);
+        taskENTER_CRITICAL(&lock);
+        stats.latency_avg_us =
+            stats.latency_avg_us == 0 ? latency : stats.latency_avg_us - stats.latency_avg_us / 16 + latency / 16;
+        if (latency > stats.latency_max_us)
+            stats.latency_max_us = latency;
+        taskEXIT_CRITICAL(&lock);
+    }
+    return true;
+}
+
+void led_realtime_get_stats(led_realtime_stats_t *out)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&lock);
+    *out = stats;
+    out->active = receiving && now - last_frame_us < TIMEOUT_US;
+    taskEXIT_CRITICAL(&lock);
+}
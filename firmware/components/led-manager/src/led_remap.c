@@ -0,0 +1,264 @@
+#include "led_remap.h"
+#include "led_segment.h"
+#include "persistence_manager.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <sdkconfig.h>
+#include <string.h>
+
+static const char *TAG = "led_remap";
+
+#define MAX_LEDS CONFIG_LED_STRIP_MAX_LEDS
+
+_Static_assert(CONFIG_LED_STRIP_MAX_LEDS < LED_REMAP_DARK, "pixel indices must not collide with LED_REMAP_DARK");
+
+// Wiring of a segment; bound by name so it survives re-ordering of the segment list
+typedef struct
+{
+    char segment[32];
+    led_remap_config_t config;
+} led_remap_binding_t;
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; // protects the bindings
+static led_remap_binding_t bindings[LED_SEGMENT_MAX_LEN];
+static size_t binding_count;
+static volatile bool bindings_dirty = true;
+
+// Owned by the LED task
+static uint16_t table[MAX_LEDS];
+static bool identity = true;
+
+// Rebuilds the table from the bindings; runs in the LED task
+static void compile_table(void)
+{
+    static led_remap_binding_t snapshot[LED_SEGMENT_MAX_LEN];
+    static led_segment_list_t list;
+    static uint32_t taken[(MAX_LEDS + 31) / 32]; // physical pixels lit by a segment, one bit each
+    size_t count;
+
+    taskENTER_CRITICAL(&lock);
+    count = binding_count;
+    memcpy(snapshot, bindings, sizeof(led_remap_binding_t) * count);
+    bindings_dirty = false;
+    taskEXIT_CRITICAL(&lock);
+    led_segment_get_all(&list);
+
+    const led_segment_t *remapped[LED_SEGMENT_MAX_LEN];
+    const led_remap_config_t *configs[LED_SEGMENT_MAX_LEN];
+    bool is_remapped[LED_SEGMENT_MAX_LEN] = {false};
+    size_t remapped_count = 0;
+    for (size_t b = 0; b < count; b++)
+    {
+        for (size_t s = 0; s < list.count; s++)
+        {
+            if (strcmp(list.segments[s].name, snapshot[b].segment) == 0 && list.segments[s].leds > 0)
+            {
+                remapped[remapped_count] = &list.segments[s];
+                configs[remapped_count] = &snapshot[b].config;
+                remapped_count++;
+                is_remapped[s] = true;
+                break;
+            }
+        }
+    }
+
+    identity = remapped_count == 0;
+    if (identity)
+        return;
+
+    for (uint16_t i = 0; i < MAX_LEDS; i++)
+    {
+        table[i] = i;
+    }
+
+    // Segments without a remap keep their pixels: a run landing on them is a conflict, gaps leave them lit
+    memset(taken, 0, sizeof(taken));
+    for (size_t s = 0; s < list.count; s++)
+    {
+        if (is_remapped[s])
+            continue;
+        uint32_t end = (uint32_t)list.segments[s].start + list.segments[s].leds;
+        for (uint32_t i = list.segments[s].start; i < end && i < MAX_LEDS; i++)
+        {
+            taken[i / 32] |= 1u << (i % 32);
+        }
+    }
+
+    // Free the physical pixels of the logical ranges first, so segments can swap places
+    for (size_t r = 0; r < remapped_count; r++)
+    {
+        uint32_t end = (uint32_t)remapped[r]->start + remapped[r]->leds;
+        for (uint32_t i = remapped[r]->start; i < end && i < MAX_LEDS; i++)
+        {
+            table[i] = LED_REMAP_DARK;
+        }
+    }
+
+    uint32_t conflicts = 0;
+    for (size_t r = 0; r < remapped_count; r++)
+    {
+        const led_segment_t *segment = remapped[r];
+        const led_remap_config_t *config = configs[r];
+        uint32_t stride = 1u + config->skip;
+        uint32_t physical = config->offset;
+        for (uint32_t k = 0; k < segment->leds && physical < MAX_LEDS; k++, physical += stride)
+        {
+            uint32_t logical = (config->flags & LED_REMAP_REVERSE) ? segment->start + segment->leds - 1u - k
+                                                                   : segment->start + k;
+            if (logical >= MAX_LEDS)
+                continue;
+            if (taken[physical / 32] & (1u << (physical % 32)))
+                conflicts++;
+            table[physical] = (uint16_t)logical;
+            taken[physical / 32] |= 1u << (physical % 32);
+
+            // Skipped pixels are switched off unless they belong to another run or segment
+            for (uint32_t gap = physical + 1; gap < physical + stride && gap < MAX_LEDS; gap++)
+            {
+                if (!(taken[gap / 32] & (1u << (gap % 32))))
+                    table[gap] = LED_REMAP_DARK;
+            }
+        }
+    }
+
+    if (conflicts > 0)
+    {
+        ESP_LOGW(TAG, "%u physical pixels are claimed by more than one segment", (unsigned)conflicts);
+    }
+    ESP_LOGI(TAG, "Compiled remap table for %u segments", (unsigned)remapped_count);
+}
+
+// --- Public API ---
+
+const uint16_t *led_remap_table(void)
+{
+    if (bindings_dirty)
+    {
+        compile_table();
+    }
+    return identity ? NULL : table;
+}
+
+bool led_remap_get(const char *segment_name, led_remap_config_t *config)
+{
+    bool found = false;
+    memset(config, 0, sizeof(*config));
+
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < binding_count; i++)
+    {
+        if (strcmp(bindings[i].segment, segment_name) == 0)
+        {
+            *config = bindings[i].config;
+            found = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    return found;
+}
+
+esp_err_t led_remap_set(const char *segment_name, const led_remap_config_t *config)
+{
+    if (!segment_name)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t ret = ESP_OK;
+
+    taskENTER_CRITICAL(&lock);
+    size_t i = 0;
+    while (i < binding_count && strcmp(bindings[i].segment, segment_name) != 0)
+        i++;
+
+    if (config == NULL)
+    {
+        if (i < binding_count)
+        {
+            bindings[i] = bindings[--binding_count];
+        }
+    }
+    else if (i < binding_count || binding_count < LED_SEGMENT_MAX_LEN)
+    {
+        if (i == binding_count)
+        {
+            strncpy(bindings[i].segment, segment_name, sizeof(bindings[i].segment) - 1);
+            bindings[i].segment[sizeof(bindings[i].segment) - 1] = '\0';
+            binding_count++;
+        }
+        bindings[i].config = *config;
+    }
+    else
+    {
+        ret = ESP_ERR_NO_MEM;
+    }
+    bindings_dirty = true;
+    taskEXIT_CRITICAL(&lock);
+
+    return ret;
+}
+
+void led_remap_segments_changed(void)
+{
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < binding_count;)
+    {
+        if (!led_segment_find(bindings[i].segment, NULL))
+            bindings[i] = bindings[--binding_count];
+        else
+            i++;
+    }
+    bindings_dirty = true;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void led_remap_load(void)
+{
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") != ESP_OK)
+        return;
+
+    int32_t count = persistence_manager_get_int(&pm, "remap_count", 0);
+    if (count < 0 || count > LED_SEGMENT_MAX_LEN)
+        count = 0;
+
+    static led_remap_binding_t loaded[LED_SEGMENT_MAX_LEN];
+    if (count > 0 && !persistence_manager_get_blob(&pm, "remaps", loaded, sizeof(led_remap_binding_t) * count, NULL))
+        count = 0;
+    persistence_manager_deinit(&pm);
+
+    taskENTER_CRITICAL(&lock);
+    binding_count = 0;
+    for (int32_t i = 0; i < count; i++)
+    {
+        loaded[i].segment[sizeof(loaded[i].segment) - 1] = '\0';
+        bindings[binding_count++] = loaded[i];
+    }
+    bindings_dirty = true;
+    taskEXIT_CRITICAL(&lock);
+
+    ESP_LOGI(TAG, "Loaded %u remapped segments", (unsigned)binding_count);
+}
+
+void led_remap_save(void)
+{
+    static led_remap_binding_t copy[LED_SEGMENT_MAX_LEN];
+    size_t count;
+
+    taskENTER_CRITICAL(&lock);
+    count = binding_count;
+    memcpy(copy, bindings, sizeof(led_remap_binding_t) * count);
+    taskEXIT_CRITICAL(&lock);
+
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") == ESP_OK)
+    {
+        if (count > 0)
+            persistence_manager_set_blob(&pm, "remaps", copy, sizeof(led_remap_binding_t) * count);
+        else
+            persistence_manager_remove_key(&pm, "remaps");
+        persistence_manager_set_int(&pm, "remap_count", (int32_t)count);
+        persistence_manager_deinit(&pm);
+    }
+}
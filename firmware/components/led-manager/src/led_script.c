@@ -0,0 +1,345 @@
+#include "led_script.h"
+#include "led_segment.h"
+#include "persistence_manager.h"
+#include "storage.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <inttypes.h>
+#include <sdkconfig.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "led_script";
+
+#define SCRIPT_SLOTS CONFIG_LED_SCRIPT_MAX
+
+// Script file bound to a segment (stored as blob, keep the layout stable)
+typedef struct
+{
+    char segment[32];
+    char file[LED_SCRIPT_NAME_MAX];
+} led_script_binding_t;
+
+// Resolved script, only touched by the LED task
+typedef struct
+{
+    uint16_t start;
+    uint16_t leds;
+    uint32_t frame;
+    uint32_t rng;
+    led_script_program_t program;
+} led_script_slot_t;
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; // protects bindings, programs and stats
+static led_script_binding_t bindings[SCRIPT_SLOTS];
+static led_script_program_t programs[SCRIPT_SLOTS];
+static size_t binding_count;
+static volatile bool bindings_dirty = true;
+static volatile bool any_active;
+static led_script_stats_t stats;
+
+static led_script_slot_t slots[SCRIPT_SLOTS];
+static size_t slot_count;
+
+// Must be called with the lock held
+static void update_any_active(void)
+{
+    bool active = false;
+    for (size_t i = 0; i < binding_count && !active; i++)
+    {
+        active = led_segment_find(bindings[i].segment, NULL);
+    }
+    any_active = active;
+    bindings_dirty = true;
+}
+
+static esp_err_t compile_file(const char *file, led_script_program_t *program, led_script_error_t *error)
+{
+    memset(error, 0, sizeof(*error));
+    FILE *f = storage_open(file, "r");
+    if (f == NULL)
+    {
+        snprintf(error->message, sizeof(error->message), "not found");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Read one byte more than allowed, so an oversized file is rejected by the compiler
+    char *source = malloc(LED_SCRIPT_SOURCE_MAX + 1);
+    if (source == NULL)
+    {
+        fclose(f);
+        snprintf(error->message, sizeof(error->message), "out of memory");
+        return ESP_ERR_NO_MEM;
+    }
+    size_t length = fread(source, 1, LED_SCRIPT_SOURCE_MAX + 1, f);
+    fclose(f);
+
+    esp_err_t ret = led_script_compile(source, length, program, error);
+    free(source);
+    return ret;
+}
+
+// Rebuilds the slot list from the bindings; runs in the LED task
+static void resolve_slots(void)
+{
+    static led_script_binding_t snapshot[SCRIPT_SLOTS];
+    static led_script_program_t program_snapshot[SCRIPT_SLOTS];
+    static led_segment_list_t list;
+    size_t count;
+
+    // Bindings and programs are copied together, a bind or unbind in between would pair them up wrongly
+    taskENTER_CRITICAL(&lock);
+    count = binding_count;
+    memcpy(snapshot, bindings, sizeof(led_script_binding_t) * count);
+    memcpy(program_snapshot, programs, sizeof(led_script_program_t) * count);
+    bindings_dirty = false;
+    taskEXIT_CRITICAL(&lock);
+    led_segment_get_all(&list);
+
+    slot_count = 0;
+    for (size_t b = 0; b < count; b++)
+    {
+        for (size_t s = 0; s < list.count; s++)
+        {
+            if (strcmp(list.segments[s].name, snapshot[b].segment) != 0 || list.segments[s].leds == 0)
+                continue;
+
+            led_script_slot_t *slot = &slots[slot_count++];
+            slot->start = list.segments[s].start;
+            slot->leds = list.segments[s].leds;
+            slot->frame = 0;
+            slot->rng = 0x6D2B79F5u ^ ((uint32_t)s * 0x9E3779B1u) ^ (uint32_t)esp_timer_get_time();
+            if (slot->rng == 0)
+                slot->rng = 1;
+            slot->program = program_snapshot[b];
+            break;
+        }
+    }
+}
+
+// --- Public API ---
+
+void led_script_render(rgb_t *framebuffer, size_t length, rgb_sum_t *sum)
+{
+    int64_t begin = esp_timer_get_time();
+
+    if (bindings_dirty)
+    {
+        resolve_slots();
+    }
+
+    // Scripts have no loops, so the cost of a segment is known before it runs
+    uint32_t budget = CONFIG_LED_SCRIPT_BUDGET;
+    uint32_t executed = 0;
+    bool cut = false;
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        led_script_slot_t *slot = &slots[i];
+        if (slot->start >= length)
+            continue;
+
+        uint16_t leds = slot->leds;
+        if (slot->start + leds > length)
+            leds = (uint16_t)(length - slot->start);
+
+        rgb_sum_t added = {0};
+        const led_script_program_t *program = &slot->program;
+        uint32_t cost = program->frame_len + (uint32_t)leds * program->pixel_len;
+        uint32_t used = led_script_run(program, &framebuffer[slot->start], leds, slot->frame, budget - executed,
+                                       &slot->rng, &added);
+        cut |= used < cost;
+        executed += used;
+        slot->frame++;
+
+        sum->red += added.red;
+        sum->green += added.green;
+        sum->blue += added.blue;
+    }
+
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - begin);
+
+    taskENTER_CRITICAL(&lock);
+    stats.frames++;
+    stats.instructions = executed;
+    if (cut)
+        stats.budget_frames++;
+    stats.avg_us = stats.frames == 1 ? elapsed : stats.avg_us - stats.avg_us / 16 + elapsed / 16;
+    if (elapsed > stats.max_us)
+        stats.max_us = elapsed;
+    stats.active_segments = (uint16_t)slot_count;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void led_script_get_stats(led_script_stats_t *out)
+{
+    taskENTER_CRITICAL(&lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&lock);
+}
+
+bool led_script_any_active(void)
+{
+    return any_active;
+}
+
+bool led_script_get(const char *segment_name, char *file, size_t size)
+{
+    bool found = false;
+
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < binding_count; i++)
+    {
+        if (strcmp(bindings[i].segment, segment_name) == 0)
+        {
+            strncpy(file, bindings[i].file, size - 1);
+            file[size - 1] = '\0';
+            found = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    return found;
+}
+
+esp_err_t led_script_bind(const char *segment_name, const char *file, led_script_error_t *error)
+{
+    memset(error, 0, sizeof(*error));
+    if (!segment_name || (file != NULL && (file[0] == '\0' || strlen(file) >= LED_SCRIPT_NAME_MAX)))
+    {
+        snprintf(error->message, sizeof(error->message), "invalid file name");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Compiled in the caller's task, the LED task only copies the finished program
+    led_script_program_t program;
+    if (file != NULL)
+    {
+        esp_err_t ret = compile_file(file, &program, error);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGW(TAG, "%s: line %u: %s", file, error->line, error->message);
+            return ret;
+        }
+    }
+
+    esp_err_t ret = ESP_OK;
+
+    taskENTER_CRITICAL(&lock);
+    size_t i = 0;
+    while (i < binding_count && strcmp(bindings[i].segment, segment_name) != 0)
+        i++;
+
+    if (file == NULL)
+    {
+        if (i < binding_count)
+        {
+            binding_count--;
+            bindings[i] = bindings[binding_count];
+            programs[i] = programs[binding_count];
+        }
+    }
+    else if (i < binding_count || binding_count < SCRIPT_SLOTS)
+    {
+        if (i == binding_count)
+        {
+            strncpy(bindings[i].segment, segment_name, sizeof(bindings[i].segment) - 1);
+            bindings[i].segment[sizeof(bindings[i].segment) - 1] = '\0';
+            binding_count++;
+        }
+        strncpy(bindings[i].file, file, sizeof(bindings[i].file) - 1);
+        bindings[i].file[sizeof(bindings[i].file) - 1] = '\0';
+        programs[i] = program;
+    }
+    else
+    {
+        ret = ESP_ERR_NO_MEM;
+    }
+    update_any_active();
+    taskEXIT_CRITICAL(&lock);
+
+    if (ret == ESP_ERR_NO_MEM)
+        snprintf(error->message, sizeof(error->message), "all %d script slots are used", SCRIPT_SLOTS);
+
+    return ret;
+}
+
+void led_script_segments_changed(void)
+{
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < binding_count;)
+    {
+        if (!led_segment_find(bindings[i].segment, NULL))
+        {
+            binding_count--;
+            bindings[i] = bindings[binding_count];
+            programs[i] = programs[binding_count];
+        }
+        else
+        {
+            i++;
+        }
+    }
+    update_any_active();
+    taskEXIT_CRITICAL(&lock);
+}
+
+void led_script_load(void)
+{
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") != ESP_OK)
+        return;
+
+    int32_t count = persistence_manager_get_int(&pm, "script_count", 0);
+    if (count < 0 || count > SCRIPT_SLOTS)
+        count = 0;
+
+    static led_script_binding_t loaded[SCRIPT_SLOTS];
+    if (count > 0 && !persistence_manager_get_blob(&pm, "scripts", loaded, sizeof(led_script_binding_t) * count, NULL))
+        count = 0;
+    persistence_manager_deinit(&pm);
+
+    taskENTER_CRITICAL(&lock);
+    binding_count = 0;
+    update_any_active();
+    taskEXIT_CRITICAL(&lock);
+
+    // The LED task starts before the API server mounts the partition.
+    // A file that no longer compiles drops its binding, the segment falls back to the base color.
+    if (count > 0)
+        initialize_storage();
+    for (int32_t i = 0; i < count; i++)
+    {
+        led_script_error_t error;
+        loaded[i].segment[sizeof(loaded[i].segment) - 1] = '\0';
+        loaded[i].file[sizeof(loaded[i].file) - 1] = '\0';
+        led_script_bind(loaded[i].segment, loaded[i].file, &error);
+    }
+
+    ESP_LOGI(TAG, "Loaded %u script bindings", (unsigned)binding_count);
+}
+
+void led_script_save(void)
+{
+    static led_script_binding_t copy[SCRIPT_SLOTS];
+    size_t count;
+
+    taskENTER_CRITICAL(&lock);
+    count = binding_count;
+    memcpy(copy, bindings, sizeof(led_script_binding_t) * count);
+    taskEXIT_CRITICAL(&lock);
+
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") == ESP_OK)
+    {
+        if (count > 0)
+            persistence_manager_set_blob(&pm, "scripts", copy, sizeof(led_script_binding_t) * count);
+        else
+            persistence_manager_remove_key(&pm, "scripts");
+        persistence_manager_set_int(&pm, "script_count", (int32_t)count);
+        persistence_manager_deinit(&pm);
+    }
+}
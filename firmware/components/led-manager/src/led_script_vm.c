@@ -0,0 +1,779 @@
+#include "led_script.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Static_assert(LED_SCRIPT_REGISTERS <= 32, "constant_mask and the temp allocator use 32 bit masks");
+_Static_assert(LED_SCRIPT_CODE_MAX <= 255, "code lengths are stored as uint8_t");
+
+// --- Instructions ---
+
+#define INSTRUCTION(op, dst, a, b) ((uint32_t)(op) | (uint32_t)(dst) << 8 | (uint32_t)(a) << 16 | (uint32_t)(b) << 24)
+#define OP(word) ((uint8_t)(word))
+#define DST(word) ((uint8_t)((word) >> 8))
+#define SRC_A(word) ((uint8_t)((word) >> 16))
+#define SRC_B(word) ((uint8_t)((word) >> 24))
+
+static const char *const op_names[LED_SCRIPT_OP_COUNT] = {
+    [LED_SCRIPT_OP_MOV] = "mov", [LED_SCRIPT_OP_ADD] = "add",     [LED_SCRIPT_OP_SUB] = "sub",
+    [LED_SCRIPT_OP_MUL] = "mul", [LED_SCRIPT_OP_DIV] = "div",     [LED_SCRIPT_OP_MOD] = "mod",
+    [LED_SCRIPT_OP_NEG] = "neg", [LED_SCRIPT_OP_ABS] = "abs",     [LED_SCRIPT_OP_MIN] = "min",
+    [LED_SCRIPT_OP_MAX] = "max", [LED_SCRIPT_OP_SCALE] = "scale", [LED_SCRIPT_OP_SIN] = "sin",
+    [LED_SCRIPT_OP_TRI] = "tri", [LED_SCRIPT_OP_NOISE] = "noise", [LED_SCRIPT_OP_RAND] = "rand",
+};
+
+static const char *const register_names[LED_SCRIPT_REG_FIRST_FREE] = {"i", "n", "t", "pr", "pg", "pb", "r", "g", "b"};
+
+// Quarter of a sine wave, 127 * sin(k / 64 * pi / 2)
+static const uint8_t sine_quarter[65] = {
+    0,   3,   6,   9,   12,  16,  19,  22,  25,  28,  31,  34,  37,  40,  43,  46,  49,  51,  54,  57,  60,  63,
+    65,  68,  71,  73,  76,  78,  81,  83,  85,  88,  90,  92,  94,  96,  98,  100, 102, 104, 106, 107, 109, 111,
+    112, 113, 115, 116, 117, 118, 120, 121, 122, 122, 123, 124, 125, 125, 126, 126, 126, 127, 127, 127, 127,
+};
+
+static inline int32_t wave_sin(int32_t x)
+{
+    uint8_t phase = (uint8_t)x;
+    uint8_t k = phase & 63;
+    switch (phase >> 6)
+    {
+    case 0:
+        return 128 + sine_quarter[k];
+    case 1:
+        return 128 + sine_quarter[64 - k];
+    case 2:
+        return 128 - sine_quarter[k];
+    default:
+        return 128 - sine_quarter[64 - k];
+    }
+}
+
+static inline int32_t wave_tri(int32_t x)
+{
+    uint8_t phase = (uint8_t)x;
+    return phase < 128 ? phase * 2 : 511 - phase * 2;
+}
+
+static inline int32_t hash8(int32_t a, int32_t b)
+{
+    uint32_t h = (uint32_t)a * 0x9E3779B1u ^ (uint32_t)b * 0x85EBCA77u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return (int32_t)(h >> 24);
+}
+
+// Integer semantics without undefined behavior: arithmetic wraps, division by zero gives 0
+static inline int32_t apply(uint8_t op, int32_t a, int32_t b)
+{
+    switch (op)
+    {
+    case LED_SCRIPT_OP_MOV:
+        return a;
+    case LED_SCRIPT_OP_ADD:
+        return (int32_t)((uint32_t)a + (uint32_t)b);
+    case LED_SCRIPT_OP_SUB:
+        return (int32_t)((uint32_t)a - (uint32_t)b);
+    case LED_SCRIPT_OP_MUL:
+        return (int32_t)((uint32_t)a * (uint32_t)b);
+    case LED_SCRIPT_OP_DIV:
+        return b == 0 || (a == INT32_MIN && b == -1) ? 0 : a / b;
+    case LED_SCRIPT_OP_MOD:
+        return b == 0 || (a == INT32_MIN && b == -1) ? 0 : a % b;
+    case LED_SCRIPT_OP_NEG:
+        return (int32_t)(0u - (uint32_t)a);
+    case LED_SCRIPT_OP_ABS:
+        return a < 0 ? (int32_t)(0u - (uint32_t)a) : a;
+    case LED_SCRIPT_OP_MIN:
+        return a < b ? a : b;
+    case LED_SCRIPT_OP_MAX:
+        return a > b ? a : b;
+    case LED_SCRIPT_OP_SCALE:
+        return (int32_t)((int64_t)a * b / 255);
+    case LED_SCRIPT_OP_SIN:
+        return wave_sin(a);
+    case LED_SCRIPT_OP_TRI:
+        return wave_tri(a);
+    case LED_SCRIPT_OP_NOISE:
+        return hash8(a, b);
+    default:
+        return 0;
+    }
+}
+
+static inline void execute(const uint32_t *code, size_t length, int32_t *regs, uint32_t *rng)
+{
+    for (size_t pc = 0; pc < length; pc++)
+    {
+        uint32_t word = code[pc];
+        uint8_t op = OP(word);
+        if (op == LED_SCRIPT_OP_RAND)
+        {
+            // xorshift32
+            uint32_t x = *rng;
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            *rng = x;
+            regs[DST(word)] = (int32_t)(x >> 24);
+        }
+        else
+        {
+            regs[DST(word)] = apply(op, regs[SRC_A(word)], regs[SRC_B(word)]);
+        }
+    }
+}
+
+static inline uint8_t clamp8(int32_t value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : (uint8_t)value;
+}
+
+static inline uint8_t add_sat8(uint8_t a, uint8_t b)
+{
+    uint16_t sum = (uint16_t)a + b;
+    return sum > 255 ? 255 : (uint8_t)sum;
+}
+
+uint32_t led_script_run(const led_script_program_t *program, rgb_t *pixels, uint16_t leds, uint32_t frame,
+                        uint32_t budget, uint32_t *rng, rgb_sum_t *added)
+{
+    if (budget < program->frame_len)
+        return 0;
+
+    int32_t regs[LED_SCRIPT_REGISTERS];
+    memcpy(regs, program->init, sizeof(regs));
+    regs[LED_SCRIPT_REG_N] = leds;
+    regs[LED_SCRIPT_REG_T] = (int32_t)frame;
+    execute(program->code, program->frame_len, regs, rng);
+
+    const uint32_t *pixel_code = program->code + program->frame_len;
+    uint32_t executed = program->frame_len;
+    uint16_t count = leds;
+    if (program->pixel_len > 0 && (budget - executed) / program->pixel_len < count)
+        count = (uint16_t)((budget - executed) / program->pixel_len);
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        rgb_t before = pixels[i];
+        regs[LED_SCRIPT_REG_I] = i;
+        regs[LED_SCRIPT_REG_PR] = before.red;
+        regs[LED_SCRIPT_REG_PG] = before.green;
+        regs[LED_SCRIPT_REG_PB] = before.blue;
+        execute(pixel_code, program->pixel_len, regs, rng);
+
+        rgb_t after = {
+            .red = add_sat8(before.red, clamp8(regs[LED_SCRIPT_REG_R])),
+            .green = add_sat8(before.green, clamp8(regs[LED_SCRIPT_REG_G])),
+            .blue = add_sat8(before.blue, clamp8(regs[LED_SCRIPT_REG_B])),
+        };
+        pixels[i] = after;
+        added->red += after.red - before.red;
+        added->green += after.green - before.green;
+        added->blue += after.blue - before.blue;
+    }
+    return executed + (uint32_t)count * program->pixel_len;
+}
+
+// --- Compiler ---
+
+typedef enum
+{
+    TOKEN_END,
+    TOKEN_NEWLINE,
+    TOKEN_NUMBER,
+    TOKEN_NAME,
+    TOKEN_CHAR,
+} token_type_t;
+
+// Value of an expression: a folded constant or a register
+typedef struct
+{
+    bool constant;
+    bool varying; // depends on the pixel, computed in the per pixel code
+    bool temp;    // register from the temp pool, the producing instruction can be retargeted
+    int32_t value;
+    uint8_t reg;
+    uint8_t producer; // index of the instruction writing a temp in its code list
+} operand_t;
+
+typedef struct
+{
+    char name[LED_SCRIPT_NAME_MAX];
+    operand_t value;
+} symbol_t;
+
+typedef struct
+{
+    const char *pos;
+    const char *end;
+    uint16_t line;
+
+    token_type_t token;
+    uint16_t token_line;
+    int32_t number;
+    char text[LED_SCRIPT_NAME_MAX];
+
+    symbol_t symbols[LED_SCRIPT_REGISTERS];
+    size_t symbol_count;
+
+    uint8_t next_reg;   // registers below are variables and constants
+    uint32_t temp_mask; // temps are taken from the top
+    uint32_t frame_code[LED_SCRIPT_CODE_MAX];
+    uint32_t pixel_code[LED_SCRIPT_CODE_MAX];
+    uint8_t frame_len;
+    uint8_t pixel_len;
+
+    led_script_program_t *program;
+    led_script_error_t *error;
+    esp_err_t result;
+} compiler_t;
+
+static const struct
+{
+    const char *name;
+    uint8_t op;
+    uint8_t args;
+} functions[] = {
+    {"sin", LED_SCRIPT_OP_SIN, 1},     {"tri", LED_SCRIPT_OP_TRI, 1}, {"abs", LED_SCRIPT_OP_ABS, 1},
+    {"min", LED_SCRIPT_OP_MIN, 2},     {"max", LED_SCRIPT_OP_MAX, 2}, {"scale", LED_SCRIPT_OP_SCALE, 2},
+    {"noise", LED_SCRIPT_OP_NOISE, 2}, {"rand", LED_SCRIPT_OP_RAND, 0},
+};
+
+static bool fail(compiler_t *c, esp_err_t result, const char *message)
+{
+    if (c->result == ESP_OK)
+    {
+        c->result = result;
+        c->error->line = c->token_line;
+        snprintf(c->error->message, sizeof(c->error->message), "%s", message);
+    }
+    return false;
+}
+
+static bool next_token(compiler_t *c)
+{
+    while (c->pos < c->end && (*c->pos == ' ' || *c->pos == '\t' || *c->pos == '\r'))
+        c->pos++;
+    if (c->pos < c->end && *c->pos == '#')
+    {
+        while (c->pos < c->end && *c->pos != '\n')
+            c->pos++;
+    }
+
+    c->token_line = c->line;
+    if (c->pos == c->end)
+    {
+        c->token = TOKEN_END;
+        return true;
+    }
+
+    char ch = *c->pos;
+    if (ch == '\n' || ch == ';')
+    {
+        c->pos++;
+        if (ch == '\n')
+            c->line++;
+        c->token = TOKEN_NEWLINE;
+        return true;
+    }
+
+    if (ch >= '0' && ch <= '9')
+    {
+        int base = 10;
+        if (ch == '0' && c->pos + 1 < c->end && (c->pos[1] == 'x' || c->pos[1] == 'X'))
+        {
+            base = 16;
+            c->pos += 2;
+        }
+        int64_t value = 0;
+        size_t digits = 0;
+        for (; c->pos < c->end; c->pos++, digits++)
+        {
+            char d = *c->pos;
+            int digit = d >= '0' && d <= '9'                ? d - '0'
+                        : base == 16 && d >= 'a' && d <= 'f' ? d - 'a' + 10
+                        : base == 16 && d >= 'A' && d <= 'F' ? d - 'A' + 10
+                                                             : -1;
+            if (digit < 0)
+                break;
+            value = value * base + digit;
+            if (value > INT32_MAX)
+                return fail(c, ESP_ERR_INVALID_ARG, "number too large");
+        }
+        if (digits == 0)
+            return fail(c, ESP_ERR_INVALID_ARG, "invalid number");
+        c->token = TOKEN_NUMBER;
+        c->number = (int32_t)value;
+        return true;
+    }
+
+    if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_')
+    {
+        size_t length = 0;
+        while (c->pos < c->end && ((*c->pos >= 'a' && *c->pos <= 'z') || (*c->pos >= 'A' && *c->pos <= 'Z') ||
+                                   (*c->pos >= '0' && *c->pos <= '9') || *c->pos == '_'))
+        {
+            if (length + 1 >= sizeof(c->text))
+                return fail(c, ESP_ERR_INVALID_ARG, "name too long");
+            c->text[length++] = *c->pos++;
+        }
+        c->text[length] = '\0';
+        c->token = TOKEN_NAME;
+        return true;
+    }
+
+    if (strchr("+-*/%(),=", ch) != NULL)
+    {
+        c->pos++;
+        c->token = TOKEN_CHAR;
+        c->text[0] = ch;
+        c->text[1] = '\0';
+        return true;
+    }
+
+    // The message ends up in JSON error responses, quote only harmless characters
+    char message[32];
+    if (ch > ' ' && ch < 0x7F && ch != '"' && ch != '\\')
+        snprintf(message, sizeof(message), "unexpected '%c'", ch);
+    else
+        snprintf(message, sizeof(message), "unexpected character 0x%02x", (uint8_t)ch);
+    return fail(c, ESP_ERR_INVALID_ARG, message);
+}
+
+static inline bool is_char(const compiler_t *c, char ch)
+{
+    return c->token == TOKEN_CHAR && c->text[0] == ch;
+}
+
+static bool expect_char(compiler_t *c, char ch)
+{
+    if (!is_char(c, ch))
+    {
+        char message[32];
+        snprintf(message, sizeof(message), "expected '%c'", ch);
+        return fail(c, ESP_ERR_INVALID_ARG, message);
+    }
+    return next_token(c);
+}
+
+// --- Registers ---
+
+static bool alloc_reg(compiler_t *c, uint8_t *reg)
+{
+    if (c->next_reg >= LED_SCRIPT_REGISTERS || (c->temp_mask & (1u << c->next_reg)))
+        return fail(c, ESP_ERR_INVALID_SIZE, "too many values");
+    *reg = c->next_reg++;
+    return true;
+}
+
+static bool alloc_temp(compiler_t *c, uint8_t *reg)
+{
+    for (int r = LED_SCRIPT_REGISTERS - 1; r >= c->next_reg; r--)
+    {
+        if (!(c->temp_mask & (1u << r)))
+        {
+            c->temp_mask |= 1u << r;
+            *reg = (uint8_t)r;
+            return true;
+        }
+    }
+    return fail(c, ESP_ERR_INVALID_SIZE, "expression too complex");
+}
+
+static void release(compiler_t *c, const operand_t *value)
+{
+    if (value->temp)
+        c->temp_mask &= ~(1u << value->reg);
+}
+
+// Constants live in registers initialized once, they cost no instructions
+static bool constant_reg(compiler_t *c, int32_t value, uint8_t *reg)
+{
+    for (uint8_t r = LED_SCRIPT_REG_FIRST_FREE; r < c->next_reg; r++)
+    {
+        if ((c->program->constant_mask & (1u << r)) && c->program->init[r] == value)
+        {
+            *reg = r;
+            return true;
+        }
+    }
+    if (!alloc_reg(c, reg))
+        return false;
+    c->program->constant_mask |= 1u << *reg;
+    c->program->init[*reg] = value;
+    return true;
+}
+
+static bool materialize(compiler_t *c, operand_t *value)
+{
+    if (!value->constant)
+        return true;
+    if (!constant_reg(c, value->value, &value->reg))
+        return false;
+    value->constant = false;
+    return true;
+}
+
+static uint32_t *code_list(compiler_t *c, bool varying)
+{
+    return varying ? c->pixel_code : c->frame_code;
+}
+
+static bool emit(compiler_t *c, bool varying, uint8_t op, uint8_t dst, uint8_t a, uint8_t b, uint8_t *index)
+{
+    if (c->frame_len + c->pixel_len >= LED_SCRIPT_CODE_MAX)
+        return fail(c, ESP_ERR_INVALID_SIZE, "too many instructions");
+    uint8_t *length = varying ? &c->pixel_len : &c->frame_len;
+    *index = *length;
+    code_list(c, varying)[(*length)++] = INSTRUCTION(op, dst, a, b);
+    return true;
+}
+
+static void retarget(compiler_t *c, const operand_t *value, uint8_t dst)
+{
+    uint32_t *word = &code_list(c, value->varying)[value->producer];
+    *word = (*word & ~0xFF00u) | (uint32_t)dst << 8;
+}
+
+// A per frame temp read by per pixel code must survive the pixel loop, which reuses the temps
+static bool promote(compiler_t *c, operand_t *value)
+{
+    if (!value->temp || value->varying)
+        return true;
+    uint8_t reg;
+    release(c, value);
+    if (!alloc_reg(c, &reg))
+        return false;
+    retarget(c, value, reg);
+    value->reg = reg;
+    value->temp = false;
+    return true;
+}
+
+static uint8_t operand_count(uint8_t op)
+{
+    switch (op)
+    {
+    case LED_SCRIPT_OP_RAND:
+        return 0;
+    case LED_SCRIPT_OP_MOV:
+    case LED_SCRIPT_OP_NEG:
+    case LED_SCRIPT_OP_ABS:
+    case LED_SCRIPT_OP_SIN:
+    case LED_SCRIPT_OP_TRI:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+// Emits op, unused operands must be constants
+static bool operation(compiler_t *c, uint8_t op, operand_t *a, operand_t *b, operand_t *out)
+{
+    uint8_t operands = operand_count(op);
+    if (operands > 0 && a->constant && b->constant)
+    {
+        *out = (operand_t){.constant = true, .value = apply(op, a->value, b->value)};
+        return true;
+    }
+
+    bool varying = operands == 0 || a->varying || b->varying;
+    if (varying && (!promote(c, a) || !promote(c, b)))
+        return false;
+    if ((operands > 0 && !materialize(c, a)) || (operands > 1 && !materialize(c, b)))
+        return false;
+    release(c, b);
+    release(c, a);
+
+    uint8_t dst, index;
+    if (!alloc_temp(c, &dst) ||
+        !emit(c, varying, op, dst, operands > 0 ? a->reg : 0, operands > 1 ? b->reg : 0, &index))
+        return false;
+    *out = (operand_t){.varying = varying, .temp = true, .reg = dst, .producer = index};
+    return true;
+}
+
+static const operand_t *lookup(compiler_t *c, const char *name)
+{
+    for (size_t i = 0; i < c->symbol_count; i++)
+    {
+        if (strcmp(c->symbols[i].name, name) == 0)
+            return &c->symbols[i].value;
+    }
+    return NULL;
+}
+
+// --- Parser ---
+
+static bool parse_expression(compiler_t *c, operand_t *out);
+
+static bool parse_call(compiler_t *c, const char *name, operand_t *out)
+{
+    size_t f = 0;
+    while (f < sizeof(functions) / sizeof(functions[0]) && strcmp(functions[f].name, name) != 0)
+        f++;
+    if (f == sizeof(functions) / sizeof(functions[0]))
+        return fail(c, ESP_ERR_INVALID_ARG, "unknown function");
+
+    operand_t args[2] = {{.constant = true}, {.constant = true}};
+    if (!next_token(c))
+        return false;
+    for (uint8_t i = 0; i < functions[f].args; i++)
+    {
+        if (i > 0 && !expect_char(c, ','))
+            return false;
+        if (!parse_expression(c, &args[i]))
+            return false;
+    }
+    if (!expect_char(c, ')'))
+        return false;
+    return operation(c, functions[f].op, &args[0], &args[1], out);
+}
+
+static bool parse_primary(compiler_t *c, operand_t *out)
+{
+    if (c->token == TOKEN_NUMBER)
+    {
+        *out = (operand_t){.constant = true, .value = c->number};
+        return next_token(c);
+    }
+
+    if (c->token == TOKEN_NAME)
+    {
+        char name[LED_SCRIPT_NAME_MAX];
+        memcpy(name, c->text, sizeof(name));
+        if (!next_token(c))
+            return false;
+        if (is_char(c, '('))
+            return parse_call(c, name, out);
+
+        const operand_t *value = lookup(c, name);
+        if (value == NULL)
+            return fail(c, ESP_ERR_INVALID_ARG, "unknown name");
+        *out = *value;
+        return true;
+    }
+
+    if (is_char(c, '('))
+    {
+        return next_token(c) && parse_expression(c, out) && expect_char(c, ')');
+    }
+
+    if (is_char(c, '-'))
+    {
+        operand_t value, unused = {.constant = true};
+        return next_token(c) && parse_primary(c, &value) && operation(c, LED_SCRIPT_OP_NEG, &value, &unused, out);
+    }
+
+    return fail(c, ESP_ERR_INVALID_ARG, "expected a value");
+}
+
+static bool parse_term(compiler_t *c, operand_t *out)
+{
+    if (!parse_primary(c, out))
+        return false;
+    while (is_char(c, '*') || is_char(c, '/') || is_char(c, '%'))
+    {
+        uint8_t op = is_char(c, '*') ? LED_SCRIPT_OP_MUL : is_char(c, '/') ? LED_SCRIPT_OP_DIV : LED_SCRIPT_OP_MOD;
+        operand_t left = *out, right;
+        if (!next_token(c) || !parse_primary(c, &right) || !operation(c, op, &left, &right, out))
+            return false;
+    }
+    return true;
+}
+
+static bool parse_expression(compiler_t *c, operand_t *out)
+{
+    if (!parse_term(c, out))
+        return false;
+    while (is_char(c, '+') || is_char(c, '-'))
+    {
+        uint8_t op = is_char(c, '+') ? LED_SCRIPT_OP_ADD : LED_SCRIPT_OP_SUB;
+        operand_t left = *out, right;
+        if (!next_token(c) || !parse_term(c, &right) || !operation(c, op, &left, &right, out))
+            return false;
+    }
+    return true;
+}
+
+static bool parse_statement(compiler_t *c)
+{
+    if (c->token != TOKEN_NAME)
+        return fail(c, ESP_ERR_INVALID_ARG, "expected an assignment");
+
+    char name[LED_SCRIPT_NAME_MAX];
+    memcpy(name, c->text, sizeof(name));
+    int output = -1;
+    for (int r = LED_SCRIPT_REG_R; r <= LED_SCRIPT_REG_B; r++)
+    {
+        if (strcmp(name, register_names[r]) == 0)
+            output = r;
+    }
+    if (lookup(c, name) != NULL)
+        return fail(c, ESP_ERR_INVALID_ARG, "name is already assigned");
+    if (c->symbol_count == LED_SCRIPT_REGISTERS)
+        return fail(c, ESP_ERR_INVALID_SIZE, "too many names");
+
+    operand_t value;
+    if (!next_token(c) || !expect_char(c, '=') || !parse_expression(c, &value))
+        return false;
+
+    if (output >= 0)
+    {
+        uint8_t index;
+        if (value.constant)
+            c->program->init[output] = value.value;
+        else if (value.temp)
+            retarget(c, &value, (uint8_t)output);
+        else if (!emit(c, value.varying, LED_SCRIPT_OP_MOV, (uint8_t)output, value.reg, 0, &index))
+            return false;
+        release(c, &value);
+
+        // Readable from here on
+        symbol_t *symbol = &c->symbols[c->symbol_count++];
+        memcpy(symbol->name, name, sizeof(symbol->name));
+        symbol->value = value.constant ? value : (operand_t){.varying = value.varying, .reg = (uint8_t)output};
+    }
+    else
+    {
+        // Every name is assigned once, so a variable can take over the temp or alias another register
+        if (value.temp)
+        {
+            uint8_t reg;
+            release(c, &value);
+            if (!alloc_reg(c, &reg))
+                return false;
+            retarget(c, &value, reg);
+            value.reg = reg;
+            value.temp = false;
+        }
+        symbol_t *symbol = &c->symbols[c->symbol_count++];
+        memcpy(symbol->name, name, sizeof(symbol->name));
+        symbol->value = value;
+    }
+
+    if (c->token != TOKEN_NEWLINE && c->token != TOKEN_END)
+        return fail(c, ESP_ERR_INVALID_ARG, "expected end of line");
+    return true;
+}
+
+esp_err_t led_script_compile(const char *source, size_t length, led_script_program_t *program,
+                             led_script_error_t *error)
+{
+    static const struct
+    {
+        uint8_t reg;
+        bool varying;
+    } inputs[] = {
+        {LED_SCRIPT_REG_I, true},   {LED_SCRIPT_REG_N, false},  {LED_SCRIPT_REG_T, false},
+        {LED_SCRIPT_REG_PR, true},  {LED_SCRIPT_REG_PG, true},  {LED_SCRIPT_REG_PB, true},
+    };
+
+    // About 2 KB, too much for the stack of the HTTP task; evaluation itself never allocates
+    compiler_t *c = calloc(1, sizeof(compiler_t));
+    memset(program, 0, sizeof(*program));
+    memset(error, 0, sizeof(*error));
+    if (c == NULL)
+    {
+        snprintf(error->message, sizeof(error->message), "out of memory");
+        return ESP_ERR_NO_MEM;
+    }
+    c->pos = source;
+    c->end = source + length;
+    c->line = 1;
+    c->next_reg = LED_SCRIPT_REG_FIRST_FREE;
+    c->program = program;
+    c->error = error;
+    c->result = ESP_OK;
+
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        symbol_t *symbol = &c->symbols[c->symbol_count++];
+        snprintf(symbol->name, sizeof(symbol->name), "%s", register_names[inputs[i].reg]);
+        symbol->value = (operand_t){.varying = inputs[i].varying, .reg = inputs[i].reg};
+    }
+
+    if (length > LED_SCRIPT_SOURCE_MAX)
+    {
+        fail(c, ESP_ERR_INVALID_SIZE, "script too long");
+    }
+    else if (next_token(c))
+    {
+        while (c->token != TOKEN_END)
+        {
+            if (c->token == TOKEN_NEWLINE)
+            {
+                if (!next_token(c))
+                    break;
+                continue;
+            }
+            if (!parse_statement(c))
+                break;
+        }
+    }
+
+    esp_err_t ret = c->result;
+    if (ret == ESP_OK)
+    {
+        program->frame_len = c->frame_len;
+        program->pixel_len = c->pixel_len;
+        memcpy(program->code, c->frame_code, sizeof(uint32_t) * c->frame_len);
+        memcpy(program->code + c->frame_len, c->pixel_code, sizeof(uint32_t) * c->pixel_len);
+    }
+    free(c);
+    return ret;
+}
+
+// --- Listing ---
+
+static void format_register(const led_script_program_t *program, uint8_t reg, char *out, size_t size)
+{
+    if (reg < LED_SCRIPT_REG_FIRST_FREE)
+        snprintf(out, size, "%s", register_names[reg]);
+    else if (program->constant_mask & (1u << reg))
+        snprintf(out, size, "#%ld", (long)program->init[reg]);
+    else
+        snprintf(out, size, "x%u", reg);
+}
+
+void led_script_disassemble(const led_script_program_t *program, void (*print)(const char *line, void *context),
+                            void *context)
+{
+    char line[64];
+    for (int r = LED_SCRIPT_REG_R; r <= LED_SCRIPT_REG_B; r++)
+    {
+        if (program->init[r] != 0)
+        {
+            snprintf(line, sizeof(line), "init  %s = %ld", register_names[r], (long)program->init[r]);
+            print(line, context);
+        }
+    }
+
+    for (size_t pc = 0; pc < (size_t)program->frame_len + program->pixel_len; pc++)
+    {
+        if (pc == 0 && program->frame_len > 0)
+            print("frame:", context);
+        if (pc == program->frame_len)
+            print("pixel:", context);
+
+        uint32_t word = program->code[pc];
+        uint8_t op = OP(word);
+        char dst[16], a[16], b[16];
+        format_register(program, DST(word), dst, sizeof(dst));
+        format_register(program, SRC_A(word), a, sizeof(a));
+        format_register(program, SRC_B(word), b, sizeof(b));
+
+        const char *name = op < LED_SCRIPT_OP_COUNT ? op_names[op] : "?";
+        if (op == LED_SCRIPT_OP_RAND)
+            snprintf(line, sizeof(line), "  %-5s %s", name, dst);
+        else if (op == LED_SCRIPT_OP_MOV || op == LED_SCRIPT_OP_NEG || op == LED_SCRIPT_OP_ABS ||
+                 op == LED_SCRIPT_OP_SIN || op == LED_SCRIPT_OP_TRI)
+            snprintf(line, sizeof(line), "  %-5s %s, %s", name, dst, a);
+        else
+            snprintf(line, sizeof(line), "  %-5s %s, %s, %s", name, dst, a, b);
+        print(line, context);
+    }
+}
@@ -0,0 +1,118 @@
+#include "led_segment.h"
+#include "persistence_manager.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "led_segment";
+
+// The list is replaced as a whole under the lock, readers take a copy
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static led_segment_list_t current;
+static uint16_t strip_length; // end of the last segment in current
+
+static int compare_segments_by_start(const void *a, const void *b)
+{
+    const led_segment_t *seg_a = (const led_segment_t *)a;
+    const led_segment_t *seg_b = (const led_segment_t *)b;
+    return (int)seg_a->start - (int)seg_b->start;
+}
+
+void led_segment_load(void)
+{
+    led_segment_t loaded[LED_SEGMENT_MAX_LEN];
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") != ESP_OK)
+    {
+        led_segment_set(NULL, 0);
+        return;
+    }
+
+    int32_t count = persistence_manager_get_int(&pm, "segment_count", 0);
+    if (count < 0 || count > LED_SEGMENT_MAX_LEN)
+        count = 0;
+    if (count > 0 && !persistence_manager_get_blob(&pm, "segments", loaded, sizeof(led_segment_t) * count, NULL))
+        count = 0;
+    persistence_manager_deinit(&pm);
+
+    led_segment_set(loaded, (size_t)count);
+
+    ESP_LOGI(TAG, "Loaded %u segments", (unsigned)count);
+}
+
+void led_segment_save(void)
+{
+    led_segment_list_t list;
+    led_segment_get_all(&list);
+
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") != ESP_OK)
+        return;
+    persistence_manager_set_blob(&pm, "segments", list.segments, sizeof(led_segment_t) * list.count);
+    persistence_manager_set_int(&pm, "segment_count", (int32_t)list.count);
+    persistence_manager_deinit(&pm);
+}
+
+void led_segment_set(const led_segment_t *segments, size_t count)
+{
+    // Sorted outside the lock; the caller's list stays untouched
+    led_segment_list_t next;
+    if (count > LED_SEGMENT_MAX_LEN)
+        count = LED_SEGMENT_MAX_LEN;
+    memset(&next, 0, sizeof(next));
+    if (count > 0)
+        memcpy(next.segments, segments, sizeof(led_segment_t) * count);
+    next.count = count;
+    for (size_t i = 0; i < count; i++)
+        next.segments[i].name[sizeof(next.segments[i].name) - 1] = '\0';
+    qsort(next.segments, count, sizeof(led_segment_t), compare_segments_by_start);
+
+    uint32_t end = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t segment_end = (uint32_t)next.segments[i].start + next.segments[i].leds;
+        if (segment_end > end)
+            end = segment_end;
+    }
+
+    taskENTER_CRITICAL(&lock);
+    current = next;
+    strip_length = end > UINT16_MAX ? UINT16_MAX : (uint16_t)end;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void led_segment_get_all(led_segment_list_t *list)
+{
+    taskENTER_CRITICAL(&lock);
+    *list = current;
+    taskEXIT_CRITICAL(&lock);
+}
+
+bool led_segment_find(const char *name, led_segment_t *segment)
+{
+    bool found = false;
+
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < current.count && !found; i++)
+    {
+        if (strcmp(current.segments[i].name, name) == 0)
+        {
+            found = true;
+            if (segment)
+                *segment = current.segments[i];
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    return found;
+}
+
+uint16_t led_segment_strip_length(void)
+{
+    taskENTER_CRITICAL(&lock);
+    uint16_t length = strip_length;
+    taskEXIT_CRITICAL(&lock);
+    return length;
+}
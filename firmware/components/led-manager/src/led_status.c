@@ -3,13 +3,20 @@
 #include <esp_log.h>
 #include <esp_timer.h> // For high-resolution timestamps
 #include <freertos/FreeRTOS.h>
-#include <freertos/semphr.h>
 #include <freertos/task.h>
 #include <led_strip.h>
 
 static const char *TAG = "led_status";
 
-// Internal control structure for each LED
+// Behavior published by led_status_set_behavior. Writers only hold a short critical section to
+// serialize against each other; the task reads it lock-free with a sequence counter.
+typedef struct
+{
+    volatile uint32_t seq; // odd while a writer updates the behavior
+    led_behavior_t behavior;
+} led_mailbox_t;
+
+// Internal control structure for each LED (owned by the task)
 typedef struct
 {
     led_behavior_t behavior;      // The desired behavior (target state)
@@ -17,84 +24,163 @@ typedef struct
     bool is_on_in_blink;          // Current state in blink mode (actual state)
 } led_control_t;
 
+// Shortest blink phase, protects the task from spinning on a zero duration
+#define MIN_BLINK_PHASE_US (10 * 1000)
+
 // --- Module variables ---
 static led_strip_handle_t led_strip;
 static led_control_t led_controls[STATUS_LED_COUNT];
-static SemaphoreHandle_t mutex; // To protect the led_controls array
+static led_mailbox_t mailboxes[STATUS_LED_COUNT];
+static portMUX_TYPE publish_lock = portMUX_INITIALIZER_UNLOCKED; // serializes writers only
+static TaskHandle_t task_handle;
 
-// The core: The task that controls the LEDs
+static inline bool rgb_equal(rgb_t a, rgb_t b)
+{
+    return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
+
+static inline bool behavior_equal(const led_behavior_t *a, const led_behavior_t *b)
+{
+    if (a->mode != b->mode || !rgb_equal(a->color, b->color))
+        return false;
+    if (a->mode == LED_MODE_OFF || a->mode == LED_MODE_SOLID)
+        return true;
+    return a->on_time_ms == b->on_time_ms && a->off_time_ms == b->off_time_ms &&
+           (a->mode != LED_MODE_BLINK_ALT || rgb_equal(a->alt_color, b->alt_color));
+}
+
+// Copies the newest published behavior of an LED if it changed since applied_seq
+static bool read_mailbox(int index, uint32_t *applied_seq, led_behavior_t *out)
+{
+    led_mailbox_t *box = &mailboxes[index];
+
+    for (;;)
+    {
+        uint32_t seq = __atomic_load_n(&box->seq, __ATOMIC_ACQUIRE);
+        if (seq == *applied_seq)
+            return false;
+        if (seq & 1)
+            continue; // writer on the other core is in the middle of an update
+
+        *out = box->behavior;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&box->seq, __ATOMIC_RELAXED) == seq)
+        {
+            *applied_seq = seq;
+            return true;
+        }
+    }
+}
+
+// Advances a blinking LED and returns the time of its next toggle
+static uint64_t update_blink(led_control_t *control, uint64_t now_us)
+{
+    uint32_t duration_ms = control->is_on_in_blink ? control->behavior.on_time_ms : control->behavior.off_time_ms;
+    uint64_t duration_us = (uint64_t)duration_ms * 1000;
+    if (duration_us < MIN_BLINK_PHASE_US)
+        duration_us = MIN_BLINK_PHASE_US;
+
+    if (now_us - control->last_toggle_time_us >= duration_us)
+    {
+        control->is_on_in_blink = !control->is_on_in_blink;
+        control->last_toggle_time_us = now_us;
+
+        duration_ms = control->is_on_in_blink ? control->behavior.on_time_ms : control->behavior.off_time_ms;
+        duration_us = (uint64_t)duration_ms * 1000;
+        if (duration_us < MIN_BLINK_PHASE_US)
+            duration_us = MIN_BLINK_PHASE_US;
+    }
+
+    return control->last_toggle_time_us + duration_us;
+}
+
+// The core: The task that controls the LEDs.
+// It only wakes up for the next blink toggle or when a behavior changes, and only refreshes the
+// strip if a pixel actually changed, so solid/off LEDs cost no wakeups at all.
 static void led_status_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "Led Status Task started.");
 
+    rgb_t shown[STATUS_LED_COUNT] = {0};
+    bool shown_valid = false;
+    uint32_t applied_seq[STATUS_LED_COUNT] = {0};
+
     while (true)
     {
         uint64_t now_us = esp_timer_get_time();
+        uint64_t next_toggle_us = UINT64_MAX;
+        rgb_t target[STATUS_LED_COUNT];
 
-        // Take the mutex to safely access the control data
-        if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) == pdTRUE)
+        for (int i = 0; i < STATUS_LED_COUNT; i++)
         {
+            led_control_t *control = &led_controls[i];
 
-            for (int i = 0; i < STATUS_LED_COUNT; i++)
+            // Pick up the newest behavior and start the new pattern cleanly
+            led_behavior_t behavior;
+            if (read_mailbox(i, &applied_seq[i], &behavior))
             {
-                led_control_t *control = &led_controls[i];
-
-                switch (control->behavior.mode)
-                {
-                case LED_MODE_OFF:
-                    led_strip_set_pixel(led_strip, i, 0, 0, 0);
-                    break;
-
-                case LED_MODE_SOLID:
-                    led_strip_set_pixel(led_strip, i, control->behavior.color.red, control->behavior.color.green,
-                                        control->behavior.color.blue);
-                    break;
-
-                case LED_MODE_BLINK: {
-                    uint32_t duration_ms =
-                        control->is_on_in_blink ? control->behavior.on_time_ms : control->behavior.off_time_ms;
-                    if ((now_us - control->last_toggle_time_us) / 1000 >= duration_ms)
-                    {
-                        control->is_on_in_blink      = !control->is_on_in_blink;
-                        control->last_toggle_time_us = now_us;
-                    }
-
-                    if (control->is_on_in_blink)
-                        led_strip_set_pixel(led_strip, i, control->behavior.color.red, control->behavior.color.green,
-                                            control->behavior.color.blue);
-                    else
-                        led_strip_set_pixel(led_strip, i, 0, 0, 0);
-                }
+                control->behavior = behavior;
+                control->is_on_in_blink = false;
+                control->last_toggle_time_us = now_us;
+            }
+
+            switch (control->behavior.mode)
+            {
+            case LED_MODE_OFF:
+                target[i] = (rgb_t){0, 0, 0};
                 break;
 
-                case LED_MODE_BLINK_ALT: {
-                    uint32_t duration_ms =
-                        control->is_on_in_blink ? control->behavior.on_time_ms : control->behavior.off_time_ms;
-                    if ((now_us - control->last_toggle_time_us) / 1000 >= duration_ms)
-                    {
-                        control->is_on_in_blink      = !control->is_on_in_blink;
-                        control->last_toggle_time_us = now_us;
-                    }
-
-                    rgb_t *c = control->is_on_in_blink ? &control->behavior.color : &control->behavior.alt_color;
-                    led_strip_set_pixel(led_strip, i, c->red, c->green, c->blue);
-                }
+            case LED_MODE_SOLID:
+                target[i] = control->behavior.color;
                 break;
-                }
+
+            case LED_MODE_BLINK: {
+                uint64_t toggle_us = update_blink(control, now_us);
+                if (toggle_us < next_toggle_us)
+                    next_toggle_us = toggle_us;
+                target[i] = control->is_on_in_blink ? control->behavior.color : (rgb_t){0, 0, 0};
+            }
+            break;
+
+            case LED_MODE_BLINK_ALT: {
+                uint64_t toggle_us = update_blink(control, now_us);
+                if (toggle_us < next_toggle_us)
+                    next_toggle_us = toggle_us;
+                target[i] = control->is_on_in_blink ? control->behavior.color : control->behavior.alt_color;
+            }
+            break;
             }
-            // Release the mutex
-            xSemaphoreGive(mutex);
         }
-        else
+
+        // Update the physical LED strip only if something changed
+        bool changed = false;
+        for (int i = 0; i < STATUS_LED_COUNT; i++)
         {
-            ESP_LOGW(TAG, "Failed to acquire mutex within timeout");
+            if (!shown_valid || !rgb_equal(shown[i], target[i]))
+            {
+                led_strip_set_pixel(led_strip, i, target[i].red, target[i].green, target[i].blue);
+                shown[i] = target[i];
+                changed = true;
+            }
+        }
+        if (changed)
+        {
+            led_strip_refresh(led_strip);
+            shown_valid = true;
         }
 
-        // Update the physical LED strip with the new values
-        led_strip_refresh(led_strip);
-
-        // Delay task for 20ms before the next iteration
-        vTaskDelay(pdMS_TO_TICKS(20));
+        // Sleep until the next toggle is due or a behavior change notification arrives
+        TickType_t wait_ticks = portMAX_DELAY;
+        if (next_toggle_us != UINT64_MAX)
+        {
+            uint64_t now = esp_timer_get_time();
+            uint64_t wait_us = next_toggle_us > now ? next_toggle_us - now : 0;
+            uint64_t tick_us = 1000000ULL / configTICK_RATE_HZ;
+            wait_ticks = (TickType_t)((wait_us + tick_us - 1) / tick_us);
+            if (wait_ticks == 0)
+                wait_ticks = 1;
+        }
+        ulTaskNotifyTake(pdTRUE, wait_ticks);
     }
 }
 
@@ -123,16 +209,8 @@ esp_err_t led_status_init(int gpio_num)
     }
     ESP_LOGI(TAG, "Status LED initialized.");
 
-    // Create mutex
-    mutex = xSemaphoreCreateMutex();
-    if (mutex == NULL)
-    {
-        ESP_LOGE(TAG, "Could not create mutex.");
-        return ESP_FAIL;
-    }
-
     // Start task
-    xTaskCreatePinnedToCore(led_status_task, "led_status_task", 2048, NULL, tskIDLE_PRIORITY + 2, NULL,
+    xTaskCreatePinnedToCore(led_status_task, "led_status_task", 2048, NULL, tskIDLE_PRIORITY + 2, &task_handle,
                             CONFIG_FREERTOS_NUMBER_OF_CORES - 1);
 
     return ESP_OK;
@@ -146,18 +224,42 @@ esp_err_t led_status_set_behavior(led_behavior_t behavior)
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) == pdTRUE)
+    bool in_isr = xPortInIsrContext();
+    led_mailbox_t *box = &mailboxes[behavior.index];
+
+    if (in_isr)
+        taskENTER_CRITICAL_ISR(&publish_lock);
+    else
+        taskENTER_CRITICAL(&publish_lock);
+
+    // Repeating the current behavior (e.g. on every strip frame) must neither restart a blink
+    // pattern nor wake the task
+    bool changed = !behavior_equal(&box->behavior, &behavior);
+    if (changed)
     {
-        led_controls[behavior.index].behavior = behavior;
-        // Reset internal state variables to start the new pattern cleanly
-        led_controls[behavior.index].is_on_in_blink = false;
-        led_controls[behavior.index].last_toggle_time_us = esp_timer_get_time();
-        xSemaphoreGive(mutex);
+        __atomic_store_n(&box->seq, box->seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        box->behavior = behavior;
+        __atomic_store_n(&box->seq, box->seq + 1, __ATOMIC_RELEASE);
     }
+
+    if (in_isr)
+        taskEXIT_CRITICAL_ISR(&publish_lock);
     else
+        taskEXIT_CRITICAL(&publish_lock);
+
+    if (changed && task_handle != NULL)
     {
-        ESP_LOGE(TAG, "Failed to acquire mutex for set_behavior");
-        return ESP_FAIL;
+        if (in_isr)
+        {
+            BaseType_t woken = pdFALSE;
+            vTaskNotifyGiveFromISR(task_handle, &woken);
+            portYIELD_FROM_ISR(woken);
+        }
+        else
+        {
+            xTaskNotifyGive(task_handle);
+        }
     }
 
     return ESP_OK;
@@ -1,9 +1,17 @@
 #include "led_strip_ws2812.h"
 #include "color.h"
+#include "led_calibration.h"
+#include "led_anim.h"
+#include "led_effect.h"
+#include "led_power.h"
+#include "led_realtime.h"
+#include "led_remap.h"
+#include "led_script.h"
+#include "led_segment.h"
 #include "led_status.h"
+#include "led_transition.h"
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
 #include <freertos/task.h>
 #include <led_strip.h>
 #include <sdkconfig.h>
@@ -11,9 +19,24 @@
 static const char *TAG = "led_strip";
 
 static led_strip_handle_t led_strip;
-static QueueHandle_t led_command_queue;
+static TaskHandle_t led_strip_task_handle;
 
 static const uint32_t MAX_LEDS = CONFIG_LED_STRIP_MAX_LEDS;
+static const TickType_t EFFECT_FRAME_TICKS = pdMS_TO_TICKS(1000 / CONFIG_LED_EFFECT_FRAME_RATE);
+
+#if CONFIG_LED_STRIP_MODEL_SK6812_RGBW
+#define STRIP_MODEL LED_MODEL_SK6812
+#define STRIP_FORMAT LED_STRIP_COLOR_COMPONENT_FMT_GRBW
+#define STRIP_HAS_WHITE 1
+#else
+#define STRIP_MODEL LED_MODEL_WS2812
+#define STRIP_FORMAT LED_STRIP_COLOR_COMPONENT_FMT_GRB
+#define STRIP_HAS_WHITE 0
+#endif
+
+// Logical frame: base color plus effects, written to the RMT buffer in one pass (remapped to the
+// physical wiring on the way)
+static rgb_t framebuffer[CONFIG_LED_STRIP_MAX_LEDS];
 
 typedef struct
 {
@@ -21,11 +44,92 @@ typedef struct
     rgb_t color;
 } led_command_t;
 
-static void set_all_pixels(const rgb_t color)
+// Latest-value mailbox: producers overwrite the pending command and never block, the LED task
+// always renders the newest one
+static portMUX_TYPE command_lock = portMUX_INITIALIZER_UNLOCKED;
+static led_command_t pending_command;
+static bool command_pending;
+static led_strip_stats_t stats;
+
+// Channel sums of the frame currently in the framebuffer, the snapshot source of a transition
+static rgb_sum_t framebuffer_sum;
+
+#if STRIP_HAS_WHITE
+static color_white_point_t white_point;
+#endif
+
+// Set while the framebuffer holds a realtime frame, its end fades back to the composed frame
+static bool showing_realtime;
+
+static void set_all_pixels(const rgb_t color, bool with_effects)
 {
+    rgb_sum_t sum;
+    // A realtime stream replaces base color, effects and animations, the frame is copied in one pass
+    bool realtime = with_effects && led_realtime_render(framebuffer, MAX_LEDS, &sum);
+    if (showing_realtime && !realtime)
+    {
+        led_transition_start(framebuffer, MAX_LEDS, &framebuffer_sum);
+    }
+    showing_realtime = realtime;
+
+    if (!realtime)
+    {
+        for (uint32_t i = 0; i < MAX_LEDS; i++)
+        {
+            framebuffer[i] = color;
+        }
+        // The base color is uniform, effects and the transition keep the sums up to date incrementally
+        sum = (rgb_sum_t){
+            .red = MAX_LEDS * color.red,
+            .green = MAX_LEDS * color.green,
+            .blue = MAX_LEDS * color.blue,
+        };
+
+        if (with_effects)
+        {
+            led_effect_render(framebuffer, MAX_LEDS, &sum);
+            led_script_render(framebuffer, MAX_LEDS, &sum);
+            led_anim_render(framebuffer, MAX_LEDS, &sum);
+        }
+    }
+
+    // Crossfade from the previously shown frame, the framebuffer keeps what is on the strip
+    led_transition_apply(framebuffer, MAX_LEDS, &sum);
+    framebuffer_sum = sum;
+
+    // The limiter only scales the output, so the framebuffer stays a valid transition source.
+    // On RGBW strips the estimate from the RGB sums is conservative, the white LED draws less
+    // than the channels it replaces. Calibration applies after the sums were taken and may raise
+    // a pixel above its rendered value, so the estimate assumes the strongest kernel for every pixel.
+    uint32_t gain = led_calibration_peak_gain();
+    rgb_sum_t estimate = sum;
+    if (gain > LED_CALIBRATION_ONE)
+    {
+        estimate.red = (uint32_t)(((uint64_t)sum.red * gain) >> LED_CALIBRATION_SHIFT);
+        estimate.green = (uint32_t)(((uint64_t)sum.green * gain) >> LED_CALIBRATION_SHIFT);
+        estimate.blue = (uint32_t)(((uint64_t)sum.blue * gain) >> LED_CALIBRATION_SHIFT);
+    }
+    uint8_t scale = led_power_update(&estimate, MAX_LEDS);
+    // Physical wiring is resolved while serializing, everything above renders logical pixels.
+    // Calibrated segments get the brightness scale folded into their color matrix.
+    const uint16_t *remap = led_remap_table();
+    const led_calibration_kernel_t *kernels = NULL;
+    const uint8_t *calibration = led_calibration_prepare(scale, &kernels);
     for (uint32_t i = 0; i < MAX_LEDS; i++)
     {
-        led_strip_set_pixel(led_strip, i, color.red, color.green, color.blue);
+        uint32_t source = remap != NULL ? remap[i] : i;
+        rgb_t pixel = source < MAX_LEDS ? framebuffer[source] : (rgb_t){.red = 0, .green = 0, .blue = 0};
+        uint8_t kernel = calibration != NULL && source < MAX_LEDS ? calibration[source] : 0;
+        if (kernel != 0)
+            pixel = led_calibration_apply(&kernels[kernel - 1], pixel);
+        else if (scale < 255)
+            pixel = color_scale(pixel, scale);
+#if STRIP_HAS_WHITE
+        rgbw_t output = color_extract_white(&white_point, pixel);
+        led_strip_set_pixel_rgbw(led_strip, i, output.red, output.green, output.blue, output.white);
+#else
+        led_strip_set_pixel(led_strip, i, pixel.red, pixel.green, pixel.blue);
+#endif
     }
     led_strip_refresh(led_strip);
 
@@ -40,14 +144,33 @@ static void set_all_pixels(const rgb_t color)
 void led_strip_task(void *pvParameters)
 {
     led_state_t current_state = LED_STATE_OFF;
-    led_command_t cmd;
+    rgb_t current_color = {0, 0, 0};
 
     for (;;)
     {
-        TickType_t wait_ticks = (current_state == LED_STATE_SIMULATION) ? pdMS_TO_TICKS(50) : portMAX_DELAY;
-        if (xQueueReceive(led_command_queue, &cmd, wait_ticks) == pdPASS)
+        bool animated = led_transition_active() || led_power_settling() ||
+                        (current_state != LED_STATE_OFF && (led_effect_any_active() || led_script_any_active() ||
+                                                            led_anim_active() || led_realtime_active()));
+        TickType_t wait_ticks = animated                                 ? EFFECT_FRAME_TICKS
+                                : (current_state == LED_STATE_SIMULATION) ? pdMS_TO_TICKS(50)
+                                                                         : portMAX_DELAY;
+        ulTaskNotifyTake(pdTRUE, wait_ticks);
+
+        bool state_changed = false;
+        taskENTER_CRITICAL(&command_lock);
+        if (command_pending)
         {
-            current_state = cmd.state;
+            state_changed = pending_command.state != current_state;
+            current_state = pending_command.state;
+            current_color = pending_command.color;
+            command_pending = false;
+        }
+        taskEXIT_CRITICAL(&command_lock);
+
+        // Only mode and power changes fade, color updates within a mode (simulation) follow directly
+        if (state_changed)
+        {
+            led_transition_start(framebuffer, MAX_LEDS, &framebuffer_sum);
         }
 
         rgb_t color;
@@ -57,11 +180,11 @@ void led_strip_task(void *pvParameters)
             color = (rgb_t){.red = 0, .green = 0, .blue = 0};
             break;
         default:
-            color = cmd.color;
+            color = current_color;
             break;
         }
 
-        set_all_pixels(color);
+        set_all_pixels(color, current_state != LED_STATE_OFF);
     }
 };
 
@@ -70,8 +193,8 @@ esp_err_t led_strip_init(void)
     led_strip_config_t strip_config = {
         .strip_gpio_num = CONFIG_WLED_DIN_PIN,
         .max_leds = MAX_LEDS,
-        .led_model = LED_MODEL_WS2812,
-        .color_component_format = LED_STRIP_COLOR_COMPONENT_FMT_GRB,
+        .led_model = STRIP_MODEL,
+        .color_component_format = STRIP_FORMAT,
         .flags = {.invert_out = 0},
     };
 
@@ -88,17 +211,30 @@ esp_err_t led_strip_init(void)
         return ret;
     }
 
-    led_command_queue = xQueueCreate(5, sizeof(led_command_t));
-    if (led_command_queue == NULL)
+#if STRIP_HAS_WHITE
+    color_white_point_init(&white_point, color_from_kelvin(CONFIG_LED_STRIP_WHITE_KELVIN));
+#endif
+
+    led_segment_load();
+    led_effect_load();
+    led_remap_load();
+    led_calibration_load();
+    led_script_load();
+    led_transition_load();
+
+    if (led_anim_init() != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to create command queue");
         return ESP_FAIL;
     }
 
-    set_all_pixels((rgb_t){.red = 0, .green = 0, .blue = 0});
+    set_all_pixels((rgb_t){.red = 0, .green = 0, .blue = 0}, false);
 
-    xTaskCreatePinnedToCore(led_strip_task, "led_strip_task", 4096, NULL, tskIDLE_PRIORITY + 1, NULL,
-                            CONFIG_FREERTOS_NUMBER_OF_CORES - 1);
+    if (xTaskCreatePinnedToCore(led_strip_task, "led_strip_task", 4096, NULL, tskIDLE_PRIORITY + 1,
+                                &led_strip_task_handle, CONFIG_FREERTOS_NUMBER_OF_CORES - 1) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create LED strip task");
+        return ESP_FAIL;
+    }
 
     ESP_LOGI(TAG, "LED strip initialized");
 
@@ -107,15 +243,41 @@ esp_err_t led_strip_init(void)
 
 esp_err_t led_strip_update(led_state_t state, rgb_t color)
 {
-    led_command_t cmd = {
+    if (led_strip_task_handle == NULL)
+    {
+        ESP_LOGE(TAG, "LED strip not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    taskENTER_CRITICAL(&command_lock);
+    if (command_pending)
+    {
+        // The previous command was never rendered, the newer one supersedes it
+        stats.dropped_commands++;
+    }
+    pending_command = (led_command_t){
         .state = state,
         .color = color,
     };
+    command_pending = true;
+    stats.commands++;
+    taskEXIT_CRITICAL(&command_lock);
 
-    if (xQueueSend(led_command_queue, &cmd, pdMS_TO_TICKS(100)) != pdPASS)
+    xTaskNotifyGive(led_strip_task_handle);
+    return ESP_OK;
+}
+
+void led_strip_wake(void)
+{
+    if (led_strip_task_handle != NULL)
     {
-        ESP_LOGE(TAG, "Failed to send command to LED manager queue");
-        return ESP_FAIL;
+        xTaskNotifyGive(led_strip_task_handle);
     }
-    return ESP_OK;
+}
+
+void led_strip_get_stats(led_strip_stats_t *out)
+{
+    taskENTER_CRITICAL(&command_lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&command_lock);
 }
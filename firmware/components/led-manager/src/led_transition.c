@@ -0,0 +1,212 @@
+#include "led_transition.h"
+#include "persistence_manager.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <sdkconfig.h>
+#include <string.h>
+
+static const char *TAG = "led_transition";
+
+#if defined(CONFIG_LED_TRANSITION_EASE_IN)
+#define DEFAULT_EASING LED_EASING_EASE_IN
+#elif defined(CONFIG_LED_TRANSITION_EASE_OUT)
+#define DEFAULT_EASING LED_EASING_EASE_OUT
+#elif defined(CONFIG_LED_TRANSITION_LINEAR)
+#define DEFAULT_EASING LED_EASING_LINEAR
+#else
+#define DEFAULT_EASING LED_EASING_EASE_IN_OUT
+#endif
+
+static const char *const easing_names[LED_EASING_COUNT] = {
+    [LED_EASING_LINEAR] = "linear",
+    [LED_EASING_EASE_IN] = "ease-in",
+    [LED_EASING_EASE_OUT] = "ease-out",
+    [LED_EASING_EASE_IN_OUT] = "ease-in-out",
+};
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; // protects config and stats
+static led_transition_config_t config = {
+    .duration_ms = CONFIG_LED_TRANSITION_DURATION_MS,
+    .easing = DEFAULT_EASING,
+};
+static led_transition_stats_t stats;
+
+// Owned by the LED task
+static rgb_t from_frame[CONFIG_LED_STRIP_MAX_LEDS];
+static size_t from_length;
+static rgb_sum_t from_sum;
+static int64_t start_us;
+static uint32_t duration_us;
+static uint8_t easing;
+
+static color_fract_t ease(uint8_t curve, color_fract_t t)
+{
+    uint32_t x = t;
+    switch (curve)
+    {
+    case LED_EASING_EASE_IN:
+        return (color_fract_t)((x * x) >> COLOR_FRACT_SHIFT);
+    case LED_EASING_EASE_OUT: {
+        uint32_t inv = COLOR_FRACT_ONE - x;
+        return (color_fract_t)(COLOR_FRACT_ONE - ((inv * inv) >> COLOR_FRACT_SHIFT));
+    }
+    case LED_EASING_EASE_IN_OUT: {
+        // Smoothstep 3t^2 - 2t^3 = t^2 * (3 - 2t); both factors stay below 2^17, the product below 2^32
+        uint32_t square = (x * x) >> COLOR_FRACT_SHIFT;
+        return (color_fract_t)((square * (3 * COLOR_FRACT_ONE - 2 * x)) >> COLOR_FRACT_SHIFT);
+    }
+    default:
+        return t;
+    }
+}
+
+void led_transition_start(const rgb_t *frame, size_t length, const rgb_sum_t *sum)
+{
+    taskENTER_CRITICAL(&lock);
+    duration_us = (uint32_t)config.duration_ms * 1000;
+    easing = config.easing;
+    stats.transitions++;
+    stats.active = duration_us > 0;
+    taskEXIT_CRITICAL(&lock);
+
+    if (duration_us == 0)
+        return;
+
+    from_length = length < CONFIG_LED_STRIP_MAX_LEDS ? length : CONFIG_LED_STRIP_MAX_LEDS;
+    memcpy(from_frame, frame, sizeof(rgb_t) * from_length);
+    from_sum = *sum;
+    start_us = esp_timer_get_time();
+}
+
+bool led_transition_active(void)
+{
+    return duration_us > 0;
+}
+
+static inline uint32_t mix_sum(uint32_t to, uint32_t from, int32_t keep)
+{
+    return (uint32_t)((int64_t)to + ((((int64_t)from - to) * keep) >> COLOR_FRACT_SHIFT));
+}
+
+void led_transition_apply(rgb_t *framebuffer, size_t length, rgb_sum_t *sum)
+{
+    if (duration_us == 0)
+        return;
+
+    int64_t begin = esp_timer_get_time();
+    uint32_t elapsed = (uint32_t)(begin - start_us);
+    if (elapsed >= duration_us)
+    {
+        // Target reached, the framebuffer already holds the new frame
+        duration_us = 0;
+        taskENTER_CRITICAL(&lock);
+        stats.active = false;
+        taskEXIT_CRITICAL(&lock);
+        return;
+    }
+
+    // Weight of the old frame, so the loop only needs one multiply per channel
+    int32_t keep = COLOR_FRACT_ONE - ease(easing, color_fract_from_ratio(elapsed, duration_us));
+    size_t count = length < from_length ? length : from_length;
+    for (size_t i = 0; i < count; i++)
+    {
+        rgb_t *to = &framebuffer[i];
+        const rgb_t from = from_frame[i];
+        to->red = (uint8_t)(to->red + ((((int32_t)from.red - to->red) * keep) >> COLOR_FRACT_SHIFT));
+        to->green = (uint8_t)(to->green + ((((int32_t)from.green - to->green) * keep) >> COLOR_FRACT_SHIFT));
+        to->blue = (uint8_t)(to->blue + ((((int32_t)from.blue - to->blue) * keep) >> COLOR_FRACT_SHIFT));
+    }
+
+    // The blend is linear, so the channel sums mix with the same weight (up to rounding)
+    sum->red = mix_sum(sum->red, from_sum.red, keep);
+    sum->green = mix_sum(sum->green, from_sum.green, keep);
+    sum->blue = mix_sum(sum->blue, from_sum.blue, keep);
+
+    uint32_t cost = (uint32_t)(esp_timer_get_time() - begin);
+
+    taskENTER_CRITICAL(&lock);
+    stats.frames++;
+    stats.last_us = cost;
+    if (cost > stats.max_us)
+        stats.max_us = cost;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void led_transition_get_stats(led_transition_stats_t *out)
+{
+    taskENTER_CRITICAL(&lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void led_transition_get_config(led_transition_config_t *out)
+{
+    taskENTER_CRITICAL(&lock);
+    *out = config;
+    taskEXIT_CRITICAL(&lock);
+}
+
+esp_err_t led_transition_set_config(const led_transition_config_t *new_config)
+{
+    if (new_config->easing >= LED_EASING_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    taskENTER_CRITICAL(&lock);
+    config = *new_config;
+    taskEXIT_CRITICAL(&lock);
+    return ESP_OK;
+}
+
+void led_transition_load(void)
+{
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") != ESP_OK)
+        return;
+
+    int32_t duration = persistence_manager_get_int(&pm, "fade_ms", CONFIG_LED_TRANSITION_DURATION_MS);
+    int32_t curve = persistence_manager_get_int(&pm, "fade_easing", DEFAULT_EASING);
+    persistence_manager_deinit(&pm);
+
+    if (duration < 0 || duration > UINT16_MAX)
+        duration = CONFIG_LED_TRANSITION_DURATION_MS;
+    if (curve < 0 || curve >= LED_EASING_COUNT)
+        curve = DEFAULT_EASING;
+
+    taskENTER_CRITICAL(&lock);
+    config.duration_ms = (uint16_t)duration;
+    config.easing = (uint8_t)curve;
+    taskEXIT_CRITICAL(&lock);
+
+    ESP_LOGI(TAG, "Transition: %d ms, %s", (int)duration, easing_names[curve]);
+}
+
+void led_transition_save(void)
+{
+    led_transition_config_t copy;
+    led_transition_get_config(&copy);
+
+    persistence_manager_t pm;
+    if (persistence_manager_init(&pm, "led_config") == ESP_OK)
+    {
+        persistence_manager_set_int(&pm, "fade_ms", copy.duration_ms);
+        persistence_manager_set_int(&pm, "fade_easing", copy.easing);
+        persistence_manager_deinit(&pm);
+    }
+}
+
+const char *led_easing_to_string(led_easing_t curve)
+{
+    return curve < LED_EASING_COUNT ? easing_names[curve] : "unknown";
+}
+
+led_easing_t led_easing_from_string(const char *name)
+{
+    for (int i = 0; i < LED_EASING_COUNT; i++)
+    {
+        if (strcmp(name, easing_names[i]) == 0)
+            return (led_easing_t)i;
+    }
+    return LED_EASING_COUNT;
+}
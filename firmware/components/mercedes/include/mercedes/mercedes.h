@@ -43,7 +43,8 @@ struct MenuItemDef
     std::string actionTopic;
     std::string targetScreenId;
     bool persistent = false;
-    std::string valueType; // "string" (default) or "int" or "bool" — controls NVS read/write type
+    std::string valueType; // "string" (default), "int", "float" or "bool", must match the registered setting
+    int setting = -1;      // setting_id_t of a persistent item, resolved when menu.json is loaded
     bool toggleValue = false;
     int selectionIndex = 0;
     std::vector<MenuSelectionItemDef> selectionItems;
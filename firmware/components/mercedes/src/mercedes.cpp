@@ -1,87 +1,99 @@
 #include "mercedes/mercedes.h"
 #include "heimdall/action_manager.h"
 #include "message_manager.h"
-#include "persistence_manager.h"
+#include "settings_registry.h"
 
 #include <cJSON.h>
 #include <cstdlib>
 #include <cstring>
 #include <esp_log.h>
 
-static persistence_manager_t s_pm;
-static bool s_pm_initialized = false;
-
-static void ensure_pm()
-{
-    if (!s_pm_initialized)
-    {
-        s_pm_initialized = (persistence_manager_init(&s_pm, "config") == ESP_OK);
-    }
-}
+static const char *TAG = "Mercedes";
 
 static void post_settings_message(const MenuItemDef &item, const std::string &value)
 {
     if (!item.persistent)
         return;
 
-    message_t msg = {};
-    msg.type = MESSAGE_TYPE_SETTINGS;
-    strncpy(msg.data.settings.key, item.id.c_str(), sizeof(msg.data.settings.key) - 1);
-
-    if (item.valueType == "int")
-    {
-        msg.data.settings.type = SETTINGS_TYPE_INT;
-        msg.data.settings.value.int_value = atoi(value.c_str());
-    }
-    else if (item.valueType == "bool" || item.type == "toggle")
-    {
-        msg.data.settings.type = SETTINGS_TYPE_BOOL;
-        msg.data.settings.value.bool_value = (value == "true");
-    }
-    else
+    setting_id_t id = static_cast<setting_id_t>(item.setting);
+    settings_value_t parsed;
+    switch (settings_registry[id].type)
     {
-        msg.data.settings.type = SETTINGS_TYPE_STRING;
-        strncpy(msg.data.settings.value.string_value, value.c_str(),
-                sizeof(msg.data.settings.value.string_value) - 1);
+    case SETTINGS_TYPE_INT:
+        parsed = settings_int(atoi(value.c_str()));
+        break;
+    case SETTINGS_TYPE_FLOAT:
+        parsed = settings_float(strtof(value.c_str(), nullptr));
+        break;
+    default:
+        parsed = settings_bool(value == "true");
+        break;
     }
-    message_manager_post(&msg, pdMS_TO_TICKS(10));
+    message_manager_post_setting(id, parsed, pdMS_TO_TICKS(10));
 }
 
 static bool nvs_read_item(const MenuItemDef &item, char *buf, size_t bufSize)
 {
     if (!item.persistent)
         return false;
-    ensure_pm();
-    if (!s_pm_initialized)
+
+    setting_id_t id = static_cast<setting_id_t>(item.setting);
+    settings_value_t value;
+    if (!settings_try_get(id, &value))
         return false;
+    switch (settings_registry[id].type)
+    {
+    case SETTINGS_TYPE_INT:
+        snprintf(buf, bufSize, "%d", (int)value.int_value);
+        break;
+    case SETTINGS_TYPE_FLOAT:
+        snprintf(buf, bufSize, "%g", (double)value.float_value);
+        break;
+    default:
+        snprintf(buf, bufSize, "%s", value.bool_value ? "true" : "false");
+        break;
+    }
+    return true;
+}
+
+// Binds a persistent item to its registry entry; an item that is not registered or has another type than its
+// registry entry stays in the menu but is not persisted
+static void resolve_setting(MenuItemDef &item)
+{
+    if (!item.persistent)
+        return;
 
-    if (item.valueType == "int")
+    setting_id_t id = settings_find(item.id.c_str());
+    if (id == SETTING_COUNT)
     {
-        int32_t v = 0;
-        if (nvs_get_i32(s_pm.nvs_handle, item.id.c_str(), &v) != ESP_OK)
-            return false;
-        snprintf(buf, bufSize, "%d", (int)v);
-        return true;
+        ESP_LOGE(TAG, "Persistent item %s is not a registered setting", item.id.c_str());
+        item.persistent = false;
+        return;
     }
-    else if (item.valueType == "bool" || item.type == "toggle")
+
+    // Items without a valueType hold strings, which no setting does
+    bool matches = false;
+    switch (settings_registry[id].type)
     {
-        uint8_t v = 0;
-        if (nvs_get_u8(s_pm.nvs_handle, item.id.c_str(), &v) != ESP_OK)
-            return false;
-        snprintf(buf, bufSize, "%s", v ? "true" : "false");
-        return true;
+    case SETTINGS_TYPE_BOOL:
+        matches = item.valueType == "bool" || (item.valueType.empty() && item.type == "toggle");
+        break;
+    case SETTINGS_TYPE_INT:
+        matches = item.valueType == "int";
+        break;
+    case SETTINGS_TYPE_FLOAT:
+        matches = item.valueType == "float";
+        break;
     }
-    else
+    if (!matches)
     {
-        if (!persistence_manager_has_key(&s_pm, item.id.c_str()))
-            return false;
-        persistence_manager_get_string(&s_pm, item.id.c_str(), buf, bufSize, "");
-        return buf[0] != '\0';
+        ESP_LOGE(TAG, "Persistent item %s has another type than its registered setting", item.id.c_str());
+        item.persistent = false;
+        return;
     }
+    item.setting = id;
 }
 
-static const char *TAG = "Mercedes";
-
 Mercedes &Mercedes::getInstance()
 {
     static Mercedes instance;
@@ -223,6 +235,7 @@ bool Mercedes::buildFromJson(const std::string &jsonPayload)
                         }
                     }
 
+                    resolve_setting(itemDef);
                     screenDef.items.push_back(itemDef);
                 }
             }
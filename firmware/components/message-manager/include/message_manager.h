@@ -1,5 +1,7 @@
 #pragma once
 
+#include "settings_registry.h"
+
 #include <freertos/FreeRTOS.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -14,9 +16,55 @@ extern "C"
     {
         MESSAGE_TYPE_SETTINGS,
         MESSAGE_TYPE_BUTTON,
-        MESSAGE_TYPE_SIMULATION
+        MESSAGE_TYPE_SIMULATION,
+        MESSAGE_TYPE_COUNT
     } message_type_t;
 
+// Bit of a message type in a subscription mask
+#define MESSAGE_MASK(type) (1u << (type))
+#define MESSAGE_MASK_ALL ((1u << MESSAGE_TYPE_COUNT) - 1)
+
+    // Dispatch order: a lane is only served while the lanes above it are empty, except that waiting telemetry
+    // gets a turn after every few messages of the others. Messages within a lane keep their order.
+    typedef enum
+    {
+        MESSAGE_LANE_INTERACTIVE, // button presses
+        MESSAGE_LANE_STATE,       // settings changes
+        MESSAGE_LANE_TELEMETRY,   // simulation updates
+        MESSAGE_LANE_COUNT
+    } message_lane_t;
+
+// Longest inbox of an asynchronous listener
+#define MESSAGE_MAX_INBOX 16
+
+// Entries of the ring message_manager_post_from_isr() writes to
+#define MESSAGE_RING_LENGTH 16
+
+// Listeners that can be subscribed at once
+#define MESSAGE_MAX_LISTENERS 8
+
+// Latency histogram buckets: bucket 0 counts durations below 16 us, bucket i those below 16 << i us and the
+// last one everything longer
+#define MESSAGE_TRACE_BUCKETS 14
+
+    // What a full inbox of an asynchronous listener does with the next message
+    typedef enum
+    {
+        MESSAGE_INBOX_DROP_NEWEST, // the new message is not delivered
+        MESSAGE_INBOX_DROP_OLDEST, // the oldest waiting message is discarded
+        MESSAGE_INBOX_COALESCE,    // a waiting message of the same type (and setting) is replaced even if the
+                                   // inbox is not full; without one the oldest is discarded
+    } message_inbox_policy_t;
+
+    typedef struct
+    {
+        const char *name; // task name
+        uint32_t stack_size;
+        UBaseType_t priority;
+        uint8_t inbox_length; // 1 .. MESSAGE_MAX_INBOX
+        message_inbox_policy_t policy;
+    } message_executor_config_t;
+
     typedef enum
     {
         BUTTON_EVENT_PRESS,
@@ -29,24 +77,11 @@ extern "C"
         uint8_t button_id;
     } button_message_t;
 
-    typedef enum
-    {
-        SETTINGS_TYPE_BOOL,
-        SETTINGS_TYPE_INT,
-        SETTINGS_TYPE_FLOAT,
-        SETTINGS_TYPE_STRING
-    } settings_type_t;
-
+    // New value of a registered setting; its type is the one of the registry entry
     typedef struct
     {
-        settings_type_t type;
-        char key[32];
-        union {
-            bool bool_value;
-            int32_t int_value;
-            float float_value;
-            char string_value[64];
-        } value;
+        setting_id_t id;
+        settings_value_t value;
     } settings_message_t;
 
     typedef struct
@@ -67,13 +102,180 @@ extern "C"
         } data;
     } message_t;
 
+    typedef struct
+    {
+        uint32_t delivered; // listener callbacks made
+        uint32_t avoided;   // callbacks skipped because the subscription did not match
+        uint32_t dropped;   // posts that found no free message slot within their timeout
+        uint32_t inbox_dropped; // messages an asynchronous listener lost to a full inbox
+        uint32_t coalesced;     // inbox messages replaced by a newer one of the same topic
+        uint32_t superseded;    // posts that updated a waiting message of the same topic in place
+        uint32_t ring_dropped;  // message_manager_post_from_isr() calls that found the ring full
+        uint16_t lane_peak[MESSAGE_LANE_COUNT]; // most messages waiting in a lane at once
+    } message_manager_stats_t;
+
+    typedef struct
+    {
+        uint32_t count;
+        uint32_t max_us; // high-water mark
+        uint64_t total_us;
+        uint32_t buckets[MESSAGE_TRACE_BUCKETS];
+    } message_histogram_t;
+
+// Message log of message_manager_record_start(): a message_log_header_t followed by one record per post, a
+// message_log_record_t and `length` bytes of message_t.data. Little endian, the layout of the device.
+#define MESSAGE_LOG_MAGIC 0x474f4c4du // "MLOG"
+#define MESSAGE_LOG_VERSION 2
+
+    typedef struct
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+    } message_log_header_t;
+
+    typedef struct __attribute__((packed))
+    {
+        uint32_t time_us; // since the start of the recording
+        uint8_t type;
+        uint8_t length;
+    } message_log_record_t;
+
+    typedef struct
+    {
+        const uint8_t *log; // valid until the next message_manager_record_start()
+        size_t length;      // bytes recorded
+        size_t capacity;
+        uint32_t records;
+        bool recording;
+        bool full; // stopped because the next record did not fit
+    } message_record_status_t;
+
     // Observer Pattern: Listener-Typ und Registrierungsfunktionen
+    // msg points into the message pool and is only valid during the call. Only the payload of msg->type is
+    // stored, so copy the fields you need, not the whole message_t.
     typedef void (*message_listener_t)(const message_t *msg);
+
+    typedef struct
+    {
+        message_listener_t listener;
+        char name[16];               // executor task name, empty for a listener called by the dispatcher
+        message_histogram_t latency; // post until the listener is called
+        message_histogram_t run;     // duration of the call
+    } message_listener_trace_t;
+
+    // Timings measured with esp_timer since boot. A message updated in place keeps the time of its first post.
+    typedef struct
+    {
+        message_histogram_t wait[MESSAGE_TYPE_COUNT]; // post until the dispatcher takes the message, per type
+        size_t listener_count;
+        message_listener_trace_t listeners[MESSAGE_MAX_LISTENERS]; // subscribed listeners
+    } message_manager_trace_t;
+
+    /**
+     * @brief Registers a listener for a subset of the messages.
+     *
+     * @param types MESSAGE_MASK() bits of the message types the listener receives.
+     * @param settings SETTING_MASK() bits of the settings the listener receives, 0 for all settings. Only applies
+     *        to MESSAGE_TYPE_SETTINGS.
+     * @return false if the listener table is full.
+     */
+    bool message_manager_subscribe(message_listener_t listener, uint32_t types, uint32_t settings);
+
+    /**
+     * @brief Registers a listener for all messages, same as
+     *        message_manager_subscribe(listener, MESSAGE_MASK_ALL, 0).
+     */
     void message_manager_register_listener(message_listener_t listener);
     void message_manager_unregister_listener(message_listener_t listener);
+
+    /**
+     * @brief Runs a subscribed listener in its own task instead of the dispatcher.
+     *
+     * Messages wait in a bounded inbox, so a slow listener only delays itself; config->policy decides what
+     * happens when it cannot keep up. Messages still hold their pool slot while they wait in an inbox.
+     *
+     * @return false if the listener is not subscribed, already asynchronous or the task cannot be created.
+     */
+    bool message_manager_set_executor(message_listener_t listener, const message_executor_config_t *config);
+
+    /**
+     * @brief Moves a message type to another lane, e.g. all into MESSAGE_LANE_STATE for plain FIFO order.
+     *
+     * Messages of the type that are still waiting move along and queue behind those already in the new lane.
+     */
+    void message_manager_set_lane(message_type_t type, message_lane_t lane);
+
+    /**
+     * @brief Makes posts of a type update a waiting message of the same type (for settings: of the same setting)
+     *        in place instead of queueing another one. On by default for MESSAGE_TYPE_SIMULATION.
+     *
+     * Messages queued before coalescing was turned on stay; the next post updates the last of them, so the
+     * listeners still end on the newest value.
+     */
+    void message_manager_set_coalescing(message_type_t type, bool coalesce);
+
+    /**
+     * @brief Returns the dispatch counters.
+     */
+    void message_manager_get_stats(message_manager_stats_t *stats);
+
+    /**
+     * @brief Returns the queue wait and listener timings. The trace of a listener starts when it subscribes.
+     */
+    void message_manager_get_trace(message_manager_trace_t *trace);
+
+    /**
+     * @brief Upper bound of a histogram bucket in microseconds, UINT32_MAX for the last one.
+     */
+    uint32_t message_manager_bucket_limit(size_t bucket);
     void message_manager_init(void);
+
+    /**
+     * @brief Copies the message into a pool slot and queues it for the listeners.
+     *
+     * Only the payload of msg->type is copied. Waits up to timeout for a free slot.
+     *
+     * @return false if the manager is not initialized or no slot became free in time.
+     */
     bool message_manager_post(const message_t *msg, TickType_t timeout);
 
+    /**
+     * @brief Posts the new value of a setting, see message_manager_post(). The value must have the type of the
+     *        registry entry; SETTINGS_POST_BOOL() and friends check that at compile time.
+     */
+    bool message_manager_post_setting(setting_id_t id, settings_value_t value, TickType_t timeout);
+
+// Typed posts by key, e.g. SETTINGS_POST_INT(LIGHT_MODE, 2, timeout); a key of another type does not compile
+#define SETTINGS_POST_BOOL(key, v, timeout)                                                                            \
+    (SETTINGS_CHECK_TYPE(key, BOOL), message_manager_post_setting(SETTING_##key, settings_bool(v), timeout))
+#define SETTINGS_POST_INT(key, v, timeout)                                                                             \
+    (SETTINGS_CHECK_TYPE(key, INT), message_manager_post_setting(SETTING_##key, settings_int(v), timeout))
+#define SETTINGS_POST_FLOAT(key, v, timeout)                                                                           \
+    (SETTINGS_CHECK_TYPE(key, FLOAT), message_manager_post_setting(SETTING_##key, settings_float(v), timeout))
+
+    /**
+     * @brief Starts recording every post into a new log of capacity bytes in RAM, replacing the previous log.
+     *
+     * Records keep the post time and the payload of the message type; the recording stops when the log is full.
+     * message_tool replay runs a downloaded log against the host build.
+     *
+     * @return false if the log cannot be allocated.
+     */
+    bool message_manager_record_start(size_t capacity);
+    void message_manager_record_stop(void);
+    void message_manager_record_status(message_record_status_t *status);
+
+    /**
+     * @brief Posts without blocking or locking, from an ISR, a timer callback or any task.
+     *
+     * The message goes into a lock-free ring of MESSAGE_RING_LENGTH entries that the dispatcher moves into
+     * the lanes before it dispatches the next message.
+     *
+     * @return false if the manager is not initialized or the ring is full.
+     */
+    bool message_manager_post_from_isr(const message_t *msg);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,125 +1,972 @@
 #include "message_manager.h"
-#include "persistence_manager.h"
+#include "settings_registry.h"
 
-#include <esp_app_desc.h>
 #include <esp_log.h>
-#include <esp_mac.h>
-#include <esp_system.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
 #include <sdkconfig.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define MESSAGE_QUEUE_LENGTH 32
-#define MESSAGE_QUEUE_ITEM_SIZE sizeof(message_t)
+// Messages wait in pool slots, linked into the list of their lane; posting copies only the bytes the message
+// type uses
+#define MESSAGE_POOL_LENGTH 32
+// While telemetry waits, it gets its turn after at most this many messages of the higher lanes
+#define TELEMETRY_MAX_SKIPS 8
+
+_Static_assert((MESSAGE_RING_LENGTH & (MESSAGE_RING_LENGTH - 1)) == 0, "ring positions wrap with a mask");
+_Static_assert(MESSAGE_POOL_LENGTH <= 32, "free slots are tracked in a 32 bit mask");
 
 static const char *TAG = "message_manager";
-static QueueHandle_t message_queue = NULL;
+static TaskHandle_t message_task = NULL;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; // protects subscriptions, executors, pools, lanes and stats
+
+typedef struct message_slot
+{
+    struct message_slot *next; // next message in the same lane
+    uint8_t refs;              // dispatcher and executor inboxes holding the slot
+    uint32_t posted_us;        // esp_timer time of the post, wraps after 71 minutes
+    message_t msg;
+} message_slot_t;
+
+typedef struct
+{
+    uint8_t *slots;            // count slots of stride bytes, allocated once in message_manager_init
+    size_t size;               // message bytes per slot
+    size_t stride;
+    uint32_t free;             // bit i set = slot i is free
+    SemaphoreHandle_t counter; // free slots, posters block on it while the pool is empty
+} message_pool_t;
+
+typedef struct
+{
+    message_slot_t *head;
+    message_slot_t *tail;
+    uint16_t depth;
+} message_lane_queue_t;
+
+static message_pool_t message_pool = {.size = sizeof(message_t)};
+static message_lane_queue_t lanes[MESSAGE_LANE_COUNT];
+static uint8_t lane_of_type[MESSAGE_TYPE_COUNT] = {
+    [MESSAGE_TYPE_SETTINGS] = MESSAGE_LANE_STATE,
+    [MESSAGE_TYPE_BUTTON] = MESSAGE_LANE_INTERACTIVE,
+    [MESSAGE_TYPE_SIMULATION] = MESSAGE_LANE_TELEMETRY,
+};
+// Types whose waiting message is updated in place by a newer post instead of queueing another one
+static bool coalesce_type[MESSAGE_TYPE_COUNT] = {
+    [MESSAGE_TYPE_SIMULATION] = true,
+};
+static uint32_t telemetry_skips; // higher lane messages dispatched while telemetry waited, dispatcher only
+
+// Bounded multi-producer ring for posts that must not block or lock. An entry is free for position p while
+// its sequence is p, and readable when it is p + 1; the dispatcher hands it back as p + MESSAGE_RING_LENGTH.
+typedef struct
+{
+    uint32_t sequence;
+    uint32_t posted_us;
+    message_t msg;
+} message_ring_entry_t;
+
+static message_ring_entry_t ring[MESSAGE_RING_LENGTH];
+static uint32_t ring_head;    // next position a producer claims
+static uint32_t ring_tail;    // next position the dispatcher reads, dispatcher only
+static uint32_t ring_dropped; // posts that found the ring full
+static bool ring_stalled;     // the dispatcher left entries in the ring for lack of a pool slot
+
+// Post log, see message_manager_record_start(); protected by the lock
+static uint8_t *record_log;
+static size_t record_length;
+static size_t record_capacity;
+static uint32_t record_count;
+static uint32_t record_start_us;
+static volatile bool recording;
+static bool record_full;
+
+// The log stores message_t.data as it is laid out on the device; the host replay relies on the same layout
+_Static_assert(offsetof(message_t, data) == 4 && sizeof(settings_message_t) == 8, "message log layout");
+_Static_assert(sizeof(simulation_message_t) == 13 && sizeof(button_message_t) == 8, "message log layout");
+
+// Bytes of the message that carry data, the rest of the union is neither copied nor stored
+static size_t message_size(const message_t *msg)
+{
+    switch (msg->type)
+    {
+    case MESSAGE_TYPE_SETTINGS:
+        return offsetof(message_t, data) + sizeof(settings_message_t);
+    case MESSAGE_TYPE_BUTTON:
+        return offsetof(message_t, data) + sizeof(button_message_t);
+    case MESSAGE_TYPE_SIMULATION:
+        return offsetof(message_t, data) + sizeof(simulation_message_t);
+    default:
+        return offsetof(message_t, data);
+    }
+}
+
+// Settings messages must name a registered setting, the dispatcher indexes the registry with the ID
+static bool message_valid(const message_t *msg)
+{
+    if ((unsigned)msg->type >= MESSAGE_TYPE_COUNT)
+        return false;
+    return msg->type != MESSAGE_TYPE_SETTINGS || (unsigned)msg->data.settings.id < SETTING_COUNT;
+}
+
+static bool pool_create(message_pool_t *pool, size_t count)
+{
+    pool->stride = (offsetof(message_slot_t, msg) + pool->size + _Alignof(message_slot_t) - 1) &
+                   ~(_Alignof(message_slot_t) - 1);
+    pool->slots = malloc(pool->stride * count);
+    pool->counter = xSemaphoreCreateCounting(count, count);
+    pool->free = count < 32 ? (1u << count) - 1 : UINT32_MAX;
+    return pool->slots != NULL && pool->counter != NULL;
+}
+
+// Takes a slot; the caller must hold a count of pool->counter
+static message_slot_t *pool_take(message_pool_t *pool)
+{
+    taskENTER_CRITICAL(&lock);
+    int index = __builtin_ctz(pool->free);
+    pool->free &= ~(1u << index);
+    taskEXIT_CRITICAL(&lock);
+    return (message_slot_t *)(pool->slots + index * pool->stride);
+}
+
+static void pool_release(message_slot_t *slot)
+{
+    message_pool_t *pool = &message_pool;
+    int index = (int)(((uint8_t *)slot - pool->slots) / pool->stride);
+
+    taskENTER_CRITICAL(&lock);
+    pool->free |= 1u << index;
+    taskEXIT_CRITICAL(&lock);
+    xSemaphoreGive(pool->counter);
+
+    if (__atomic_exchange_n(&ring_stalled, false, __ATOMIC_SEQ_CST))
+        xTaskNotifyGive(message_task);
+}
+
+static void slot_unref(message_slot_t *slot)
+{
+    taskENTER_CRITICAL(&lock);
+    bool last = --slot->refs == 0;
+    taskEXIT_CRITICAL(&lock);
+    if (last)
+        pool_release(slot);
+}
 
 // Observer Pattern: Listener-Liste
-#define MAX_MESSAGE_LISTENERS 8
-static message_listener_t message_listeners[MAX_MESSAGE_LISTENERS] = {0};
-static size_t message_listener_count = 0;
+// Worker task of an asynchronous listener. The inbox holds references to pool slots, so a message
+// is copied once no matter how many listeners receive it.
+typedef struct
+{
+    message_listener_t listener;
+    TaskHandle_t task;
+    message_inbox_policy_t policy;
+    uint8_t trace;      // index into traces
+    bool closing;       // unsubscribed, the worker releases the inbox and ends
+    uint8_t notifying;  // dispatches between enqueue and notify, the worker waits for them before it ends
+    uint8_t length;
+    uint8_t head;
+    uint8_t count;
+    message_slot_t *inbox[];
+} message_executor_t;
 
-void message_manager_register_listener(message_listener_t listener)
+typedef struct
+{
+    message_listener_t listener;
+    message_executor_t *executor; // NULL = called by the dispatcher
+    uint8_t trace;                // index into traces, stays with the listener while it is subscribed
+    uint32_t types;
+    uint32_t settings; // SETTING_MASK() bits, every setting if 0
+} subscription_t;
+
+static subscription_t subscriptions[MESSAGE_MAX_LISTENERS];
+static size_t subscription_count = 0;
+// Subscriptions per message type, rebuilt on every (un)subscribe so dispatch never looks at the others
+static uint8_t dispatch_lists[MESSAGE_TYPE_COUNT][MESSAGE_MAX_LISTENERS];
+static uint8_t dispatch_counts[MESSAGE_TYPE_COUNT];
+static message_manager_stats_t stats;
+static message_histogram_t wait_traces[MESSAGE_TYPE_COUNT];
+static message_listener_trace_t traces[MESSAGE_MAX_LISTENERS]; // listener NULL = unused
+
+static uint32_t trace_now(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+// Must be called with the lock held
+static void histogram_add(message_histogram_t *histogram, uint32_t us)
 {
-    if (listener && message_listener_count < MAX_MESSAGE_LISTENERS)
+    int bucket = us < 16 ? 0 : 28 - __builtin_clz(us);
+    if (bucket >= MESSAGE_TRACE_BUCKETS)
+        bucket = MESSAGE_TRACE_BUCKETS - 1;
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total_us += us;
+    if (us > histogram->max_us)
+        histogram->max_us = us;
+}
+
+// Must be called with the lock held. The listener may have unsubscribed since the call started.
+static void trace_listener(uint8_t trace, message_listener_t listener, uint32_t latency_us, uint32_t run_us)
+{
+    if (traces[trace].listener != listener)
+        return;
+    histogram_add(&traces[trace].latency, latency_us);
+    histogram_add(&traces[trace].run, run_us);
+}
+
+// Must be called with the lock held
+static void rebuild_dispatch_lists(void)
+{
+    for (int type = 0; type < MESSAGE_TYPE_COUNT; type++)
     {
-        // Doppelte Registrierung vermeiden
-        for (size_t i = 0; i < message_listener_count; ++i)
+        dispatch_counts[type] = 0;
+        for (size_t i = 0; i < subscription_count; i++)
         {
-            if (message_listeners[i] == listener)
-                return;
+            if (subscriptions[i].types & MESSAGE_MASK(type))
+                dispatch_lists[type][dispatch_counts[type]++] = (uint8_t)i;
         }
-        message_listeners[message_listener_count++] = listener;
     }
 }
 
+bool message_manager_subscribe(message_listener_t listener, uint32_t types, uint32_t settings)
+{
+    if (!listener)
+        return false;
+
+    bool ok = true;
+    taskENTER_CRITICAL(&lock);
+    // Doppelte Registrierung ersetzt die bisherige Subscription
+    size_t i = 0;
+    while (i < subscription_count && subscriptions[i].listener != listener)
+        i++;
+    if (i < MESSAGE_MAX_LISTENERS)
+    {
+        subscription_t *subscription = &subscriptions[i];
+        if (i == subscription_count)
+        {
+            // There are as many traces as subscriptions, so a new listener always finds a free one
+            uint8_t trace = 0;
+            while (traces[trace].listener != NULL)
+                trace++;
+            memset(&traces[trace], 0, sizeof(traces[trace]));
+            traces[trace].listener = listener;
+            subscription->trace = trace;
+            subscription->executor = NULL;
+        }
+        subscription->listener = listener;
+        subscription->types = types & MESSAGE_MASK_ALL;
+        subscription->settings = settings;
+        if (i == subscription_count)
+            subscription_count++;
+        rebuild_dispatch_lists();
+    }
+    else
+    {
+        ok = false;
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    if (!ok)
+        ESP_LOGE(TAG, "Listener table full");
+    return ok;
+}
+
+void message_manager_register_listener(message_listener_t listener)
+{
+    message_manager_subscribe(listener, MESSAGE_MASK_ALL, 0);
+}
+
 void message_manager_unregister_listener(message_listener_t listener)
 {
-    for (size_t i = 0; i < message_listener_count; ++i)
+    message_executor_t *executor = NULL;
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < subscription_count; ++i)
     {
-        if (message_listeners[i] == listener)
+        if (subscriptions[i].listener == listener)
         {
+            executor = subscriptions[i].executor;
+            if (executor)
+                executor->closing = true;
+            traces[subscriptions[i].trace].listener = NULL;
             // Nachfolgende Listener nach vorne schieben
-            for (size_t j = i; j < message_listener_count - 1; ++j)
+            for (size_t j = i; j < subscription_count - 1; ++j)
+            {
+                subscriptions[j] = subscriptions[j + 1];
+            }
+            subscription_count--;
+            rebuild_dispatch_lists();
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    if (executor)
+        xTaskNotifyGive(executor->task);
+}
+
+// Two messages are about the same thing if they have the same type and, for settings, the same setting
+static bool same_topic(const message_t *a, const message_t *b)
+{
+    if (a->type != b->type)
+        return false;
+    return a->type != MESSAGE_TYPE_SETTINGS || a->data.settings.id == b->data.settings.id;
+}
+
+// Must be called with the lock held. Returns false if the full inbox refused the slot; *released is set to a
+// slot the caller has to unref after unlocking, or NULL.
+static bool executor_enqueue(message_executor_t *executor, message_slot_t *slot, message_slot_t **released)
+{
+    *released = NULL;
+    if (executor->policy == MESSAGE_INBOX_COALESCE)
+    {
+        for (uint8_t i = 0; i < executor->count; i++)
+        {
+            message_slot_t **pending = &executor->inbox[(executor->head + i) % executor->length];
+            if (same_topic(&(*pending)->msg, &slot->msg))
+            {
+                *released = *pending;
+                *pending = slot;
+                slot->refs++;
+                stats.coalesced++;
+                return true;
+            }
+        }
+    }
+
+    if (executor->count == executor->length)
+    {
+        stats.inbox_dropped++;
+        if (executor->policy == MESSAGE_INBOX_DROP_NEWEST)
+            return false;
+        *released = executor->inbox[executor->head];
+        executor->head = (executor->head + 1) % executor->length;
+        executor->count--;
+    }
+    executor->inbox[(executor->head + executor->count) % executor->length] = slot;
+    executor->count++;
+    slot->refs++;
+    return true;
+}
+
+static message_slot_t *executor_pop(message_executor_t *executor)
+{
+    message_slot_t *slot = NULL;
+    taskENTER_CRITICAL(&lock);
+    if (executor->count > 0)
+    {
+        slot = executor->inbox[executor->head];
+        executor->head = (executor->head + 1) % executor->length;
+        executor->count--;
+    }
+    taskEXIT_CRITICAL(&lock);
+    return slot;
+}
+
+static void executor_task(void *param)
+{
+    message_executor_t *executor = param;
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        message_slot_t *slot;
+        while ((slot = executor_pop(executor)) != NULL)
+        {
+            if (!executor->closing)
             {
-                message_listeners[j] = message_listeners[j + 1];
+                uint32_t start = trace_now();
+                executor->listener(&slot->msg);
+                uint32_t end = trace_now();
+                taskENTER_CRITICAL(&lock);
+                trace_listener(executor->trace, executor->listener, start - slot->posted_us, end - start);
+                taskEXIT_CRITICAL(&lock);
             }
-            message_listeners[--message_listener_count] = NULL;
+            slot_unref(slot);
+        }
+
+        if (executor->closing)
+        {
+            // No new messages after closing, but the dispatcher may be about to notify
+            bool idle = false;
+            while (!idle)
+            {
+                taskENTER_CRITICAL(&lock);
+                idle = executor->notifying == 0;
+                taskEXIT_CRITICAL(&lock);
+                if (!idle)
+                    vTaskDelay(1);
+            }
+            while ((slot = executor_pop(executor)) != NULL)
+                slot_unref(slot);
+            free(executor);
+            vTaskDelete(NULL);
+        }
+    }
+}
+
+bool message_manager_set_executor(message_listener_t listener, const message_executor_config_t *config)
+{
+    if (!listener || !config || config->inbox_length == 0 || config->inbox_length > MESSAGE_MAX_INBOX)
+        return false;
+
+    message_executor_t *executor =
+        calloc(1, sizeof(message_executor_t) + config->inbox_length * sizeof(message_slot_t *));
+    if (!executor)
+        return false;
+    executor->listener = listener;
+    executor->policy = config->policy;
+    executor->length = config->inbox_length;
+
+    // The task waits for its first notification, so it may start before the executor is attached
+    if (xTaskCreate(executor_task, config->name ? config->name : "message_executor", config->stack_size, executor,
+                    config->priority, &executor->task) != pdPASS)
+    {
+        free(executor);
+        return false;
+    }
+
+    bool attached = false;
+    taskENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < subscription_count; i++)
+    {
+        if (subscriptions[i].listener == listener && subscriptions[i].executor == NULL)
+        {
+            subscriptions[i].executor = executor;
+            executor->trace = subscriptions[i].trace;
+            char *name = traces[executor->trace].name;
+            strncpy(name, config->name ? config->name : "message_executor", sizeof(traces[0].name) - 1);
+            name[sizeof(traces[0].name) - 1] = '\0';
+            attached = true;
             break;
         }
     }
+    if (!attached)
+        executor->closing = true;
+    taskEXIT_CRITICAL(&lock);
+
+    if (!attached)
+    {
+        ESP_LOGE(TAG, "Listener is not subscribed or already asynchronous");
+        xTaskNotifyGive(executor->task);
+    }
+    return attached;
+}
+
+void message_manager_get_stats(message_manager_stats_t *out)
+{
+    taskENTER_CRITICAL(&lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&lock);
+    out->ring_dropped = __atomic_load_n(&ring_dropped, __ATOMIC_RELAXED);
+}
+
+void message_manager_get_trace(message_manager_trace_t *out)
+{
+    taskENTER_CRITICAL(&lock);
+    memcpy(out->wait, wait_traces, sizeof(out->wait));
+    out->listener_count = subscription_count;
+    for (size_t i = 0; i < subscription_count; i++)
+    {
+        out->listeners[i] = traces[subscriptions[i].trace];
+    }
+    taskEXIT_CRITICAL(&lock);
+}
+
+bool message_manager_record_start(size_t capacity)
+{
+    if (capacity < sizeof(message_log_header_t))
+        return false;
+    uint8_t *log = malloc(capacity);
+    if (!log)
+        return false;
+    message_log_header_t header = {.magic = MESSAGE_LOG_MAGIC, .version = MESSAGE_LOG_VERSION};
+    memcpy(log, &header, sizeof(header));
+
+    taskENTER_CRITICAL(&lock);
+    uint8_t *previous = record_log;
+    record_log = log;
+    record_length = sizeof(header);
+    record_capacity = capacity;
+    record_count = 0;
+    record_start_us = trace_now();
+    record_full = false;
+    recording = true;
+    taskEXIT_CRITICAL(&lock);
+
+    free(previous);
+    return true;
+}
+
+void message_manager_record_stop(void)
+{
+    taskENTER_CRITICAL(&lock);
+    recording = false;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void message_manager_record_status(message_record_status_t *status)
+{
+    taskENTER_CRITICAL(&lock);
+    status->log = record_log;
+    status->length = record_length;
+    status->capacity = record_capacity;
+    status->records = record_count;
+    status->recording = recording;
+    status->full = record_full;
+    taskEXIT_CRITICAL(&lock);
+}
+
+uint32_t message_manager_bucket_limit(size_t bucket)
+{
+    return bucket + 1 < MESSAGE_TRACE_BUCKETS ? 16u << bucket : UINT32_MAX;
+}
+
+// Calls the synchronous listeners subscribed to the message and queues it for the asynchronous ones. The
+// listeners are copied so a listener may (un)subscribe.
+static void dispatch(message_slot_t *slot)
+{
+    const message_t *msg = &slot->msg;
+    if ((unsigned)msg->type >= MESSAGE_TYPE_COUNT)
+        return;
+
+    message_listener_t targets[MESSAGE_MAX_LISTENERS];
+    uint8_t target_traces[MESSAGE_MAX_LISTENERS];
+    uint32_t run_us[MESSAGE_MAX_LISTENERS];
+    uint32_t latency_us[MESSAGE_MAX_LISTENERS];
+    message_executor_t *executors[MESSAGE_MAX_LISTENERS];
+    message_slot_t *released[MESSAGE_MAX_LISTENERS];
+    size_t target_count = 0;
+    size_t executor_count = 0;
+    size_t released_count = 0;
+    size_t refused_count = 0;
+    uint32_t setting = msg->type == MESSAGE_TYPE_SETTINGS ? 1u << msg->data.settings.id : 0;
+
+    taskENTER_CRITICAL(&lock);
+    const uint8_t *list = dispatch_lists[msg->type];
+    for (size_t i = 0; i < dispatch_counts[msg->type]; i++)
+    {
+        const subscription_t *subscription = &subscriptions[list[i]];
+        if (setting != 0 && subscription->settings != 0 && (subscription->settings & setting) == 0)
+            continue;
+
+        if (subscription->executor == NULL)
+        {
+            target_traces[target_count] = subscription->trace;
+            targets[target_count++] = subscription->listener;
+            continue;
+        }
+        message_slot_t *dropped;
+        bool queued = executor_enqueue(subscription->executor, slot, &dropped);
+        if (dropped)
+            released[released_count++] = dropped;
+        if (!queued)
+        {
+            // Counted in inbox_dropped
+            refused_count++;
+            continue;
+        }
+        subscription->executor->notifying++;
+        executors[executor_count++] = subscription->executor;
+    }
+    stats.delivered += target_count + executor_count;
+    stats.avoided += subscription_count - target_count - executor_count - refused_count;
+    taskEXIT_CRITICAL(&lock);
+
+    for (size_t i = 0; i < executor_count; ++i)
+    {
+        xTaskNotifyGive(executors[i]->task);
+        taskENTER_CRITICAL(&lock);
+        executors[i]->notifying--;
+        taskEXIT_CRITICAL(&lock);
+    }
+    for (size_t i = 0; i < released_count; ++i)
+    {
+        slot_unref(released[i]);
+    }
+    uint32_t start = trace_now();
+    for (size_t i = 0; i < target_count; ++i)
+    {
+        targets[i](msg);
+        uint32_t end = trace_now();
+        latency_us[i] = start - slot->posted_us;
+        run_us[i] = end - start;
+        start = end;
+    }
+    if (target_count > 0)
+    {
+        taskENTER_CRITICAL(&lock);
+        for (size_t i = 0; i < target_count; ++i)
+        {
+            trace_listener(target_traces[i], targets[i], latency_us[i], run_us[i]);
+        }
+        taskEXIT_CRITICAL(&lock);
+    }
+}
+
+// Interactive before state before telemetry, but telemetry is not starved by a steady stream of the others
+static message_slot_t *next_message(void)
+{
+    message_slot_t *slot = NULL;
+
+    taskENTER_CRITICAL(&lock);
+    int lane = 0;
+    if (lanes[MESSAGE_LANE_TELEMETRY].head != NULL && telemetry_skips >= TELEMETRY_MAX_SKIPS)
+        lane = MESSAGE_LANE_TELEMETRY;
+    while (lane < MESSAGE_LANE_COUNT && lanes[lane].head == NULL)
+        lane++;
+    if (lane < MESSAGE_LANE_COUNT)
+    {
+        slot = lanes[lane].head;
+        lanes[lane].head = slot->next;
+        if (lanes[lane].head == NULL)
+            lanes[lane].tail = NULL;
+        lanes[lane].depth--;
+        if ((unsigned)slot->msg.type < MESSAGE_TYPE_COUNT)
+            histogram_add(&wait_traces[slot->msg.type], trace_now() - slot->posted_us);
+
+        if (lane == MESSAGE_LANE_TELEMETRY)
+            telemetry_skips = 0;
+        else if (lanes[MESSAGE_LANE_TELEMETRY].head != NULL)
+            telemetry_skips++;
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    return slot;
+}
+
+// Appends a post to the log; cheap to call while nothing is recorded
+static void record_message(const message_t *msg, size_t size, uint32_t posted_us)
+{
+    if (!recording)
+        return;
+
+    message_log_record_t record = {
+        .time_us = posted_us - record_start_us,
+        .type = (uint8_t)msg->type,
+        .length = (uint8_t)(size - offsetof(message_t, data)),
+    };
+    taskENTER_CRITICAL(&lock);
+    if (recording)
+    {
+        if (record_length + sizeof(record) + record.length <= record_capacity)
+        {
+            memcpy(record_log + record_length, &record, sizeof(record));
+            memcpy(record_log + record_length + sizeof(record), &msg->data, record.length);
+            record_length += sizeof(record) + record.length;
+            record_count++;
+        }
+        else
+        {
+            recording = false;
+            record_full = true;
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+}
+
+// Must be called with the lock held. Returns the last waiting message of the same topic as msg. There is at
+// most one while the type coalesces, but posts queued before coalescing was turned on may still wait; updating
+// the last of them keeps listeners from ending on an older value.
+static message_slot_t *find_pending(const message_lane_queue_t *lane, const message_t *msg)
+{
+    message_slot_t *found = NULL;
+    for (message_slot_t *pending = lane->head; pending != NULL; pending = pending->next)
+    {
+        if (same_topic(&pending->msg, msg))
+            found = pending;
+    }
+    return found;
+}
+
+// Must be called with the lock held
+static bool update_pending(message_slot_t *pending, const message_t *msg, size_t size)
+{
+    if (pending == NULL)
+        return false;
+    memcpy(&pending->msg, msg, size);
+    stats.superseded++;
+    return true;
+}
+
+// Links a filled slot into its lane or, for a coalescing type, copies it into the waiting message of the same
+// topic. Returns true if the slot was linked, i.e. the dispatcher has one more message to take.
+static bool queue_slot(message_slot_t *slot, size_t size)
+{
+    const message_t *msg = &slot->msg;
+    bool linked = true;
+
+    taskENTER_CRITICAL(&lock);
+    message_lane_queue_t *lane = &lanes[lane_of_type[msg->type]];
+    // Another post of the same topic may have come in meanwhile
+    if (coalesce_type[msg->type] && update_pending(find_pending(lane, msg), msg, size))
+    {
+        linked = false;
+    }
+    else
+    {
+        if (lane->tail != NULL)
+            lane->tail->next = slot;
+        else
+            lane->head = slot;
+        lane->tail = slot;
+        lane->depth++;
+        if (lane->depth > stats.lane_peak[lane_of_type[msg->type]])
+            stats.lane_peak[lane_of_type[msg->type]] = lane->depth;
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    if (!linked)
+        slot_unref(slot);
+    return linked;
+}
+
+// Moves the messages posted from ISRs into the lanes; runs in the dispatcher
+static void ring_drain(void)
+{
+    for (;;)
+    {
+        message_ring_entry_t *entry = &ring[ring_tail & (MESSAGE_RING_LENGTH - 1)];
+        if (__atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE) != ring_tail + 1)
+            return; // empty, or the producer of this entry is not done yet
+
+        if (xSemaphoreTake(message_pool.counter, 0) != pdTRUE)
+        {
+            // Every slot waits in a lane or an inbox; the next release wakes the dispatcher again. A slot
+            // released before the flag was set did not see it, so look once more.
+            __atomic_store_n(&ring_stalled, true, __ATOMIC_SEQ_CST);
+            if (xSemaphoreTake(message_pool.counter, 0) != pdTRUE)
+                return;
+        }
+
+        message_slot_t *slot = pool_take(&message_pool);
+        const message_t *msg = &entry->msg;
+        size_t size = message_size(msg);
+        memcpy(&slot->msg, msg, size);
+        slot->next = NULL;
+        slot->refs = 1;
+        slot->posted_us = entry->posted_us;
+        __atomic_store_n(&entry->sequence, ring_tail + MESSAGE_RING_LENGTH, __ATOMIC_RELEASE);
+        ring_tail++;
+
+        record_message(&slot->msg, size, slot->posted_us);
+
+        queue_slot(slot, size);
+    }
 }
 
 static void message_manager_task(void *param)
 {
-    message_t msg;
-    persistence_manager_t pm;
     while (1)
     {
-        if (xQueueReceive(message_queue, &msg, portMAX_DELAY) == pdTRUE)
+        // One notification per post; the lanes are drained completely before waiting again
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (;;)
         {
-            switch (msg.type)
+            // Messages posted from ISRs join their lanes before the next one is picked
+            ring_drain();
+            message_slot_t *slot = next_message();
+            if (slot == NULL)
+                break;
+
+            const message_t *msg = &slot->msg;
+            switch (msg->type)
             {
             case MESSAGE_TYPE_SETTINGS:
-                if (persistence_manager_init(&pm, "config") == ESP_OK)
-                {
-                    switch (msg.data.settings.type)
-                    {
-                    case SETTINGS_TYPE_BOOL:
-                        persistence_manager_set_bool(&pm, msg.data.settings.key, msg.data.settings.value.bool_value);
-                        break;
-                    case SETTINGS_TYPE_INT:
-                        persistence_manager_set_int(&pm, msg.data.settings.key, msg.data.settings.value.int_value);
-                        break;
-                    case SETTINGS_TYPE_FLOAT:
-                        persistence_manager_set_float(&pm, msg.data.settings.key, msg.data.settings.value.float_value);
-                        break;
-                    case SETTINGS_TYPE_STRING:
-                        persistence_manager_set_string(&pm, msg.data.settings.key,
-                                                       msg.data.settings.value.string_value);
-                        break;
-                    }
-                    persistence_manager_deinit(&pm);
-                    ESP_LOGD(TAG, "Setting written: %s", msg.data.settings.key);
-                }
+                // Queued in the write-behind journal; listeners already read the new value, the flash follows
+                settings_set(msg->data.settings.id, msg->data.settings.value);
+                ESP_LOGD(TAG, "Setting queued: %s", settings_registry[msg->data.settings.id].name);
                 break;
             case MESSAGE_TYPE_BUTTON:
-                ESP_LOGD(TAG, "Button event: id=%d, type=%d", msg.data.button.button_id, msg.data.button.event_type);
+                ESP_LOGD(TAG, "Button event: id=%d, type=%d", msg->data.button.button_id, msg->data.button.event_type);
                 break;
             case MESSAGE_TYPE_SIMULATION:
                 /// just logging
-                ESP_LOGD(TAG, "Simulation event: time=%s, color=(%d,%d,%d)", msg.data.simulation.time,
-                         msg.data.simulation.red, msg.data.simulation.green, msg.data.simulation.blue);
+                ESP_LOGD(TAG, "Simulation event: time=%s, color=(%d,%d,%d)", msg->data.simulation.time,
+                         msg->data.simulation.red, msg->data.simulation.green, msg->data.simulation.blue);
+                break;
+            default:
                 break;
             }
             // Observer Pattern: Listener benachrichtigen
-            for (size_t i = 0; i < message_listener_count; ++i)
-            {
-                if (message_listeners[i])
-                {
-                    message_listeners[i](&msg);
-                }
-            }
+            dispatch(slot);
+            slot_unref(slot);
         }
     }
 }
 
 void message_manager_init(void)
 {
-    if (!message_queue)
+    if (!message_task)
+    {
+        if (!pool_create(&message_pool, MESSAGE_POOL_LENGTH))
+        {
+            ESP_LOGE(TAG, "Failed to allocate the message pool");
+            return;
+        }
+        for (uint32_t i = 0; i < MESSAGE_RING_LENGTH; i++)
+        {
+            ring[i].sequence = i;
+        }
+        xTaskCreate(message_manager_task, "message_manager_task", 4096, NULL, 5, &message_task);
+    }
+}
+
+// Must be called with the lock held. Unlinks the waiting messages of a type from a lane and appends them, in
+// order, to another one.
+static void move_waiting(message_lane_queue_t *from, message_lane_queue_t *to, message_type_t type)
+{
+    message_slot_t *previous = NULL;
+    message_slot_t *slot = from->head;
+    while (slot != NULL)
+    {
+        message_slot_t *next = slot->next;
+        if (slot->msg.type == type)
+        {
+            if (previous != NULL)
+                previous->next = next;
+            else
+                from->head = next;
+            if (from->tail == slot)
+                from->tail = previous;
+            from->depth--;
+
+            slot->next = NULL;
+            if (to->tail != NULL)
+                to->tail->next = slot;
+            else
+                to->head = slot;
+            to->tail = slot;
+            to->depth++;
+        }
+        else
+        {
+            previous = slot;
+        }
+        slot = next;
+    }
+}
+
+void message_manager_set_lane(message_type_t type, message_lane_t lane)
+{
+    if ((unsigned)type >= MESSAGE_TYPE_COUNT || (unsigned)lane >= MESSAGE_LANE_COUNT)
+        return;
+
+    taskENTER_CRITICAL(&lock);
+    // Messages already waiting follow the type, so coalescing finds them and the lane depths stay right
+    if (lane_of_type[type] != lane)
     {
-        message_queue = xQueueCreate(MESSAGE_QUEUE_LENGTH, MESSAGE_QUEUE_ITEM_SIZE);
-        xTaskCreate(message_manager_task, "message_manager_task", 4096, NULL, 5, NULL);
+        move_waiting(&lanes[lane_of_type[type]], &lanes[lane], type);
+        if (lanes[lane].depth > stats.lane_peak[lane])
+            stats.lane_peak[lane] = lanes[lane].depth;
+        lane_of_type[type] = (uint8_t)lane;
     }
+    taskEXIT_CRITICAL(&lock);
+}
+
+void message_manager_set_coalescing(message_type_t type, bool coalesce)
+{
+    if ((unsigned)type >= MESSAGE_TYPE_COUNT)
+        return;
+
+    taskENTER_CRITICAL(&lock);
+    coalesce_type[type] = coalesce;
+    taskEXIT_CRITICAL(&lock);
 }
 
 bool message_manager_post(const message_t *msg, TickType_t timeout)
 {
-    if (!message_queue)
+    if (!message_task || !message_valid(msg))
         return false;
     ESP_LOGD(TAG, "Post: type=%d", msg->type);
-    return xQueueSend(message_queue, msg, timeout) == pdTRUE;
+
+    size_t size = message_size(msg);
+    record_message(msg, size, trace_now());
+    bool coalesce = coalesce_type[msg->type];
+    if (coalesce)
+    {
+        // Nothing to allocate while the previous message of this topic is still waiting
+        taskENTER_CRITICAL(&lock);
+        bool updated = update_pending(find_pending(&lanes[lane_of_type[msg->type]], msg), msg, size);
+        taskEXIT_CRITICAL(&lock);
+        if (updated)
+            return true;
+    }
+
+    if (xSemaphoreTake(message_pool.counter, timeout) != pdTRUE)
+    {
+        taskENTER_CRITICAL(&lock);
+        stats.dropped++;
+        taskEXIT_CRITICAL(&lock);
+        return false;
+    }
+
+    message_slot_t *slot = pool_take(&message_pool);
+    memcpy(&slot->msg, msg, size);
+    slot->next = NULL;
+    slot->refs = 1; // the dispatcher's
+    slot->posted_us = trace_now();
+    if (queue_slot(slot, size))
+        xTaskNotifyGive(message_task);
+    return true;
+}
+
+bool message_manager_post_setting(setting_id_t id, settings_value_t value, TickType_t timeout)
+{
+    message_t msg;
+    msg.type = MESSAGE_TYPE_SETTINGS;
+    msg.data.settings.id = id;
+    msg.data.settings.value = value;
+    return message_manager_post(&msg, timeout);
+}
+
+bool message_manager_post_from_isr(const message_t *msg)
+{
+    if (!message_task || !message_valid(msg))
+        return false;
+    size_t size = message_size(msg);
+
+    // Claim a position with a CAS; a full ring is not waited for
+    uint32_t position = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    message_ring_entry_t *entry;
+    for (;;)
+    {
+        entry = &ring[position & (MESSAGE_RING_LENGTH - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE) - position);
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&ring_head, &position, position + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+        {
+            __atomic_fetch_add(&ring_dropped, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+        else
+        {
+            position = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(&entry->msg, msg, size);
+    entry->posted_us = trace_now();
+    __atomic_store_n(&entry->sequence, position + 1, __ATOMIC_RELEASE);
+
+    if (xPortInIsrContext())
+    {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(message_task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+    else
+    {
+        xTaskNotifyGive(message_task);
+    }
+    return true;
 }
@@ -28,6 +28,36 @@ extern "C"
         bool initialized;
     } persistence_manager_t;
 
+    /**
+     * @brief Counters of the value cache, see persistence_manager_get_cache_stats().
+     */
+    typedef struct
+    {
+        /** Reads answered from RAM. */
+        uint32_t hits;
+        /** Reads that went to NVS. */
+        uint32_t misses;
+        /** Keys currently cached. */
+        uint32_t entries;
+    } persistence_manager_cache_stats_t;
+
+    /**
+     * @brief Counters of the write-behind journal, see persistence_manager_get_write_stats().
+     */
+    typedef struct
+    {
+        /** Values written through the persistence manager. */
+        uint32_t writes;
+        /** Values written to NVS by a flush. */
+        uint32_t flash_writes;
+        /** Writes replaced by a newer value of the same key before they reached NVS. */
+        uint32_t saved;
+        /** NVS commits, one per namespace and flush. */
+        uint32_t commits;
+        /** Writes waiting for the next flush. */
+        uint32_t pending;
+    } persistence_manager_write_stats_t;
+
     /**
      * @brief Erases the entire NVS flash (factory reset).
      *
@@ -95,11 +125,31 @@ extern "C"
     /**
      * @brief Save all pending changes to NVS storage.
      *
+     * Writes the journal of every namespace (see persistence_manager_flush()) and commits.
+     *
      * @param pm Pointer to the persistence manager structure.
      * @return true if successful, false otherwise.
      */
     bool persistence_manager_save(persistence_manager_t *pm);
 
+    /**
+     * @brief Writes the pending values of all namespaces to NVS and commits them.
+     *
+     * The set functions only queue their value in RAM. The journal is written in one batch once no write came in
+     * for CONFIG_PERSISTENCE_WRITE_DELAY_MS, at the latest CONFIG_PERSISTENCE_WRITE_MAX_DELAY_MS after the first
+     * pending write, when it is full, and by esp_restart() through a shutdown handler. Reads always return the
+     * newest value. A power loss or crash loses at most the writes of the last CONFIG_PERSISTENCE_WRITE_MAX_DELAY_MS;
+     * call this function where a value has to be on the flash right away.
+     */
+    void persistence_manager_flush(void);
+
+    /**
+     * @brief Returns the counters of the write-behind journal since boot.
+     *
+     * @param stats Receives the counters.
+     */
+    void persistence_manager_get_write_stats(persistence_manager_write_stats_t *stats);
+
     /**
      * @brief Load all data from NVS storage.
      *
@@ -153,6 +203,40 @@ extern "C"
      */
     void persistence_manager_set_string(persistence_manager_t *pm, const char *key, const char *value);
 
+    /**
+     * @brief Get a boolean value for a key, telling a stored value apart from a missing one.
+     *
+     * Bool, int, float, double and string values up to 31 characters are cached in RAM after the first read
+     * and updated by every write through the persistence manager, so repeated reads do not touch NVS. Values
+     * written with the nvs_* functions directly bypass the cache and the journal (see persistence_manager_flush()).
+     *
+     * @param pm Pointer to the persistence manager structure.
+     * @param key Key to retrieve.
+     * @param out_value Receives the value, left unchanged if the key does not exist.
+     * @return true if the key exists, false otherwise.
+     */
+    bool persistence_manager_try_get_bool(const persistence_manager_t *pm, const char *key, bool *out_value);
+
+    /**
+     * @brief Get an integer value for a key, telling a stored value apart from a missing one.
+     *
+     * @param pm Pointer to the persistence manager structure.
+     * @param key Key to retrieve.
+     * @param out_value Receives the value, left unchanged if the key does not exist.
+     * @return true if the key exists, false otherwise.
+     */
+    bool persistence_manager_try_get_int(const persistence_manager_t *pm, const char *key, int32_t *out_value);
+
+    /**
+     * @brief Get a float value for a key, telling a stored value apart from a missing one.
+     *
+     * @param pm Pointer to the persistence manager structure.
+     * @param key Key to retrieve.
+     * @param out_value Receives the value, left unchanged if the key does not exist.
+     * @return true if the key exists, false otherwise.
+     */
+    bool persistence_manager_try_get_float(const persistence_manager_t *pm, const char *key, float *out_value);
+
     /**
      * @brief Get a boolean value for a key from NVS storage.
      *
@@ -205,6 +289,13 @@ extern "C"
     void persistence_manager_get_string(const persistence_manager_t *pm, const char *key, char *out_value,
                                         size_t max_len, const char *default_value);
 
+    /**
+     * @brief Returns the hit and miss counters of the value cache since boot.
+     *
+     * @param stats Receives the counters.
+     */
+    void persistence_manager_get_cache_stats(persistence_manager_cache_stats_t *stats);
+
     /**
      * @brief Set a blob (binary data) value for a key in NVS storage.
      *
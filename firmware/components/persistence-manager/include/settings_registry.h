@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Every setting the firmware persists: X(key, NVS name, namespace, type, default). The code addresses a setting
+// by its setting_id_t SETTING_<key>; the name is only used in NVS and where settings come in as text (menu.json,
+// the JSON API). Names have at most 15 characters, the NVS limit, which settings_registry.c checks.
+#define SETTINGS_REGISTRY(X)                                                                                           \
+    X(LIGHT_ACTIVE, "light_active", "config", BOOL, false)                                                             \
+    X(LIGHT_MODE, "light_mode", "config", INT, 1)                                                                      \
+    X(LIGHT_VARIANT, "light_variant", "config", INT, 1)
+
+    typedef enum
+    {
+        SETTINGS_TYPE_BOOL,
+        SETTINGS_TYPE_INT,
+        SETTINGS_TYPE_FLOAT
+    } settings_type_t;
+
+    typedef enum
+    {
+#define X(key, name, nvs_namespace, type, default_value) SETTING_##key,
+        SETTINGS_REGISTRY(X)
+#undef X
+        SETTING_COUNT
+    } setting_id_t;
+
+    // SETTING_TYPE_OF_<key>, the type of a setting as a constant for SETTINGS_CHECK_TYPE()
+    enum
+    {
+#define X(key, name, nvs_namespace, type, default_value) SETTING_TYPE_OF_##key = SETTINGS_TYPE_##type,
+        SETTINGS_REGISTRY(X)
+#undef X
+    };
+
+// Bit of a setting in a subscription mask, e.g. SETTING_MASK(LIGHT_MODE)
+#define SETTING_MASK(key) (1u << SETTING_##key)
+
+// Does not compile unless the setting has the given type (BOOL, INT or FLOAT)
+#define SETTINGS_CHECK_TYPE(key, type)                                                                                 \
+    ((void)sizeof(char[(int)SETTING_TYPE_OF_##key == (int)SETTINGS_TYPE_##type ? 1 : -1]))
+
+// Typed access by key, e.g. SETTINGS_GET_INT(LIGHT_MODE); an unknown key or one of another type does not compile
+#define SETTINGS_GET_BOOL(key) (SETTINGS_CHECK_TYPE(key, BOOL), settings_get_bool(SETTING_##key))
+#define SETTINGS_GET_INT(key) (SETTINGS_CHECK_TYPE(key, INT), settings_get_int(SETTING_##key))
+#define SETTINGS_GET_FLOAT(key) (SETTINGS_CHECK_TYPE(key, FLOAT), settings_get_float(SETTING_##key))
+#define SETTINGS_SET_BOOL(key, v) (SETTINGS_CHECK_TYPE(key, BOOL), settings_set(SETTING_##key, settings_bool(v)))
+#define SETTINGS_SET_INT(key, v) (SETTINGS_CHECK_TYPE(key, INT), settings_set(SETTING_##key, settings_int(v)))
+#define SETTINGS_SET_FLOAT(key, v) (SETTINGS_CHECK_TYPE(key, FLOAT), settings_set(SETTING_##key, settings_float(v)))
+
+    typedef union {
+        bool bool_value;
+        int32_t int_value;
+        float float_value;
+    } settings_value_t;
+
+    typedef struct
+    {
+        const char *name;          // NVS key and name in menu.json and the API
+        const char *nvs_namespace; // namespace of the persistence manager
+        settings_type_t type;
+        settings_value_t default_value;
+    } setting_def_t;
+
+    extern const setting_def_t settings_registry[SETTING_COUNT];
+
+    static inline settings_value_t settings_bool(bool value)
+    {
+        settings_value_t result;
+        result.int_value = 0;
+        result.bool_value = value;
+        return result;
+    }
+
+    static inline settings_value_t settings_int(int32_t value)
+    {
+        settings_value_t result;
+        result.int_value = value;
+        return result;
+    }
+
+    static inline settings_value_t settings_float(float value)
+    {
+        settings_value_t result;
+        result.float_value = value;
+        return result;
+    }
+
+    /**
+     * @brief Opens the namespaces of all settings. Call once at startup, after nvs_flash_init() and before other
+     *        tasks read or write settings; until then every setting reads as its default and writes are dropped.
+     */
+    void settings_init(void);
+
+    /**
+     * @brief Looks up a setting by its name, for settings that come in as text.
+     *
+     * @return The ID of the setting, SETTING_COUNT if no setting has this name.
+     */
+    setting_id_t settings_find(const char *name);
+
+    /**
+     * @brief Reads a setting of the given type through the persistence manager, the registry default if it is
+     *        not stored. A setting of another type reads as its default and logs an error.
+     */
+    bool settings_get_bool(setting_id_t id);
+    int32_t settings_get_int(setting_id_t id);
+    float settings_get_float(setting_id_t id);
+
+    /**
+     * @brief Reads a setting, telling a stored value apart from a missing one.
+     *
+     * @param value Receives the stored value, or the default if there is none.
+     * @return true if the setting is stored, false otherwise.
+     */
+    bool settings_try_get(setting_id_t id, settings_value_t *value);
+
+    /**
+     * @brief Writes a setting with the type of its registry entry through the persistence manager.
+     */
+    void settings_set(setting_id_t id, settings_value_t value);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,9 +1,18 @@
 #include "persistence_manager.h"
 #include <esp_log.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define TAG "persistence_manager"
 #define PM_MAX_CACHED_HANDLES 8
+#define PM_MAX_CACHED_VALUES 32
+#define PM_CACHED_STRING_SIZE 32
+#define PM_MAX_PENDING_WRITES 16
 
 // NVS handle cache to avoid repeated nvs_open/close operations (performance optimization)
 typedef struct
@@ -52,10 +61,470 @@ static esp_err_t _get_cached_nvs_handle(const char *nvs_namespace, nvs_handle_t
     return ESP_ERR_NO_MEM;
 }
 
+// Typed copy of a value read or written through the persistence manager, so hot keys like "light_mode" are a
+// memory load instead of an NVS lookup. Filled on the first read, updated by every write.
+typedef enum
+{
+    PM_VALUE_BOOL,
+    PM_VALUE_INT,
+    PM_VALUE_FLOAT,
+    PM_VALUE_DOUBLE,
+    PM_VALUE_STRING,
+} pm_value_type_t;
+
+typedef struct
+{
+    nvs_handle_t handle; // one handle per namespace, see nvs_cache
+    uint32_t hash;       // of the key, compared before the key itself
+    char key[16];        // NVS keys have at most 15 characters
+    uint8_t type;        // pm_value_type_t
+    bool present;        // false: the key is not stored with this type, reads return the default
+    uint32_t used;       // stamp of the last access, a full cache replaces the oldest entry
+    union {
+        bool b;
+        int32_t i;
+        float f;
+        double d;
+        char s[PM_CACHED_STRING_SIZE];
+    } value;
+} pm_value_cache_entry_t;
+
+static portMUX_TYPE value_lock = portMUX_INITIALIZER_UNLOCKED; // protects the value cache
+static pm_value_cache_entry_t value_cache[PM_MAX_CACHED_VALUES];
+static size_t value_count;
+static uint32_t value_clock;
+// Bumped by every write: a read that missed only fills in its NVS value if no write happened in between
+static uint32_t value_generation;
+static uint32_t value_hits;
+static uint32_t value_misses;
+
+// FNV-1a of the key; also tells if the key fits into an entry (*length < 16)
+static uint32_t _hash_key(const char *key, size_t *length)
+{
+    uint32_t hash = 2166136261u;
+    const char *c = key;
+    for (; *c; c++)
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+    *length = (size_t)(c - key);
+    return hash;
+}
+
+// Must be called with value_lock held
+static pm_value_cache_entry_t *_find_value(nvs_handle_t handle, uint32_t hash, const char *key)
+{
+    for (size_t i = 0; i < value_count; i++)
+    {
+        if (value_cache[i].hash == hash && value_cache[i].handle == handle && strcmp(value_cache[i].key, key) == 0)
+            return &value_cache[i];
+    }
+    return NULL;
+}
+
+// Must be called with value_lock held; returns the entry of the key, replacing the oldest one if the cache is full
+static pm_value_cache_entry_t *_claim_value(nvs_handle_t handle, uint32_t hash, const char *key)
+{
+    pm_value_cache_entry_t *entry = _find_value(handle, hash, key);
+    if (entry)
+        return entry;
+
+    if (value_count < PM_MAX_CACHED_VALUES)
+    {
+        entry = &value_cache[value_count++];
+    }
+    else
+    {
+        entry = &value_cache[0];
+        for (size_t i = 1; i < value_count; i++)
+        {
+            if ((int32_t)(value_cache[i].used - entry->used) < 0)
+                entry = &value_cache[i];
+        }
+    }
+    entry->handle = handle;
+    entry->hash = hash;
+    strcpy(entry->key, key);
+    return entry;
+}
+
+// Looks the key up in the cache. On a hit, *present tells if the key is stored and value holds it. On a miss,
+// *generation receives the stamp to pass to _fill_value() together with the value read from NVS.
+static bool _get_cached_value(nvs_handle_t handle, const char *key, pm_value_type_t type, void *value, size_t size,
+                              bool *present, uint32_t *generation)
+{
+    size_t length;
+    uint32_t hash = _hash_key(key, &length);
+    if (length >= sizeof(value_cache[0].key))
+    {
+        *generation = 0;
+        return false;
+    }
+
+    bool hit = false;
+    taskENTER_CRITICAL(&value_lock);
+    pm_value_cache_entry_t *entry = _find_value(handle, hash, key);
+    if (entry && entry->type == type)
+    {
+        entry->used = ++value_clock;
+        *present = entry->present;
+        if (entry->present)
+            memcpy(value, &entry->value, size);
+        value_hits++;
+        hit = true;
+    }
+    else
+    {
+        *generation = value_generation;
+        value_misses++;
+    }
+    taskEXIT_CRITICAL(&value_lock);
+    return hit;
+}
+
+// Stores the result of an NVS read, unless a write happened since the miss
+static void _fill_value(nvs_handle_t handle, const char *key, pm_value_type_t type, const void *value, size_t size,
+                        bool present, uint32_t generation)
+{
+    size_t length;
+    uint32_t hash = _hash_key(key, &length);
+    if (length >= sizeof(value_cache[0].key) || size > sizeof(value_cache[0].value))
+        return;
+
+    taskENTER_CRITICAL(&value_lock);
+    if (generation == value_generation)
+    {
+        pm_value_cache_entry_t *entry = _claim_value(handle, hash, key);
+        entry->type = type;
+        entry->present = present;
+        entry->used = ++value_clock;
+        if (present)
+            memcpy(&entry->value, value, size);
+    }
+    taskEXIT_CRITICAL(&value_lock);
+}
+
+// Updates the cache after a write; value NULL forgets the key, e.g. after a failed write or a removal
+static void _store_value(nvs_handle_t handle, const char *key, pm_value_type_t type, const void *value, size_t size)
+{
+    size_t length;
+    uint32_t hash = _hash_key(key, &length);
+    bool cacheable = value && length < sizeof(value_cache[0].key) && size <= sizeof(value_cache[0].value);
+
+    taskENTER_CRITICAL(&value_lock);
+    value_generation++;
+    pm_value_cache_entry_t *entry = cacheable ? _claim_value(handle, hash, key) : _find_value(handle, hash, key);
+    if (entry && cacheable)
+    {
+        entry->type = type;
+        entry->present = true;
+        entry->used = ++value_clock;
+        memcpy(&entry->value, value, size);
+    }
+    else if (entry)
+    {
+        *entry = value_cache[--value_count];
+    }
+    taskEXIT_CRITICAL(&value_lock);
+}
+
+// Forgets every value of a namespace, or of all namespaces for handle 0
+static void _forget_values(nvs_handle_t handle)
+{
+    taskENTER_CRITICAL(&value_lock);
+    value_generation++;
+    for (size_t i = 0; i < value_count;)
+    {
+        if (handle == 0 || value_cache[i].handle == handle)
+            value_cache[i] = value_cache[--value_count];
+        else
+            i++;
+    }
+    taskEXIT_CRITICAL(&value_lock);
+}
+
+// Write-behind journal: writes wait here until no write came in for CONFIG_PERSISTENCE_WRITE_DELAY_MS (at most
+// CONFIG_PERSISTENCE_WRITE_MAX_DELAY_MS after the first one) and then reach NVS in one batch, so a slider drag
+// becomes one flash write per key. Reads see the pending values; esp_restart() flushes them.
+typedef struct
+{
+    nvs_handle_t handle;
+    char key[16];
+    nvs_type_t type; // NVS_TYPE_U8, NVS_TYPE_I32, NVS_TYPE_STR or NVS_TYPE_BLOB (float and double are blobs)
+    size_t length;
+    union {
+        uint8_t bytes[8]; // values up to 8 bytes
+        void *heap;       // copy of longer strings and blobs
+    } data;
+} pm_pending_write_t;
+
+static SemaphoreHandle_t journal_mutex; // protects the journal, held while a flush writes to NVS
+static pm_pending_write_t pending[PM_MAX_PENDING_WRITES];
+static size_t pending_count;
+static TaskHandle_t flush_task;
+static persistence_manager_write_stats_t write_stats;
+static portMUX_TYPE journal_init_lock = portMUX_INITIALIZER_UNLOCKED; // makes the journal be created once
+
+static const void *_pending_data(const pm_pending_write_t *write)
+{
+    return write->length > sizeof(write->data.bytes) ? write->data.heap : write->data.bytes;
+}
+
+static void _free_pending(pm_pending_write_t *write)
+{
+    if (write->length > sizeof(write->data.bytes))
+        free(write->data.heap);
+}
+
+// Must be called with journal_mutex held
+static pm_pending_write_t *_find_pending(nvs_handle_t handle, const char *key)
+{
+    for (size_t i = 0; i < pending_count; i++)
+    {
+        if (pending[i].handle == handle && strcmp(pending[i].key, key) == 0)
+            return &pending[i];
+    }
+    return NULL;
+}
+
+// Must be called with journal_mutex held; writes every pending value to NVS and commits each namespace once
+static void _flush_locked(void)
+{
+    nvs_handle_t committed[PM_MAX_PENDING_WRITES];
+    size_t commit_count = 0;
+
+    for (size_t i = 0; i < pending_count; i++)
+    {
+        pm_pending_write_t *write = &pending[i];
+        const void *data = _pending_data(write);
+        esp_err_t err;
+        switch (write->type)
+        {
+        case NVS_TYPE_U8:
+            err = nvs_set_u8(write->handle, write->key, *(const uint8_t *)data);
+            break;
+        case NVS_TYPE_I32: {
+            int32_t value;
+            memcpy(&value, data, sizeof(value));
+            err = nvs_set_i32(write->handle, write->key, value);
+            break;
+        }
+        case NVS_TYPE_STR:
+            err = nvs_set_str(write->handle, write->key, data);
+            break;
+        default:
+            err = nvs_set_blob(write->handle, write->key, data, write->length);
+            break;
+        }
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to write key '%s': %s", write->key, esp_err_to_name(err));
+            // Reads fall back to what NVS holds
+            _store_value(write->handle, write->key, PM_VALUE_BOOL, NULL, 0);
+        }
+        else
+        {
+            write_stats.flash_writes++;
+        }
+        _free_pending(write);
+
+        size_t c = 0;
+        while (c < commit_count && committed[c] != write->handle)
+            c++;
+        if (c == commit_count)
+            committed[commit_count++] = write->handle;
+    }
+    pending_count = 0;
+
+    for (size_t c = 0; c < commit_count; c++)
+    {
+        esp_err_t err = nvs_commit(committed[c]);
+        if (err != ESP_OK)
+            ESP_LOGE(TAG, "Failed to commit NVS: %s", esp_err_to_name(err));
+        write_stats.commits++;
+    }
+}
+
+// Must be called with journal_mutex held; drops the pending writes of a key, a namespace (key NULL) or of all
+// namespaces (handle 0)
+static void _drop_pending(nvs_handle_t handle, const char *key)
+{
+    for (size_t i = 0; i < pending_count;)
+    {
+        if ((handle == 0 || pending[i].handle == handle) && (!key || strcmp(pending[i].key, key) == 0))
+        {
+            _free_pending(&pending[i]);
+            pending[i] = pending[--pending_count];
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+static void _flush_task(void *arg)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Every further write restarts the quiet period, up to the maximum delay since the first one
+        TickType_t first = xTaskGetTickCount();
+        for (;;)
+        {
+            TickType_t waited = xTaskGetTickCount() - first;
+            TickType_t limit = pdMS_TO_TICKS(CONFIG_PERSISTENCE_WRITE_MAX_DELAY_MS);
+            if (waited >= limit)
+                break;
+            TickType_t quiet = pdMS_TO_TICKS(CONFIG_PERSISTENCE_WRITE_DELAY_MS);
+            if (ulTaskNotifyTake(pdTRUE, quiet < limit - waited ? quiet : limit - waited) == 0)
+                break;
+        }
+        persistence_manager_flush();
+    }
+}
+
+// Creates the journal on first use: its mutex, the flush task and the flush at esp_restart(). Without the task
+// every write goes to NVS at once.
+static void _init_journal(void)
+{
+    taskENTER_CRITICAL(&journal_init_lock);
+    bool first = !journal_mutex;
+    if (first)
+        journal_mutex = xSemaphoreCreateMutex();
+    taskEXIT_CRITICAL(&journal_init_lock);
+    if (!first)
+        return;
+
+    TaskHandle_t task;
+    if (xTaskCreate(_flush_task, "pm_flush", 3072, NULL, tskIDLE_PRIORITY + 1, &task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create the flush task, writes go to NVS at once");
+        task = NULL;
+    }
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    flush_task = task;
+    xSemaphoreGive(journal_mutex);
+    esp_register_shutdown_handler(persistence_manager_flush);
+}
+
+// Queues a write of an NVS value; the value cache must be updated by the caller
+static esp_err_t _queue_write(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t length)
+{
+    if (strlen(key) >= sizeof(pending[0].key))
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    void *copy = NULL;
+    if (length > sizeof(pending[0].data.bytes))
+    {
+        copy = malloc(length);
+        if (!copy)
+            return ESP_ERR_NO_MEM;
+        memcpy(copy, value, length);
+    }
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    write_stats.writes++;
+    pm_pending_write_t *write = _find_pending(handle, key);
+    if (write)
+    {
+        // Replaces a write that never reached the flash
+        _free_pending(write);
+        write_stats.saved++;
+    }
+    else
+    {
+        if (pending_count == PM_MAX_PENDING_WRITES)
+            _flush_locked();
+        write = &pending[pending_count++];
+        write->handle = handle;
+        strcpy(write->key, key);
+    }
+    write->type = type;
+    write->length = length;
+    if (copy)
+        write->data.heap = copy;
+    else
+        memcpy(write->data.bytes, value, length);
+
+    TaskHandle_t task = flush_task;
+    xSemaphoreGive(journal_mutex);
+
+    if (task)
+        xTaskNotifyGive(task);
+    else
+        persistence_manager_flush();
+    return ESP_OK;
+}
+
+// NVS read that sees the pending writes; a pending value of another type reads as missing
+static esp_err_t _read_value(nvs_handle_t handle, const char *key, nvs_type_t type, void *out_value, size_t *length)
+{
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    const pm_pending_write_t *write = _find_pending(handle, key);
+    if (write)
+    {
+        esp_err_t err = ESP_OK;
+        if (write->type != type)
+            err = ESP_ERR_NVS_NOT_FOUND;
+        else if (out_value && *length < write->length)
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        else if (out_value)
+            memcpy(out_value, _pending_data(write), write->length);
+        if (err == ESP_OK)
+            *length = write->length;
+        xSemaphoreGive(journal_mutex);
+        return err;
+    }
+    xSemaphoreGive(journal_mutex);
+
+    switch (type)
+    {
+    case NVS_TYPE_U8:
+        return nvs_get_u8(handle, key, out_value);
+    case NVS_TYPE_I32:
+        return nvs_get_i32(handle, key, out_value);
+    case NVS_TYPE_STR:
+        return nvs_get_str(handle, key, out_value, length);
+    default:
+        return nvs_get_blob(handle, key, out_value, length);
+    }
+}
+
+void persistence_manager_flush(void)
+{
+    _init_journal();
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    _flush_locked();
+    xSemaphoreGive(journal_mutex);
+}
+
+void persistence_manager_get_write_stats(persistence_manager_write_stats_t *stats)
+{
+    _init_journal();
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    *stats = write_stats;
+    stats->pending = pending_count;
+    xSemaphoreGive(journal_mutex);
+}
+
+void persistence_manager_get_cache_stats(persistence_manager_cache_stats_t *stats)
+{
+    taskENTER_CRITICAL(&value_lock);
+    stats->hits = value_hits;
+    stats->misses = value_misses;
+    stats->entries = value_count;
+    taskEXIT_CRITICAL(&value_lock);
+}
+
 esp_err_t persistence_manager_factory_reset(void)
 {
-    // Erase the entire NVS flash (factory reset)
+    // Erase the entire NVS flash (factory reset), pending writes must not come back at the next flush
+    _init_journal();
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    _drop_pending(0, NULL);
     esp_err_t err = nvs_flash_erase();
+    _forget_values(0);
+    xSemaphoreGive(journal_mutex);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Factory reset failed: %s", esp_err_to_name(err));
@@ -68,6 +537,8 @@ esp_err_t persistence_manager_init(persistence_manager_t *pm, const char *nvs_na
     if (!pm)
         return ESP_ERR_INVALID_ARG;
 
+    _init_journal();
+
     strncpy(pm->nvs_namespace, nvs_namespace ? nvs_namespace : "config", sizeof(pm->nvs_namespace) - 1);
     pm->nvs_namespace[sizeof(pm->nvs_namespace) - 1] = '\0';
     pm->initialized = false;
@@ -107,7 +578,7 @@ bool persistence_manager_has_key(const persistence_manager_t *pm, const char *ke
     if (!persistence_manager_is_initialized(pm))
         return false;
     size_t required_size = 0;
-    esp_err_t err = nvs_get_blob(pm->nvs_handle, key, NULL, &required_size);
+    esp_err_t err = _read_value(pm->nvs_handle, key, NVS_TYPE_BLOB, NULL, &required_size);
     return err == ESP_OK;
 }
 
@@ -115,7 +586,11 @@ void persistence_manager_remove_key(persistence_manager_t *pm, const char *key)
 {
     if (!persistence_manager_is_initialized(pm))
         return;
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    _drop_pending(pm->nvs_handle, key);
     esp_err_t err = nvs_erase_key(pm->nvs_handle, key);
+    _store_value(pm->nvs_handle, key, PM_VALUE_BOOL, NULL, 0);
+    xSemaphoreGive(journal_mutex);
     if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
     {
         ESP_LOGE(TAG, "Failed to remove key '%s': %s", key, esp_err_to_name(err));
@@ -126,7 +601,11 @@ void persistence_manager_clear(persistence_manager_t *pm)
 {
     if (!persistence_manager_is_initialized(pm))
         return;
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    _drop_pending(pm->nvs_handle, NULL);
     esp_err_t err = nvs_erase_all(pm->nvs_handle);
+    _forget_values(pm->nvs_handle);
+    xSemaphoreGive(journal_mutex);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to clear all keys: %s", esp_err_to_name(err));
@@ -137,6 +616,8 @@ size_t persistence_manager_get_key_count(const persistence_manager_t *pm)
 {
     if (!persistence_manager_is_initialized(pm))
         return 0;
+    // New keys may still wait in the journal
+    persistence_manager_flush();
     nvs_iterator_t it = NULL;
     esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, pm->nvs_namespace, NVS_TYPE_ANY, &it);
     if (err != ESP_OK || it == NULL)
@@ -157,6 +638,7 @@ bool persistence_manager_save(persistence_manager_t *pm)
 {
     if (!persistence_manager_is_initialized(pm))
         return false;
+    persistence_manager_flush();
     esp_err_t err = nvs_commit(pm->nvs_handle);
     if (err != ESP_OK)
     {
@@ -176,7 +658,8 @@ void persistence_manager_set_bool(persistence_manager_t *pm, const char *key, bo
     if (!persistence_manager_is_initialized(pm))
         return;
     uint8_t val = value ? 1 : 0;
-    esp_err_t err = nvs_set_u8(pm->nvs_handle, key, val);
+    esp_err_t err = _queue_write(pm->nvs_handle, key, NVS_TYPE_U8, &val, sizeof(val));
+    _store_value(pm->nvs_handle, key, PM_VALUE_BOOL, err == ESP_OK ? &value : NULL, sizeof(value));
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to set bool key '%s': %s", key, esp_err_to_name(err));
@@ -187,7 +670,8 @@ void persistence_manager_set_int(persistence_manager_t *pm, const char *key, int
 {
     if (!persistence_manager_is_initialized(pm))
         return;
-    esp_err_t err = nvs_set_i32(pm->nvs_handle, key, value);
+    esp_err_t err = _queue_write(pm->nvs_handle, key, NVS_TYPE_I32, &value, sizeof(value));
+    _store_value(pm->nvs_handle, key, PM_VALUE_INT, err == ESP_OK ? &value : NULL, sizeof(value));
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to set int key '%s': %s", key, esp_err_to_name(err));
@@ -198,7 +682,8 @@ void persistence_manager_set_float(persistence_manager_t *pm, const char *key, f
 {
     if (!persistence_manager_is_initialized(pm))
         return;
-    esp_err_t err = nvs_set_blob(pm->nvs_handle, key, &value, sizeof(float));
+    esp_err_t err = _queue_write(pm->nvs_handle, key, NVS_TYPE_BLOB, &value, sizeof(float));
+    _store_value(pm->nvs_handle, key, PM_VALUE_FLOAT, err == ESP_OK ? &value : NULL, sizeof(value));
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to set float key '%s': %s", key, esp_err_to_name(err));
@@ -209,7 +694,8 @@ void persistence_manager_set_double(persistence_manager_t *pm, const char *key,
 {
     if (!persistence_manager_is_initialized(pm))
         return;
-    esp_err_t err = nvs_set_blob(pm->nvs_handle, key, &value, sizeof(double));
+    esp_err_t err = _queue_write(pm->nvs_handle, key, NVS_TYPE_BLOB, &value, sizeof(double));
+    _store_value(pm->nvs_handle, key, PM_VALUE_DOUBLE, err == ESP_OK ? &value : NULL, sizeof(value));
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to set double key '%s': %s", key, esp_err_to_name(err));
@@ -220,7 +706,8 @@ void persistence_manager_set_string(persistence_manager_t *pm, const char *key,
 {
     if (!persistence_manager_is_initialized(pm))
         return;
-    esp_err_t err = nvs_set_str(pm->nvs_handle, key, value);
+    esp_err_t err = _queue_write(pm->nvs_handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+    _store_value(pm->nvs_handle, key, PM_VALUE_STRING, err == ESP_OK ? value : NULL, strlen(value) + 1);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to set string key '%s': %s", key, esp_err_to_name(err));
@@ -231,44 +718,89 @@ void persistence_manager_set_blob(persistence_manager_t *pm, const char *key, co
 {
     if (!persistence_manager_is_initialized(pm) || !value || length == 0)
         return;
-    esp_err_t err = nvs_set_blob(pm->nvs_handle, key, value, length);
+    esp_err_t err = _queue_write(pm->nvs_handle, key, NVS_TYPE_BLOB, value, length);
+    _store_value(pm->nvs_handle, key, PM_VALUE_BOOL, NULL, 0);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to set blob key '%s': %s", key, esp_err_to_name(err));
     }
 }
 
-bool persistence_manager_get_bool(const persistence_manager_t *pm, const char *key, bool default_value)
+bool persistence_manager_try_get_bool(const persistence_manager_t *pm, const char *key, bool *out_value)
 {
     if (!persistence_manager_is_initialized(pm))
-        return default_value;
-    uint8_t value;
-    esp_err_t err = nvs_get_u8(pm->nvs_handle, key, &value);
-    if (err != ESP_OK)
-        return default_value;
-    return value != 0;
+        return false;
+    bool value;
+    bool present;
+    uint32_t generation;
+    if (!_get_cached_value(pm->nvs_handle, key, PM_VALUE_BOOL, &value, sizeof(value), &present, &generation))
+    {
+        uint8_t stored;
+        size_t length = sizeof(stored);
+        present = _read_value(pm->nvs_handle, key, NVS_TYPE_U8, &stored, &length) == ESP_OK;
+        value = present && stored != 0;
+        _fill_value(pm->nvs_handle, key, PM_VALUE_BOOL, &value, sizeof(value), present, generation);
+    }
+    if (present)
+        *out_value = value;
+    return present;
 }
 
-int32_t persistence_manager_get_int(const persistence_manager_t *pm, const char *key, int32_t default_value)
+bool persistence_manager_try_get_int(const persistence_manager_t *pm, const char *key, int32_t *out_value)
 {
     if (!persistence_manager_is_initialized(pm))
-        return default_value;
-    int32_t value;
-    esp_err_t err = nvs_get_i32(pm->nvs_handle, key, &value);
-    if (err != ESP_OK)
-        return default_value;
+        return false;
+    int32_t value = 0;
+    bool present;
+    uint32_t generation;
+    if (!_get_cached_value(pm->nvs_handle, key, PM_VALUE_INT, &value, sizeof(value), &present, &generation))
+    {
+        size_t length = sizeof(value);
+        present = _read_value(pm->nvs_handle, key, NVS_TYPE_I32, &value, &length) == ESP_OK;
+        _fill_value(pm->nvs_handle, key, PM_VALUE_INT, &value, sizeof(value), present, generation);
+    }
+    if (present)
+        *out_value = value;
+    return present;
+}
+
+bool persistence_manager_try_get_float(const persistence_manager_t *pm, const char *key, float *out_value)
+{
+    if (!persistence_manager_is_initialized(pm))
+        return false;
+    float value = 0;
+    bool present;
+    uint32_t generation;
+    if (!_get_cached_value(pm->nvs_handle, key, PM_VALUE_FLOAT, &value, sizeof(value), &present, &generation))
+    {
+        size_t required_size = sizeof(float);
+        esp_err_t err = _read_value(pm->nvs_handle, key, NVS_TYPE_BLOB, &value, &required_size);
+        present = err == ESP_OK && required_size == sizeof(float);
+        _fill_value(pm->nvs_handle, key, PM_VALUE_FLOAT, &value, sizeof(value), present, generation);
+    }
+    if (present)
+        *out_value = value;
+    return present;
+}
+
+bool persistence_manager_get_bool(const persistence_manager_t *pm, const char *key, bool default_value)
+{
+    bool value = default_value;
+    persistence_manager_try_get_bool(pm, key, &value);
+    return value;
+}
+
+int32_t persistence_manager_get_int(const persistence_manager_t *pm, const char *key, int32_t default_value)
+{
+    int32_t value = default_value;
+    persistence_manager_try_get_int(pm, key, &value);
     return value;
 }
 
 float persistence_manager_get_float(const persistence_manager_t *pm, const char *key, float default_value)
 {
-    if (!persistence_manager_is_initialized(pm))
-        return default_value;
-    float value;
-    size_t required_size = sizeof(float);
-    esp_err_t err = nvs_get_blob(pm->nvs_handle, key, &value, &required_size);
-    if (err != ESP_OK || required_size != sizeof(float))
-        return default_value;
+    float value = default_value;
+    persistence_manager_try_get_float(pm, key, &value);
     return value;
 }
 
@@ -276,12 +808,17 @@ double persistence_manager_get_double(const persistence_manager_t *pm, const cha
 {
     if (!persistence_manager_is_initialized(pm))
         return default_value;
-    double value;
-    size_t required_size = sizeof(double);
-    esp_err_t err = nvs_get_blob(pm->nvs_handle, key, &value, &required_size);
-    if (err != ESP_OK || required_size != sizeof(double))
-        return default_value;
-    return value;
+    double value = 0;
+    bool present;
+    uint32_t generation;
+    if (!_get_cached_value(pm->nvs_handle, key, PM_VALUE_DOUBLE, &value, sizeof(value), &present, &generation))
+    {
+        size_t required_size = sizeof(double);
+        esp_err_t err = _read_value(pm->nvs_handle, key, NVS_TYPE_BLOB, &value, &required_size);
+        present = err == ESP_OK && required_size == sizeof(double);
+        _fill_value(pm->nvs_handle, key, PM_VALUE_DOUBLE, &value, sizeof(value), present, generation);
+    }
+    return present ? value : default_value;
 }
 
 void persistence_manager_get_string(const persistence_manager_t *pm, const char *key, char *out_value, size_t max_len,
@@ -293,21 +830,46 @@ void persistence_manager_get_string(const persistence_manager_t *pm, const char
         out_value[max_len - 1] = '\0';
         return;
     }
+
+    char cached[PM_CACHED_STRING_SIZE];
+    bool present;
+    uint32_t generation;
+    if (_get_cached_value(pm->nvs_handle, key, PM_VALUE_STRING, cached, sizeof(cached), &present, &generation))
+    {
+        if (present && strlen(cached) < max_len)
+            strcpy(out_value, cached);
+        else
+        {
+            strncpy(out_value, default_value, max_len - 1);
+            out_value[max_len - 1] = '\0';
+        }
+        return;
+    }
+
     size_t required_size = 0;
-    esp_err_t err = nvs_get_str(pm->nvs_handle, key, NULL, &required_size);
-    if (err != ESP_OK || required_size == 0 || required_size > max_len)
+    esp_err_t err = _read_value(pm->nvs_handle, key, NVS_TYPE_STR, NULL, &required_size);
+    if (err != ESP_OK || required_size == 0)
+    {
+        _fill_value(pm->nvs_handle, key, PM_VALUE_STRING, NULL, 0, false, generation);
+        strncpy(out_value, default_value, max_len - 1);
+        out_value[max_len - 1] = '\0';
+        return;
+    }
+    if (required_size > max_len)
     {
         strncpy(out_value, default_value, max_len - 1);
         out_value[max_len - 1] = '\0';
         return;
     }
-    err = nvs_get_str(pm->nvs_handle, key, out_value, &required_size);
+    err = _read_value(pm->nvs_handle, key, NVS_TYPE_STR, out_value, &required_size);
     if (err != ESP_OK)
     {
         strncpy(out_value, default_value, max_len - 1);
         out_value[max_len - 1] = '\0';
         return;
     }
+    // Longer strings are not cached, they are read from NVS every time
+    _fill_value(pm->nvs_handle, key, PM_VALUE_STRING, out_value, required_size, true, generation);
 }
 
 bool persistence_manager_get_blob(const persistence_manager_t *pm, const char *key, void *out_value, size_t max_length,
@@ -316,10 +878,10 @@ bool persistence_manager_get_blob(const persistence_manager_t *pm, const char *k
     if (!persistence_manager_is_initialized(pm) || !out_value || max_length == 0)
         return false;
     size_t required_size = 0;
-    esp_err_t err = nvs_get_blob(pm->nvs_handle, key, NULL, &required_size);
+    esp_err_t err = _read_value(pm->nvs_handle, key, NVS_TYPE_BLOB, NULL, &required_size);
     if (err != ESP_OK || required_size == 0 || required_size > max_length)
         return false;
-    err = nvs_get_blob(pm->nvs_handle, key, out_value, &required_size);
+    err = _read_value(pm->nvs_handle, key, NVS_TYPE_BLOB, out_value, &required_size);
     if (err != ESP_OK)
         return false;
     if (out_length)
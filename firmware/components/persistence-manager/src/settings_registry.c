@@ -0,0 +1,142 @@
+#include "settings_registry.h"
+#include "persistence_manager.h"
+
+#include <esp_log.h>
+#include <string.h>
+
+#define TAG "settings_registry"
+
+// Member of settings_value_t that holds a value of the type
+#define SETTINGS_MEMBER_BOOL bool_value
+#define SETTINGS_MEMBER_INT int_value
+#define SETTINGS_MEMBER_FLOAT float_value
+
+_Static_assert(SETTING_COUNT <= 32, "subscriptions filter settings with a 32 bit mask");
+
+#define X(key, name, nvs_namespace, type, default_value)                                                               \
+    _Static_assert(sizeof(name) <= 16, "NVS key " name " is longer than 15 characters");                               \
+    _Static_assert(sizeof(nvs_namespace) <= 16, "NVS namespace " nvs_namespace " is longer than 15 characters");
+SETTINGS_REGISTRY(X)
+#undef X
+
+const setting_def_t settings_registry[SETTING_COUNT] = {
+#define X(key, name, nvs_namespace, type, default_value)                                                               \
+    [SETTING_##key] = {name, nvs_namespace, SETTINGS_TYPE_##type, {.SETTINGS_MEMBER_##type = (default_value)}},
+    SETTINGS_REGISTRY(X)
+#undef X
+};
+
+setting_id_t settings_find(const char *name)
+{
+    for (int id = 0; name && id < SETTING_COUNT; id++)
+    {
+        if (strcmp(settings_registry[id].name, name) == 0)
+            return (setting_id_t)id;
+    }
+    return SETTING_COUNT;
+}
+
+// Namespace of each setting, opened by settings_init() before other tasks use the settings. NVS handles stay
+// open, so the managers are never deinitialized and later reads need no lock.
+static persistence_manager_t managers[SETTING_COUNT];
+
+void settings_init(void)
+{
+    for (int id = 0; id < SETTING_COUNT; id++)
+    {
+        if (!managers[id].initialized &&
+            persistence_manager_init(&managers[id], settings_registry[id].nvs_namespace) != ESP_OK)
+            ESP_LOGE(TAG, "Failed to open namespace %s of setting %s", settings_registry[id].nvs_namespace,
+                     settings_registry[id].name);
+    }
+}
+
+// Returns the manager of the setting, NULL for an unknown ID or one whose namespace is not open
+static persistence_manager_t *_open(setting_id_t id)
+{
+    if ((unsigned)id >= SETTING_COUNT)
+    {
+        ESP_LOGE(TAG, "Unknown setting %d", (int)id);
+        return NULL;
+    }
+    if (!managers[id].initialized)
+    {
+        ESP_LOGE(TAG, "Setting %s used before settings_init()", settings_registry[id].name);
+        return NULL;
+    }
+    return &managers[id];
+}
+
+// Stored value or default of a setting read as type; a setting of another type reads as its default
+static settings_value_t _get(setting_id_t id, settings_type_t type)
+{
+    if ((unsigned)id >= SETTING_COUNT)
+    {
+        ESP_LOGE(TAG, "Unknown setting %d", (int)id);
+        return settings_int(0);
+    }
+    settings_value_t value = settings_registry[id].default_value;
+    if (settings_registry[id].type != type)
+        ESP_LOGE(TAG, "Setting %s read with the wrong type", settings_registry[id].name);
+    else
+        settings_try_get(id, &value);
+    return value;
+}
+
+bool settings_get_bool(setting_id_t id)
+{
+    return _get(id, SETTINGS_TYPE_BOOL).bool_value;
+}
+
+int32_t settings_get_int(setting_id_t id)
+{
+    return _get(id, SETTINGS_TYPE_INT).int_value;
+}
+
+float settings_get_float(setting_id_t id)
+{
+    return _get(id, SETTINGS_TYPE_FLOAT).float_value;
+}
+
+bool settings_try_get(setting_id_t id, settings_value_t *value)
+{
+    persistence_manager_t *pm = _open(id);
+    if (!pm)
+        return false;
+    const setting_def_t *def = &settings_registry[id];
+    *value = def->default_value;
+    bool found = false;
+    switch (def->type)
+    {
+    case SETTINGS_TYPE_BOOL:
+        found = persistence_manager_try_get_bool(pm, def->name, &value->bool_value);
+        break;
+    case SETTINGS_TYPE_INT:
+        found = persistence_manager_try_get_int(pm, def->name, &value->int_value);
+        break;
+    case SETTINGS_TYPE_FLOAT:
+        found = persistence_manager_try_get_float(pm, def->name, &value->float_value);
+        break;
+    }
+    return found;
+}
+
+void settings_set(setting_id_t id, settings_value_t value)
+{
+    persistence_manager_t *pm = _open(id);
+    if (!pm)
+        return;
+    const setting_def_t *def = &settings_registry[id];
+    switch (def->type)
+    {
+    case SETTINGS_TYPE_BOOL:
+        persistence_manager_set_bool(pm, def->name, value.bool_value);
+        break;
+    case SETTINGS_TYPE_INT:
+        persistence_manager_set_int(pm, def->name, value.int_value);
+        break;
+    case SETTINGS_TYPE_FLOAT:
+        persistence_manager_set_float(pm, def->name, value.float_value);
+        break;
+    }
+}
@@ -24,6 +24,13 @@ extern "C"
     void stop_simulation_task(void);
     void start_simulation_with_reload(bool force_reload);
     void start_simulation(void);
+    bool simulation_task_running(void);
+
+    /**
+     * @brief Restarts the simulation whenever LIGHT_ACTIVE, LIGHT_MODE or LIGHT_VARIANT changes. The
+     *        listener runs on its own "app_settings" executor, a schema reload does not hold up the dispatcher.
+     */
+    void simulator_subscribe_settings(void);
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
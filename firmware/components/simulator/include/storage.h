@@ -1,6 +1,7 @@
 #pragma once
 
 #include <esp_err.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -18,6 +19,14 @@ extern "C"
      * @return ESP_OK on success, error code otherwise
      */
     esp_err_t write_lines(const char *filename, char **lines, int count);
+    /**
+     * Open a file in the storage partition for binary access.
+     * @param filename File name (without /spiffs/)
+     * @param mode fopen() mode
+     * @return File handle or NULL
+     */
+    FILE *storage_open(const char *filename, const char *mode);
+    esp_err_t storage_remove(const char *filename);
 #ifdef __cplusplus
 }
 #endif
@@ -2,7 +2,7 @@
 #include "color.h"
 #include "led_strip_ws2812.h"
 #include "message_manager.h"
-#include "persistence_manager.h"
+#include "settings_registry.h"
 #include "storage.h"
 
 #include <esp_heap_caps.h>
@@ -11,6 +11,7 @@
 #include <freertos/semphr.h>
 #include <freertos/task.h>
 #include <math.h>
+#include <sdkconfig.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -72,7 +73,7 @@ static bool ensure_mutex_initialized(void)
 }
 
 // Main interpolation function that selects the appropriate method
-static rgb_t interpolate_color(rgb_t start, rgb_t end, float factor)
+static rgb_t interpolate_color(rgb_t start, rgb_t end, color_fract_t factor)
 {
     switch (interpolation_mode)
     {
@@ -98,19 +99,26 @@ esp_err_t add_light_item(const char time[5], uint8_t red, uint8_t green, uint8_t
 
     rgb_t color = {.red = red, .green = green, .blue = blue};
 
+    // The white column adds the white LED color on top; the output stage of an RGBW strip moves it back
+    // to the white LED, an RGB strip mixes it from the color channels
+    if (white > 0)
+    {
+        color = color_add(color, color_scale(color_from_kelvin(CONFIG_LED_STRIP_WHITE_KELVIN), white));
+    }
+
     if (saturation < 255)
     {
         hsv_t hsv = rgb_to_hsv(color);
-        hsv.s = hsv.s * (saturation / 255.0f);
+        hsv.s = (uint8_t)color_div255(hsv.s * saturation);
         // color = hsv_to_rgb(hsv);
     }
 
-    float brightness_factor = brightness / 255.0f;
+    color = color_scale(color, brightness);
 
     memcpy(new_node->time, time, sizeof(new_node->time));
-    new_node->red = (uint8_t)(color.red * brightness_factor);
-    new_node->green = (uint8_t)(color.green * brightness_factor);
-    new_node->blue = (uint8_t)(color.blue * brightness_factor);
+    new_node->red = color.red;
+    new_node->green = color.green;
+    new_node->blue = color.blue;
     new_node->next = NULL;
 
     // Insert sorted: find the correct position
@@ -155,10 +163,7 @@ void cleanup_light_items(void)
 static void initialize_light_items(bool force_reload)
 {
     static char filename[30];
-    persistence_manager_t persistence;
-    persistence_manager_init(&persistence, "config");
-    int variant = persistence_manager_get_int(&persistence, "light_variant", 1);
-    persistence_manager_deinit(&persistence);
+    int variant = SETTINGS_GET_INT(LIGHT_VARIANT);
 
     bool variant_changed = (loaded_variant != variant);
     bool needs_reload = force_reload || !schema_loaded || variant_changed;
@@ -346,7 +351,7 @@ void simulate_cycle(void *args)
                     interval = 1;
                 }
 
-                float factor = (float)minutes_since_current / (float)interval;
+                color_fract_t factor = color_fract_from_ratio(minutes_since_current, interval);
 
                 rgb_t start_rgb = {.red = current_item->red, .green = current_item->green, .blue = current_item->blue};
                 rgb_t end_rgb = {.red = next_item->red, .green = next_item->green, .blue = next_item->blue};
@@ -427,11 +432,9 @@ void start_simulation_with_reload(bool force_reload)
 {
     stop_simulation_task();
 
-    persistence_manager_t persistence;
-    persistence_manager_init(&persistence, "config");
-    if (persistence_manager_get_bool(&persistence, "light_active", false))
+    if (SETTINGS_GET_BOOL(LIGHT_ACTIVE))
     {
-        int mode = persistence_manager_get_int(&persistence, "light_mode", 0);
+        int mode = SETTINGS_GET_INT(LIGHT_MODE);
         switch (mode)
         {
         case 0: // Simulation mode
@@ -456,10 +459,54 @@ void start_simulation_with_reload(bool force_reload)
     {
         led_strip_update(LED_STATE_OFF, rgb_t{});
     }
-    persistence_manager_deinit(&persistence);
 }
 
 void start_simulation(void)
 {
     start_simulation_with_reload(true);
 }
+
+bool simulation_task_running(void)
+{
+    if (!ensure_mutex_initialized())
+        return false;
+    xSemaphoreTake(simulation_mutex, portMAX_DELAY);
+    bool running = simulation_task_handle != NULL;
+    xSemaphoreGive(simulation_mutex);
+    return running;
+}
+
+// Restarts the simulation for the new light settings; runs on the app_settings executor
+static void on_light_setting(const message_t *msg)
+{
+    const settings_message_t *setting = &msg->data.settings;
+    switch (setting->id)
+    {
+    case SETTING_LIGHT_VARIANT:
+        start_simulation_with_reload(true);
+        break;
+    case SETTING_LIGHT_MODE:
+        start_simulation_with_reload(setting->value.int_value == 0);
+        break;
+    case SETTING_LIGHT_ACTIVE:
+        start_simulation_with_reload(false);
+        break;
+    default:
+        break;
+    }
+}
+
+void simulator_subscribe_settings(void)
+{
+    message_manager_subscribe(on_light_setting, MESSAGE_MASK(MESSAGE_TYPE_SETTINGS),
+                              SETTING_MASK(LIGHT_VARIANT) | SETTING_MASK(LIGHT_MODE) | SETTING_MASK(LIGHT_ACTIVE));
+
+    // Restarting the simulation may reload the schema; the latest value per setting is enough
+    message_executor_config_t executor = {};
+    executor.name = "app_settings";
+    executor.stack_size = 6144;
+    executor.priority = 4;
+    executor.inbox_length = 4;
+    executor.policy = MESSAGE_INBOX_COALESCE;
+    message_manager_set_executor(on_light_setting, &executor);
+}
@@ -1,4 +1,5 @@
 #include "storage.h"
+#include "color.h"
 #include "simulator.h"
 
 #include <errno.h>
@@ -9,6 +10,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+// The desktop build points this at the storage folder of the repository
+#ifndef STORAGE_BASE_PATH
+#define STORAGE_BASE_PATH "/spiffs"
+#endif
+
 static const char *TAG = "storage";
 
 static bool is_spiffs_mounted = false;
@@ -21,7 +27,7 @@ void initialize_storage()
     }
 
     esp_vfs_spiffs_conf_t conf = {
-        .base_path = "/spiffs",
+        .base_path = STORAGE_BASE_PATH,
         .partition_label = NULL,
         .max_files = 5,
         .format_if_mount_failed = false,
@@ -59,17 +65,25 @@ void load_file(const char *filename)
     {
         char time[10] = {0};
         int red, green, blue, white, brightness, saturation;
+        int kelvin;
+        char unit;
+        int total_minutes = line_number * 30;
+        snprintf(time, sizeof(time), "%02d%02d", total_minutes / 60, total_minutes % 60);
+
         int items_scanned =
             sscanf(lines[i], "%d,%d,%d,%d,%d,%d", &red, &green, &blue, &white, &brightness, &saturation);
         if (items_scanned == 6)
         {
-            int total_minutes = line_number * 30;
-            int hours = total_minutes / 60;
-            int minutes = total_minutes % 60;
-            snprintf(time, sizeof(time), "%02d%02d", hours, minutes);
             add_light_item(time, red, green, blue, white, brightness, saturation);
             line_number++;
         }
+        else if (sscanf(lines[i], "%d%c,%d", &kelvin, &unit, &brightness) == 3 && (unit == 'K' || unit == 'k'))
+        {
+            // Color temperature row: "5600K,200"
+            rgb_t color = color_from_kelvin((uint16_t)(kelvin < 0 ? 0 : kelvin > UINT16_MAX ? UINT16_MAX : kelvin));
+            add_light_item(time, color.red, color.green, color.blue, 0, brightness, 255);
+            line_number++;
+        }
         else
         {
             ESP_LOGW(TAG, "Could not parse line: %s", lines[i]);
@@ -81,8 +95,8 @@ void load_file(const char *filename)
 
 char **read_lines_filtered(const char *filename, int *out_count)
 {
-    char fullpath[128];
-    snprintf(fullpath, sizeof(fullpath), "/spiffs/%s", filename[0] == '/' ? filename + 1 : filename);
+    char fullpath[sizeof(STORAGE_BASE_PATH) + 64];
+    snprintf(fullpath, sizeof(fullpath), STORAGE_BASE_PATH "/%s", filename[0] == '/' ? filename + 1 : filename);
     FILE *f = fopen(fullpath, "r");
     if (!f)
     {
@@ -134,8 +148,8 @@ void free_lines(char **lines, int count)
 
 esp_err_t write_lines(const char *filename, char **lines, int count)
 {
-    char fullpath[128];
-    snprintf(fullpath, sizeof(fullpath), "/spiffs/%s", filename[0] == '/' ? filename + 1 : filename);
+    char fullpath[sizeof(STORAGE_BASE_PATH) + 64];
+    snprintf(fullpath, sizeof(fullpath), STORAGE_BASE_PATH "/%s", filename[0] == '/' ? filename + 1 : filename);
     FILE *f = fopen(fullpath, "w");
     if (!f)
     {
@@ -155,3 +169,22 @@ esp_err_t write_lines(const char *filename, char **lines, int count)
     ESP_LOGI(TAG, "Wrote %d lines to %s", count, fullpath);
     return ESP_OK;
 }
+
+FILE *storage_open(const char *filename, const char *mode)
+{
+    char fullpath[sizeof(STORAGE_BASE_PATH) + 64];
+    snprintf(fullpath, sizeof(fullpath), STORAGE_BASE_PATH "/%s", filename[0] == '/' ? filename + 1 : filename);
+    FILE *f = fopen(fullpath, mode);
+    if (!f)
+    {
+        ESP_LOGW(TAG, "Failed to open %s (%s)", fullpath, mode);
+    }
+    return f;
+}
+
+esp_err_t storage_remove(const char *filename)
+{
+    char fullpath[sizeof(STORAGE_BASE_PATH) + 64];
+    snprintf(fullpath, sizeof(fullpath), STORAGE_BASE_PATH "/%s", filename[0] == '/' ? filename + 1 : filename);
+    return remove(fullpath) == 0 ? ESP_OK : ESP_FAIL;
+}
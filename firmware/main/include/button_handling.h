@@ -3,6 +3,6 @@
 #include <sys/cdefs.h>
 
 __BEGIN_DECLS
+// Button presses are posted as MESSAGE_TYPE_BUTTON with the GPIO number as button_id
 void setup_buttons(void);
-void cleanup_buttons(void);
 __END_DECLS
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+/**
+ * @brief Logs the CPU cycles per call of the fixed point color math and of the floating point versions
+ *        it replaced (color_reference.h). Runs from app_main with CONFIG_COLOR_BENCH, before the other
+ *        tasks start.
+ */
+void color_bench_run(void);
+__END_DECLS
@@ -29,12 +29,9 @@
 static const char *TAG = "app_task";
 
 u8g2_t u8g2;
-uint8_t received_signal;
 
 persistence_manager_t g_persistence_manager;
 
-extern QueueHandle_t buttonQueue;
-
 static TaskHandle_t display_update_task_handle = nullptr;
 
 // Display update task - handles I2C transfer asynchronously
@@ -139,39 +136,89 @@ static void handle_button(uint8_t button)
     }
 }
 
-// --- Message manager listener ---
+// Work for the app task, handled in the order it was posted: button presses from the dispatcher and
+// menu updates from the settings executor, so that the menu is not changed by two tasks at once
+struct app_event_t
+{
+    enum : uint8_t
+    {
+        BUTTON,
+        SETTING,
+    } kind;
+    uint8_t button; // GPIO of the pressed button
+    settings_message_t setting;
+};
 
-static void on_message_received(const message_t *msg)
+#define APP_EVENT_QUEUE_LENGTH 16
+
+static QueueHandle_t app_events = nullptr;
+
+static void post_app_event(const app_event_t &event)
 {
-    if (!msg || msg->type != MESSAGE_TYPE_SETTINGS)
+    if (xQueueSend(app_events, &event, 0) != pdTRUE)
     {
-        return;
+        ESP_LOGW(TAG, "App event queue full, %s dropped",
+                 event.kind == app_event_t::BUTTON ? "button press" : "menu update");
     }
+}
 
-    if (std::strcmp(msg->data.settings.key, "light_variant") == 0)
-    {
-        char val[8];
-        snprintf(val, sizeof(val), "%d", (int)msg->data.settings.value.int_value);
-        Mercedes::getInstance().updateItemValue("light_variant", val);
-        start_simulation_with_reload(true);
+// Runs in the dispatcher
+static void on_button_message(const message_t *msg)
+{
+    if (msg->data.button.event_type != BUTTON_EVENT_PRESS)
         return;
-    }
+    app_event_t event = {};
+    event.kind = app_event_t::BUTTON;
+    event.button = msg->data.button.button_id;
+    post_app_event(event);
+}
 
-    if (std::strcmp(msg->data.settings.key, "light_mode") == 0)
+// Shows a changed setting in its menu item; runs in the app task
+static void update_menu_item(const settings_message_t &setting)
+{
+    // The menu item of a setting has the name of the setting
+    const char *item = settings_registry[setting.id].name;
+    char val[12];
+    switch (settings_registry[setting.id].type)
     {
-        char val[8];
-        snprintf(val, sizeof(val), "%d", (int)msg->data.settings.value.int_value);
-        Mercedes::getInstance().updateItemValue("light_mode", val);
-        bool force_reload = (msg->data.settings.type == SETTINGS_TYPE_INT && msg->data.settings.value.int_value == 0);
-        start_simulation_with_reload(force_reload);
-        return;
+    case SETTINGS_TYPE_BOOL:
+        Mercedes::getInstance().updateItemValue(item, setting.value.bool_value ? "true" : "false");
+        break;
+    case SETTINGS_TYPE_INT:
+        snprintf(val, sizeof(val), "%d", (int)setting.value.int_value);
+        Mercedes::getInstance().updateItemValue(item, val);
+        break;
+    default:
+        break;
     }
+}
+
+static void handle_app_event(const app_event_t &event)
+{
+    if (event.kind == app_event_t::BUTTON)
+        handle_button(event.button);
+    else
+        update_menu_item(event.setting);
+}
+
+// --- Message manager listener ---
+
+static constexpr uint32_t light_settings =
+    SETTING_MASK(LIGHT_VARIANT) | SETTING_MASK(LIGHT_MODE) | SETTING_MASK(LIGHT_ACTIVE);
 
-    if (std::strcmp(msg->data.settings.key, "light_active") == 0)
+// Runs in the dispatcher; the menu item is updated by the app task, the simulation restarted by the
+// listener of simulator_subscribe_settings()
+static void on_message_received(const message_t *msg)
+{
+    if (!msg || msg->type != MESSAGE_TYPE_SETTINGS)
     {
-        Mercedes::getInstance().updateItemValue("light_active", msg->data.settings.value.bool_value ? "true" : "false");
-        start_simulation_with_reload(false);
+        return;
     }
+
+    app_event_t event = {};
+    event.kind = app_event_t::SETTING;
+    event.setting = msg->data.settings;
+    post_app_event(event);
 }
 
 // --- Main task ---
@@ -242,6 +289,8 @@ void app_task(void *args)
     // Initialize subsystems
     persistence_manager_init(&g_persistence_manager, "config");
     message_manager_init();
+    app_events = xQueueCreate(APP_EVENT_QUEUE_LENGTH, sizeof(app_event_t));
+    message_manager_subscribe(on_button_message, MESSAGE_MASK(MESSAGE_TYPE_BUTTON), 0);
     setup_buttons();
 
     // Initialize Heimdall button actions
@@ -258,7 +307,8 @@ void app_task(void *args)
 
     // Start services
     thread_manager_init(NULL);
-    message_manager_register_listener(on_message_received);
+    message_manager_subscribe(on_message_received, MESSAGE_MASK(MESSAGE_TYPE_SETTINGS), light_settings);
+    simulator_subscribe_settings();
     start_simulation();
 
     // Set up dynamic value provider for label items
@@ -327,12 +377,13 @@ void app_task(void *args)
             xTaskNotifyGive(display_update_task_handle);
         }
 
-        // Process button input
-        if (xQueueReceive(buttonQueue, &received_signal, pdMS_TO_TICKS(10)) == pdTRUE)
+        // Process button presses and menu updates, all that came in since the last frame
+        app_event_t event;
+        TickType_t wait = pdMS_TO_TICKS(10);
+        while (xQueueReceive(app_events, &event, wait) == pdTRUE)
         {
-            handle_button(received_signal);
+            handle_app_event(event);
+            wait = 0;
         }
     }
-
-    cleanup_buttons();
 }
@@ -1,6 +1,7 @@
 #include "button_handling.h"
 #include "button_gpio.h"
 #include "common.h"
+#include "message_manager.h"
 
 #include <driver/gpio.h>
 #include <esp_err.h>
@@ -25,24 +26,21 @@ typedef struct
 
 static button_user_data_t button_data[6];
 
-QueueHandle_t buttonQueue = NULL;
-
+// Runs in the iot_button timer context, so the press is posted through the non-blocking ring
 static void button_event_cb(void *arg, void *usr_data)
 {
-    if (buttonQueue == NULL)
-    {
-        ESP_LOGE(TAG, "Button queue not initialized!");
-        return;
-    }
     button_user_data_t *data = (button_user_data_t *)usr_data;
     uint8_t gpio_num = data->gpio;
     const char *button_name = button_names[data->index];
 
     ESP_LOGI(TAG, "Button %s pressed (GPIO %d)", button_name, gpio_num);
 
-    if (xQueueSend(buttonQueue, &gpio_num, 0) != pdTRUE)
+    message_t msg = {.type = MESSAGE_TYPE_BUTTON};
+    msg.data.button.event_type = BUTTON_EVENT_PRESS;
+    msg.data.button.button_id = gpio_num;
+    if (!message_manager_post_from_isr(&msg))
     {
-        ESP_LOGW(TAG, "Failed to send button press to queue");
+        ESP_LOGW(TAG, "Failed to post button press");
     }
 }
 
@@ -68,25 +66,8 @@ static void init_button(uint8_t gpio, int index)
 
 void setup_buttons(void)
 {
-    buttonQueue = xQueueCreate(10, sizeof(uint8_t));
-    if (buttonQueue == NULL)
-    {
-        ESP_LOGE(TAG, "Failed to create button queue");
-        return;
-    }
-
-    ESP_LOGI(TAG, "Button queue created successfully");
     for (int i = 0; i < sizeof(gpios) / sizeof(gpios[0]); i++)
     {
         init_button(gpios[i], i);
     }
 }
-
-// Cleanup function (optional)
-void cleanup_buttons(void)
-{
-    if (buttonQueue != NULL)
-    {
-        vQueueDelete(buttonQueue);
-    }
-}
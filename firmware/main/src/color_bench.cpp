@@ -0,0 +1,129 @@
+#include "color_bench.h"
+#include "color.h"
+#include "color_reference.h"
+
+#include <esp_cpu.h>
+#include <esp_log.h>
+
+static const char *TAG = "color_bench";
+
+// Small enough to stay in the data cache, so the calls are measured and not the memory
+static constexpr size_t COUNT = 256;
+static constexpr int ROUNDS = 16;
+
+static rgb_t colors[COUNT];
+static rgb_t others[COUNT];
+static rgb_t out[COUNT];
+static hsv_t hsv[COUNT];
+static HsvFloat hsv_float[COUNT];
+static color_fract_t factors[COUNT];
+
+// Fixed inputs, so two boards (or two builds) measure the same work
+static uint32_t next_random(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+template <typename Pass> static uint32_t cycles_per_call(Pass pass)
+{
+    // The first pass loads the code into the flash cache
+    pass();
+    uint32_t begin = esp_cpu_get_cycle_count();
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        pass();
+        // The results count as read and the inputs as changed, so the compiler can neither drop the calls
+        // nor fold the rounds into one
+        asm volatile("" : : "r"(out), "r"(hsv), "r"(hsv_float) : "memory");
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - begin;
+    return cycles / (ROUNDS * COUNT);
+}
+
+template <typename Fixed, typename Reference>
+static void row(const char *name, Fixed fixed, Reference reference)
+{
+    uint32_t fixed_cycles = cycles_per_call(fixed);
+    uint32_t reference_cycles = cycles_per_call(reference);
+    ESP_LOGI(TAG, "%-22s %6lu %6lu cycles", name, (unsigned long)fixed_cycles, (unsigned long)reference_cycles);
+}
+
+void color_bench_run(void)
+{
+    uint32_t state = 7;
+    for (size_t i = 0; i < COUNT; i++)
+    {
+        uint32_t a = next_random(state);
+        uint32_t b = next_random(state);
+        colors[i] = rgb_t{(uint8_t)a, (uint8_t)(a >> 8), (uint8_t)(a >> 16)};
+        others[i] = rgb_t{(uint8_t)b, (uint8_t)(b >> 8), (uint8_t)(b >> 16)};
+        hsv[i] = hsv_t{(uint8_t)((a >> 24) % HSV_HUE_MAX), (uint8_t)(b >> 24), (uint8_t)(a ^ b)};
+        hsv_float[i] = HsvFloat{(float)hsv[i].h, (float)hsv[i].s, (float)hsv[i].v};
+        factors[i] = (color_fract_t)(next_random(state) % (COLOR_FRACT_ONE + 1));
+    }
+
+    ESP_LOGI(TAG, "per call over %u inputs    fixed  float", (unsigned)COUNT);
+    row(
+        "rgb_to_hsv",
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                hsv[i] = rgb_to_hsv(colors[i]);
+        },
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                hsv_float[i] = RefRgbToHsv(colors[i]);
+        });
+    row(
+        "hsv_to_rgb",
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = hsv_to_rgb(hsv[i]);
+        },
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = RefHsvToRgb(hsv_float[i]);
+        });
+    row(
+        "interpolate_color_rgb",
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = interpolate_color_rgb(colors[i], others[i], factors[i]);
+        },
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = RefInterpolateRgb(colors[i], others[i], (float)factors[i] / COLOR_FRACT_ONE);
+        });
+    row(
+        "interpolate_color_hsv",
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = interpolate_color_hsv(colors[i], others[i], factors[i]);
+        },
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = RefInterpolateHsv(colors[i], others[i], (float)factors[i] / COLOR_FRACT_ONE);
+        });
+    row(
+        "color_scale",
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = color_scale(colors[i], others[i].red);
+        },
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = RefScale(colors[i], others[i].red);
+        });
+    row(
+        "color_blend",
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = color_blend(colors[i], others[i], others[i].green);
+        },
+        [] {
+            for (size_t i = 0; i < COUNT; i++)
+                out[i] = RefBlend(colors[i], others[i], others[i].green);
+        });
+}
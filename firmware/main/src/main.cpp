@@ -1,8 +1,10 @@
 #include "app_task.h"
 #include "color.h"
+#include "color_bench.h"
 #include "led_status.h"
 #include "led_strip_ws2812.h"
 #include "persistence_manager.h"
+#include "settings_registry.h"
 #include "wifi_manager.h"
 
 #include <driver/gpio.h>
@@ -39,6 +41,10 @@ void app_main(void)
     gpio_set_level(WIFI_ANT_CONFIG, 1); // HIGH
 #endif
 
+#ifdef CONFIG_COLOR_BENCH
+    color_bench_run();
+#endif
+
     esp_reset_reason_t reset_reason = esp_reset_reason();
     if (reset_reason == ESP_RST_PANIC || reset_reason == ESP_RST_TASK_WDT || reset_reason == ESP_RST_INT_WDT)
     {
@@ -56,6 +62,7 @@ void app_main(void)
     persistence_manager_t persistence;
     persistence_manager_init(&persistence, "config");
     persistence_manager_load(&persistence);
+    settings_init();
 
     led_status_init(CONFIG_STATUS_WLED_PIN);
 
@@ -0,0 +1,60 @@
+#include "Matrix.h"
+
+#include <algorithm>
+
+Matrix::Matrix(SDL_WindowID windowId, SDL_Renderer *renderer, uint8_t cols, uint8_t rows)
+    : m_windowId(windowId), m_renderer(renderer), m_cols(cols), m_rows(rows)
+{
+}
+
+SDL_Renderer *Matrix::renderer() const
+{
+    return m_renderer;
+}
+
+SDL_WindowID Matrix::windowId() const
+{
+    return m_windowId;
+}
+
+float Matrix::PixelSize(uint8_t cells)
+{
+    return cells * (cellSize + spacing) + spacing;
+}
+
+void Matrix::SetPixels(const uint8_t *rgb, size_t count)
+{
+    m_pixels.assign(rgb, rgb + std::min<size_t>(count, (size_t)m_cols * m_rows) * 3);
+}
+
+void Matrix::Render() const
+{
+    SDL_SetRenderDrawColor(m_renderer, 20, 20, 20, SDL_ALPHA_OPAQUE);
+    SDL_RenderClear(m_renderer);
+    DrawColoredGrid();
+    SDL_RenderPresent(m_renderer);
+}
+
+void Matrix::DrawColoredGrid() const
+{
+    for (uint8_t row = 0; row < m_rows; row++)
+    {
+        for (uint8_t col = 0; col < m_cols; col++)
+        {
+            size_t index = ((size_t)row * m_cols + col) * 3;
+            if (index + 2 < m_pixels.size())
+                SDL_SetRenderDrawColor(m_renderer, m_pixels[index], m_pixels[index + 1], m_pixels[index + 2],
+                                       SDL_ALPHA_OPAQUE);
+            else
+                SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+
+            const SDL_FRect cell = {
+                spacing + col * (cellSize + spacing),
+                spacing + row * (cellSize + spacing),
+                cellSize,
+                cellSize,
+            };
+            SDL_RenderFillRect(m_renderer, &cell);
+        }
+    }
+}
@@ -0,0 +1,431 @@
+// Host tool for pre-rendered animations (see led_anim.h for the format):
+//
+//   led_anim_tool record FILE --effect SPEC [--effect SPEC...] [--base R,G,B] [--frames N]
+//   led_anim_tool info FILE
+//   led_anim_tool roundtrip
+//   led_anim_tool bench [FILE] [--seconds S]
+//
+// record renders the effect engine frame by frame at CONFIG_LED_EFFECT_FRAME_RATE, the file covers the
+// pixels from the first to the last effect segment. roundtrip encodes and decodes a set of synthetic and
+// recorded sequences and fails on the first mismatch. bench measures how fast frames decode.
+
+#include "app.h"
+#include "led_anim.h"
+#include "led_effect.h"
+#include "led_segment.h"
+
+#include <sdkconfig.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using Frame = std::vector<rgb_t>;
+using Generator = std::function<void(uint32_t index, Frame &frame)>;
+
+// Encoded animation in memory, same layout as the file behind the header
+struct Encoded
+{
+    led_anim_header_t header = {};
+    std::vector<uint8_t> data;
+    size_t raw_bytes = 0;
+};
+
+static bool SameFrame(const Frame &a, const Frame &b)
+{
+    return memcmp(a.data(), b.data(), a.size() * sizeof(rgb_t)) == 0;
+}
+
+static Encoded Encode(uint16_t leds, uint16_t start, uint32_t frames, const Generator &generate)
+{
+    Encoded encoded;
+    memcpy(encoded.header.magic, LED_ANIM_MAGIC, sizeof(encoded.header.magic));
+    encoded.header.version = LED_ANIM_VERSION;
+    encoded.header.leds = leds;
+    encoded.header.start = start;
+    encoded.header.frame_rate = CONFIG_LED_EFFECT_FRAME_RATE;
+    encoded.header.frame_count = frames;
+
+    Frame previous(leds, rgb_t{0, 0, 0});
+    Frame frame(leds);
+    std::vector<uint8_t> ops(LED_ANIM_FRAME_BYTES_MAX(leds));
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        frame = previous;
+        generate(i, frame);
+        size_t size = led_anim_encode_frame(previous.data(), frame.data(), leds, ops.data());
+        encoded.data.push_back((uint8_t)size);
+        encoded.data.push_back((uint8_t)(size >> 8));
+        encoded.data.insert(encoded.data.end(), ops.begin(), ops.begin() + size);
+        encoded.raw_bytes += leds * sizeof(rgb_t);
+        previous.swap(frame);
+    }
+    return encoded;
+}
+
+// Decodes all frames; visit gets every frame, returns false on a corrupt stream
+static bool Decode(const Encoded &encoded, const std::function<void(uint32_t, const Frame &)> &visit)
+{
+    Frame frame(encoded.header.leds, rgb_t{0, 0, 0});
+    size_t pos = 0;
+    for (uint32_t i = 0; i < encoded.header.frame_count; i++)
+    {
+        if (pos + 2 > encoded.data.size())
+            return false;
+        size_t size = encoded.data[pos] | ((size_t)encoded.data[pos + 1] << 8);
+        pos += 2;
+        if (pos + size > encoded.data.size() ||
+            led_anim_decode_frame(frame.data(), frame.size(), &encoded.data[pos], size) != ESP_OK)
+            return false;
+        pos += size;
+        if (visit)
+            visit(i, frame);
+    }
+    return pos == encoded.data.size();
+}
+
+static bool Save(const Encoded &encoded, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return false;
+    }
+    bool ok = fwrite(&encoded.header, sizeof(encoded.header), 1, file) == 1 &&
+              fwrite(encoded.data.data(), 1, encoded.data.size(), file) == encoded.data.size();
+    return fclose(file) == 0 && ok;
+}
+
+static bool Load(const char *path, Encoded &encoded)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    bool ok = fread(&encoded.header, sizeof(encoded.header), 1, file) == 1;
+    uint8_t buffer[4096];
+    size_t read;
+    while (ok && (read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        encoded.data.insert(encoded.data.end(), buffer, buffer + read);
+    fclose(file);
+
+    if (!ok || led_anim_header_check(&encoded.header) != ESP_OK)
+    {
+        fprintf(stderr, "%s is not a valid animation\n", path);
+        return false;
+    }
+    encoded.raw_bytes = (size_t)encoded.header.frame_count * encoded.header.leds * sizeof(rgb_t);
+    return true;
+}
+
+// Binds the effects to segments like the API does, returns the pixel range they cover
+static bool SetupEffects(const std::vector<std::string> &specs, uint16_t &start, uint16_t &leds)
+{
+    uint32_t first = UINT32_MAX;
+    uint32_t end = 0;
+    led_segment_t segments[LED_SEGMENT_MAX_LEN] = {};
+    size_t segment_count = 0;
+    for (const std::string &spec : specs)
+    {
+        std::string name;
+        led_effect_config_t effect;
+        if (segment_count == LED_SEGMENT_MAX_LEN)
+        {
+            fprintf(stderr, "Invalid effect: %s\n", spec.c_str());
+            return false;
+        }
+        led_segment_t &segment = segments[segment_count];
+        if (!ParseEffect(spec, name, segment.start, segment.leds, effect))
+        {
+            fprintf(stderr, "Invalid effect: %s\n", spec.c_str());
+            return false;
+        }
+        strncpy(segment.name, name.c_str(), sizeof(segment.name) - 1);
+        led_effect_set(segment.name, &effect);
+        first = std::min<uint32_t>(first, segment.start);
+        end = std::max<uint32_t>(end, segment.start + segment.leds);
+        segment_count++;
+    }
+    led_segment_set(segments, segment_count);
+    led_effect_segments_changed();
+
+    if (segment_count == 0 || end <= first || end > CONFIG_LED_STRIP_MAX_LEDS)
+    {
+        fprintf(stderr, "The effects must cover 1..%d pixels\n", CONFIG_LED_STRIP_MAX_LEDS);
+        return false;
+    }
+    start = (uint16_t)first;
+    leds = (uint16_t)(end - first);
+    return true;
+}
+
+// Renders the effect engine on top of a uniform base color, cropped to [start, start + leds)
+static Generator EffectGenerator(rgb_t base, uint16_t start)
+{
+    auto strip = std::make_shared<Frame>(CONFIG_LED_STRIP_MAX_LEDS);
+    return [strip, base, start](uint32_t, Frame &frame) {
+        std::fill(strip->begin(), strip->end(), base);
+        rgb_sum_t sum = {};
+        led_effect_render(strip->data(), strip->size(), &sum);
+        std::copy(strip->begin() + start, strip->begin() + start + frame.size(), frame.begin());
+    };
+}
+
+static int Record(int argc, char **argv)
+{
+    if (argc < 1)
+        return 2;
+    const char *path = argv[0];
+    std::vector<std::string> effects;
+    rgb_t base = {40, 30, 20};
+    uint32_t frames = 10 * CONFIG_LED_EFFECT_FRAME_RATE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--effect" && hasValue)
+            effects.emplace_back(argv[++i]);
+        else if (arg == "--base" && hasValue)
+        {
+            unsigned red, green, blue;
+            if (sscanf(argv[++i], "%u,%u,%u", &red, &green, &blue) != 3)
+                return 2;
+            base = {(uint8_t)red, (uint8_t)green, (uint8_t)blue};
+        }
+        else if (arg == "--frames" && hasValue)
+            frames = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else
+            return 2;
+    }
+
+    uint16_t start, leds;
+    if (frames == 0 || !SetupEffects(effects, start, leds))
+        return 1;
+
+    Encoded encoded = Encode(leds, start, frames, EffectGenerator(base, start));
+    if (!Save(encoded, path))
+        return 1;
+
+    printf("%s: %u leds at %u, %" PRIu32 " frames, %zu bytes (%.1f%% of raw)\n", path, leds, start, frames,
+           sizeof(encoded.header) + encoded.data.size(), 100.0 * encoded.data.size() / encoded.raw_bytes);
+    return 0;
+}
+
+static int Info(int argc, char **argv)
+{
+    Encoded encoded;
+    if (argc < 1 || !Load(argv[0], encoded))
+        return 1;
+
+    size_t largest = 0;
+    uint32_t still = 0;
+    size_t pos = 0;
+    for (uint32_t i = 0; i < encoded.header.frame_count && pos + 2 <= encoded.data.size(); i++)
+    {
+        size_t size = encoded.data[pos] | ((size_t)encoded.data[pos + 1] << 8);
+        largest = std::max(largest, size);
+        still += size == 0;
+        pos += 2 + size;
+    }
+
+    const led_anim_header_t &header = encoded.header;
+    printf("leds          %u at %u\n", header.leds, header.start);
+    printf("frames        %" PRIu32 " at %u fps (%.1f s)\n", header.frame_count, header.frame_rate,
+           (double)header.frame_count / header.frame_rate);
+    printf("size          %zu bytes, %.1f%% of raw\n", sizeof(header) + encoded.data.size(),
+           100.0 * encoded.data.size() / encoded.raw_bytes);
+    printf("largest frame %zu bytes (bound %zu)\n", largest, LED_ANIM_FRAME_BYTES_MAX(header.leds));
+    printf("still frames  %" PRIu32 "\n", still);
+    printf("stream        %s\n", Decode(encoded, nullptr) ? "ok" : "CORRUPT");
+    return 0;
+}
+
+static bool Check(const char *name, uint16_t leds, uint32_t frames, const Generator &generate)
+{
+    std::vector<Frame> expected;
+    Frame previous(leds, rgb_t{0, 0, 0});
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        Frame frame = previous;
+        generate(i, frame);
+        expected.push_back(frame);
+        previous = frame;
+    }
+
+    // Generators may keep state, replay the recorded frames into the encoder
+    Encoded encoded = Encode(leds, 0, frames, [&](uint32_t i, Frame &frame) { frame = expected[i]; });
+    bool ok = true;
+    bool complete = Decode(encoded, [&](uint32_t i, const Frame &frame) {
+        if (ok && !SameFrame(frame, expected[i]))
+        {
+            fprintf(stderr, "%s: frame %" PRIu32 " differs\n", name, i);
+            ok = false;
+        }
+    });
+    if (!complete)
+    {
+        fprintf(stderr, "%s: stream rejected\n", name);
+        ok = false;
+    }
+
+    // Every frame must fit the bound the player sizes its buffers with
+    size_t pos = 0;
+    for (uint32_t i = 0; i < frames && ok; i++)
+    {
+        size_t size = encoded.data[pos] | ((size_t)encoded.data[pos + 1] << 8);
+        if (size > LED_ANIM_FRAME_BYTES_MAX(leds))
+        {
+            fprintf(stderr, "%s: frame %" PRIu32 " exceeds the size bound\n", name, i);
+            ok = false;
+        }
+        pos += 2 + size;
+    }
+
+    printf("%-12s %4u leds %4" PRIu32 " frames %8zu bytes %6.1f%%  %s\n", name, leds, frames, encoded.data.size(),
+           100.0 * encoded.data.size() / encoded.raw_bytes, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+static int Roundtrip()
+{
+    std::mt19937 random(1234);
+    auto color = [&random]() { return rgb_t{(uint8_t)random(), (uint8_t)random(), (uint8_t)random()}; };
+    bool ok = true;
+
+    for (uint16_t leds : {1, 2, 63, 64, 65, 129, CONFIG_LED_STRIP_MAX_LEDS})
+    {
+        ok &= Check("noise", leds, 20, [&](uint32_t, Frame &frame) {
+            for (rgb_t &pixel : frame)
+                pixel = color();
+        });
+    }
+    ok &= Check("still", 300, 50, [&](uint32_t i, Frame &frame) {
+        if (i == 0)
+            std::fill(frame.begin(), frame.end(), rgb_t{255, 180, 90});
+    });
+    ok &= Check("sparse", 800, 200, [&](uint32_t, Frame &frame) {
+        for (int n = 0; n < 10; n++)
+            frame[random() % frame.size()] = color();
+    });
+    ok &= Check("chase", 800, 200, [&](uint32_t i, Frame &frame) {
+        for (size_t p = 0; p < frame.size(); p++)
+            frame[p] = ((p + i) / 7) % 3 == 0 ? rgb_t{255, 120, 0} : rgb_t{0, 0, 30};
+    });
+    // Neighbouring pixels that only differ in one channel and alternate with unchanged pixels
+    ok &= Check("alternating", 200, 50, [&](uint32_t i, Frame &frame) {
+        for (size_t p = i % 2; p < frame.size(); p += 2)
+            frame[p] = rgb_t{(uint8_t)p, (uint8_t)i, (uint8_t)(p & 1)};
+    });
+
+    uint16_t start, leds;
+    if (!SetupEffects({"lantern:0:120:lantern", "fire:120:200:fire", "tv:320:40:tv", "chase:360:440:chase"}, start,
+                      leds))
+        return 1;
+    ok &= Check("effects", leds, 500, EffectGenerator(rgb_t{40, 30, 20}, start));
+
+    // A truncated or foreign stream must be rejected, never decoded past the frame
+    Frame frame(10, rgb_t{0, 0, 0});
+    const uint8_t overrun[] = {LED_ANIM_OP_SKIP | 9, LED_ANIM_OP_RUN, 1, 2, 3};
+    const uint8_t truncated[] = {LED_ANIM_OP_LITERAL | 1, 1, 2, 3};
+    const uint8_t reserved[] = {0xC0};
+    bool rejected = led_anim_decode_frame(frame.data(), frame.size(), overrun, sizeof(overrun)) != ESP_OK &&
+                    led_anim_decode_frame(frame.data(), frame.size(), truncated, sizeof(truncated)) != ESP_OK &&
+                    led_anim_decode_frame(frame.data(), frame.size(), reserved, sizeof(reserved)) != ESP_OK;
+    printf("%-12s %s\n", "corrupt", rejected ? "ok" : "FAIL");
+    ok &= rejected;
+
+    printf("%s\n", ok ? "roundtrip ok" : "roundtrip FAILED");
+    return ok ? 0 : 1;
+}
+
+static int Bench(int argc, char **argv)
+{
+    Encoded encoded;
+    double seconds = 2.0;
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (!Load(argv[i], encoded))
+            return 1;
+    }
+
+    if (encoded.header.frame_count == 0)
+    {
+        uint16_t start, leds;
+        if (!SetupEffects({"lantern:0:120:lantern", "fire:120:200:fire", "tv:320:40:tv", "chase:360:440:chase"},
+                          start, leds))
+            return 1;
+        encoded = Encode(leds, start, 500, EffectGenerator(rgb_t{40, 30, 20}, start));
+    }
+
+    using Clock = std::chrono::steady_clock;
+    uint64_t frames = 0;
+    uint8_t checksum = 0;
+    Clock::time_point begin = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        Decode(encoded, [&](uint32_t, const Frame &frame) { checksum ^= frame[frames++ % frame.size()].red; });
+        elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+
+    // Decodes in place; the player additionally copies the previous frame into the next ring slot
+    double per_frame_us = elapsed * 1e6 / frames;
+    printf("frames        %" PRIu64 " in %.2f s (checksum %02x)\n", frames, elapsed, checksum);
+    printf("decode        %.2f us/frame, %.0f frames/s\n", per_frame_us, frames / elapsed);
+    printf("pixels        %.1f Mpixel/s\n", frames * encoded.header.leds / elapsed / 1e6);
+    printf("input         %.1f MB/s compressed (%.1f%% of raw)\n",
+           encoded.data.size() * (frames / (double)encoded.header.frame_count) / elapsed / 1e6,
+           100.0 * encoded.data.size() / encoded.raw_bytes);
+    printf("budget        %.3f%% of a frame at %u fps\n", per_frame_us * encoded.header.frame_rate / 1e4,
+           encoded.header.frame_rate);
+    return 0;
+}
+
+static void Usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s record FILE --effect SPEC [--effect SPEC...] [--base R,G,B] [--frames N]\n"
+            "       %s info FILE\n"
+            "       %s roundtrip\n"
+            "       %s bench [FILE] [--seconds S]\n",
+            program, program, program, program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::string command = argv[1];
+    int result = 2;
+    if (command == "record")
+        result = Record(argc - 2, argv + 2);
+    else if (command == "info")
+        result = Info(argc - 2, argv + 2);
+    else if (command == "roundtrip")
+        result = Roundtrip();
+    else if (command == "bench")
+        result = Bench(argc - 2, argv + 2);
+
+    if (result == 2)
+        Usage(argv[0]);
+    return result;
+}
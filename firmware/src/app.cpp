@@ -0,0 +1,262 @@
+#include "app.h"
+
+#include "host/host.h"
+#include "led_anim.h"
+#include "led_effect.h"
+#include "led_remap.h"
+#include "led_script.h"
+#include "led_segment.h"
+#include "led_status.h"
+#include "led_strip_ws2812.h"
+#include "message_manager.h"
+#include "persistence_manager.h"
+#include "settings_registry.h"
+#include "simulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sdkconfig.h>
+#include <sstream>
+
+static bool ModeToSettings(const std::string &mode, bool &active, int32_t &lightMode)
+{
+    active = true;
+    if (mode == "simulation")
+        lightMode = 0;
+    else if (mode == "day")
+        lightMode = 1;
+    else if (mode == "night")
+        lightMode = 2;
+    else if (mode == "off")
+        active = false;
+    else
+        return false;
+    return true;
+}
+
+static bool StoreMode(const std::string &mode)
+{
+    bool active;
+    int32_t lightMode = 0;
+    if (!ModeToSettings(mode, active, lightMode))
+    {
+        fprintf(stderr, "Unknown mode: %s\n", mode.c_str());
+        return false;
+    }
+
+    SETTINGS_SET_BOOL(LIGHT_ACTIVE, active);
+    SETTINGS_SET_INT(LIGHT_MODE, lightMode);
+    return true;
+}
+
+bool ParseEffect(const std::string &spec, std::string &name, uint16_t &start, uint16_t &leds,
+                 led_effect_config_t &effect)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(spec);
+    std::string part;
+    while (std::getline(stream, part, ':'))
+        parts.push_back(part);
+    if (parts.size() < 4 || parts.size() > 6)
+        return false;
+
+    led_effect_type_t type = led_effect_type_from_string(parts[3].c_str());
+    if (type == LED_EFFECT_COUNT || parts[0].empty() || parts[0].size() >= sizeof(led_segment_t::name))
+        return false;
+
+    name = parts[0];
+    start = (uint16_t)strtoul(parts[1].c_str(), nullptr, 10);
+    leds = (uint16_t)strtoul(parts[2].c_str(), nullptr, 10);
+    effect = {};
+    effect.type = (uint8_t)type;
+    effect.speed = parts.size() > 4 ? (uint8_t)strtoul(parts[4].c_str(), nullptr, 10) : 128;
+    effect.intensity = parts.size() > 5 ? (uint8_t)strtoul(parts[5].c_str(), nullptr, 10) : 255;
+    effect.color = {255, 160, 60};
+    return true;
+}
+
+bool ParseRemap(const std::string &spec, std::string &name, led_remap_config_t &remap)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(spec);
+    std::string part;
+    while (std::getline(stream, part, ':'))
+        parts.push_back(part);
+    if (parts.size() < 2 || parts.size() > 4 || parts[0].empty())
+        return false;
+
+    name = parts[0];
+    remap = {};
+    remap.offset = (uint16_t)strtoul(parts[1].c_str(), nullptr, 10);
+    for (size_t i = 2; i < parts.size(); i++)
+    {
+        if (parts[i] == "r")
+            remap.flags |= LED_REMAP_REVERSE;
+        else
+            remap.skip = (uint8_t)strtoul(parts[i].c_str(), nullptr, 10);
+    }
+    return true;
+}
+
+bool ParseCalibration(const std::string &spec, std::string &name, led_calibration_config_t &calibration)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(spec);
+    std::string part;
+    while (std::getline(stream, part, ':'))
+        parts.push_back(part);
+    if (parts.size() < 2 || parts.size() > 3 || parts[0].empty())
+        return false;
+
+    std::vector<double> gains, matrix;
+    for (size_t p = 1; p < parts.size(); p++)
+    {
+        std::vector<double> &values = p == 1 ? gains : matrix;
+        std::stringstream list(parts[p]);
+        while (std::getline(list, part, ','))
+            values.push_back(strtod(part.c_str(), nullptr));
+    }
+    if (gains.size() != 3 || (parts.size() == 3 && matrix.size() != 9))
+        return false;
+
+    name = parts[0];
+    led_calibration_identity(&calibration);
+    for (size_t i = 0; i < 3; i++)
+        calibration.gain[i] = (uint8_t)std::clamp(gains[i], 0.0, 255.0);
+    for (size_t i = 0; i < matrix.size(); i++)
+    {
+        double value = std::round(matrix[i] * LED_CALIBRATION_ONE);
+        if (value < INT16_MIN || value > INT16_MAX)
+            return false;
+        calibration.matrix[i] = (int16_t)value;
+    }
+    return true;
+}
+
+bool AppStart(const AppOptions &options)
+{
+    host_scheduler_init();
+    settings_init();
+
+    // Segments and effects go through NVS, so led_strip_init() loads them like on the device
+    led_segment_t configured[LED_SEGMENT_MAX_LEN] = {};
+    size_t count = 0;
+    for (const std::string &spec : options.effects)
+    {
+        std::string name;
+        led_effect_config_t effect;
+        if (count == LED_SEGMENT_MAX_LEN ||
+            !ParseEffect(spec, name, configured[count].start, configured[count].leds, effect))
+        {
+            fprintf(stderr, "Invalid effect: %s\n", spec.c_str());
+            return false;
+        }
+        strncpy(configured[count].name, name.c_str(), sizeof(configured[count].name) - 1);
+        led_effect_set(configured[count].name, &effect);
+        count++;
+    }
+
+    for (const std::string &spec : options.remaps)
+    {
+        std::string name;
+        led_remap_config_t remap;
+        size_t i = 0;
+        bool parsed = ParseRemap(spec, name, remap);
+        while (parsed && i < count && name != configured[i].name)
+            i++;
+        if (!parsed || i == count)
+        {
+            fprintf(stderr, "Invalid remap: %s\n", spec.c_str());
+            return false;
+        }
+        led_remap_set(configured[i].name, &remap);
+    }
+
+    for (const std::string &spec : options.calibrations)
+    {
+        std::string name;
+        led_calibration_config_t calibration;
+        size_t i = 0;
+        bool parsed = ParseCalibration(spec, name, calibration);
+        while (parsed && i < count && name != configured[i].name)
+            i++;
+        if (!parsed || i == count)
+        {
+            fprintf(stderr, "Invalid calibration: %s\n", spec.c_str());
+            return false;
+        }
+        led_calibration_set(configured[i].name, &calibration);
+    }
+
+    persistence_manager_t pm;
+    persistence_manager_init(&pm, "led_config");
+    persistence_manager_set_blob(&pm, "segments", configured, sizeof(led_segment_t) * (count > 0 ? count : 1));
+    persistence_manager_set_int(&pm, "segment_count", (int32_t)count);
+    persistence_manager_deinit(&pm);
+    led_effect_save();
+    led_remap_save();
+    led_calibration_save();
+
+    SETTINGS_SET_INT(LIGHT_VARIANT, options.variant);
+    if (!StoreMode(options.mode))
+        return false;
+
+    led_status_init(CONFIG_STATUS_WLED_PIN);
+    if (led_strip_init() != ESP_OK)
+        return false;
+
+    start_simulation();
+
+    // Bound after led_strip_init(), the script compiles against the loaded segment list
+    for (const std::string &spec : options.scripts)
+    {
+        size_t colon = spec.find(':');
+        led_script_error_t error = {};
+        esp_err_t ret = colon == std::string::npos
+                            ? ESP_ERR_INVALID_ARG
+                            : led_script_bind(spec.substr(0, colon).c_str(), spec.substr(colon + 1).c_str(), &error);
+        if (ret != ESP_OK)
+        {
+            fprintf(stderr, "Invalid script: %s (line %u: %s)\n", spec.c_str(), error.line, error.message);
+            return false;
+        }
+    }
+
+    if (!options.animation.empty())
+    {
+        size_t colon = options.animation.find(':');
+        std::string file = options.animation.substr(0, colon);
+        std::string segment = colon == std::string::npos ? "" : options.animation.substr(colon + 1);
+        if (led_anim_play(file.c_str(), segment.empty() ? nullptr : segment.c_str(), true) != ESP_OK)
+        {
+            fprintf(stderr, "Cannot play %s\n", options.animation.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+void AppSetMode(const std::string &mode)
+{
+    if (StoreMode(mode))
+        start_simulation_with_reload(false);
+}
+
+bool AppPostMode(const std::string &mode)
+{
+    bool active;
+    int32_t lightMode = 0;
+    if (!ModeToSettings(mode, active, lightMode))
+    {
+        fprintf(stderr, "Unknown mode: %s\n", mode.c_str());
+        return false;
+    }
+
+    // Like the light API: the dispatcher stores the settings and the listeners restart the simulation
+    SETTINGS_POST_BOOL(LIGHT_ACTIVE, active, portMAX_DELAY);
+    if (active)
+        SETTINGS_POST_INT(LIGHT_MODE, lightMode, portMAX_DELAY);
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "led_calibration.h"
+#include "led_effect.h"
+#include "led_remap.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scene the desktop and headless builds start with
+struct AppOptions
+{
+    std::string mode = "simulation"; // simulation, day, night or off
+    int variant = 1;                 // schema_XX.csv in the storage folder
+    std::vector<std::string> effects;
+    std::vector<std::string> remaps; // wiring of segments created by effects
+    std::vector<std::string> calibrations; // color correction of segments created by effects
+    std::vector<std::string> scripts; // "segment:file" in the storage folder, on segments created by effects
+    std::string animation; // "file[:segment]" in the storage folder, played in a loop
+};
+
+/**
+ * @brief Parses "name:start:leds:type[:speed[:intensity]]" into a segment with an effect.
+ */
+bool ParseEffect(const std::string &spec, std::string &name, uint16_t &start, uint16_t &leds,
+                 led_effect_config_t &effect);
+
+/**
+ * @brief Parses "name:offset[:r][:skip]" into the wiring of a segment ("r" = reversed).
+ */
+bool ParseRemap(const std::string &spec, std::string &name, led_remap_config_t &remap);
+
+/**
+ * @brief Parses "name:gr,gg,gb[:m0,m1,...,m8]" into the calibration of a segment (gains 0-255, matrix
+ *        coefficients as decimals in row-major order).
+ */
+bool ParseCalibration(const std::string &spec, std::string &name, led_calibration_config_t &calibration);
+
+/**
+ * @brief Boots the LED pipeline like the firmware does and starts the requested scene.
+ *
+ * Must be called from the thread that drives the virtual clock (see host/host.h).
+ */
+bool AppStart(const AppOptions &options);
+
+/**
+ * @brief Switches to another mode while running, as the menu or the API would.
+ */
+void AppSetMode(const std::string &mode);
+
+/**
+ * @brief Switches to another mode by posting the settings messages, as the light API does. Needs the
+ *        message manager and the listener of simulator_subscribe_settings() to take effect.
+ */
+bool AppPostMode(const std::string &mode);
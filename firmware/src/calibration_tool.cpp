@@ -0,0 +1,258 @@
+// Host tool for the color calibration of the output stage (see led_calibration.h):
+//
+//   led_calibration_tool check
+//   led_calibration_tool bench [--leds N] [--seconds S]
+//
+// check compares the fused fixed point kernel with a floating point reference for a set of matrices,
+// gains and brightness scales, and that no pixel draws more than led_calibration_current_gain() allows
+// for the power estimate. bench measures the output loop of the LED task over N pixels (default
+// CONFIG_LED_STRIP_MAX_LEDS) with brightness scaling only, with every pixel calibrated and, for
+// comparison, with the calibration as a separate pass in front of the scaling.
+
+#include "color.h"
+#include "led_calibration.h"
+
+#include <led_strip.h>
+#include <sdkconfig.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using Frame = std::vector<rgb_t>;
+
+static led_calibration_config_t Config(const std::vector<double> &matrix, uint8_t r, uint8_t g, uint8_t b)
+{
+    led_calibration_config_t config;
+    led_calibration_identity(&config);
+    for (size_t i = 0; i < matrix.size(); i++)
+        config.matrix[i] = (int16_t)std::lround(matrix[i] * LED_CALIBRATION_ONE);
+    config.gain[0] = r;
+    config.gain[1] = g;
+    config.gain[2] = b;
+    return config;
+}
+
+static const std::vector<led_calibration_config_t> &Configs()
+{
+    static const std::vector<led_calibration_config_t> configs = {
+        Config({}, 255, 255, 255),
+        Config({}, 255, 236, 198),
+        Config({1.02, -0.04, 0.02, 0.03, 0.91, 0.06, -0.01, 0.05, 0.96}, 250, 240, 230),
+        Config({0.5, 0.3, 0.2, 0.2, 0.6, 0.2, 0.1, 0.1, 0.8}, 255, 255, 255),
+        Config({1.6, -0.3, -0.3, -0.3, 1.6, -0.3, -0.3, -0.3, 1.6}, 255, 255, 255),
+        Config({7.99, -8.0, 0, 0, 0, 0, 0, 0, 0}, 255, 0, 17),
+    };
+    return configs;
+}
+
+// --- check ---
+
+static int Check()
+{
+    int failures = 0;
+    std::mt19937 random(11);
+
+    for (size_t c = 0; c < Configs().size(); c++)
+    {
+        const led_calibration_config_t &config = Configs()[c];
+        uint32_t gain = led_calibration_current_gain(&config);
+        for (int scale : {255, 254, 200, 128, 37, 1, 0})
+        {
+            led_calibration_kernel_t kernel;
+            led_calibration_fuse(&config, (uint8_t)scale, &kernel);
+
+            int worst = 0;
+            for (int n = 0; n < 20000; n++)
+            {
+                uint32_t value = random();
+                rgb_t in = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16)};
+                if (n < 8)
+                    in = rgb_t{(uint8_t)(n & 1 ? 255 : 0), (uint8_t)(n & 2 ? 255 : 0), (uint8_t)(n & 4 ? 255 : 0)};
+                rgb_t out = led_calibration_apply(&kernel, in);
+
+                // The power estimate scales the rendered sums by the gain; rounding adds up to 1.5
+                uint32_t limit = ((in.red + in.green + in.blue) * gain >> LED_CALIBRATION_SHIFT) + 2;
+                if (scale == 255 && (uint32_t)(out.red + out.green + out.blue) > limit)
+                {
+                    fprintf(stderr, "FAIL: config %zu draws more than its current gain %.2f\n", c,
+                            gain / (double)LED_CALIBRATION_ONE);
+                    failures++;
+                    break;
+                }
+
+                const uint8_t channels[3] = {in.red, in.green, in.blue};
+                const uint8_t result[3] = {out.red, out.green, out.blue};
+                for (int row = 0; row < 3; row++)
+                {
+                    double sum = 0;
+                    for (int col = 0; col < 3; col++)
+                        sum += config.matrix[row * 3 + col] / (double)LED_CALIBRATION_ONE * channels[col];
+                    double exact = std::clamp(sum * config.gain[row] / 255.0 * scale / 255.0, 0.0, 255.0);
+                    worst = std::max(worst, (int)std::lround(std::fabs(result[row] - exact) + 0.49));
+                }
+
+                if (c == 0 && scale == 255 && (out.red != in.red || out.green != in.green || out.blue != in.blue))
+                {
+                    fprintf(stderr, "FAIL: identity changes %u,%u,%u\n", in.red, in.green, in.blue);
+                    failures++;
+                    break;
+                }
+                if (c == 0)
+                {
+                    // Without a matrix the fused kernel matches the plain brightness scaling
+                    rgb_t scaled = color_scale(in, (uint8_t)scale);
+                    if (std::abs(scaled.red - out.red) > 1 || std::abs(scaled.blue - out.blue) > 1)
+                    {
+                        fprintf(stderr, "FAIL: scale %d differs from color_scale\n", scale);
+                        failures++;
+                        break;
+                    }
+                }
+            }
+            if (worst > 1)
+            {
+                fprintf(stderr, "FAIL: config %zu, scale %d: off by %d from the exact value\n", c, scale, worst);
+                failures++;
+            }
+        }
+    }
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("calibration checks passed\n");
+    return 0;
+}
+
+// --- bench ---
+
+using Clock = std::chrono::steady_clock;
+
+static double Measure(double seconds, const std::function<void()> &pass)
+{
+    uint64_t passes = 0;
+    Clock::time_point begin = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        for (int k = 0; k < 16; k++, passes++)
+            pass();
+        elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+    return elapsed * 1e6 / passes;
+}
+
+static int Bench(int argc, char **argv)
+{
+    uint32_t leds = CONFIG_LED_STRIP_MAX_LEDS;
+    double seconds = 1.0;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--leds")
+            leds = (uint32_t)std::clamp(atoi(argv[i + 1]), 1, 65535);
+        else if (arg == "--seconds")
+            seconds = atof(argv[i + 1]);
+        else
+            return 2;
+    }
+
+    led_strip_handle_t strip;
+    led_strip_config_t strip_config = {};
+    strip_config.strip_gpio_num = 0;
+    strip_config.max_leds = leds;
+    led_strip_rmt_config_t rmt_config = {};
+    if (led_strip_new_rmt_device(&strip_config, &rmt_config, &strip) != ESP_OK)
+        return 1;
+
+    std::mt19937 random(3);
+    Frame framebuffer(leds), scratch(leds);
+    for (rgb_t &pixel : framebuffer)
+    {
+        uint32_t value = random();
+        pixel = rgb_t{(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16)};
+    }
+
+    // Same shape as the loop in led_strip_ws2812.c: the kernel index comes from a per pixel table
+    std::vector<uint8_t> table(leds, 1);
+    led_calibration_kernel_t kernels[1];
+    const uint8_t scale = 200;
+    led_calibration_fuse(&Configs()[2], scale, &kernels[0]);
+
+    auto output = [&](const uint8_t *calibration, uint8_t brightness) {
+        for (uint32_t i = 0; i < leds; i++)
+        {
+            rgb_t pixel = framebuffer[i];
+            uint8_t kernel = calibration != nullptr ? calibration[i] : 0;
+            if (kernel != 0)
+                pixel = led_calibration_apply(&kernels[kernel - 1], pixel);
+            else if (brightness < 255)
+                pixel = color_scale(pixel, brightness);
+            led_strip_set_pixel(strip, i, pixel.red, pixel.green, pixel.blue);
+        }
+    };
+
+    double plain_us = Measure(seconds, [&] { output(nullptr, 255); });
+    double scaled_us = Measure(seconds, [&] { output(nullptr, scale); });
+    double fused_us = Measure(seconds, [&] { output(table.data(), scale); });
+
+    // Unfused: correction as its own pass over the framebuffer, then the regular output loop
+    led_calibration_kernel_t unscaled;
+    led_calibration_fuse(&Configs()[2], 255, &unscaled);
+    double separate_us = Measure(seconds, [&] {
+        for (uint32_t i = 0; i < leds; i++)
+            scratch[i] = led_calibration_apply(&unscaled, framebuffer[i]);
+        for (uint32_t i = 0; i < leds; i++)
+        {
+            rgb_t pixel = color_scale(scratch[i], scale);
+            led_strip_set_pixel(strip, i, pixel.red, pixel.green, pixel.blue);
+        }
+    });
+
+    double frame_us = 1e6 / CONFIG_LED_EFFECT_FRAME_RATE;
+    printf("output loop over %u pixels\n", leds);
+    printf("  unscaled                 %8.2f us\n", plain_us);
+    printf("  brightness               %8.2f us\n", scaled_us);
+    printf("  calibration (fused)      %8.2f us  %+.2f us, %.3f%% of a frame at %d fps\n", fused_us,
+           fused_us - scaled_us, (fused_us - scaled_us) * 100 / frame_us, CONFIG_LED_EFFECT_FRAME_RATE);
+    printf("  calibration (own pass)   %8.2f us  %+.2f us\n", separate_us, separate_us - scaled_us);
+    printf("  throughput (fused)       %8.1f Mpixel/s\n", leds / fused_us);
+    return 0;
+}
+
+static void Usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s check\n"
+            "       %s bench [--leds N] [--seconds S]\n",
+            program, program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::string command = argv[1];
+    int result = 2;
+    if (command == "check")
+        result = Check();
+    else if (command == "bench")
+        result = Bench(argc - 2, argv + 2);
+
+    if (result == 2)
+        Usage(argv[0]);
+    return result;
+}
@@ -0,0 +1,306 @@
+// Host tool for the integer color math of color.h:
+//
+//   led_color_tool check
+//   led_color_tool bench [--seconds S]
+//
+// check compares the fixed point functions with the floating point versions they replaced, over every
+// input where that is feasible: rgb_to_hsv for all 2^24 colors, hsv_to_rgb for every hue, saturation
+// and value, the RGB interpolation, color_scale and color_blend for every channel pair and a dense set of
+// factors. The HSV interpolation is compared on random color pairs. bench measures the time per call of
+// both versions on the host; CONFIG_COLOR_BENCH logs the CPU cycles of the same calls on the device
+// (main/src/color_bench.cpp). The floating point versions are in color_reference.h.
+
+#include "color.h"
+#include "color_reference.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// --- check ---
+
+static int Distance(rgb_t a, rgb_t b)
+{
+    return std::max({std::abs(a.red - b.red), std::abs(a.green - b.green), std::abs(a.blue - b.blue)});
+}
+
+// Counts the inputs that differ and the largest difference; fails above tolerance
+struct Comparison
+{
+    const char *name;
+    int tolerance;
+    uint64_t inputs = 0;
+    uint64_t differing = 0;
+    int worst = 0;
+
+    void Add(int distance)
+    {
+        inputs++;
+        if (distance != 0)
+            differing++;
+        worst = std::max(worst, distance);
+    }
+
+    bool Report() const
+    {
+        bool ok = worst <= tolerance;
+        printf("  %-22s %10llu inputs, %8llu differ, max %d LSB (allowed %d)%s\n", name,
+               (unsigned long long)inputs, (unsigned long long)differing, worst, tolerance, ok ? "" : "  FAILED");
+        return ok;
+    }
+};
+
+static rgb_t Rgb(uint32_t value)
+{
+    return rgb_t{(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16)};
+}
+
+static int Check()
+{
+    int failures = 0;
+
+    Comparison to_hsv{"rgb_to_hsv", 0};
+    for (uint32_t value = 0; value < (1u << 24); value++)
+    {
+        hsv_t hsv = rgb_to_hsv(Rgb(value));
+        HsvFloat ref = RefRgbToHsv(Rgb(value));
+        to_hsv.Add(std::max({std::abs(hsv.h - (int)ref.h), std::abs(hsv.s - (int)ref.s),
+                             std::abs(hsv.v - (int)ref.v)}));
+    }
+    failures += !to_hsv.Report();
+
+    Comparison to_rgb{"hsv_to_rgb", 1};
+    for (int h = 0; h < HSV_HUE_MAX; h++)
+    {
+        for (int s = 0; s < 256; s++)
+        {
+            for (int v = 0; v < 256; v++)
+            {
+                rgb_t rgb = hsv_to_rgb(hsv_t{(uint8_t)h, (uint8_t)s, (uint8_t)v});
+                to_rgb.Add(Distance(rgb, RefHsvToRgb(HsvFloat{(float)h, (float)s, (float)v})));
+            }
+        }
+    }
+    failures += !to_rgb.Report();
+
+    // Factors that are exact in both representations, plus the ends
+    std::vector<color_fract_t> factors;
+    for (uint32_t factor = 0; factor < COLOR_FRACT_ONE; factor += 97)
+        factors.push_back((color_fract_t)factor);
+    factors.push_back(COLOR_FRACT_ONE);
+
+    Comparison lerp{"interpolate_color_rgb", 0};
+    for (int start = 0; start < 256; start++)
+    {
+        for (int end = 0; end < 256; end++)
+        {
+            rgb_t a = {(uint8_t)start, (uint8_t)end, (uint8_t)(255 - start)};
+            rgb_t b = {(uint8_t)end, (uint8_t)start, (uint8_t)(255 - end)};
+            for (color_fract_t factor : factors)
+            {
+                float f = (float)factor / COLOR_FRACT_ONE;
+                lerp.Add(Distance(interpolate_color_rgb(a, b, factor), RefInterpolateRgb(a, b, f)));
+            }
+        }
+    }
+    failures += !lerp.Report();
+
+    Comparison scale{"color_scale", 0};
+    for (int channel = 0; channel < 256; channel++)
+    {
+        for (int s = 0; s < 256; s++)
+        {
+            rgb_t color = {(uint8_t)channel, (uint8_t)(255 - channel), (uint8_t)(channel ^ 0x5a)};
+            scale.Add(Distance(color_scale(color, (uint8_t)s), RefScale(color, (uint8_t)s)));
+        }
+    }
+    failures += !scale.Report();
+
+    // The float blend truncates background + delta * alpha, the integer one rounds down the weighted sum
+    Comparison blend{"color_blend", 1};
+    for (int background = 0; background < 256; background++)
+    {
+        for (int foreground = 0; foreground < 256; foreground++)
+        {
+            rgb_t a = {(uint8_t)background, (uint8_t)foreground, (uint8_t)(255 - background)};
+            rgb_t b = {(uint8_t)foreground, (uint8_t)background, (uint8_t)(255 - foreground)};
+            for (int alpha = 0; alpha < 256; alpha++)
+                blend.Add(Distance(color_blend(a, b, (uint8_t)alpha), RefBlend(a, b, (uint8_t)alpha)));
+        }
+    }
+    failures += !blend.Report();
+
+    // Saturation and value are interpolated in 8 bits, the float version kept their fraction
+    Comparison lerp_hsv{"interpolate_color_hsv", 2};
+    std::mt19937 random(5);
+    for (int n = 0; n < 200000; n++)
+    {
+        rgb_t a = Rgb(random());
+        rgb_t b = Rgb(random());
+        color_fract_t factor = (color_fract_t)(random() % (COLOR_FRACT_ONE + 1));
+        float f = (float)factor / COLOR_FRACT_ONE;
+        lerp_hsv.Add(Distance(interpolate_color_hsv(a, b, factor), RefInterpolateHsv(a, b, f)));
+    }
+    failures += !lerp_hsv.Report();
+
+    if (failures)
+    {
+        printf("%d color checks failed\n", failures);
+        return 1;
+    }
+    printf("color checks passed\n");
+    return 0;
+}
+
+// --- bench ---
+
+using Clock = std::chrono::steady_clock;
+
+static double Measure(double seconds, const std::function<void()> &pass)
+{
+    uint64_t passes = 0;
+    Clock::time_point begin = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        for (int k = 0; k < 16; k++, passes++)
+            pass();
+        elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+    return elapsed * 1e6 / passes;
+}
+
+static int Bench(int argc, char **argv)
+{
+    double seconds = 1.0;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--seconds")
+            seconds = atof(argv[i + 1]);
+        else
+            return 2;
+    }
+
+    const size_t count = 4096;
+    std::mt19937 random(7);
+    std::vector<rgb_t> colors(count), others(count), out(count);
+    std::vector<hsv_t> hsv(count);
+    std::vector<HsvFloat> hsv_float(count);
+    std::vector<color_fract_t> factors(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        colors[i] = Rgb(random());
+        others[i] = Rgb(random());
+        hsv[i] = hsv_t{(uint8_t)(random() % HSV_HUE_MAX), (uint8_t)random(), (uint8_t)random()};
+        hsv_float[i] = HsvFloat{(float)hsv[i].h, (float)hsv[i].s, (float)hsv[i].v};
+        factors[i] = (color_fract_t)(random() % (COLOR_FRACT_ONE + 1));
+    }
+
+    // The results go to out so that the compiler keeps the calls
+    volatile uint32_t sink = 0;
+    auto row = [&](const char *name, const std::function<void()> &fixed, const std::function<void()> &reference) {
+        double fixed_ns = Measure(seconds, fixed) * 1000 / count;
+        double reference_ns = Measure(seconds, reference) * 1000 / count;
+        printf("  %-22s %8.2f ns %8.2f ns  %5.2fx\n", name, fixed_ns, reference_ns, reference_ns / fixed_ns);
+        sink = sink + out[count / 2].red;
+    };
+
+    printf("per call over %zu inputs     fixed    float\n", count);
+    row(
+        "rgb_to_hsv",
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                hsv[i] = rgb_to_hsv(colors[i]);
+        },
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                hsv_float[i] = RefRgbToHsv(colors[i]);
+        });
+    row(
+        "hsv_to_rgb",
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = hsv_to_rgb(hsv[i]);
+        },
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = RefHsvToRgb(hsv_float[i]);
+        });
+    row(
+        "interpolate_color_rgb",
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = interpolate_color_rgb(colors[i], others[i], factors[i]);
+        },
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = RefInterpolateRgb(colors[i], others[i], (float)factors[i] / COLOR_FRACT_ONE);
+        });
+    row(
+        "interpolate_color_hsv",
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = interpolate_color_hsv(colors[i], others[i], factors[i]);
+        },
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = RefInterpolateHsv(colors[i], others[i], (float)factors[i] / COLOR_FRACT_ONE);
+        });
+    row(
+        "color_scale",
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = color_scale(colors[i], others[i].red);
+        },
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = RefScale(colors[i], others[i].red);
+        });
+    row(
+        "color_blend",
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = color_blend(colors[i], others[i], others[i].green);
+        },
+        [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = RefBlend(colors[i], others[i], others[i].green);
+        });
+    printf("(the host has a single precision FPU like the ESP32-S3; the ESP32-C6 emulates float in software)\n");
+    return 0;
+}
+
+static void Usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s check\n"
+            "       %s bench [--seconds S]\n",
+            program, program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::string command = argv[1];
+    int result = 2;
+    if (command == "check")
+        result = Check();
+    else if (command == "bench")
+        result = Bench(argc - 2, argv + 2);
+
+    if (result == 2)
+        Usage(argv[0]);
+    return result;
+}
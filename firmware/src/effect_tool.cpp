@@ -0,0 +1,248 @@
+// Host tool for the segment effect engine (see led_effect.h and led_segment.h):
+//
+//   led_effect_tool check
+//   led_effect_tool bench [--segments N] [--leds N] [--seconds S]
+//
+// check moves, adds and removes segments while effects are bound to them and checks that the effects
+// follow the published segment list. bench renders N segments (default 15, the maximum) with all
+// effect types over the strip at CONFIG_LED_EFFECT_FRAME_RATE and reports the time per frame, once
+// with a fixed segment list and once with the list published again every second.
+
+#include "color.h"
+#include "led_effect.h"
+#include "led_segment.h"
+
+#include <sdkconfig.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+using Frame = std::vector<rgb_t>;
+
+static const rgb_t kBase = {20, 20, 20};
+
+static led_segment_t Segment(const char *name, uint16_t start, uint16_t leds)
+{
+    led_segment_t segment = {};
+    strncpy(segment.name, name, sizeof(segment.name) - 1);
+    segment.start = start;
+    segment.leds = leds;
+    return segment;
+}
+
+// Renders one frame on the base color, returns the first and one past the last pixel that changed
+static std::pair<size_t, size_t> RenderLit(Frame &frame)
+{
+    std::fill(frame.begin(), frame.end(), kBase);
+    rgb_sum_t sum = {};
+    led_effect_render(frame.data(), frame.size(), &sum);
+
+    size_t first = frame.size(), end = 0;
+    for (size_t i = 0; i < frame.size(); i++)
+    {
+        if (frame[i].red != kBase.red || frame[i].green != kBase.green || frame[i].blue != kBase.blue)
+        {
+            first = std::min(first, i);
+            end = i + 1;
+        }
+    }
+    return {first, end};
+}
+
+// --- check ---
+
+static int Check()
+{
+    int failures = 0;
+    auto expect = [&](bool ok, const char *what) {
+        if (!ok)
+        {
+            printf("FAILED: %s\n", what);
+            failures++;
+        }
+    };
+
+    // Published sorted by start, names always terminated, at most LED_SEGMENT_MAX_LEN entries
+    std::vector<led_segment_t> list = {Segment("c", 40, 10), Segment("a", 0, 10), Segment("b", 20, 10)};
+    memset(list[2].name, 'x', sizeof(list[2].name));
+    led_segment_set(list.data(), list.size());
+    led_segment_list_t published;
+    led_segment_get_all(&published);
+    expect(published.count == 3, "three segments published");
+    expect(published.segments[0].start == 0 && published.segments[1].start == 20 && published.segments[2].start == 40,
+           "segments sorted by start");
+    expect(strlen(published.segments[1].name) == sizeof(published.segments[1].name) - 1, "long name terminated");
+    expect(list[0].start == 40, "caller's list left unsorted");
+
+    std::vector<led_segment_t> many(LED_SEGMENT_MAX_LEN + 5, Segment("many", 0, 1));
+    led_segment_set(many.data(), many.size());
+    led_segment_get_all(&published);
+    expect(published.count == LED_SEGMENT_MAX_LEN, "list clamped to LED_SEGMENT_MAX_LEN");
+
+    // An effect follows its segment when the list is replaced
+    Frame frame(100);
+    led_segment_t lamp = Segment("lamp", 10, 10);
+    led_segment_set(&lamp, 1);
+    led_effect_config_t config = {LED_EFFECT_FIRE, 128, 255, rgb_t{255, 120, 40}};
+    led_effect_set("lamp", &config);
+    led_effect_segments_changed();
+    expect(led_effect_any_active(), "effect active on an existing segment");
+    auto lit = RenderLit(frame);
+    expect(lit.first == 10 && lit.second == 20, "effect renders on its segment");
+
+    led_segment_t moved[2] = {Segment("other", 0, 5), Segment("lamp", 60, 20)};
+    led_segment_set(moved, 2);
+    led_effect_segments_changed();
+    led_segment_t found;
+    expect(led_segment_find("lamp", &found) && found.start == 60 && found.leds == 20, "moved segment found");
+    lit = RenderLit(frame);
+    expect(lit.first == 60 && lit.second == 80, "effect moved with its segment");
+
+    // Removing the segment drops the binding
+    led_segment_set(moved, 1);
+    led_effect_segments_changed();
+    expect(!led_segment_find("lamp", nullptr), "removed segment not found");
+    expect(!led_effect_any_active(), "no effect active after its segment is gone");
+    lit = RenderLit(frame);
+    expect(lit.second == 0, "nothing rendered after the segment is gone");
+
+    led_segment_set(nullptr, 0);
+    led_effect_segments_changed();
+
+    if (failures)
+    {
+        printf("%d effect checks failed\n", failures);
+        return 1;
+    }
+    printf("effect checks passed\n");
+    return 0;
+}
+
+// --- bench ---
+
+using Clock = std::chrono::steady_clock;
+
+// Average time of one call in us, repeated for the given time
+static double Measure(double seconds, const std::function<void(uint32_t frame)> &render)
+{
+    uint32_t frames = 0;
+    Clock::time_point begin = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        for (int k = 0; k < 16; k++)
+            render(frames++);
+        elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+    return elapsed * 1e6 / frames;
+}
+
+static int Bench(int argc, char **argv)
+{
+    uint16_t leds = CONFIG_LED_STRIP_MAX_LEDS;
+    size_t count = LED_SEGMENT_MAX_LEN;
+    double seconds = 1.0;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--leds")
+            leds = (uint16_t)std::clamp(atoi(argv[i + 1]), 1, 65535);
+        else if (arg == "--segments")
+            count = (size_t)std::clamp(atoi(argv[i + 1]), 1, LED_SEGMENT_MAX_LEN);
+        else if (arg == "--seconds")
+            seconds = atof(argv[i + 1]);
+        else
+            return 2;
+    }
+    if (leds < count)
+        count = leds;
+
+    // Adjacent segments over the whole strip, every effect type in turn
+    std::vector<led_segment_t> list;
+    for (size_t s = 0; s < count; s++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "segment%u", (unsigned)s);
+        uint16_t start = (uint16_t)(leds * s / count);
+        uint16_t end = (uint16_t)(leds * (s + 1) / count);
+        list.push_back(Segment(name, start, (uint16_t)(end - start)));
+
+        led_effect_config_t config = {(uint8_t)(LED_EFFECT_LANTERN + s % (LED_EFFECT_COUNT - 1)), 128, 255,
+                                      rgb_t{255, 160, 80}};
+        led_effect_set(name, &config);
+    }
+    led_segment_set(list.data(), list.size());
+    led_effect_segments_changed();
+
+    Frame frame(leds);
+    auto render = [&] {
+        std::fill(frame.begin(), frame.end(), kBase);
+        rgb_sum_t sum = {};
+        led_effect_render(frame.data(), frame.size(), &sum);
+    };
+
+    double fixed_us = Measure(seconds, [&](uint32_t) { render(); });
+    led_effect_stats_t stats;
+    led_effect_get_stats(&stats);
+
+    // Same list published again once per second of frames, as a POST of the configuration does
+    double republished_us = Measure(seconds, [&](uint32_t frame_number) {
+        if (frame_number % CONFIG_LED_EFFECT_FRAME_RATE == 0)
+        {
+            led_segment_set(list.data(), list.size());
+            led_effect_segments_changed();
+        }
+        render();
+    });
+
+    double frame_us = 1e6 / CONFIG_LED_EFFECT_FRAME_RATE;
+    printf("%u segments over %u pixels at %d fps (%.0f us per frame)\n", (unsigned)count, leds,
+           CONFIG_LED_EFFECT_FRAME_RATE, frame_us);
+    printf("  active                   %8u segments, %u pixels\n", stats.active_segments, stats.active_pixels);
+    printf("  render                   %8.2f us  %.3f%% of a frame\n", fixed_us, fixed_us * 100 / frame_us);
+    printf("  render, list published   %8.2f us  %.3f%% of a frame\n", republished_us,
+           republished_us * 100 / frame_us);
+
+    for (const led_segment_t &segment : list)
+    {
+        led_effect_config_t none = {LED_EFFECT_NONE, 0, 0, rgb_t{}};
+        led_effect_set(segment.name, &none);
+    }
+    led_segment_set(nullptr, 0);
+    led_effect_segments_changed();
+    return 0;
+}
+
+static void Usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s check\n"
+            "       %s bench [--segments N] [--leds N] [--seconds S]\n",
+            program, program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::string command = argv[1];
+    int result = 2;
+    if (command == "check")
+        result = Check();
+    else if (command == "bench")
+        result = Bench(argc - 2, argv + 2);
+
+    if (result == 2)
+        Usage(argv[0]);
+    return result;
+}
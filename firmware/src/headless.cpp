@@ -0,0 +1,256 @@
+// Headless run of the LED pipeline: boots simulator, effects, transitions and the power limiter on the
+// host scheduler, renders a span of virtual time as fast as possible and writes the strip frames to a
+// raw file or a PPM image sequence. The frame digest allows regression checks on CI, the task run
+// times show the wall-clock cost of the pipeline.
+
+#include "app.h"
+#include "host/host.h"
+#include "led_anim.h"
+#include "led_effect.h"
+#include "led_power.h"
+#include "led_script.h"
+#include "led_strip_ws2812.h"
+#include "led_transition.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <led_strip.h>
+#include <sdkconfig.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+struct ModeSwitch
+{
+    uint32_t at_ms;
+    std::string mode;
+};
+
+struct Output
+{
+    FILE *raw = nullptr;
+    std::string ppmDir;
+    int cols = 40;
+    int cell = 4;
+    uint32_t every = 1;
+    uint32_t frames = 0;
+    uint32_t written = 0;
+    uint64_t digest = 0xcbf29ce484222325ULL; // FNV-1a 64
+};
+
+static void WritePpm(Output &out, const uint8_t *rgb, size_t count)
+{
+    int rows = (int)((count + out.cols - 1) / out.cols);
+    int width = out.cols * out.cell;
+    int height = rows * out.cell;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/frame_%06" PRIu32 ".ppm", out.ppmDir.c_str(), out.written);
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    std::vector<uint8_t> line(width * 3);
+    for (int row = 0; row < rows; row++)
+    {
+        for (int col = 0; col < out.cols; col++)
+        {
+            size_t index = (size_t)row * out.cols + col;
+            const uint8_t black[3] = {0, 0, 0};
+            const uint8_t *pixel = index < count ? &rgb[index * 3] : black;
+            for (int x = 0; x < out.cell; x++)
+                memcpy(&line[(col * out.cell + x) * 3], pixel, 3);
+        }
+        for (int y = 0; y < out.cell; y++)
+            fwrite(line.data(), 1, line.size(), file);
+    }
+    fclose(file);
+}
+
+static void OnFrame(int gpio, const uint8_t *rgb, size_t count, void *context)
+{
+    // The status LEDs share the driver, only the main strip is recorded
+    if (gpio != CONFIG_WLED_DIN_PIN)
+        return;
+
+    Output &out = *static_cast<Output *>(context);
+    for (size_t i = 0; i < count * 3; i++)
+    {
+        out.digest ^= rgb[i];
+        out.digest *= 0x100000001b3ULL;
+    }
+
+    if (out.frames++ % out.every != 0)
+        return;
+    if (out.raw != nullptr)
+        fwrite(rgb, 3, count, out.raw);
+    if (!out.ppmDir.empty())
+        WritePpm(out, rgb, count);
+    out.written++;
+}
+
+static void Usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --mode MODE         simulation (default), day, night or off\n"
+            "  --variant N         schema_NN.csv from the storage folder (default 1)\n"
+            "  --effect SPEC       name:start:leds:type[:speed[:intensity]], repeatable\n"
+            "  --remap SPEC        name:offset[:r][:skip] wiring of an --effect segment, repeatable\n"
+            "  --calibrate SPEC    name:gr,gg,gb[:m0,...,m8] color correction of an --effect segment\n"
+            "  --script SEG:FILE   run a script from the storage folder on an --effect segment, repeatable\n"
+            "  --anim FILE[:SEG]   loop an animation from the storage folder, on a segment\n"
+            "  --switch MS:MODE    switch the mode after MS ms of virtual time, repeatable\n"
+            "  --duration MS       virtual time to render (default 60000)\n"
+            "  --raw FILE          append every written frame as RGB24 to FILE\n"
+            "  --ppm DIR           write every written frame as DIR/frame_NNNNNN.ppm\n"
+            "  --cols N            pixels per image row for --ppm (default 40)\n"
+            "  --cell N            size of one LED in the image in pixels (default 4)\n"
+            "  --every N           only write every Nth frame (default 1)\n"
+            "  --verbose           show the component log\n",
+            program);
+}
+
+int main(int argc, char **argv)
+{
+    AppOptions options;
+    Output out;
+    std::vector<ModeSwitch> switches;
+    uint32_t duration_ms = 60000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--mode" && hasValue)
+            options.mode = argv[++i];
+        else if (arg == "--variant" && hasValue)
+            options.variant = atoi(argv[++i]);
+        else if (arg == "--effect" && hasValue)
+            options.effects.emplace_back(argv[++i]);
+        else if (arg == "--remap" && hasValue)
+            options.remaps.emplace_back(argv[++i]);
+        else if (arg == "--calibrate" && hasValue)
+            options.calibrations.emplace_back(argv[++i]);
+        else if (arg == "--script" && hasValue)
+            options.scripts.emplace_back(argv[++i]);
+        else if (arg == "--anim" && hasValue)
+            options.animation = argv[++i];
+        else if (arg == "--switch" && hasValue)
+        {
+            std::string spec = argv[++i];
+            size_t colon = spec.find(':');
+            if (colon == std::string::npos)
+            {
+                Usage(argv[0]);
+                return 2;
+            }
+            switches.push_back({(uint32_t)strtoul(spec.c_str(), nullptr, 10), spec.substr(colon + 1)});
+        }
+        else if (arg == "--duration" && hasValue)
+            duration_ms = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--raw" && hasValue)
+        {
+            out.raw = fopen(argv[++i], "wb");
+            if (out.raw == nullptr)
+            {
+                fprintf(stderr, "Cannot open %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (arg == "--ppm" && hasValue)
+            out.ppmDir = argv[++i];
+        else if (arg == "--cols" && hasValue)
+            out.cols = std::max(1, atoi(argv[++i]));
+        else if (arg == "--cell" && hasValue)
+            out.cell = std::max(1, atoi(argv[++i]));
+        else if (arg == "--every" && hasValue)
+            out.every = std::max(1, atoi(argv[++i]));
+        else if (arg == "--verbose")
+            esp_log_level_set("*", ESP_LOG_INFO);
+        else
+        {
+            Usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (!out.ppmDir.empty() && mkdir(out.ppmDir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Cannot create %s\n", out.ppmDir.c_str());
+        return 1;
+    }
+
+    host_led_strip_set_sink(OnFrame, &out);
+    if (!AppStart(options))
+    {
+        // Tasks may already be parked inside the scheduler, see below
+        fflush(nullptr);
+        _exit(1);
+    }
+
+    // Advance the virtual clock in 10 ms steps, mode switches land on the next step
+    const uint32_t step_ms = 10;
+    size_t next_switch = 0;
+    for (uint32_t now_ms = 0; now_ms < duration_ms; now_ms += step_ms)
+    {
+        while (next_switch < switches.size() && switches[next_switch].at_ms <= now_ms)
+        {
+            AppSetMode(switches[next_switch].mode);
+            next_switch++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(step_ms));
+    }
+
+    if (out.raw != nullptr)
+        fclose(out.raw);
+
+    led_strip_stats_t strip;
+    led_effect_stats_t effects;
+    led_script_stats_t scripts;
+    led_transition_stats_t transition;
+    led_power_stats_t power;
+    led_anim_stats_t animation;
+    led_strip_get_stats(&strip);
+    led_effect_get_stats(&effects);
+    led_script_get_stats(&scripts);
+    led_transition_get_stats(&transition);
+    led_power_get_stats(&power);
+    led_anim_get_stats(&animation);
+
+    int64_t pipeline_us = host_task_run_time_us("led_strip_task");
+    printf("frames            %" PRIu32 " (%" PRIu32 " written)\n", out.frames, out.written);
+    printf("virtual time      %" PRIu32 " ms\n", duration_ms);
+    printf("digest            %016" PRIx64 "\n", out.digest);
+    printf("led_strip_task    %lld us, %.1f us/frame\n", (long long)pipeline_us,
+           out.frames > 0 ? (double)pipeline_us / out.frames : 0.0);
+    printf("strip commands    %" PRIu32 " (%" PRIu32 " dropped)\n", strip.commands, strip.dropped_commands);
+    printf("effects           %u segments, %u pixels, %" PRIu32 " frames\n", effects.active_segments,
+           effects.active_pixels, effects.frames);
+    printf("scripts           %u segments, %" PRIu32 " instructions/frame, %" PRIu32 " over budget\n",
+           scripts.active_segments, scripts.instructions, scripts.budget_frames);
+    printf("transitions       %" PRIu32 " (%" PRIu32 " frames)\n", transition.transitions, transition.frames);
+    printf("animation         %" PRIu32 " frames, %" PRIu32 " skipped, %" PRIu32 " underruns, %" PRIu32 " errors\n",
+           animation.frames, animation.skipped, animation.underruns, animation.errors);
+    printf("power             %" PRIu32 " mA estimated, %" PRIu32 " mA output, scale %u\n", power.estimate_ma,
+           power.output_ma, power.scale);
+    printf("\n");
+    host_scheduler_report(stdout);
+
+    // The other tasks are still parked inside the scheduler, skip static destructors
+    fflush(nullptr);
+    _exit(0);
+}
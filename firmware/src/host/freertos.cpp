@@ -0,0 +1,404 @@
+// Deterministic FreeRTOS replacement for the desktop build.
+//
+// Every task is a detached pthread, but only the task holding the baton (`current`) runs; all others
+// wait on the shared condition variable. A task gives the baton away only when it blocks, yields or
+// ends, just like a single core without preemption. When no task is ready the virtual clock jumps to
+// the earliest timeout, so a simulated day takes as long as its rendering, not 24 hours.
+
+#include "host.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+struct host_task
+{
+    std::string name;
+    TaskFunction_t function = nullptr;
+    void *arg = nullptr;
+    uint32_t notify_value = 0;
+    int64_t wake_us = INT64_MAX;
+    bool waiting_for_notify = false;
+    eTaskState state = eReady;
+    std::chrono::steady_clock::duration run_time{};
+    uint32_t switches = 0;
+};
+
+struct host_semaphore
+{
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+static constexpr int64_t TICK_US = 1000000 / configTICK_RATE_HZ;
+
+static std::mutex lock;
+static std::condition_variable baton;
+static host_task *current = nullptr;
+static std::deque<host_task *> ready_tasks;
+static std::vector<host_task *> blocked_tasks;
+static std::vector<host_task *> all_tasks;
+static std::atomic<int64_t> now_us{0};
+static std::chrono::steady_clock::time_point running_since;
+
+static int64_t deadline_after(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? INT64_MAX : now_us.load() + (int64_t)ticks * TICK_US;
+}
+
+static void make_ready(host_task *task)
+{
+    auto it = std::find(blocked_tasks.begin(), blocked_tasks.end(), task);
+    if (it != blocked_tasks.end())
+    {
+        blocked_tasks.erase(it);
+    }
+    task->state = eReady;
+    task->waiting_for_notify = false;
+    ready_tasks.push_back(task);
+}
+
+// Hands the baton to the next task; must be called with the lock held by the running task
+static void switch_to_next(void)
+{
+    auto now = std::chrono::steady_clock::now();
+    current->run_time += now - running_since;
+
+    if (ready_tasks.empty())
+    {
+        auto earliest = std::min_element(blocked_tasks.begin(), blocked_tasks.end(),
+                                         [](const host_task *a, const host_task *b) { return a->wake_us < b->wake_us; });
+        if (earliest == blocked_tasks.end() || (*earliest)->wake_us == INT64_MAX)
+        {
+            fprintf(stderr, "host scheduler: all tasks are blocked forever\n");
+            abort();
+        }
+
+        // Nothing can run before the next timeout, so time jumps there
+        int64_t wake_us = (*earliest)->wake_us;
+        if (wake_us > now_us.load())
+        {
+            now_us.store(wake_us);
+        }
+        std::vector<host_task *> due;
+        for (host_task *task : blocked_tasks)
+        {
+            if (task->wake_us <= wake_us)
+                due.push_back(task);
+        }
+        for (host_task *task : due)
+        {
+            make_ready(task);
+        }
+    }
+
+    current = ready_tasks.front();
+    ready_tasks.pop_front();
+    current->state = eRunning;
+    current->switches++;
+    running_since = now;
+    baton.notify_all();
+}
+
+// Waits until the scheduler hands the baton back to self; ends the thread if it was deleted meanwhile
+static void wait_for_baton(std::unique_lock<std::mutex> &guard, host_task *self)
+{
+    baton.wait(guard, [self] { return current == self || self->state == eDeleted; });
+    if (self->state == eDeleted)
+    {
+        guard.unlock();
+        pthread_exit(nullptr);
+    }
+}
+
+static void block_current(std::unique_lock<std::mutex> &guard, int64_t wake_us, bool for_notify)
+{
+    host_task *self = current;
+    self->state = eBlocked;
+    self->wake_us = wake_us;
+    self->waiting_for_notify = for_notify;
+    blocked_tasks.push_back(self);
+    switch_to_next();
+    wait_for_baton(guard, self);
+}
+
+static void *task_entry(void *arg)
+{
+    host_task *self = static_cast<host_task *>(arg);
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        wait_for_baton(guard, self);
+    }
+
+    self->function(self->arg);
+
+    // A FreeRTOS task must not return, treat it like vTaskDelete(NULL)
+    vTaskDelete(nullptr);
+    return nullptr;
+}
+
+void host_scheduler_init(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (current != nullptr)
+        return;
+
+    host_task *main_task = new host_task();
+    main_task->name = "main";
+    main_task->state = eRunning;
+    all_tasks.push_back(main_task);
+    current = main_task;
+    running_since = std::chrono::steady_clock::now();
+}
+
+void host_scheduler_report(FILE *out)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto now = std::chrono::steady_clock::now();
+    fprintf(out, "%-20s %12s %10s\n", "task", "cpu_us", "switches");
+    for (const host_task *task : all_tasks)
+    {
+        auto run_time = task->run_time + (task == current ? now - running_since : std::chrono::steady_clock::duration{});
+        fprintf(out, "%-20s %12lld %10u\n", task->name.c_str(),
+                (long long)std::chrono::duration_cast<std::chrono::microseconds>(run_time).count(), task->switches);
+    }
+}
+
+int64_t host_task_run_time_us(const char *name)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto now = std::chrono::steady_clock::now();
+    for (const host_task *task : all_tasks)
+    {
+        if (task->name == name)
+        {
+            auto run_time = task->run_time + (task == current ? now - running_since : std::chrono::steady_clock::duration{});
+            return std::chrono::duration_cast<std::chrono::microseconds>(run_time).count();
+        }
+    }
+    return -1;
+}
+
+void host_task_consume_us(int64_t us)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    now_us.store(now_us.load() + std::max<int64_t>(us, 0));
+
+    std::vector<host_task *> due;
+    for (host_task *task : blocked_tasks)
+    {
+        if (task->wake_us <= now_us.load())
+            due.push_back(task);
+    }
+    for (host_task *task : due)
+    {
+        make_ready(task);
+    }
+}
+
+extern "C" int64_t esp_timer_get_time(void)
+{
+    return now_us.load();
+}
+
+// --- Tasks ---
+
+extern "C" BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                                              void *arg, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    host_task *task = new host_task();
+    // Cut like the task control block of FreeRTOS does, so names read back match the device
+    task->name = std::string(name ? name : "task").substr(0, configMAX_TASK_NAME_LEN - 1);
+    task->function = function;
+    task->arg = arg;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    // Host stacks are larger than the FreeRTOS ones (given in bytes on ESP-IDF), keep the glibc default
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        all_tasks.push_back(task);
+        ready_tasks.push_back(task);
+    }
+
+    pthread_t thread;
+    int result = pthread_create(&thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (result != 0)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ready_tasks.erase(std::find(ready_tasks.begin(), ready_tasks.end(), task));
+        task->state = eDeleted;
+        return pdFAIL;
+    }
+
+    if (handle != nullptr)
+        *handle = task;
+    return pdPASS;
+}
+
+extern "C" BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                                  UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(function, name, stack_depth, arg, priority, handle, 0);
+}
+
+extern "C" void vTaskDelete(TaskHandle_t task)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    host_task *target = task != nullptr ? task : current;
+
+    if (target != current)
+    {
+        // The thread wakes up in wait_for_baton() and ends itself
+        auto ready = std::find(ready_tasks.begin(), ready_tasks.end(), target);
+        if (ready != ready_tasks.end())
+            ready_tasks.erase(ready);
+        auto blocked = std::find(blocked_tasks.begin(), blocked_tasks.end(), target);
+        if (blocked != blocked_tasks.end())
+            blocked_tasks.erase(blocked);
+        target->state = eDeleted;
+        baton.notify_all();
+        return;
+    }
+
+    target->state = eDeleted;
+    switch_to_next();
+    guard.unlock();
+    pthread_exit(nullptr);
+}
+
+extern "C" void vTaskDelay(TickType_t ticks)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (ticks == 0)
+    {
+        // Plain yield: queue up behind all ready tasks
+        host_task *self = current;
+        self->state = eReady;
+        ready_tasks.push_back(self);
+        switch_to_next();
+        wait_for_baton(guard, self);
+        return;
+    }
+    block_current(guard, deadline_after(ticks), false);
+}
+
+extern "C" TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us.load() / TICK_US);
+}
+
+extern "C" TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current;
+}
+
+extern "C" eTaskState eTaskGetState(TaskHandle_t task)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return task != nullptr ? task->state : eInvalid;
+}
+
+// --- Notifications ---
+
+extern "C" uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    host_task *self = current;
+    if (self->notify_value == 0 && ticks > 0)
+    {
+        block_current(guard, deadline_after(ticks), true);
+    }
+
+    uint32_t value = self->notify_value;
+    if (value > 0)
+    {
+        self->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+extern "C" BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    task->notify_value++;
+    if (task->state == eBlocked && task->waiting_for_notify)
+    {
+        make_ready(task);
+    }
+    return pdPASS;
+}
+
+extern "C" void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken != nullptr)
+        *higher_priority_task_woken = pdFALSE;
+}
+
+// --- Semaphores ---
+
+extern "C" SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return new host_semaphore{1, 1};
+}
+
+extern "C" SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return new host_semaphore{0, 1};
+}
+
+extern "C" SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    return new host_semaphore{initial_count, max_count};
+}
+
+extern "C" BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    int64_t deadline = deadline_after(ticks);
+    for (;;)
+    {
+        if (semaphore->count > 0)
+        {
+            semaphore->count--;
+            return pdTRUE;
+        }
+        if (now_us.load() >= deadline)
+        {
+            return pdFALSE;
+        }
+        // Only the holder can give it back and it has to run for that; poll once per tick
+        block_current(guard, std::min(deadline, now_us.load() + TICK_US), false);
+    }
+}
+
+extern "C" BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (semaphore->count >= semaphore->max_count)
+        return pdFALSE;
+    semaphore->count++;
+    return pdTRUE;
+}
+
+extern "C" void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    delete semaphore;
+}
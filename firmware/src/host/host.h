@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    /**
+     * @brief Turns the calling thread into the "main" task of the host scheduler.
+     *
+     * Must be called before any FreeRTOS function. The main task advances the virtual clock by
+     * blocking, e.g. vTaskDelay(pdMS_TO_TICKS(20)) renders the next 20 ms of all other tasks.
+     */
+    void host_scheduler_init(void);
+
+    /**
+     * @brief Lets virtual time pass while the calling task keeps running, as if it computed for us microseconds.
+     *
+     * Tasks whose timeout expires meanwhile become ready and run when the caller blocks or yields.
+     */
+    void host_task_consume_us(int64_t us);
+
+    /**
+     * @brief Prints the wall-clock CPU time every task spent running.
+     */
+    void host_scheduler_report(FILE *out);
+
+    /**
+     * @brief Returns the wall-clock CPU time of the task with the given name in us, -1 if unknown. Names are
+     *        cut to configMAX_TASK_NAME_LEN - 1 characters like on the device.
+     */
+    int64_t host_task_run_time_us(const char *name);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+// Only the handle type, for headers that mention the HTTP server. The desktop build has no server; tools
+// that link code calling it provide the functions they need (see message_tool.cpp).
+
+typedef void *httpd_handle_t;
@@ -0,0 +1,21 @@
+#pragma once
+
+// The desktop build reads the storage folder of the repository directly, there is nothing to mount
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct
+{
+    const char *base_path;
+    const char *partition_label;
+    size_t max_files;
+    bool format_if_mount_failed;
+} esp_vfs_spiffs_conf_t;
+
+static inline esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t *conf)
+{
+    (void)conf;
+    return ESP_OK;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    typedef void (*shutdown_handler_t)(void);
+
+    /**
+     * @brief Registers a function that esp_restart() calls before the restart.
+     */
+    esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+
+    /**
+     * @brief Runs the shutdown handlers and ends the process with exit code 0.
+     */
+    void esp_restart(void) __attribute__((noreturn));
+#ifdef __cplusplus
+}
+#endif
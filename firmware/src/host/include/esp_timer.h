@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    /**
+     * @brief Virtual time of the host scheduler in microseconds (see host/freertos.cpp).
+     */
+    int64_t esp_timer_get_time(void);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum
+{
+    eRunning,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+} eTaskState;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                                       UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+    BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                           UBaseType_t priority, TaskHandle_t *handle);
+    void vTaskDelete(TaskHandle_t task);
+    void vTaskDelay(TickType_t ticks);
+    TickType_t xTaskGetTickCount(void);
+    TaskHandle_t xTaskGetCurrentTaskHandle(void);
+    eTaskState eTaskGetState(TaskHandle_t task);
+
+    uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+    BaseType_t xTaskNotifyGive(TaskHandle_t task);
+    void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+// Host replacement of the NVS API: values live in memory for the lifetime of the process (host/nvs.cpp)
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_TYPE_MISMATCH (ESP_ERR_NVS_BASE + 0x03)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_KEY_TOO_LONG (ESP_ERR_NVS_BASE + 0x13)
+
+#define NVS_DEFAULT_PART_NAME "nvs"
+
+typedef uint32_t nvs_handle_t;
+typedef struct host_nvs_iterator *nvs_iterator_t;
+
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+
+typedef enum
+{
+    NVS_TYPE_U8 = 0x01,
+    NVS_TYPE_I32 = 0x14,
+    NVS_TYPE_STR = 0x21,
+    NVS_TYPE_BLOB = 0x42,
+    NVS_TYPE_ANY = 0xff
+} nvs_type_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    esp_err_t nvs_open(const char *name_space, nvs_open_mode_t open_mode, nvs_handle_t *out_handle);
+    void nvs_close(nvs_handle_t handle);
+    esp_err_t nvs_commit(nvs_handle_t handle);
+    esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key);
+    esp_err_t nvs_erase_all(nvs_handle_t handle);
+
+    esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value);
+    esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value);
+    esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value);
+    esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+    esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value);
+    esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *out_value);
+    esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length);
+    esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length);
+
+    esp_err_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type,
+                             nvs_iterator_t *output_iterator);
+    esp_err_t nvs_entry_next(nvs_iterator_t *iterator);
+    void nvs_release_iterator(nvs_iterator_t iterator);
+#ifdef __cplusplus
+}
+#endif
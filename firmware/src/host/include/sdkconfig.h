@@ -0,0 +1,26 @@
+#pragma once
+
+// Configuration of the desktop build, mirrors the Kconfig defaults of the components
+
+#define CONFIG_FREERTOS_NUMBER_OF_CORES 1
+
+#define CONFIG_WLED_DIN_PIN 14
+#define CONFIG_STATUS_WLED_PIN 2
+#define CONFIG_LED_STRIP_MAX_LEDS 800
+#define CONFIG_LED_STRIP_MODEL_WS2812 1
+#define CONFIG_LED_STRIP_WHITE_KELVIN 4500
+#define CONFIG_LED_EFFECT_FRAME_RATE 50
+#define CONFIG_LED_ANIM_RING_FRAMES 3
+#define CONFIG_LED_SCRIPT_MAX 4
+#define CONFIG_LED_SCRIPT_BUDGET 16000
+#define CONFIG_LED_REALTIME_ENABLE 1
+#define CONFIG_LED_REALTIME_TIMEOUT_MS 2500
+#define CONFIG_LED_REALTIME_DDP_PORT 4048
+#define CONFIG_LED_REALTIME_E131_UNIVERSE 1
+#define CONFIG_LED_TRANSITION_DURATION_MS 800
+#define CONFIG_LED_TRANSITION_EASE_IN_OUT 1
+#define CONFIG_LED_POWER_BUDGET_MA 4000
+#define CONFIG_LED_POWER_CHANNEL_MA 20
+#define CONFIG_LED_POWER_IDLE_UA 1000
+#define CONFIG_PERSISTENCE_WRITE_DELAY_MS 1000
+#define CONFIG_PERSISTENCE_WRITE_MAX_DELAY_MS 5000
@@ -0,0 +1,73 @@
+// In-memory LED strip for the desktop build; every refresh is handed to the installed sink
+
+#include <led_strip.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+struct host_led_strip
+{
+    int gpio;
+    std::vector<uint8_t> pixels;
+};
+
+static host_led_strip_sink_t sink = nullptr;
+static void *sink_context = nullptr;
+
+extern "C"
+{
+    void host_led_strip_set_sink(host_led_strip_sink_t new_sink, void *context)
+    {
+        sink = new_sink;
+        sink_context = context;
+    }
+
+    esp_err_t led_strip_new_rmt_device(const led_strip_config_t *config, const led_strip_rmt_config_t *rmt_config,
+                                       led_strip_handle_t *handle)
+    {
+        if (config == nullptr || handle == nullptr || config->max_leds == 0)
+            return ESP_ERR_INVALID_ARG;
+        *handle = new host_led_strip{config->strip_gpio_num, std::vector<uint8_t>(config->max_leds * 3, 0)};
+        return ESP_OK;
+    }
+
+    esp_err_t led_strip_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green,
+                                  uint32_t blue)
+    {
+        if (index * 3 >= strip->pixels.size())
+            return ESP_ERR_INVALID_ARG;
+        uint8_t *pixel = &strip->pixels[index * 3];
+        pixel[0] = (uint8_t)red;
+        pixel[1] = (uint8_t)green;
+        pixel[2] = (uint8_t)blue;
+        return ESP_OK;
+    }
+
+    esp_err_t led_strip_set_pixel_rgbw(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green,
+                                       uint32_t blue, uint32_t white)
+    {
+        // The sink only knows RGB, the white LED is shown as neutral white on top
+        return led_strip_set_pixel(strip, index, std::min<uint32_t>(red + white, 255),
+                                   std::min<uint32_t>(green + white, 255), std::min<uint32_t>(blue + white, 255));
+    }
+
+    esp_err_t led_strip_refresh(led_strip_handle_t strip)
+    {
+        if (sink != nullptr)
+            sink(strip->gpio, strip->pixels.data(), strip->pixels.size() / 3, sink_context);
+        return ESP_OK;
+    }
+
+    esp_err_t led_strip_clear(led_strip_handle_t strip)
+    {
+        memset(strip->pixels.data(), 0, strip->pixels.size());
+        return led_strip_refresh(strip);
+    }
+
+    esp_err_t led_strip_del(led_strip_handle_t strip)
+    {
+        delete strip;
+        return ESP_OK;
+    }
+}
@@ -0,0 +1,207 @@
+// In-memory NVS for the desktop build, so the real persistence manager runs unchanged
+
+#include <nvs.h>
+#include <nvs_flash.h>
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct Entry
+{
+    nvs_type_t type;
+    std::vector<uint8_t> data;
+};
+
+using Namespace = std::map<std::string, Entry>;
+
+std::mutex lock;
+std::vector<std::string> handles; // handle - 1 = index
+std::map<std::string, Namespace> storage;
+
+Namespace *find_namespace(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > handles.size())
+        return nullptr;
+    return &storage[handles[handle - 1]];
+}
+
+esp_err_t set_value(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t length)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    Namespace *ns = find_namespace(handle);
+    if (ns == nullptr)
+        return ESP_ERR_INVALID_ARG;
+    const uint8_t *bytes = static_cast<const uint8_t *>(value);
+    (*ns)[key] = Entry{type, std::vector<uint8_t>(bytes, bytes + length)};
+    return ESP_OK;
+}
+
+esp_err_t get_value(nvs_handle_t handle, const char *key, nvs_type_t type, void *out_value, size_t *length)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    Namespace *ns = find_namespace(handle);
+    if (ns == nullptr)
+        return ESP_ERR_INVALID_ARG;
+    auto it = ns->find(key);
+    if (it == ns->end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (it->second.type != type)
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+
+    size_t size = it->second.data.size();
+    if (out_value == nullptr)
+    {
+        *length = size;
+        return ESP_OK;
+    }
+    if (*length < size)
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out_value, it->second.data.data(), size);
+    *length = size;
+    return ESP_OK;
+}
+} // namespace
+
+struct host_nvs_iterator
+{
+    std::vector<std::string> keys;
+    size_t position;
+};
+
+extern "C"
+{
+    esp_err_t nvs_flash_init(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t nvs_flash_erase(void)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        storage.clear();
+        return ESP_OK;
+    }
+
+    esp_err_t nvs_open(const char *name_space, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        handles.emplace_back(name_space);
+        *out_handle = (nvs_handle_t)handles.size();
+        return ESP_OK;
+    }
+
+    void nvs_close(nvs_handle_t handle)
+    {
+    }
+
+    esp_err_t nvs_commit(nvs_handle_t handle)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        Namespace *ns = find_namespace(handle);
+        if (ns == nullptr)
+            return ESP_ERR_INVALID_ARG;
+        return ns->erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    esp_err_t nvs_erase_all(nvs_handle_t handle)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        Namespace *ns = find_namespace(handle);
+        if (ns == nullptr)
+            return ESP_ERR_INVALID_ARG;
+        ns->clear();
+        return ESP_OK;
+    }
+
+    esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+    {
+        return set_value(handle, key, NVS_TYPE_U8, &value, sizeof(value));
+    }
+
+    esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value)
+    {
+        return set_value(handle, key, NVS_TYPE_I32, &value, sizeof(value));
+    }
+
+    esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+    {
+        return set_value(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+    }
+
+    esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+    {
+        return set_value(handle, key, NVS_TYPE_BLOB, value, length);
+    }
+
+    esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+    {
+        size_t length = sizeof(*out_value);
+        return get_value(handle, key, NVS_TYPE_U8, out_value, &length);
+    }
+
+    esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *out_value)
+    {
+        size_t length = sizeof(*out_value);
+        return get_value(handle, key, NVS_TYPE_I32, out_value, &length);
+    }
+
+    esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+    {
+        return get_value(handle, key, NVS_TYPE_STR, out_value, length);
+    }
+
+    esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+    {
+        return get_value(handle, key, NVS_TYPE_BLOB, out_value, length);
+    }
+
+    esp_err_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type,
+                             nvs_iterator_t *output_iterator)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto ns = storage.find(namespace_name);
+        *output_iterator = nullptr;
+        if (ns == storage.end())
+            return ESP_ERR_NVS_NOT_FOUND;
+
+        auto *it = new host_nvs_iterator{{}, 0};
+        for (const auto &entry : ns->second)
+        {
+            if (type == NVS_TYPE_ANY || entry.second.type == type)
+                it->keys.push_back(entry.first);
+        }
+        if (it->keys.empty())
+        {
+            delete it;
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+        *output_iterator = it;
+        return ESP_OK;
+    }
+
+    esp_err_t nvs_entry_next(nvs_iterator_t *iterator)
+    {
+        if (++(*iterator)->position >= (*iterator)->keys.size())
+        {
+            delete *iterator;
+            *iterator = nullptr;
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+        return ESP_OK;
+    }
+
+    void nvs_release_iterator(nvs_iterator_t iterator)
+    {
+        delete iterator;
+    }
+}
@@ -0,0 +1,166 @@
+// Desktop application: runs the LED pipeline on the host scheduler in real time and shows the main strip
+// as a grid. Keys: S = simulation, D = day, N = night, O = off, Esc = quit.
+
+#include "Matrix.h"
+#include "app.h"
+
+#include <SDL3/SDL.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <led_strip.h>
+#include <sdkconfig.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+struct Frame
+{
+    std::vector<uint8_t> pixels;
+    bool dirty = false;
+};
+
+static void OnFrame(int gpio, const uint8_t *rgb, size_t count, void *context)
+{
+    if (gpio != CONFIG_WLED_DIN_PIN)
+        return;
+
+    // Called by the LED task while the main task waits in vTaskDelay, so no lock is needed
+    Frame &frame = *static_cast<Frame *>(context);
+    frame.pixels.assign(rgb, rgb + count * 3);
+    frame.dirty = true;
+}
+
+static const char *ModeForKey(SDL_Keycode key)
+{
+    switch (key)
+    {
+    case SDLK_S:
+        return "simulation";
+    case SDLK_D:
+        return "day";
+    case SDLK_N:
+        return "night";
+    case SDLK_O:
+        return "off";
+    default:
+        return nullptr;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    AppOptions options;
+    int cols = 40;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--mode" && hasValue)
+            options.mode = argv[++i];
+        else if (arg == "--variant" && hasValue)
+            options.variant = atoi(argv[++i]);
+        else if (arg == "--effect" && hasValue)
+            options.effects.emplace_back(argv[++i]);
+        else if (arg == "--remap" && hasValue)
+            options.remaps.emplace_back(argv[++i]);
+        else if (arg == "--calibrate" && hasValue)
+            options.calibrations.emplace_back(argv[++i]);
+        else if (arg == "--script" && hasValue)
+            options.scripts.emplace_back(argv[++i]);
+        else if (arg == "--anim" && hasValue)
+            options.animation = argv[++i];
+        else if (arg == "--cols" && hasValue)
+            cols = std::clamp(atoi(argv[++i]), 1, 255);
+        else if (arg == "--verbose")
+            esp_log_level_set("*", ESP_LOG_INFO);
+        else
+        {
+            fprintf(stderr,
+                    "Usage: %s [--mode simulation|day|night|off] [--variant N] "
+                    "[--effect name:start:leds:type[:speed[:intensity]]] [--remap name:offset[:r][:skip]] "
+                    "[--calibrate name:gr,gg,gb[:m0,...,m8]] [--script name:file] [--anim file[:segment]] "
+                    "[--cols N] [--verbose]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    int rows = std::min(255, (CONFIG_LED_STRIP_MAX_LEDS + cols - 1) / cols);
+
+    if (!SDL_Init(SDL_INIT_VIDEO))
+    {
+        fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    SDL_Window *window = nullptr;
+    SDL_Renderer *renderer = nullptr;
+    if (!SDL_CreateWindowAndRenderer("System Control", (int)Matrix::PixelSize(cols), (int)Matrix::PixelSize(rows), 0,
+                                     &window, &renderer))
+    {
+        fprintf(stderr, "SDL_CreateWindowAndRenderer failed: %s\n", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+    SDL_SetRenderVSync(renderer, 1);
+
+    Matrix matrix(SDL_GetWindowID(window), renderer, (uint8_t)cols, (uint8_t)rows);
+
+    Frame frame;
+    host_led_strip_set_sink(OnFrame, &frame);
+    if (!AppStart(options))
+    {
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        fflush(nullptr);
+        _exit(1);
+    }
+
+    bool running = true;
+    Uint64 last = SDL_GetTicks();
+    while (running)
+    {
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+        {
+            if (event.type == SDL_EVENT_QUIT ||
+                (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_ESCAPE))
+            {
+                running = false;
+            }
+            else if (event.type == SDL_EVENT_KEY_DOWN)
+            {
+                const char *mode = ModeForKey(event.key.key);
+                if (mode != nullptr)
+                    AppSetMode(mode);
+            }
+        }
+
+        // Let the firmware tasks catch up with the wall clock
+        Uint64 now = SDL_GetTicks();
+        Uint64 elapsed = std::clamp<Uint64>(now - last, 1, 100);
+        last = now;
+        vTaskDelay(pdMS_TO_TICKS(elapsed));
+
+        if (frame.dirty)
+        {
+            matrix.SetPixels(frame.pixels.data(), frame.pixels.size() / 3);
+            frame.dirty = false;
+        }
+        matrix.Render();
+    }
+
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    // The firmware tasks are still parked inside the scheduler, skip static destructors
+    fflush(nullptr);
+    _exit(0);
+}
@@ -0,0 +1,1071 @@
+// Host tool for the message manager (see message_manager.h):
+//
+//   message_tool load [--rounds N] [--burst N] [--work US]
+//   message_tool isolation [--rounds N] [--burst N] [--work US]
+//   message_tool coalesce [--rounds N] [--burst N]
+//   message_tool trace [--rounds N] [--burst N] [--work MS]
+//   message_tool ring [--rounds N] [--burst N]
+//   message_tool record FILE [--duration MS] [--bytes N] [--switch MS:MODE]...
+//   message_tool replay FILE [--speed X] [--work NAME=US]...
+//
+// load measures how long a button press waits behind simulation traffic. Every round posts a burst
+// of simulation updates with one button press at a random position, then lets the dispatcher drain
+// them. Each simulation callback busy-waits --work microseconds, about what the status broadcast
+// costs on the device. The run is made twice, first with every type in one lane (the former FIFO)
+// and then with the priority lanes; it fails if a button press waits for more than one message.
+//
+// isolation posts bursts of simulation updates to a fast listener and a slow one (--work us per
+// call, default 500). The slow listener runs in the dispatcher first and then on its own executor
+// with a coalescing inbox. It fails if the fast listener still waits for the slow one on the executor.
+//
+// coalesce posts bursts of simulation updates while the dispatcher is busy, moving them to another lane
+// in the middle of every other burst. It fails if more than one update waits at a time or the listener
+// gets anything but the newest color of a burst. Then it turns coalescing on in the middle of bursts
+// and fails unless the last color delivered of every burst is the newest.
+//
+// trace posts bursts of button presses to a listener in the dispatcher that sleeps --work ms per call
+// and to one on an executor that sleeps half as long. On the virtual clock of the host scheduler the
+// timings are exact, so it fails unless the histograms show every call, the sleep as run time and the
+// burst queued up behind it as wait.
+//
+// ring has three tasks post bursts through message_manager_post_from_isr(), more per round than the ring
+// holds. It fails if a message of a producer overtakes an earlier one or a rejected post is not counted.
+// Then it fills every message slot with executors that hold on to their inbox and checks that the
+// ring waits for a free slot and is drained as soon as one is released.
+//
+// record runs the simulation for --duration ms of virtual time (default 10 minutes) and saves the
+// posted messages as a message log, the format /api/diagnostics/messages/log downloads from a device.
+// --switch posts the settings of a mode (simulation, day, night or off) after MS ms, as the light API does.
+//
+// replay posts the messages of a log at their recorded times, divided by --speed (0 = back to back), to
+// the listeners of the firmware and reports calls, throughput and latency per listener from the
+// dispatch trace. The simulation restart of the simulator and, if cJSON was found, the status broadcast
+// of bifrost/common.c run for real on their executors, api_server_ws_broadcast() only counts what would
+// be sent. Their work takes no virtual time, so the table shows it as host CPU time per call. The app
+// task has no host build; its listeners and the status broadcast without cJSON are modeled: subscribed
+// like on the device, a call takes --work us of virtual time (estimates from the device trace by default)
+// and they are marked as modeled in the table.
+//
+// load and isolation turn the coalescing of simulation updates off, so every update is delivered.
+
+#include "app.h"
+#include "host/host.h"
+#include "message_manager.h"
+#include "settings_registry.h"
+#include "simulator.h"
+
+#ifdef MESSAGE_TOOL_STATUS_JSON
+#include "bifrost/api_server.h"
+#include "bifrost/common.h"
+#endif
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    int rounds = 2000;
+    int burst = 24;
+    int work_us = 50;
+};
+
+struct Result
+{
+    std::vector<double> latency_us; // post to listener call, wall clock
+    std::vector<int> ahead;         // messages dispatched between post and listener call
+};
+
+static Options options;
+static Result *result = nullptr;
+static Clock::time_point button_posted;
+static uint64_t dispatched = 0;
+static uint64_t dispatched_at_post = 0;
+
+static void BusyWait(int us)
+{
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+    while (Clock::now() < end)
+    {
+    }
+}
+
+static void OnMessage(const message_t *msg)
+{
+    if (msg->type == MESSAGE_TYPE_BUTTON)
+    {
+        result->latency_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - button_posted).count());
+        result->ahead.push_back((int)(dispatched - dispatched_at_post));
+    }
+    else
+    {
+        BusyWait(options.work_us);
+    }
+    dispatched++;
+}
+
+template <typename T> static T Percentile(std::vector<T> values, double p)
+{
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p / 100.0 * values.size()))];
+}
+
+static Result Run(bool lanes)
+{
+    Result run;
+    result = &run;
+
+    message_manager_set_lane(MESSAGE_TYPE_SETTINGS, MESSAGE_LANE_STATE);
+    message_manager_set_lane(MESSAGE_TYPE_BUTTON, lanes ? MESSAGE_LANE_INTERACTIVE : MESSAGE_LANE_STATE);
+    message_manager_set_lane(MESSAGE_TYPE_SIMULATION, lanes ? MESSAGE_LANE_TELEMETRY : MESSAGE_LANE_STATE);
+
+    std::mt19937 random(5);
+    for (int round = 0; round < options.rounds; round++)
+    {
+        int position = (int)(random() % (options.burst + 1));
+        for (int i = 0; i <= options.burst; i++)
+        {
+            message_t msg = {};
+            if (i == position)
+            {
+                msg.type = MESSAGE_TYPE_BUTTON;
+                msg.data.button.event_type = BUTTON_EVENT_PRESS;
+                button_posted = Clock::now();
+                dispatched_at_post = dispatched;
+            }
+            else
+            {
+                msg.type = MESSAGE_TYPE_SIMULATION;
+                snprintf(msg.data.simulation.time, sizeof(msg.data.simulation.time), "%02d:%02d", round / 60 % 24,
+                         round % 60);
+                msg.data.simulation.blue = (uint8_t)i;
+            }
+            message_manager_post(&msg, 0);
+        }
+        // The dispatcher runs while the main task sleeps
+        vTaskDelay(1);
+    }
+
+    result = nullptr;
+    return run;
+}
+
+// calls: what the latency was measured for, ahead: what ran between post and call
+static void Print(const char *name, const char *calls, const char *ahead, const Result &run)
+{
+    printf("%-6s %s %5zu  latency p50 %8.1f us  p99 %8.1f us  max %8.1f us  %s ahead p99 %3d  max %3d\n", name,
+           calls, run.latency_us.size(), Percentile(run.latency_us, 50), Percentile(run.latency_us, 99),
+           Percentile(run.latency_us, 100), ahead, Percentile(run.ahead, 99), Percentile(run.ahead, 100));
+}
+
+static int Load(int argc, char **argv)
+{
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rounds")
+            options.rounds = std::max(1, atoi(argv[i + 1]));
+        else if (arg == "--burst")
+            options.burst = std::clamp(atoi(argv[i + 1]), 1, 31); // 32 message slots
+        else if (arg == "--work")
+            options.work_us = std::max(0, atoi(argv[i + 1]));
+        else
+            return 2;
+    }
+
+    host_scheduler_init();
+    settings_init();
+    message_manager_init();
+    message_manager_set_coalescing(MESSAGE_TYPE_SIMULATION, false);
+    message_manager_subscribe(OnMessage, MESSAGE_MASK(MESSAGE_TYPE_BUTTON) | MESSAGE_MASK(MESSAGE_TYPE_SIMULATION),
+                              0);
+
+    printf("%d rounds of %d simulation updates and one button press, %d us per simulation callback\n",
+           options.rounds, options.burst, options.work_us);
+    Result fifo = Run(false);
+    Print("fifo", "buttons", "messages", fifo);
+    Result lanes = Run(true);
+    Print("lanes", "buttons", "messages", lanes);
+
+    message_manager_stats_t stats;
+    message_manager_get_stats(&stats);
+    printf("dropped %u, lane peaks interactive %u state %u telemetry %u\n", stats.dropped,
+           stats.lane_peak[MESSAGE_LANE_INTERACTIVE], stats.lane_peak[MESSAGE_LANE_STATE],
+           stats.lane_peak[MESSAGE_LANE_TELEMETRY]);
+
+    bool ok = stats.dropped == 0 && (int)lanes.latency_us.size() == options.rounds && Percentile(lanes.ahead, 100) <= 1;
+    if (!ok)
+        fprintf(stderr, "FAIL: button presses waited behind simulation updates\n");
+
+    // The dispatcher is still parked inside the scheduler, skip static destructors
+    fflush(nullptr);
+    _exit(ok ? 0 : 1);
+}
+
+// --- isolation ---
+
+static Clock::time_point burst_posted;
+static uint64_t slow_calls = 0;
+static uint64_t slow_calls_at_post = 0;
+
+static void OnFast(const message_t *msg)
+{
+    result->latency_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - burst_posted).count());
+    result->ahead.push_back((int)(slow_calls - slow_calls_at_post));
+}
+
+static void OnSlow(const message_t *msg)
+{
+    BusyWait(options.work_us);
+    slow_calls++;
+}
+
+static Result RunIsolation(uint64_t *slow_calls_run)
+{
+    Result run;
+    result = &run;
+    uint64_t calls_before = slow_calls;
+
+    for (int round = 0; round < options.rounds; round++)
+    {
+        burst_posted = Clock::now();
+        slow_calls_at_post = slow_calls;
+        for (int i = 0; i < options.burst; i++)
+        {
+            message_t msg = {};
+            msg.type = MESSAGE_TYPE_SIMULATION;
+            msg.data.simulation.red = (uint8_t)i;
+            message_manager_post(&msg, 0);
+        }
+        vTaskDelay(1);
+    }
+    // Let the executor finish its inbox
+    vTaskDelay(10);
+
+    *slow_calls_run = slow_calls - calls_before;
+    result = nullptr;
+    return run;
+}
+
+static int Isolation(int argc, char **argv)
+{
+    options.work_us = 500;
+    options.rounds = 500;
+    options.burst = 8;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rounds")
+            options.rounds = std::max(1, atoi(argv[i + 1]));
+        else if (arg == "--burst")
+            options.burst = std::clamp(atoi(argv[i + 1]), 1, 32); // message slots
+        else if (arg == "--work")
+            options.work_us = std::max(0, atoi(argv[i + 1]));
+        else
+            return 2;
+    }
+
+    host_scheduler_init();
+    settings_init();
+    message_manager_init();
+    message_manager_set_coalescing(MESSAGE_TYPE_SIMULATION, false);
+    message_manager_subscribe(OnSlow, MESSAGE_MASK(MESSAGE_TYPE_SIMULATION), 0);
+    message_manager_subscribe(OnFast, MESSAGE_MASK(MESSAGE_TYPE_SIMULATION), 0);
+
+    printf("%d rounds of %d simulation updates, %d us per slow callback\n", options.rounds, options.burst,
+           options.work_us);
+    uint64_t inline_calls = 0;
+    Result inline_run = RunIsolation(&inline_calls);
+    Print("inline", "fast calls", "slow calls", inline_run);
+
+    message_executor_config_t config = {};
+    config.name = "slow_listener";
+    config.stack_size = 4096;
+    config.priority = 1;
+    config.inbox_length = 4;
+    config.policy = MESSAGE_INBOX_COALESCE;
+    if (!message_manager_set_executor(OnSlow, &config))
+    {
+        fprintf(stderr, "FAIL: cannot create the executor\n");
+        fflush(nullptr);
+        _exit(1);
+    }
+    uint64_t async_calls = 0;
+    Result async_run = RunIsolation(&async_calls);
+    Print("async", "fast calls", "slow calls", async_run);
+
+    message_manager_stats_t stats;
+    message_manager_get_stats(&stats);
+    printf("slow listener calls: inline %llu, async %llu (coalesced %u, inbox dropped %u)\n",
+           (unsigned long long)inline_calls, (unsigned long long)async_calls, stats.coalesced, stats.inbox_dropped);
+
+    // The executor ends with its subscription
+    message_manager_unregister_listener(OnSlow);
+    vTaskDelay(10);
+
+    bool ok = stats.dropped == 0 && (int)async_run.latency_us.size() == options.rounds * options.burst &&
+              Percentile(async_run.ahead, 100) == 0 && async_calls > 0;
+    if (!ok)
+        fprintf(stderr, "FAIL: the fast listener waited for the slow one\n");
+
+    fflush(nullptr);
+    _exit(ok ? 0 : 1);
+}
+
+// --- coalesce ---
+
+static int last_posted = -1;
+static int last_delivered = -1;
+static int stale = 0;
+static int delivered = 0;
+
+static void OnColor(const message_t *msg)
+{
+    if (msg->data.simulation.red != last_posted)
+        stale++;
+    last_delivered = msg->data.simulation.red;
+    delivered++;
+}
+
+static void PostColor(int red)
+{
+    message_t msg = {};
+    msg.type = MESSAGE_TYPE_SIMULATION;
+    msg.data.simulation.red = (uint8_t)(red & 0xFF);
+    last_posted = msg.data.simulation.red;
+    message_manager_post(&msg, 0);
+}
+
+static int Coalesce(int argc, char **argv)
+{
+    options.rounds = 500;
+    options.burst = 32;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rounds")
+            options.rounds = std::max(1, atoi(argv[i + 1]));
+        else if (arg == "--burst")
+            options.burst = std::clamp(atoi(argv[i + 1]), 1, 255);
+        else
+            return 2;
+    }
+
+    host_scheduler_init();
+    settings_init();
+    message_manager_init();
+    message_manager_subscribe(OnColor, MESSAGE_MASK(MESSAGE_TYPE_SIMULATION), 0);
+
+    // More updates per round than there are message slots, only the last one of a round may arrive. The
+    // waiting update has to follow a lane change, or the rest of the burst queues a second one.
+    for (int round = 0; round < options.rounds; round++)
+    {
+        for (int i = 0; i < options.burst; i++)
+        {
+            if (round % 2 == 1 && i == options.burst / 2)
+                message_manager_set_lane(MESSAGE_TYPE_SIMULATION,
+                                         round % 4 == 1 ? MESSAGE_LANE_STATE : MESSAGE_LANE_TELEMETRY);
+            PostColor(round + i);
+        }
+        vTaskDelay(1);
+    }
+
+    message_manager_stats_t stats;
+    message_manager_get_stats(&stats);
+    printf("posted %d, delivered %d, stale %d, superseded %u, dropped %u, lane peak telemetry %u state %u\n",
+           options.rounds * options.burst, delivered, stale, stats.superseded, stats.dropped,
+           stats.lane_peak[MESSAGE_LANE_TELEMETRY], stats.lane_peak[MESSAGE_LANE_STATE]);
+
+    bool ok = delivered == options.rounds && stale == 0 && stats.dropped == 0 &&
+              stats.lane_peak[MESSAGE_LANE_TELEMETRY] == 1 && stats.lane_peak[MESSAGE_LANE_STATE] == 1;
+    if (!ok)
+        fprintf(stderr, "FAIL: simulation updates were not coalesced\n");
+
+    // Updates queued before coalescing was turned on still wait, the newest color has to be delivered last
+    int behind = 0;
+    int burst = std::min(options.burst, 16); // the uncoalesced half has to fit into the 32 pool slots
+    for (int round = 0; round < options.rounds; round++)
+    {
+        message_manager_set_coalescing(MESSAGE_TYPE_SIMULATION, false);
+        for (int i = 0; i < burst; i++)
+        {
+            if (i == burst / 2)
+                message_manager_set_coalescing(MESSAGE_TYPE_SIMULATION, true);
+            PostColor(round + i);
+        }
+        vTaskDelay(1);
+        if (last_delivered != last_posted)
+            behind++;
+    }
+    printf("coalescing turned on mid-burst: %d of %d bursts ended on an older color\n", behind, options.rounds);
+    if (behind != 0)
+    {
+        fprintf(stderr, "FAIL: an older update was delivered after the newest one\n");
+        ok = false;
+    }
+
+    fflush(nullptr);
+    _exit(ok ? 0 : 1);
+}
+
+// --- trace ---
+
+static void OnTimed(const message_t *)
+{
+    vTaskDelay(pdMS_TO_TICKS(options.work_us / 1000));
+}
+
+static void OnTimedAsync(const message_t *)
+{
+    vTaskDelay(pdMS_TO_TICKS(options.work_us / 2000));
+}
+
+static int refused_calls = 0;
+
+static void OnRefusing(const message_t *)
+{
+    refused_calls++;
+    vTaskDelay(pdMS_TO_TICKS(10));
+}
+
+static void PrintHistogram(const char *label, const message_histogram_t &histogram)
+{
+    printf("%-24s count %6u  avg %8.1f us  max %7u us  |", label, histogram.count,
+           histogram.count ? (double)histogram.total_us / histogram.count : 0.0, histogram.max_us);
+    for (int bucket = 0; bucket < MESSAGE_TRACE_BUCKETS; bucket++)
+        printf(" %u", histogram.buckets[bucket]);
+    printf("\n");
+}
+
+static int Trace(int argc, char **argv)
+{
+    options.rounds = 200;
+    options.burst = 4;
+    options.work_us = 2000;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rounds")
+            options.rounds = std::max(1, atoi(argv[i + 1]));
+        else if (arg == "--burst")
+            options.burst = std::clamp(atoi(argv[i + 1]), 1, 16);
+        else if (arg == "--work")
+            options.work_us = std::clamp(atoi(argv[i + 1]), 2, 100) * 1000;
+        else
+            return 2;
+    }
+
+    host_scheduler_init();
+    settings_init();
+    message_manager_init();
+    message_manager_subscribe(OnTimed, MESSAGE_MASK(MESSAGE_TYPE_BUTTON), 0);
+    message_manager_subscribe(OnTimedAsync, MESSAGE_MASK(MESSAGE_TYPE_BUTTON), 0);
+    message_executor_config_t config = {"trace_async", 4096, 4, MESSAGE_MAX_INBOX, MESSAGE_INBOX_DROP_NEWEST};
+    if (!message_manager_set_executor(OnTimedAsync, &config))
+    {
+        fprintf(stderr, "FAIL: could not start the executor\n");
+        fflush(nullptr);
+        _exit(1);
+    }
+
+    for (int round = 0; round < options.rounds; round++)
+    {
+        for (int i = 0; i < options.burst; i++)
+        {
+            message_t msg = {};
+            msg.type = MESSAGE_TYPE_BUTTON;
+            msg.data.button.button_id = (uint8_t)i;
+            message_manager_post(&msg, 0);
+        }
+        vTaskDelay(pdMS_TO_TICKS(options.burst * options.work_us / 1000 + 10));
+    }
+
+    message_manager_trace_t trace;
+    message_manager_get_trace(&trace);
+    printf("buckets below");
+    for (int bucket = 0; bucket + 1 < MESSAGE_TRACE_BUCKETS; bucket++)
+        printf(" %u", message_manager_bucket_limit(bucket));
+    printf(" us and the rest\n");
+    PrintHistogram("wait button", trace.wait[MESSAGE_TYPE_BUTTON]);
+    const message_listener_trace_t *sync = nullptr, *async = nullptr;
+    for (size_t i = 0; i < trace.listener_count; i++)
+    {
+        const message_listener_trace_t &listener = trace.listeners[i];
+        std::string name = listener.name[0] ? listener.name : "dispatcher";
+        PrintHistogram((name + " latency").c_str(), listener.latency);
+        PrintHistogram((name + " run").c_str(), listener.run);
+        (listener.listener == OnTimed ? sync : async) = &listener;
+    }
+
+    uint32_t calls = (uint32_t)(options.rounds * options.burst);
+    uint32_t work = (uint32_t)options.work_us;
+    bool ok = sync != nullptr && async != nullptr && trace.wait[MESSAGE_TYPE_BUTTON].count == calls &&
+              sync->run.count == calls && async->run.count == calls;
+    // Run times are exact to the tick, the last message of a burst waits for all before it
+    ok = ok && sync->run.max_us >= work && sync->run.max_us < work + 1000 && async->run.max_us >= work / 2 &&
+         async->run.max_us < work / 2 + 1000;
+    ok = ok && trace.wait[MESSAGE_TYPE_BUTTON].max_us >= (calls > 1 ? (uint32_t)(options.burst - 1) * work : 0);
+    ok = ok && sync->latency.max_us >= trace.wait[MESSAGE_TYPE_BUTTON].max_us;
+    if (!ok)
+        fprintf(stderr, "FAIL: the trace does not match the posted messages\n");
+
+    // A message a full inbox refuses counts as dropped, not as delivered
+    message_manager_unregister_listener(OnTimed);
+    message_manager_unregister_listener(OnTimedAsync);
+    message_manager_subscribe(OnRefusing, MESSAGE_MASK(MESSAGE_TYPE_BUTTON), 0);
+    message_executor_config_t refusing = {"trace_refusing", 4096, 4, 1, MESSAGE_INBOX_DROP_NEWEST};
+    message_manager_set_executor(OnRefusing, &refusing);
+    message_manager_stats_t before, after;
+    message_manager_get_stats(&before);
+    for (int i = 0; i < 4; i++)
+    {
+        message_t msg = {};
+        msg.type = MESSAGE_TYPE_BUTTON;
+        message_manager_post(&msg, 0);
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));
+    message_manager_get_stats(&after);
+    uint32_t delivered = after.delivered - before.delivered, dropped = after.inbox_dropped - before.inbox_dropped;
+    printf("full inbox: %u delivered, %u dropped, %d calls\n", delivered, dropped, refused_calls);
+    if (delivered != (uint32_t)refused_calls || delivered + dropped != 4 || dropped == 0)
+    {
+        fprintf(stderr, "FAIL: messages refused by a full inbox are counted as delivered\n");
+        ok = false;
+    }
+
+    fflush(nullptr);
+    _exit(ok ? 0 : 1);
+}
+
+// --- ring ---
+
+struct RingProducer
+{
+    int index;
+    int posted = 0;
+    int rejected = 0;
+    bool done = false;
+};
+
+static int ring_next[3];
+static int ring_received = 0;
+static int ring_overtaken = 0;
+static volatile bool ring_hold = false;
+static int ring_buttons = 0;
+
+static void OnRing(const message_t *msg)
+{
+    int producer = msg->data.simulation.red;
+    int sequence = msg->data.simulation.green | msg->data.simulation.blue << 8;
+    if (sequence < ring_next[producer])
+        ring_overtaken++;
+    ring_next[producer] = sequence + 1;
+    ring_received++;
+}
+
+static void RingProducerTask(void *param)
+{
+    RingProducer *producer = (RingProducer *)param;
+    int sequence = 0;
+    for (int round = 0; round < options.rounds; round++)
+    {
+        for (int i = 0; i < options.burst; i++, sequence++)
+        {
+            message_t msg = {};
+            msg.type = MESSAGE_TYPE_SIMULATION;
+            msg.data.simulation.red = (uint8_t)producer->index;
+            msg.data.simulation.green = (uint8_t)sequence;
+            msg.data.simulation.blue = (uint8_t)(sequence >> 8);
+            producer->posted++;
+            if (!message_manager_post_from_isr(&msg))
+                producer->rejected++;
+            // Let the other producers in between; the three halves overflow the ring now and then
+            if (i == options.burst / 2)
+                vTaskDelay(0);
+        }
+        vTaskDelay(1);
+    }
+    producer->done = true;
+    vTaskDelete(nullptr);
+}
+
+static void OnHold(const message_t *)
+{
+    while (ring_hold)
+        vTaskDelay(1);
+}
+
+// Same, a second executor needs a listener of its own
+static void OnHoldSettings(const message_t *msg)
+{
+    OnHold(msg);
+}
+
+static void OnRingButton(const message_t *)
+{
+    ring_buttons++;
+}
+
+static int Ring(int argc, char **argv)
+{
+    options.rounds = 500;
+    options.burst = 12;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rounds")
+            options.rounds = std::clamp(atoi(argv[i + 1]), 1, 5000);
+        else if (arg == "--burst")
+            options.burst = std::clamp(atoi(argv[i + 1]), 1, 16);
+        else
+            return 2;
+    }
+
+    host_scheduler_init();
+    settings_init();
+    message_manager_init();
+    message_manager_set_coalescing(MESSAGE_TYPE_SIMULATION, false);
+    message_manager_subscribe(OnRing, MESSAGE_MASK(MESSAGE_TYPE_SIMULATION), 0);
+
+    RingProducer producers[3];
+    for (int p = 0; p < 3; p++)
+    {
+        producers[p].index = p;
+        xTaskCreate(RingProducerTask, "ring_producer", 4096, &producers[p], 3, nullptr);
+    }
+    while (!producers[0].done || !producers[1].done || !producers[2].done)
+        vTaskDelay(1);
+    vTaskDelay(10);
+    message_manager_unregister_listener(OnRing);
+
+    int posted = 0, rejected = 0;
+    for (const RingProducer &producer : producers)
+    {
+        posted += producer.posted;
+        rejected += producer.rejected;
+    }
+    message_manager_stats_t stats;
+    message_manager_get_stats(&stats);
+    printf("posted %d from 3 tasks, received %d, rejected %d (ring_dropped %u), overtaken %d\n", posted,
+           ring_received, rejected, stats.ring_dropped, ring_overtaken);
+    bool ok = ring_received + rejected == posted && (int)stats.ring_dropped == rejected && ring_overtaken == 0;
+
+    // Occupy every message slot: two executors take 16 messages each and hold on to them
+    ring_hold = true;
+    message_executor_config_t config = {"ring_hold", 4096, 2, MESSAGE_MAX_INBOX, MESSAGE_INBOX_DROP_NEWEST};
+    message_manager_subscribe(OnHold, MESSAGE_MASK(MESSAGE_TYPE_SIMULATION), 0);
+    message_manager_set_executor(OnHold, &config);
+    message_manager_subscribe(OnHoldSettings, MESSAGE_MASK(MESSAGE_TYPE_SETTINGS), 0);
+    message_manager_set_executor(OnHoldSettings, &config);
+    message_manager_subscribe(OnRingButton, MESSAGE_MASK(MESSAGE_TYPE_BUTTON), 0);
+    for (int i = 0; i < MESSAGE_MAX_INBOX; i++)
+    {
+        message_t msg = {};
+        msg.type = MESSAGE_TYPE_SIMULATION;
+        message_manager_post(&msg, 0);
+        message_manager_post_setting(SETTING_LIGHT_VARIANT, settings_int(i), 0);
+        vTaskDelay(1);
+    }
+    vTaskDelay(10);
+
+    for (int i = 0; i < 3; i++)
+    {
+        message_t msg = {};
+        msg.type = MESSAGE_TYPE_BUTTON;
+        message_manager_post_from_isr(&msg);
+    }
+    vTaskDelay(10);
+    int while_full = ring_buttons;
+    ring_hold = false;
+    vTaskDelay(50);
+    int after_release = ring_buttons;
+
+    message_manager_get_stats(&stats);
+    printf("all slots held: %d of 3 ring posts delivered, %d after a slot was released (post dropped %u)\n",
+           while_full, after_release, stats.dropped);
+    ok = ok && stats.dropped == 0 && while_full == 0 && after_release == 3;
+    if (!ok)
+        fprintf(stderr, "FAIL: the ring lost or reordered messages\n");
+
+    fflush(nullptr);
+    _exit(ok ? 0 : 1);
+}
+
+// --- record ---
+
+static int Record(int argc, char **argv)
+{
+    if (argc < 1)
+        return 2;
+    const char *path = argv[0];
+    int duration_ms = 600000;
+    size_t bytes = 256 * 1024;
+    std::vector<std::pair<int, std::string>> switches;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        size_t colon = value.find(':');
+        if (arg == "--duration")
+            duration_ms = std::max(1, atoi(value.c_str()));
+        else if (arg == "--bytes")
+            bytes = (size_t)std::max(64, atoi(value.c_str()));
+        else if (arg == "--switch" && colon != std::string::npos)
+            switches.push_back({std::max(0, atoi(value.c_str())), value.substr(colon + 1)});
+        else
+            return 2;
+    }
+    std::stable_sort(switches.begin(), switches.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    AppOptions app;
+    if (!AppStart(app))
+        return 1;
+    message_manager_init();
+    simulator_subscribe_settings();
+    message_manager_record_start(bytes);
+    int64_t start_us = esp_timer_get_time();
+    for (const auto &mode_switch : switches)
+    {
+        if (mode_switch.first >= duration_ms)
+            break;
+        int64_t wait_ms = mode_switch.first - (esp_timer_get_time() - start_us) / 1000;
+        if (wait_ms > 0)
+            vTaskDelay(pdMS_TO_TICKS(wait_ms));
+        if (!AppPostMode(mode_switch.second))
+            return 1;
+    }
+    int64_t left_ms = duration_ms - (esp_timer_get_time() - start_us) / 1000;
+    if (left_ms > 0)
+        vTaskDelay(pdMS_TO_TICKS(left_ms));
+    message_manager_record_stop();
+
+    message_record_status_t status;
+    message_manager_record_status(&status);
+    FILE *file = fopen(path, "wb");
+    bool ok = file != nullptr && fwrite(status.log, 1, status.length, file) == status.length;
+    if (file != nullptr)
+        ok = fclose(file) == 0 && ok;
+    printf("%u messages in %zu bytes%s\n", status.records, status.length, status.full ? ", log full" : "");
+    if (!ok)
+        fprintf(stderr, "Cannot write %s\n", path);
+
+    fflush(nullptr);
+    _exit(ok ? 0 : 1);
+}
+
+// --- replay ---
+
+struct ReplayMessage
+{
+    uint32_t time_us;
+    message_t msg;
+};
+
+// A listener of the firmware that cannot be built for the host
+struct ModeledListener
+{
+    const char *name;
+    message_listener_t listener;
+    uint32_t types;
+    uint32_t settings;
+    uint8_t inbox_length; // 0 = called by the dispatcher
+    int work_us;
+};
+
+// Subscription of the settings menu in app_task.cpp and of the status broadcast
+static constexpr uint32_t light_settings =
+    SETTING_MASK(LIGHT_ACTIVE) | SETTING_MASK(LIGHT_MODE) | SETTING_MASK(LIGHT_VARIANT);
+
+template <int N> static void OnModeled(const message_t *);
+
+// Subscriptions and executors as in app_task.cpp and bifrost/common.c
+static ModeledListener modeled_listeners[] = {
+    {"app_buttons", OnModeled<0>, MESSAGE_MASK(MESSAGE_TYPE_BUTTON), 0, 0, 20},
+    {"app_menu", OnModeled<1>, MESSAGE_MASK(MESSAGE_TYPE_SETTINGS), light_settings, 0, 10},
+#ifndef MESSAGE_TOOL_STATUS_JSON
+    {"status_broadcast", OnModeled<2>, MESSAGE_MASK(MESSAGE_TYPE_SIMULATION) | MESSAGE_MASK(MESSAGE_TYPE_SETTINGS),
+     light_settings, 4, 600},
+#endif
+};
+
+template <int N> static void OnModeled(const message_t *)
+{
+    host_task_consume_us(modeled_listeners[N].work_us);
+}
+
+#ifdef MESSAGE_TOOL_STATUS_JSON
+static uint32_t broadcasts;
+static uint64_t broadcast_bytes;
+
+// The WebSocket server of the device; only the status_broadcast executor calls it
+esp_err_t api_server_ws_broadcast(const char *message)
+{
+    broadcasts++;
+    broadcast_bytes += strlen(message);
+    return ESP_OK;
+}
+#endif
+
+static bool ReadLog(const char *path, std::vector<ReplayMessage> &messages)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+    std::vector<uint8_t> log;
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        log.insert(log.end(), buffer, buffer + read);
+    fclose(file);
+
+    message_log_header_t header;
+    if (log.size() < sizeof(header))
+        return false;
+    memcpy(&header, log.data(), sizeof(header));
+    if (header.magic != MESSAGE_LOG_MAGIC || header.version != MESSAGE_LOG_VERSION)
+        return false;
+
+    for (size_t offset = sizeof(header); offset < log.size();)
+    {
+        message_log_record_t record;
+        if (offset + sizeof(record) > log.size())
+            return false;
+        memcpy(&record, log.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        if (record.type >= MESSAGE_TYPE_COUNT || record.length > sizeof(message_t::data) ||
+            offset + record.length > log.size())
+            return false;
+
+        ReplayMessage message = {};
+        message.time_us = record.time_us;
+        message.msg.type = (message_type_t)record.type;
+        memcpy(&message.msg.data, log.data() + offset, record.length);
+        offset += record.length;
+        messages.push_back(message);
+    }
+    return true;
+}
+
+// Upper bound of the bucket holding the given percentile
+static std::string BucketPercentile(const message_histogram_t &histogram, double p)
+{
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < MESSAGE_TRACE_BUCKETS; bucket++)
+    {
+        seen += histogram.buckets[bucket];
+        if (seen > 0 && seen >= p / 100.0 * histogram.count)
+        {
+            uint32_t limit = message_manager_bucket_limit(bucket);
+            return limit == UINT32_MAX ? ">" + std::to_string(message_manager_bucket_limit(bucket - 1))
+                                       : "<" + std::to_string(limit);
+        }
+    }
+    return "-";
+}
+
+static int Replay(int argc, char **argv)
+{
+    if (argc < 1)
+        return 2;
+    const char *path = argv[0];
+    double speed = 1.0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        size_t equals = value.find('=');
+        if (arg == "--speed")
+        {
+            speed = std::max(0.0, atof(value.c_str()));
+        }
+        else if (arg == "--work" && equals != std::string::npos)
+        {
+            bool found = false;
+            for (ModeledListener &listener : modeled_listeners)
+            {
+                if (value.compare(0, equals, listener.name) == 0 && strlen(listener.name) == equals)
+                {
+                    listener.work_us = std::max(0, atoi(value.c_str() + equals + 1));
+                    found = true;
+                }
+            }
+            if (!found)
+                return 2;
+        }
+        else
+        {
+            return 2;
+        }
+    }
+
+    std::vector<ReplayMessage> messages;
+    if (!ReadLog(path, messages))
+    {
+        fprintf(stderr, "Cannot read the message log %s\n", path);
+        return 1;
+    }
+
+    // The scene starts switched off, the replayed settings switch it like they did on the device
+    AppOptions app;
+    app.mode = "off";
+    if (!AppStart(app))
+        return 1;
+    message_manager_init();
+#ifdef MESSAGE_TOOL_STATUS_JSON
+    common_init();
+#endif
+    simulator_subscribe_settings();
+    for (const ModeledListener &listener : modeled_listeners)
+    {
+        message_manager_subscribe(listener.listener, listener.types, listener.settings);
+        if (listener.inbox_length > 0)
+        {
+            message_executor_config_t config = {listener.name, 3072, 4, listener.inbox_length,
+                                                MESSAGE_INBOX_COALESCE};
+            message_manager_set_executor(listener.listener, &config);
+        }
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    uint32_t posted[MESSAGE_TYPE_COUNT] = {};
+    uint32_t skipped = 0;
+    for (const ReplayMessage &message : messages)
+    {
+        if (speed > 0)
+        {
+            int64_t due_us = start_us + (int64_t)(message.time_us / speed);
+            int64_t ticks = (due_us - esp_timer_get_time()) / (1000000 / configTICK_RATE_HZ);
+            if (ticks > 0)
+                vTaskDelay((TickType_t)ticks);
+        }
+        else
+        {
+            // Back to back, but the listeners get the CPU between two posts
+            vTaskDelay(0);
+        }
+        if (message.msg.type == MESSAGE_TYPE_SIMULATION && simulation_task_running())
+        {
+            // A replayed setting started the simulation, which posts its own updates now
+            skipped++;
+            continue;
+        }
+        // Buttons come from the iot_button timer on the device
+        if (message.msg.type == MESSAGE_TYPE_BUTTON)
+            message_manager_post_from_isr(&message.msg);
+        else
+            message_manager_post(&message.msg, pdMS_TO_TICKS(100));
+        posted[message.msg.type]++;
+    }
+    double posted_s = (esp_timer_get_time() - start_us) / 1e6;
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    printf("%zu messages over %.1f s (settings %u, button %u, simulation %u, %u left to the simulation), "
+           "speed %g\n",
+           messages.size(), posted_s, posted[MESSAGE_TYPE_SETTINGS], posted[MESSAGE_TYPE_BUTTON],
+           posted[MESSAGE_TYPE_SIMULATION], skipped, speed);
+    message_manager_trace_t trace;
+    message_manager_get_trace(&trace);
+    printf("%-27s %7s %9s %9s  %-30s %-18s %s\n", "listener", "calls", "calls/s", "max/s",
+           "latency p50 p99 max (us)", "run avg max (us)", "host us/call");
+    for (size_t i = 0; i < trace.listener_count; i++)
+    {
+        const message_listener_trace_t &traced = trace.listeners[i];
+        std::string name = traced.name;
+        bool modeled = false;
+        for (const ModeledListener &listener : modeled_listeners)
+        {
+            if (listener.listener == traced.listener)
+            {
+                name = std::string(listener.name) + " (modeled)";
+                modeled = true;
+            }
+        }
+        // A real listener works in no virtual time; its cost is the CPU time of its executor on this host
+        double run_avg = traced.run.count ? (double)traced.run.total_us / traced.run.count : 0;
+        int64_t host_us = modeled || traced.name[0] == '\0' ? -1 : host_task_run_time_us(traced.name);
+        char host[32] = "-";
+        double cost_us = run_avg;
+        if (host_us >= 0 && traced.run.count > 0)
+        {
+            cost_us = (double)host_us / traced.run.count;
+            snprintf(host, sizeof(host), "%.1f", cost_us);
+        }
+        char latency[64];
+        snprintf(latency, sizeof(latency), "%s %s %u", BucketPercentile(traced.latency, 50).c_str(),
+                 BucketPercentile(traced.latency, 99).c_str(), traced.latency.max_us);
+        char run[32];
+        snprintf(run, sizeof(run), "%.0f %u", run_avg, traced.run.max_us);
+        // max/s: calls per second the listener could take at its average cost
+        printf("%-27s %7u %9.1f %9.0f  %-30s %-18s %s\n", name.c_str(), traced.run.count,
+               posted_s > 0 ? traced.run.count / posted_s : 0.0, cost_us > 0 ? 1e6 / cost_us : 0.0, latency, run,
+               host);
+    }
+#ifdef MESSAGE_TOOL_STATUS_JSON
+    printf("status broadcast: %u messages, %llu bytes\n", broadcasts, (unsigned long long)broadcast_bytes);
+#endif
+
+    message_manager_stats_t stats;
+    message_manager_get_stats(&stats);
+    printf("dropped %u, ring dropped %u, superseded %u, coalesced %u, inbox dropped %u\n", stats.dropped,
+           stats.ring_dropped, stats.superseded, stats.coalesced, stats.inbox_dropped);
+
+    fflush(nullptr);
+    _exit(0);
+}
+
+static void Usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s load [--rounds N] [--burst N] [--work US]\n"
+            "       %s isolation [--rounds N] [--burst N] [--work US]\n"
+            "       %s coalesce [--rounds N] [--burst N]\n"
+            "       %s trace [--rounds N] [--burst N] [--work MS]\n"
+            "       %s ring [--rounds N] [--burst N]\n"
+            "       %s record FILE [--duration MS] [--bytes N] [--switch MS:MODE]...\n"
+            "       %s replay FILE [--speed X] [--work NAME=US]...\n",
+            program, program, program, program, program, program, program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::string command = argv[1];
+    int result = 2;
+    if (command == "load")
+        result = Load(argc - 2, argv + 2);
+    else if (command == "isolation")
+        result = Isolation(argc - 2, argv + 2);
+    else if (command == "coalesce")
+        result = Coalesce(argc - 2, argv + 2);
+    else if (command == "trace")
+        result = Trace(argc - 2, argv + 2);
+    else if (command == "ring")
+        result = Ring(argc - 2, argv + 2);
+    else if (command == "record")
+        result = Record(argc - 2, argv + 2);
+    else if (command == "replay")
+        result = Replay(argc - 2, argv + 2);
+
+    if (result == 2)
+        Usage(argv[0]);
+    return result;
+}
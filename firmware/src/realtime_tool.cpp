@@ -0,0 +1,444 @@
+// Host tool for the realtime UDP input (see led_realtime.h):
+//
+//   led_realtime_tool send HOST [--proto ddp|e131] [--port P] [--fps N] [--seconds S] [--leds N] [--no-push]
+//   led_realtime_tool loopback [--proto ddp|e131] [--port P] [--fps N] [--frames N] [--loss P] [--leds N]
+//                              [--no-push]
+//
+// send streams a moving test pattern of N pixels (default CONFIG_LED_STRIP_MAX_LEDS) to a device.
+// loopback runs the receiver of the firmware on 127.0.0.1 without its task: every frame is sent,
+// received and rendered in turn, the rendered frame is compared with the sent one, dropped packets
+// (--loss) must show up in the lost packet counter and the strip must time out once the stream ends.
+// --fps 0 sends as fast as the receiver keeps up. With --leds the receiver gets a segment list that
+// ends at pixel N, the pixels behind it must stay dark. --no-push sends DDP without the push flag, so
+// only the configured strip length completes a frame. For E1.31 a new sender with one universe then
+// starts after the timeout and again after a stream termination, reusing the last sequence numbers of
+// the stream before; its frames must be shown.
+
+#include "host/host.h"
+#include "led_realtime.h"
+#include "led_segment.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using Frame = std::vector<rgb_t>;
+using Packet = std::vector<uint8_t>;
+
+static const size_t LEDS = CONFIG_LED_STRIP_MAX_LEDS;
+static const size_t DDP_PIXELS_PER_PACKET = 480; // 1440 bytes, fits an Ethernet frame like WLED sends
+
+struct Options
+{
+    led_realtime_protocol_t protocol = LED_REALTIME_DDP;
+    uint16_t port = 0;
+    double fps = 40;
+    double seconds = 10;
+    uint32_t frames = 2000;
+    double loss = 0;
+    size_t leds = LEDS;
+    bool push = true;
+    const char *host = nullptr;
+};
+
+static void Pattern(uint32_t index, Frame &frame)
+{
+    for (size_t i = 0; i < frame.size(); i++)
+    {
+        uint32_t phase = (uint32_t)(i * 3 + index * 5);
+        frame[i] = rgb_t{(uint8_t)phase, (uint8_t)(phase * 7 + index), (uint8_t)(255 - (phase & 0xFF))};
+    }
+}
+
+static void Put16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static void Put32(uint8_t *p, uint32_t value)
+{
+    Put16(p, (uint16_t)(value >> 16));
+    Put16(p + 2, (uint16_t)value);
+}
+
+class Encoder
+{
+  public:
+    Encoder(led_realtime_protocol_t protocol, bool push, uint8_t first_sequence = 0)
+        : protocol(protocol), push(push), first_sequence(first_sequence)
+    {
+    }
+
+    // Sequence number of the next E1.31 packet of the first universe
+    uint8_t NextSequence() const
+    {
+        return e131_sequence.empty() ? first_sequence : e131_sequence[0];
+    }
+
+    std::vector<Packet> Encode(const Frame &frame)
+    {
+        return protocol == LED_REALTIME_DDP ? Ddp(frame) : E131(frame);
+    }
+
+  private:
+    std::vector<Packet> Ddp(const Frame &frame)
+    {
+        std::vector<Packet> packets;
+        for (size_t first = 0; first < frame.size(); first += DDP_PIXELS_PER_PACKET)
+        {
+            size_t count = std::min(DDP_PIXELS_PER_PACKET, frame.size() - first);
+            bool last = first + count == frame.size();
+            Packet packet(LED_REALTIME_DDP_HEADER_LEN + count * sizeof(rgb_t));
+            ddp_sequence = ddp_sequence % 15 + 1;
+            packet[0] = LED_REALTIME_DDP_VERSION_1 | (last && push ? LED_REALTIME_DDP_FLAG_PUSH : 0);
+            packet[1] = ddp_sequence;
+            packet[2] = LED_REALTIME_DDP_TYPE_RGB8;
+            packet[3] = LED_REALTIME_DDP_ID_DISPLAY;
+            Put32(&packet[4], (uint32_t)(first * sizeof(rgb_t)));
+            Put16(&packet[8], (uint16_t)(count * sizeof(rgb_t)));
+            memcpy(&packet[LED_REALTIME_DDP_HEADER_LEN], &frame[first], count * sizeof(rgb_t));
+            packets.push_back(std::move(packet));
+        }
+        return packets;
+    }
+
+    std::vector<Packet> E131(const Frame &frame)
+    {
+        static const uint8_t acn_id[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+        std::vector<Packet> packets;
+        for (size_t first = 0, index = 0; first < frame.size(); first += LED_REALTIME_E131_PIXELS_PER_UNIVERSE, index++)
+        {
+            size_t count = std::min((size_t)LED_REALTIME_E131_PIXELS_PER_UNIVERSE, frame.size() - first);
+            size_t slots = count * sizeof(rgb_t);
+            Packet packet(LED_REALTIME_E131_HEADER_LEN + slots);
+            size_t length = packet.size();
+            if (e131_sequence.size() <= index)
+                e131_sequence.resize(index + 1, first_sequence);
+
+            Put16(&packet[0], 0x0010);
+            memcpy(&packet[4], acn_id, sizeof(acn_id));
+            Put16(&packet[16], (uint16_t)(0x7000 | (length - 16)));
+            Put32(&packet[18], 0x00000004);
+            memcpy(&packet[22], "led_realtime_cid", 16);
+            Put16(&packet[38], (uint16_t)(0x7000 | (length - 38)));
+            Put32(&packet[40], 0x00000002);
+            snprintf((char *)&packet[44], 64, "led_realtime_tool");
+            packet[108] = 100; // priority
+            packet[111] = e131_sequence[index]++;
+            Put16(&packet[113], (uint16_t)(CONFIG_LED_REALTIME_E131_UNIVERSE + index));
+            Put16(&packet[115], (uint16_t)(0x7000 | (length - 115)));
+            packet[117] = 0x02;
+            packet[118] = 0xA1;
+            Put16(&packet[121], 1);
+            Put16(&packet[123], (uint16_t)(slots + 1));
+            memcpy(&packet[LED_REALTIME_E131_HEADER_LEN], &frame[first], slots);
+            packets.push_back(std::move(packet));
+        }
+        return packets;
+    }
+
+    led_realtime_protocol_t protocol;
+    bool push;
+    uint8_t first_sequence;
+    uint8_t ddp_sequence = 0;
+    std::vector<uint8_t> e131_sequence;
+};
+
+static bool ParseOptions(int argc, char **argv, Options &options, bool needs_host)
+{
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--proto" && i + 1 < argc)
+        {
+            std::string proto = argv[++i];
+            if (proto == "ddp")
+                options.protocol = LED_REALTIME_DDP;
+            else if (proto == "e131")
+                options.protocol = LED_REALTIME_E131;
+            else
+                return false;
+        }
+        else if (arg == "--port" && i + 1 < argc)
+            options.port = (uint16_t)atoi(argv[++i]);
+        else if (arg == "--fps" && i + 1 < argc)
+            options.fps = atof(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            options.seconds = atof(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc)
+            options.frames = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--loss" && i + 1 < argc)
+            options.loss = atof(argv[++i]);
+        else if (arg == "--leds" && i + 1 < argc)
+            options.leds = (size_t)std::clamp(atoi(argv[++i]), 1, (int)LEDS);
+        else if (arg == "--no-push")
+            options.push = false;
+        else if (needs_host && options.host == nullptr && arg[0] != '-')
+            options.host = argv[i];
+        else
+            return false;
+    }
+    if (options.port == 0)
+        options.port = options.protocol == LED_REALTIME_DDP ? CONFIG_LED_REALTIME_DDP_PORT : LED_REALTIME_E131_PORT;
+    return !needs_host || options.host != nullptr;
+}
+
+static int OpenSender(const char *host, uint16_t port, sockaddr_in &target)
+{
+    target = {};
+    target.sin_family = AF_INET;
+    target.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &target.sin_addr) != 1)
+    {
+        fprintf(stderr, "invalid address %s\n", host);
+        return -1;
+    }
+    return socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+}
+
+static bool SendPacket(int sock, const sockaddr_in &target, const Packet &packet)
+{
+    return sendto(sock, packet.data(), packet.size(), 0, (const sockaddr *)&target, sizeof(target)) ==
+           (ssize_t)packet.size();
+}
+
+static void Pace(Clock::time_point begin, uint32_t frame, double fps)
+{
+    if (fps > 0)
+        std::this_thread::sleep_until(begin + std::chrono::microseconds((int64_t)(frame * 1e6 / fps)));
+}
+
+static int Send(int argc, char **argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options, true))
+        return 2;
+
+    sockaddr_in target;
+    int sock = OpenSender(options.host, options.port, target);
+    if (sock < 0)
+        return 1;
+
+    Encoder encoder(options.protocol, options.push);
+    Frame frame(options.leds);
+    uint32_t frames = (uint32_t)(options.seconds * (options.fps > 0 ? options.fps : 40));
+    Clock::time_point begin = Clock::now();
+    for (uint32_t index = 0; index < frames; index++)
+    {
+        Pattern(index, frame);
+        for (const Packet &packet : encoder.Encode(frame))
+        {
+            if (!SendPacket(sock, target, packet))
+            {
+                perror("sendto");
+                close(sock);
+                return 1;
+            }
+        }
+        Pace(begin, index + 1, options.fps);
+    }
+    close(sock);
+    printf("sent %" PRIu32 " frames of %zu pixels to %s:%u\n", frames, options.leds, options.host, options.port);
+    return 0;
+}
+
+// Streams frames over the first universe as a new E1.31 sender starting at the given sequence number,
+// then ends the stream with a termination packet. Returns false if a frame after the first (which tells
+// the receiver the number of universes) is not shown or the strip does not fall back at the end.
+static bool RestartE131(int sender, const sockaddr_in &target, int receiver, uint8_t sequence)
+{
+    Encoder encoder(LED_REALTIME_E131, true, sequence);
+    Frame frame(LED_REALTIME_E131_PIXELS_PER_UNIVERSE);
+    Frame output(LEDS);
+    rgb_sum_t sum;
+    bool shown = true;
+    for (uint32_t index = 0; index < 5; index++)
+    {
+        Pattern(index + 11, frame);
+        for (const Packet &packet : encoder.Encode(frame))
+            SendPacket(sender, target, packet);
+        while (led_realtime_receive(receiver, LED_REALTIME_E131) != ESP_ERR_NOT_FOUND)
+            ;
+        bool active = led_realtime_render(output.data(), output.size(), &sum);
+        if (index > 0)
+            shown = shown && active && memcmp(output.data(), frame.data(), frame.size() * sizeof(rgb_t)) == 0;
+    }
+
+    Packet terminate = encoder.Encode(frame)[0];
+    terminate[112] |= LED_REALTIME_E131_OPTION_TERMINATED;
+    SendPacket(sender, target, terminate);
+    while (led_realtime_receive(receiver, LED_REALTIME_E131) != ESP_ERR_NOT_FOUND)
+        ;
+    return shown && !led_realtime_render(output.data(), output.size(), &sum);
+}
+
+static int Loopback(int argc, char **argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options, false))
+        return 2;
+
+    host_scheduler_init();
+    int receiver = led_realtime_open(options.protocol, options.port);
+    sockaddr_in target;
+    int sender = OpenSender("127.0.0.1", options.port, target);
+    if (receiver < 0 || sender < 0)
+        return 1;
+
+    // The configured strip ends with the last segment
+    led_segment_t strip = {};
+    snprintf(strip.name, sizeof(strip.name), "strip");
+    strip.leds = (uint16_t)options.leds;
+    led_segment_set(&strip, options.leds < LEDS ? 1 : 0);
+
+    Encoder encoder(options.protocol, options.push);
+    Frame frame(options.leds);
+    Frame output(LEDS);
+    const Frame dark(LEDS - options.leds);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> chance(0, 1);
+    uint32_t dropped = 0;
+    uint32_t checked = 0;
+    uint32_t mismatches = 0;
+    uint32_t rendered = 0;
+    uint32_t consecutive = 0;
+    double latency_sum_us = 0;
+    double latency_max_us = 0;
+
+    Clock::time_point begin = Clock::now();
+    for (uint32_t index = 0; index < options.frames; index++)
+    {
+        Pattern(index, frame);
+        std::vector<Packet> packets = encoder.Encode(frame);
+        bool complete = true;
+        Clock::time_point sent = Clock::now();
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            // The first and the last frame always arrive, otherwise gaps at the ends go unnoticed. Runs of
+            // drops stay below the 4 bit DDP sequence range.
+            if (index > 0 && index + 1 < options.frames && consecutive < 10 && chance(random) < options.loss)
+            {
+                dropped++;
+                consecutive++;
+                complete = false;
+                continue;
+            }
+            consecutive = 0;
+            if (!SendPacket(sender, target, packets[i]))
+            {
+                perror("sendto");
+                return 1;
+            }
+        }
+
+        while (led_realtime_receive(receiver, options.protocol) != ESP_ERR_NOT_FOUND)
+            ;
+        rgb_sum_t sum;
+        if (led_realtime_render(output.data(), output.size(), &sum))
+            rendered++;
+        double latency_us = std::chrono::duration<double, std::micro>(Clock::now() - sent).count();
+        latency_sum_us += latency_us;
+        if (latency_us > latency_max_us)
+            latency_max_us = latency_us;
+
+        // The E1.31 receiver learns the number of universes from the first frame, it is shown with the
+        // start of the second
+        if (complete && (index > 0 || options.protocol == LED_REALTIME_DDP))
+        {
+            checked++;
+            if (memcmp(output.data(), frame.data(), options.leds * sizeof(rgb_t)) != 0 ||
+                (!dark.empty() && memcmp(&output[options.leds], dark.data(), dark.size() * sizeof(rgb_t)) != 0))
+                mismatches++;
+        }
+        Pace(begin, index + 1, options.fps);
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    led_realtime_stats_t stats;
+    led_realtime_get_stats(&stats);
+    bool active_after_stream = stats.active;
+
+    // Virtual time of the host scheduler, nothing else runs
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_LED_REALTIME_TIMEOUT_MS + 100));
+    rgb_sum_t sum;
+    bool timed_out = !led_realtime_render(output.data(), output.size(), &sum);
+    led_realtime_get_stats(&stats);
+
+    // Sequence numbers just behind the last ones received look like late duplicates of the old stream
+    bool restarted = true;
+    if (options.protocol == LED_REALTIME_E131)
+    {
+        uint8_t reused = (uint8_t)(encoder.NextSequence() - 10);
+        restarted = RestartE131(sender, target, receiver, reused) && RestartE131(sender, target, receiver, reused);
+    }
+    close(sender);
+    close(receiver);
+
+    double fps = options.frames / elapsed;
+    printf("protocol      %s%s, %zu of %zu pixels\n", options.protocol == LED_REALTIME_DDP ? "ddp" : "e131",
+           options.push ? "" : " without push", options.leds, LEDS);
+    printf("frames        %" PRIu32 " sent, %" PRIu32 " rendered, %" PRIu32 " checked, %" PRIu32 " mismatches\n",
+           options.frames, rendered, checked, mismatches);
+    printf("packets       %" PRIu32 " valid, %" PRIu32 " invalid, %" PRIu32 " dropped, %" PRIu32 " counted lost\n",
+           stats.packets, stats.invalid_packets, dropped, stats.lost_packets);
+    printf("receiver      %" PRIu32 " frames, %" PRIu32 " incomplete, %" PRIu32 " superseded, %" PRIu32 " timeouts\n",
+           stats.frames, stats.incomplete_frames, stats.superseded_frames, stats.timeouts);
+    printf("throughput    %.0f frames/s\n", fps);
+    printf("latency       %.1f us avg, %.1f us max (send to framebuffer)\n", latency_sum_us / options.frames,
+           latency_max_us);
+    if (options.protocol == LED_REALTIME_E131)
+        printf("restart       new stream %s after the timeout and a termination\n", restarted ? "shown" : "NOT shown");
+
+    bool ok = mismatches == 0 && checked > 0 && stats.lost_packets == dropped && stats.invalid_packets == 0 &&
+              active_after_stream && timed_out && stats.timeouts == 1 && restarted &&
+              (options.fps > 0 || fps >= 40);
+    printf("%s\n", ok ? "loopback ok" : "loopback FAILED");
+    return ok ? 0 : 1;
+}
+
+static void Usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s send HOST [--proto ddp|e131] [--port P] [--fps N] [--seconds S] [--leds N] [--no-push]\n"
+            "       %s loopback [--proto ddp|e131] [--port P] [--fps N] [--frames N] [--loss P] [--leds N]\n"
+            "                [--no-push]\n",
+            program, program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::string command = argv[1];
+    int result = 2;
+    if (command == "send")
+        result = Send(argc - 2, argv + 2);
+    else if (command == "loopback")
+        result = Loopback(argc - 2, argv + 2);
+
+    if (result == 2)
+        Usage(argv[0]);
+    return result;
+}
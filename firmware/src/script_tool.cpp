@@ -0,0 +1,581 @@
+// Host tool for effect scripts (see led_script.h for the language):
+//
+//   led_script_tool compile FILE
+//   led_script_tool check
+//   led_script_tool bench [--leds N] [--seconds S]
+//
+// compile prints the bytecode of a script or the first error. check compiles a set of scripts and
+// compares every frame the VM renders with the same effect written in C, and verifies error reporting,
+// constant folding and the instruction budget. bench measures the VM against the C versions of the
+// scripts and against the built-in effects of led_effect.c.
+
+#include "led_effect.h"
+#include "led_script.h"
+#include "led_segment.h"
+
+#include <sdkconfig.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using Frame = std::vector<rgb_t>;
+
+// Adds the light of one pixel like the VM does: outputs clamped to 0..255, saturating add
+using Native = std::function<void(uint32_t t, int32_t n, Frame &frame)>;
+
+struct Example
+{
+    const char *name;
+    const char *source;
+    Native native; // same effect in C, empty if it uses sin(), noise() or rand()
+};
+
+static inline uint8_t Clamp8(int32_t value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : (uint8_t)value;
+}
+
+static inline void AddLight(rgb_t &pixel, int32_t r, int32_t g, int32_t b)
+{
+    pixel.red = (uint8_t)std::min(255, pixel.red + Clamp8(r));
+    pixel.green = (uint8_t)std::min(255, pixel.green + Clamp8(g));
+    pixel.blue = (uint8_t)std::min(255, pixel.blue + Clamp8(b));
+}
+
+static inline int32_t Tri(int32_t x)
+{
+    uint8_t phase = (uint8_t)x;
+    return phase < 128 ? phase * 2 : 511 - phase * 2;
+}
+
+static inline int32_t Scale(int32_t a, int32_t b)
+{
+    return (int32_t)((int64_t)a * b / 255);
+}
+
+static const std::vector<Example> &Examples()
+{
+    static const std::vector<Example> examples = {
+        {"gradient",
+         "# red to green across the segment, a blue triangle wave running along\n"
+         "r = i * 255 / max(n - 1, 1)\n"
+         "g = 255 - r\n"
+         "b = tri(i * 4 + t)\n",
+         [](uint32_t t, int32_t n, Frame &frame) {
+             for (int32_t i = 0; i < n; i++)
+             {
+                 int32_t r = i * 255 / std::max(n - 1, 1);
+                 AddLight(frame[i], r, 255 - r, Tri(i * 4 + (int32_t)t));
+             }
+         }},
+        {"invert",
+         "r = (255 - pr) / 2; g = scale(pg, 128)\n"
+         "b = abs(pb - 128) % 77\n",
+         [](uint32_t, int32_t n, Frame &frame) {
+             for (int32_t i = 0; i < n; i++)
+             {
+                 rgb_t p = frame[i];
+                 AddLight(frame[i], (255 - p.red) / 2, Scale(p.green, 128), std::abs(p.blue - 128) % 77);
+             }
+         }},
+        {"pulse",
+         "k = t * 3 + 2 * 8\n"
+         "level = tri(k)\n"
+         "r = scale(level, 200)\n"
+         "g = -i / 3 + level\n"
+         "b = min(i, level) - (n % 5)\n",
+         [](uint32_t t, int32_t n, Frame &frame) {
+             int32_t level = Tri((int32_t)t * 3 + 16);
+             for (int32_t i = 0; i < n; i++)
+             {
+                 AddLight(frame[i], Scale(level, 200), -i / 3 + level, std::min(i, level) - n % 5);
+             }
+         }},
+        {"vignette",
+         "x = i - n / 2\n"
+         "y = x * x / max(n, 1)\n"
+         "r = 255 - y\n"
+         "g = x / -3 + 100 % 7\n"
+         "b = 300 - i - t % 0x40\n",
+         [](uint32_t t, int32_t n, Frame &frame) {
+             for (int32_t i = 0; i < n; i++)
+             {
+                 int32_t x = i - n / 2;
+                 AddLight(frame[i], 255 - x * x / std::max(n, 1), x / -3 + 2, 300 - i - (int32_t)(t % 64));
+             }
+         }},
+        {"chase",
+         "# every 8th pixel lit with a dim neighbour, one step every 4 frames\n"
+         "head = t / 4 % 8\n"
+         "d = (i + 8 - head) % 8\n"
+         "level = max(255 - d * 207, 0)\n"
+         "r = level; g = scale(level, 120); b = scale(level, 40)\n",
+         [](uint32_t t, int32_t n, Frame &frame) {
+             int32_t head = (int32_t)(t / 4 % 8);
+             for (int32_t i = 0; i < n; i++)
+             {
+                 int32_t level = std::max(255 - (i + 8 - head) % 8 * 207, 0);
+                 AddLight(frame[i], level, Scale(level, 120), Scale(level, 40));
+             }
+         }},
+        {"aurora",
+         "wave = sin(i * 6 - t * 2)\n"
+         "shimmer = noise(i, t / 8) / 6\n"
+         "g = scale(wave, 140) + shimmer\n"
+         "b = scale(255 - wave, 90)\n",
+         nullptr},
+        {"fire",
+         "# value noise like the built-in fire effect at speed 32\n"
+         "p = t * 5\n"
+         "key = p / 64\n"
+         "frac = p % 64 * 4\n"
+         "a = noise(i, key)\n"
+         "h = a + (noise(i, key + 1) - a) * frac / 256\n"
+         "heat = 80 + scale(h, 175)\n"
+         "r = heat\n"
+         "g = scale(scale(120, heat), heat)\n"
+         "b = scale(scale(40, heat), scale(heat, heat))\n",
+         nullptr},
+        {"sparkle", "s = rand()\nr = max(s - 240, 0) * 16\ng = r\nb = r\n", nullptr},
+    };
+    return examples;
+}
+
+static bool Compile(const std::string &source, led_script_program_t &program, const char *name)
+{
+    led_script_error_t error;
+    if (led_script_compile(source.data(), source.size(), &program, &error) != ESP_OK)
+    {
+        fprintf(stderr, "%s: line %u: %s\n", name, error.line, error.message);
+        return false;
+    }
+    return true;
+}
+
+static int CompileFile(int argc, char **argv)
+{
+    if (argc < 1)
+        return 2;
+    FILE *file = fopen(argv[0], "rb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[0]);
+        return 1;
+    }
+    std::string source;
+    char chunk[512];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        source.append(chunk, read);
+    fclose(file);
+
+    led_script_program_t program;
+    if (!Compile(source, program, argv[0]))
+        return 1;
+    led_script_disassemble(
+        &program, [](const char *line, void *) { printf("%s\n", line); }, nullptr);
+    printf("%u instructions per frame + %u per pixel, %" PRIu32 " pixels within the budget of %d\n",
+           program.frame_len, program.pixel_len,
+           program.pixel_len ? (CONFIG_LED_SCRIPT_BUDGET - program.frame_len) / program.pixel_len : UINT32_MAX,
+           CONFIG_LED_SCRIPT_BUDGET);
+    return 0;
+}
+
+// --- check ---
+
+static int failures = 0;
+
+static void Expect(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void RandomFrame(std::mt19937 &random, Frame &frame)
+{
+    for (rgb_t &pixel : frame)
+    {
+        uint32_t value = random();
+        pixel = rgb_t{(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16)};
+    }
+}
+
+static void CheckAgainstNative(const Example &example)
+{
+    led_script_program_t program;
+    if (!Compile(example.source, program, example.name))
+    {
+        failures++;
+        return;
+    }
+
+    std::mt19937 random(7);
+    for (int32_t n : {1, 2, 7, 150, 800})
+    {
+        Frame vm(n), native(n);
+        for (uint32_t t = 0; t < 300; t += 7)
+        {
+            RandomFrame(random, vm);
+            native = vm;
+            Frame before = vm;
+
+            uint32_t rng = 1;
+            rgb_sum_t added = {};
+            uint32_t executed = led_script_run(&program, vm.data(), (uint16_t)n, t, UINT32_MAX, &rng, &added);
+            example.native(t, n, native);
+
+            std::string what = std::string(example.name) + " n=" + std::to_string(n) + " t=" + std::to_string(t);
+            Expect(memcmp(vm.data(), native.data(), n * sizeof(rgb_t)) == 0, (what + ": pixels").c_str());
+            Expect(executed == program.frame_len + (uint32_t)n * program.pixel_len, (what + ": cost").c_str());
+
+            int64_t red = 0;
+            for (int32_t i = 0; i < n; i++)
+                red += vm[i].red - before[i].red;
+            Expect(added.red == red, (what + ": added light").c_str());
+        }
+    }
+}
+
+static void CheckErrors()
+{
+    static const struct
+    {
+        const char *source;
+        esp_err_t result;
+        uint16_t line;
+        const char *message;
+    } cases[] = {
+        {"r = 1\nr = 2\n", ESP_ERR_INVALID_ARG, 2, "name is already assigned"},
+        {"i = 3\n", ESP_ERR_INVALID_ARG, 1, "name is already assigned"},
+        {"x = 1\n\n# comment\nr = foo + x\n", ESP_ERR_INVALID_ARG, 4, "unknown name"},
+        {"r = g\ng = 1\n", ESP_ERR_INVALID_ARG, 1, "unknown name"},
+        {"r = (1 + i\n", ESP_ERR_INVALID_ARG, 1, "expected ')'"},
+        {"r = sin(i, 2)\n", ESP_ERR_INVALID_ARG, 1, "expected ')'"},
+        {"r = cos(i)\n", ESP_ERR_INVALID_ARG, 1, "unknown function"},
+        {"r = i $ 2\n", ESP_ERR_INVALID_ARG, 1, "unexpected '$'"},
+        {"r = i \"\n", ESP_ERR_INVALID_ARG, 1, "unexpected character 0x22"},
+        {"r = 99999999999\n", ESP_ERR_INVALID_ARG, 1, "number too large"},
+        {"r = 1 2\n", ESP_ERR_INVALID_ARG, 1, "expected end of line"},
+        {"r + 1\n", ESP_ERR_INVALID_ARG, 1, "expected '='"},
+        {"= 1\n", ESP_ERR_INVALID_ARG, 1, "expected an assignment"},
+        {"r = \n", ESP_ERR_INVALID_ARG, 1, "expected a value"},
+    };
+    for (const auto &c : cases)
+    {
+        led_script_program_t program;
+        led_script_error_t error;
+        esp_err_t result = led_script_compile(c.source, strlen(c.source), &program, &error);
+        bool ok = result == c.result && error.line == c.line && strcmp(error.message, c.message) == 0;
+        if (!ok)
+            fprintf(stderr, "  got %s, line %u: %s\n", esp_err_to_name(result), error.line, error.message);
+        Expect(ok, c.source);
+    }
+
+    // 65 pixel instructions
+    std::string big = "x0 = i * 3\n";
+    for (int k = 1; k <= 64; k++)
+        big += "x" + std::to_string(k) + " = x" + std::to_string(k - 1) + " + i\n";
+    led_script_program_t program;
+    led_script_error_t error;
+    Expect(led_script_compile(big.data(), big.size(), &program, &error) == ESP_ERR_INVALID_SIZE,
+           "too many instructions");
+
+    std::string nested = "r = i";
+    for (int k = 0; k < 30; k++)
+        nested += " + (i * (" + std::to_string(k + 2);
+    nested += std::string(60, ')') + "\n";
+    Expect(led_script_compile(nested.data(), nested.size(), &program, &error) == ESP_ERR_INVALID_SIZE,
+           "too many registers");
+
+    std::string longSource(LED_SCRIPT_SOURCE_MAX + 1, '#');
+    Expect(led_script_compile(longSource.data(), longSource.size(), &program, &error) == ESP_ERR_INVALID_SIZE,
+           "source too long");
+}
+
+static void CheckOptimizations()
+{
+    led_script_program_t program;
+    Frame frame(10, rgb_t{1, 2, 3});
+    uint32_t rng = 1;
+    rgb_sum_t added = {};
+
+    // Folded completely, the outputs are initial register values
+    Expect(Compile("r = 2 * 3 + 4\ng = (100 - 1) / 0\nb = -(-5) % 3 + max(1, 2)\n", program, "folding") &&
+               program.frame_len == 0 && program.pixel_len == 0,
+           "constant folding");
+    led_script_run(&program, frame.data(), (uint16_t)frame.size(), 0, UINT32_MAX, &rng, &added);
+    Expect(frame[9].red == 11 && frame[9].green == 2 && frame[9].blue == 7, "folded outputs");
+
+    // Only depends on the frame: hoisted, nothing runs per pixel
+    Expect(Compile("k = t * 3\nr = tri(k) + n\n", program, "hoisting") && program.frame_len == 3 &&
+               program.pixel_len == 0,
+           "frame invariant code hoisted");
+
+    // Invariant part of a pixel expression computed once per frame
+    Expect(Compile("r = i + scale(t, 7) * 2\n", program, "mixed") && program.frame_len == 2 &&
+               program.pixel_len == 1,
+           "invariant subexpression hoisted");
+
+    // Equal constants share a register
+    Expect(Compile("r = i * 77\ng = i + 77\nb = 77 - i\n", program, "constants") &&
+               __builtin_popcount(program.constant_mask) == 1,
+           "constants deduplicated");
+}
+
+static void CheckBudget()
+{
+    led_script_program_t program;
+    if (!Compile("x = i * 2 + t\nr = x\ng = 200\n", program, "budget"))
+    {
+        failures++;
+        return;
+    }
+
+    const uint16_t leds = 100;
+    Frame frame(leds, rgb_t{0, 0, 0});
+    uint32_t rng = 1;
+    rgb_sum_t added = {};
+    uint32_t budget = program.frame_len + 10 * program.pixel_len + program.pixel_len - 1;
+    uint32_t executed = led_script_run(&program, frame.data(), leds, 1, budget, &rng, &added);
+    Expect(executed == program.frame_len + 10u * program.pixel_len, "budget: instructions executed");
+    Expect(frame[9].red == 19 && frame[9].green == 200, "budget: pixels within the budget rendered");
+    Expect(frame[10].red == 0 && frame[10].green == 0, "budget: pixels beyond the budget unchanged");
+    Expect(added.green == 10 * 200, "budget: added light");
+
+    executed = led_script_run(&program, frame.data(), leds, 1, program.frame_len > 0 ? program.frame_len - 1 : 0,
+                              &rng, &added);
+    Expect(executed == 0 || program.frame_len == 0, "budget: no frame below the prologue");
+}
+
+static void CheckFunctions()
+{
+    led_script_program_t program;
+    const uint16_t leds = 256;
+    Frame frame(leds);
+    uint32_t rng = 1;
+    rgb_sum_t added = {};
+
+    // sin() from a quarter wave table of 127 * sin, within rounding of the exact value
+    Expect(Compile("r = sin(i)\ng = sin(i + 256 * 1000) - sin(i) + 10\nb = sin(-i - 1) / 2\n", program, "sin"),
+           "sin compiles");
+    std::fill(frame.begin(), frame.end(), rgb_t{0, 0, 0});
+    led_script_run(&program, frame.data(), leds, 0, UINT32_MAX, &rng, &added);
+    int worst = 0;
+    for (int i = 0; i < leds; i++)
+    {
+        int exact = (int)lround(128 + 127 * sin(i * 2 * M_PI / 256));
+        worst = std::max(worst, std::abs(frame[i].red - exact));
+        Expect(frame[i].green == 10, "sin: period of 256");
+    }
+    Expect(worst <= 1, "sin: accuracy");
+    Expect(frame[64].red == 255 && frame[192].red == 1, "sin: extremes");
+
+    // noise(): stable per input, spread over 0..255
+    Expect(Compile("r = noise(i, t)\ng = noise(i, t)\nb = noise(t, i)\n", program, "noise"), "noise compiles");
+    std::fill(frame.begin(), frame.end(), rgb_t{0, 0, 0});
+    led_script_run(&program, frame.data(), leds, 5, UINT32_MAX, &rng, &added);
+    int64_t sum = 0, differs = 0;
+    for (const rgb_t &pixel : frame)
+    {
+        sum += pixel.red;
+        differs += pixel.red != pixel.blue;
+        Expect(pixel.red == pixel.green, "noise: deterministic");
+    }
+    Expect(sum / leds > 100 && sum / leds < 155 && differs > leds / 2, "noise: distribution");
+
+    // rand(): xorshift32, a new value for every call
+    Expect(Compile("r = rand()\ng = rand()\n", program, "rand"), "rand compiles");
+    std::fill(frame.begin(), frame.end(), rgb_t{0, 0, 0});
+    rng = 12345;
+    led_script_run(&program, frame.data(), leds, 0, UINT32_MAX, &rng, &added);
+    uint32_t x = 12345;
+    bool same = true;
+    for (const rgb_t &pixel : frame)
+    {
+        for (uint8_t channel : {pixel.red, pixel.green})
+        {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            same &= channel == (uint8_t)(x >> 24);
+        }
+    }
+    Expect(same && rng == x, "rand: sequence");
+}
+
+static int Check()
+{
+    for (const Example &example : Examples())
+    {
+        if (example.native)
+            CheckAgainstNative(example);
+        else
+        {
+            led_script_program_t program;
+            Expect(Compile(example.source, program, example.name), example.name);
+        }
+    }
+    CheckErrors();
+    CheckOptimizations();
+    CheckBudget();
+    CheckFunctions();
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("script checks passed\n");
+    return 0;
+}
+
+// --- bench ---
+
+using Clock = std::chrono::steady_clock;
+
+// Average time of one call in us, repeated for the given time
+static double Measure(double seconds, const std::function<void(uint32_t frame)> &render)
+{
+    uint32_t frames = 0;
+    Clock::time_point begin = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        for (int k = 0; k < 16; k++)
+            render(frames++);
+        elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+    return elapsed * 1e6 / frames;
+}
+
+static double BenchEffect(led_effect_type_t type, uint16_t leds, double seconds)
+{
+    led_segment_t segment = {};
+    strncpy(segment.name, "bench", sizeof(segment.name) - 1);
+    segment.start = 0;
+    segment.leds = leds;
+    led_segment_set(&segment, 1);
+    led_effect_config_t config = {(uint8_t)type, 32, 255, rgb_t{255, 120, 40}};
+    led_effect_set("bench", &config);
+    led_effect_segments_changed();
+
+    Frame frame(leds, rgb_t{20, 20, 20});
+    double us = Measure(seconds, [&](uint32_t) {
+        std::fill(frame.begin(), frame.end(), rgb_t{20, 20, 20});
+        rgb_sum_t sum = {};
+        led_effect_render(frame.data(), frame.size(), &sum);
+    });
+
+    config.type = LED_EFFECT_NONE;
+    led_effect_set("bench", &config);
+    led_segment_set(nullptr, 0);
+    return us;
+}
+
+static int Bench(int argc, char **argv)
+{
+    uint16_t leds = CONFIG_LED_STRIP_MAX_LEDS;
+    double seconds = 0.5;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--leds")
+            leds = (uint16_t)std::clamp(atoi(argv[i + 1]), 1, 65535);
+        else if (arg == "--seconds")
+            seconds = atof(argv[i + 1]);
+        else
+            return 2;
+    }
+
+    double frame_us = 1e6 / CONFIG_LED_EFFECT_FRAME_RATE;
+    printf("%u pixels, budget %d instructions per frame\n\n", leds, CONFIG_LED_SCRIPT_BUDGET);
+    printf("%-10s %6s %8s %10s %10s %7s\n", "script", "instr", "pixels", "vm us", "native us", "ratio");
+
+    Frame frame(leds);
+    for (const Example &example : Examples())
+    {
+        led_script_program_t program;
+        if (!Compile(example.source, program, example.name))
+            return 1;
+
+        // Unbudgeted, the time of the whole segment
+        uint32_t rng = 1;
+        double vm_us = Measure(seconds, [&](uint32_t t) {
+            std::fill(frame.begin(), frame.end(), rgb_t{20, 20, 20});
+            rgb_sum_t added = {};
+            led_script_run(&program, frame.data(), leds, t, UINT32_MAX, &rng, &added);
+        });
+        uint32_t fits = program.pixel_len ? (CONFIG_LED_SCRIPT_BUDGET - program.frame_len) / program.pixel_len : leds;
+
+        printf("%-10s %2u+%-3u %8u %10.2f", example.name, program.frame_len, program.pixel_len,
+               std::min<uint32_t>(fits, leds), vm_us);
+        if (example.native)
+        {
+            double native_us = Measure(seconds, [&](uint32_t t) {
+                std::fill(frame.begin(), frame.end(), rgb_t{20, 20, 20});
+                example.native(t, leds, frame);
+            });
+            printf(" %10.2f %6.1fx\n", native_us, vm_us / native_us);
+        }
+        else
+        {
+            printf(" %10s %7s\n", "-", "-");
+        }
+    }
+
+    printf("\nbuilt-in effects\n");
+    static const struct
+    {
+        const char *name;
+        led_effect_type_t type;
+    } effects[] = {{"fire", LED_EFFECT_FIRE}, {"chase", LED_EFFECT_CHASE}, {"lantern", LED_EFFECT_LANTERN}};
+    for (const auto &effect : effects)
+    {
+        printf("%-10s %26.2f\n", effect.name, BenchEffect(effect.type, leds, seconds));
+    }
+    printf("\nframe time at %d fps: %.0f us\n", CONFIG_LED_EFFECT_FRAME_RATE, frame_us);
+    return 0;
+}
+
+static void Usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s compile FILE\n"
+            "       %s check\n"
+            "       %s bench [--leds N] [--seconds S]\n",
+            program, program, program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::string command = argv[1];
+    int result = 2;
+    if (command == "compile")
+        result = CompileFile(argc - 2, argv + 2);
+    else if (command == "check")
+        result = Check();
+    else if (command == "bench")
+        result = Bench(argc - 2, argv + 2);
+
+    if (result == 2)
+        Usage(argv[0]);
+    return result;
+}
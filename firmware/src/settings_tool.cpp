@@ -0,0 +1,421 @@
+// Host tool for the settings store (see persistence_manager.h):
+//
+//   settings_tool check
+//   settings_tool bench [--seconds S]
+//
+// check writes, reads, removes and clears values through the persistence manager and compares every read
+// with the value expected in NVS, so the RAM cache in front of NVS never serves a stale or mistyped value.
+// It also checks when the write-behind journal reaches NVS: after the quiet period, at the maximum delay
+// while writes keep coming in, when it is full, and before esp_restart(). Settings of the registry
+// (settings_registry.h) have to resolve by name, read as their default until stored and refuse reads of
+// another type.
+// bench measures the three reads create_light_status_json() does on every status update ("light_active",
+// "light_mode", "light_variant"), once directly from NVS as before the cache and once through the registry.
+// NVS is a std::map on the host; on the device every uncached read also searches the flash pages. It then
+// drags a brightness slider and scrolls through a menu on the virtual clock and counts the NVS writes.
+
+#include "host/host.h"
+#include "persistence_manager.h"
+#include "settings_registry.h"
+
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unistd.h>
+
+static int failures = 0;
+
+static void Expect(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static std::string GetString(const persistence_manager_t *pm, const char *key, size_t max_len)
+{
+    char buffer[64];
+    persistence_manager_get_string(pm, key, buffer, max_len, "-");
+    return buffer;
+}
+
+// Value of a key as it is on the flash, bypassing the journal
+static int32_t Stored(const persistence_manager_t *pm, const char *key)
+{
+    int32_t value = -1;
+    nvs_get_i32(pm->nvs_handle, key, &value);
+    return value;
+}
+
+static void CheckRestart()
+{
+    // Registered before the persistence manager registers its handler, so it runs after the journal was flushed
+    persistence_manager_t pm;
+    persistence_manager_init(&pm, "check");
+    bool stored = Stored(&pm, "restart") == 42;
+    Expect(stored, "esp_restart() writes the journal");
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        fflush(nullptr);
+        _exit(1);
+    }
+    printf("settings checks passed\n");
+}
+
+static void CheckRegistry()
+{
+    for (int id = 0; id < SETTING_COUNT; id++)
+        Expect(settings_find(settings_registry[id].name) == id, "registered names resolve to their ID");
+    Expect(settings_find("light") == SETTING_COUNT && settings_find(nullptr) == SETTING_COUNT,
+           "unknown names do not resolve");
+
+    persistence_manager_t pm;
+    persistence_manager_init(&pm, "config");
+    persistence_manager_remove_key(&pm, "light_variant");
+    settings_value_t value = settings_int(-1);
+    Expect(!settings_try_get(SETTING_LIGHT_VARIANT, &value) &&
+               value.int_value == settings_registry[SETTING_LIGHT_VARIANT].default_value.int_value,
+           "a missing setting reads as its default");
+    SETTINGS_SET_INT(LIGHT_VARIANT, 4);
+    Expect(SETTINGS_GET_INT(LIGHT_VARIANT) == 4 && persistence_manager_get_int(&pm, "light_variant", 0) == 4,
+           "settings are stored under their name");
+
+    SETTINGS_SET_BOOL(LIGHT_ACTIVE, true);
+    Expect(settings_get_int(SETTING_LIGHT_ACTIVE) == 0, "a read of another type returns the default");
+    settings_set(SETTING_COUNT, settings_int(1));
+    Expect(settings_get_int(SETTING_COUNT) == 0, "unknown IDs are refused");
+}
+
+static void CheckJournal()
+{
+    persistence_manager_t pm;
+    persistence_manager_init(&pm, "journal");
+    persistence_manager_write_stats_t before, after;
+
+    // A slider drag at 50 Hz is one write once it stops
+    persistence_manager_flush();
+    persistence_manager_get_write_stats(&before);
+    for (int i = 1; i <= 100; i++)
+    {
+        persistence_manager_set_int(&pm, "brightness", i);
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    Expect(persistence_manager_get_int(&pm, "brightness", 0) == 100, "pending value is read back");
+    Expect(Stored(&pm, "brightness") == -1, "nothing is written during the drag");
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_PERSISTENCE_WRITE_DELAY_MS + 100));
+    Expect(Stored(&pm, "brightness") == 100, "last value is written after the quiet period");
+    persistence_manager_get_write_stats(&after);
+    Expect(after.writes - before.writes == 100 && after.flash_writes - before.flash_writes == 1 &&
+               after.saved - before.saved == 99 && after.commits - before.commits == 1 && after.pending == 0,
+           "drag counts one flash write and one commit");
+
+    // Writes that never pause still reach the flash after the maximum delay
+    int written = -1;
+    for (int i = 0; i < 2 * CONFIG_PERSISTENCE_WRITE_MAX_DELAY_MS / 100; i++)
+    {
+        persistence_manager_set_int(&pm, "scroll", i);
+        vTaskDelay(pdMS_TO_TICKS(100));
+        if (written < 0 && Stored(&pm, "scroll") >= 0)
+            written = i;
+    }
+    Expect(written >= 0 && written <= CONFIG_PERSISTENCE_WRITE_MAX_DELAY_MS / 100 + 1, "maximum delay is kept");
+
+    // Long strings and blobs wait in the journal as copies
+    const char *long_value = "a string longer than the cached strings of 31 characters";
+    persistence_manager_set_string(&pm, "long", long_value);
+    Expect(GetString(&pm, "long", 64) == long_value, "pending long string is read back");
+    const uint8_t blob[40] = {1, 2, 3, 4, 5};
+    uint8_t read[40] = {};
+    size_t length = 0;
+    persistence_manager_set_blob(&pm, "blob", blob, sizeof(blob));
+    Expect(persistence_manager_get_blob(&pm, "blob", read, sizeof(read), &length) && length == sizeof(blob) &&
+               memcmp(read, blob, sizeof(blob)) == 0,
+           "pending blob is read back");
+    Expect(persistence_manager_has_key(&pm, "blob"), "pending blob exists");
+
+    // save() and a full journal write right away
+    persistence_manager_set_int(&pm, "saved", 5);
+    persistence_manager_save(&pm);
+    Expect(Stored(&pm, "saved") == 5, "save() writes the journal");
+    char key[16];
+    for (int i = 0; i < 20; i++)
+    {
+        snprintf(key, sizeof(key), "full_%d", i);
+        persistence_manager_set_int(&pm, key, i);
+    }
+    Expect(Stored(&pm, "full_0") == 0, "full journal is written");
+
+    // Removing a pending key drops the write
+    persistence_manager_set_int(&pm, "removed", 1);
+    persistence_manager_remove_key(&pm, "removed");
+    Expect(persistence_manager_get_int(&pm, "removed", 7) == 7, "removed pending key returns the default");
+    persistence_manager_flush();
+    Expect(Stored(&pm, "removed") == -1, "removed pending key is not written");
+
+    // A write NVS refuses is not counted as a flash write
+    persistence_manager_t closed = pm;
+    closed.nvs_handle = 0;
+    persistence_manager_get_write_stats(&before);
+    persistence_manager_set_int(&closed, "refused", 1);
+    persistence_manager_flush();
+    persistence_manager_get_write_stats(&after);
+    Expect(after.writes - before.writes == 1 && after.flash_writes == before.flash_writes && after.pending == 0,
+           "refused write is not counted as a flash write");
+}
+
+// --- check ---
+
+static int Check()
+{
+    host_scheduler_init();
+    esp_register_shutdown_handler(CheckRestart);
+    settings_init();
+
+    persistence_manager_t pm, other;
+    persistence_manager_init(&pm, "check");
+    persistence_manager_init(&other, "check_other");
+
+    // A miss is cached as missing, the next write replaces it
+    Expect(persistence_manager_get_int(&pm, "mode", 7) == 7, "missing int returns the default");
+    persistence_manager_set_int(&pm, "mode", 2);
+    Expect(persistence_manager_get_int(&pm, "mode", 7) == 2, "write after a miss is visible");
+    persistence_manager_set_int(&pm, "mode", 3);
+    Expect(persistence_manager_get_int(&pm, "mode", 7) == 3, "overwrite is visible");
+
+    int32_t value = 0;
+    Expect(persistence_manager_try_get_int(&pm, "mode", &value) && value == 3, "try_get finds a stored int");
+    bool flag = true;
+    Expect(!persistence_manager_try_get_bool(&pm, "unknown", &flag) && flag, "try_get leaves a missing bool alone");
+
+    // Types are kept apart like in NVS
+    Expect(persistence_manager_get_bool(&pm, "mode", true), "int read as bool returns the default");
+    Expect(persistence_manager_get_int(&pm, "mode", 7) == 3, "int stays readable after a mistyped read");
+    persistence_manager_set_bool(&pm, "active", true);
+    Expect(persistence_manager_get_bool(&pm, "active", false), "bool is visible");
+    persistence_manager_set_float(&pm, "gain", 0.5f);
+    Expect(persistence_manager_get_double(&pm, "gain", 2.0) == 2.0, "float read as double returns the default");
+    Expect(persistence_manager_get_float(&pm, "gain", 2.0f) == 0.5f, "float is visible");
+    float gain = 2.0f;
+    Expect(persistence_manager_try_get_float(&pm, "gain", &gain) && gain == 0.5f, "try_get finds a stored float");
+    Expect(!persistence_manager_try_get_float(&pm, "ratio", &gain) && gain == 0.5f,
+           "try_get leaves a missing float alone");
+    persistence_manager_set_double(&pm, "ratio", 0.25);
+    Expect(persistence_manager_get_double(&pm, "ratio", 2.0) == 0.25, "double is visible");
+
+    // Namespaces do not share values
+    Expect(persistence_manager_get_int(&other, "mode", 7) == 7, "other namespace does not see the value");
+    persistence_manager_set_int(&other, "mode", 9);
+    Expect(persistence_manager_get_int(&pm, "mode", 7) == 3, "other namespace does not overwrite the value");
+
+    // Strings: short ones are cached, long ones read from NVS; both honor the buffer size
+    persistence_manager_set_string(&pm, "name", "harbor");
+    Expect(GetString(&pm, "name", 64) == "harbor", "string is visible");
+    Expect(GetString(&pm, "name", 6) == "-", "string longer than the buffer returns the default");
+    Expect(GetString(&pm, "name", 7) == "harbor", "string that just fits is returned");
+    const char *long_value = "a string longer than the cached strings of 31 characters";
+    persistence_manager_set_string(&pm, "name", long_value);
+    Expect(GetString(&pm, "name", 64) == long_value, "long string replaces a cached one");
+    Expect(GetString(&pm, "name", 64) == long_value, "long string is read again");
+    persistence_manager_set_string(&pm, "name", "dock");
+    Expect(GetString(&pm, "name", 64) == "dock", "short string replaces a long one");
+
+    // Blobs are not cached, but a blob write replaces a cached value of the same key
+    persistence_manager_set_blob(&pm, "mode", "xy", 2);
+    Expect(persistence_manager_get_int(&pm, "mode", 7) == 7, "blob write forgets the int");
+
+    // Removal and clearing
+    persistence_manager_remove_key(&pm, "active");
+    Expect(!persistence_manager_get_bool(&pm, "active", false), "removed key returns the default");
+    persistence_manager_clear(&pm);
+    Expect(persistence_manager_get_double(&pm, "ratio", 2.0) == 2.0, "cleared namespace returns the default");
+    Expect(GetString(&pm, "name", 64) == "-", "cleared string returns the default");
+    Expect(persistence_manager_get_int(&other, "mode", 7) == 9, "clear keeps the other namespace");
+
+    // More keys than cache entries: the oldest are replaced and read from NVS again
+    char key[16];
+    for (int i = 0; i < 100; i++)
+    {
+        snprintf(key, sizeof(key), "key_%d", i);
+        persistence_manager_set_int(&pm, key, i * 3);
+    }
+    for (int round = 0; round < 2; round++)
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            snprintf(key, sizeof(key), "key_%d", i);
+            if (persistence_manager_get_int(&pm, key, -1) != i * 3)
+            {
+                Expect(false, "value survives replacement in the cache");
+                break;
+            }
+        }
+    }
+
+    // Keys too long for NVS are not cached either
+    Expect(persistence_manager_get_int(&pm, "a_key_of_twenty_chars", 5) == 5, "overlong key returns the default");
+
+    // Repeated reads of a hot key are hits
+    persistence_manager_set_int(&pm, "light_mode", 1);
+    persistence_manager_cache_stats_t before, after;
+    persistence_manager_get_cache_stats(&before);
+    for (int i = 0; i < 1000; i++)
+        persistence_manager_get_int(&pm, "light_mode", 0);
+    persistence_manager_get_cache_stats(&after);
+    Expect(after.hits - before.hits == 1000 && after.misses == before.misses, "hot key is served from RAM");
+
+    CheckRegistry();
+    CheckJournal();
+
+    persistence_manager_set_int(&pm, "pending", 1);
+    persistence_manager_factory_reset();
+    Expect(persistence_manager_get_int(&pm, "light_mode", 0) == 0, "factory reset forgets the values");
+    Expect(persistence_manager_get_int(&other, "mode", 7) == 7, "factory reset forgets every namespace");
+    persistence_manager_flush();
+    Expect(Stored(&pm, "pending") == -1, "factory reset drops the journal");
+
+    // Ends the process through CheckRestart()
+    persistence_manager_set_int(&pm, "restart", 42);
+    esp_restart();
+}
+
+// --- bench ---
+
+using Clock = std::chrono::steady_clock;
+
+static double Measure(double seconds, const std::function<void()> &pass)
+{
+    uint64_t passes = 0;
+    Clock::time_point begin = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        for (int k = 0; k < 256; k++, passes++)
+            pass();
+        elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+    return elapsed * 1e9 / passes;
+}
+
+static int Bench(int argc, char **argv)
+{
+    double seconds = 1.0;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--seconds")
+            seconds = atof(argv[i + 1]);
+        else
+            return 2;
+    }
+    host_scheduler_init();
+    settings_init();
+
+    persistence_manager_t pm;
+    persistence_manager_init(&pm, "config");
+    persistence_manager_set_bool(&pm, "light_active", true);
+    persistence_manager_set_int(&pm, "light_mode", 1);
+    persistence_manager_set_int(&pm, "light_variant", 3);
+    // Other settings of the device, so the store is not trivially small
+    char key[16];
+    for (int i = 0; i < 40; i++)
+    {
+        snprintf(key, sizeof(key), "setting_%d", i);
+        persistence_manager_set_int(&pm, key, i);
+    }
+    persistence_manager_flush();
+
+    volatile int32_t sink = 0;
+    double nvs_ns = Measure(seconds, [&] {
+        uint8_t active = 0;
+        int32_t mode = 0, variant = 0;
+        nvs_get_u8(pm.nvs_handle, "light_active", &active);
+        nvs_get_i32(pm.nvs_handle, "light_mode", &mode);
+        nvs_get_i32(pm.nvs_handle, "light_variant", &variant);
+        sink = active + mode + variant;
+    });
+
+    persistence_manager_cache_stats_t before, after;
+    persistence_manager_get_cache_stats(&before);
+    double cached_ns = Measure(seconds, [&] {
+        bool active = SETTINGS_GET_BOOL(LIGHT_ACTIVE);
+        int32_t mode = SETTINGS_GET_INT(LIGHT_MODE);
+        int32_t variant = SETTINGS_GET_INT(LIGHT_VARIANT);
+        sink = active + mode + variant;
+    });
+    persistence_manager_get_cache_stats(&after);
+    (void)sink;
+
+    uint32_t hits = after.hits - before.hits, misses = after.misses - before.misses;
+    printf("3 reads of the light status (%u cached keys)\n", (unsigned)after.entries);
+    printf("  nvs                %8.1f ns  %6.1f ns per read\n", nvs_ns, nvs_ns / 3);
+    printf("  cache              %8.1f ns  %6.1f ns per read  %.1fx\n", cached_ns, cached_ns / 3,
+           nvs_ns / cached_ns);
+    printf("  hit rate           %8.4f %%\n", 100.0 * hits / (hits + misses));
+
+    // A 3 s slider drag at 50 Hz, a pause, then scrolling through 12 menu entries that each store their value
+    persistence_manager_write_stats_t write_before, write_after;
+    persistence_manager_get_write_stats(&write_before);
+    for (int i = 0; i < 150; i++)
+    {
+        persistence_manager_set_int(&pm, "brightness", i % 100);
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    for (int i = 0; i < 36; i++)
+    {
+        snprintf(key, sizeof(key), "setting_%d", i % 12);
+        persistence_manager_set_int(&pm, key, i);
+        vTaskDelay(pdMS_TO_TICKS(150));
+    }
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_PERSISTENCE_WRITE_MAX_DELAY_MS));
+    persistence_manager_get_write_stats(&write_after);
+
+    uint32_t writes = write_after.writes - write_before.writes;
+    uint32_t flash_writes = write_after.flash_writes - write_before.flash_writes;
+    printf("slider drag and menu scroll (%d ms quiet period)\n", CONFIG_PERSISTENCE_WRITE_DELAY_MS);
+    printf("  writes             %8u\n", (unsigned)writes);
+    printf("  flash writes       %8u  %u saved\n", (unsigned)flash_writes,
+           (unsigned)(write_after.saved - write_before.saved));
+    printf("  commits            %8u\n", (unsigned)(write_after.commits - write_before.commits));
+    fflush(nullptr);
+    _exit(0);
+}
+
+static void Usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s check\n"
+            "       %s bench [--seconds S]\n",
+            program, program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::string command = argv[1];
+    int result = 2;
+    if (command == "check")
+        result = Check();
+    else if (command == "bench")
+        result = Bench(argc - 2, argv + 2);
+
+    if (result == 2)
+        Usage(argv[0]);
+    return result;
+}